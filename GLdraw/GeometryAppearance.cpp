@@ -7,6 +7,7 @@
 #include "drawextra.h"
 #include <meshing/PointCloud.h>
 #include <meshing/VolumeGrid.h>
+#include <meshing/SparseVolumeGrid.h>
 #include <meshing/Expand.h>
 #include <geometry/Conversions.h>
 #include "Timer.h"
@@ -311,9 +312,11 @@ void GeometryAppearance::Set(const AnyGeometry3D& _geom)
 {
   geom = &_geom;
   if(geom->type == AnyGeometry3D::ImplicitSurface) {
-    const Meshing::VolumeGrid* g = &geom->AsImplicitSurface();
     if(!implicitSurfaceMesh) implicitSurfaceMesh = new Meshing::TriMesh;
-    ImplicitSurfaceToMesh(*g,*implicitSurfaceMesh);
+    if(geom->IsSparseImplicitSurface())
+      ImplicitSurfaceToMesh(geom->AsSparseImplicitSurface(),*implicitSurfaceMesh);
+    else
+      ImplicitSurfaceToMesh(geom->AsImplicitSurface(),*implicitSurfaceMesh);
     drawFaces = true;
   }
   else if(geom->type == AnyGeometry3D::PointCloud) {
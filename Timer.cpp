@@ -1,5 +1,11 @@
 #include "Timer.h"
+#include <utils/threadutils.h>
 #include <stdlib.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
 
 #ifdef _WIN32
 #include <windows.h>
@@ -102,6 +108,40 @@ double Timer::LastElapsedTime() const
 #endif //_WIN32
 }
 
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+unsigned long long ReadCycleCounter() { return __rdtsc(); }
+
+static Mutex cycleCounterMutex;
+
+double CycleCounterFrequency()
+{
+  //calibrate once, even if several threads ask at the same time
+  static double frequency = 0;
+  ScopedLock lock(cycleCounterMutex);
+  if(frequency == 0) {
+    Timer timer;
+    unsigned long long start = ReadCycleCounter();
+    double t;
+    while((t=timer.ElapsedTime()) < 0.005) {}
+    frequency = double(ReadCycleCounter()-start)/t;
+  }
+  return frequency;
+}
+#else
+unsigned long long ReadCycleCounter()
+{
+  TimerCounterType t;
+  GETCURRENTTIME(t);
+#ifdef _POSIX_MONOTONIC_CLOCK
+  return (unsigned long long)t.tv_sec*1000000000ull + (unsigned long long)t.tv_nsec;
+#else
+  return (unsigned long long)t.tv_sec*1000000000ull + (unsigned long long)t.tv_usec*1000ull;
+#endif
+}
+
+double CycleCounterFrequency() { return 1e9; }
+#endif
+
 /*
 clock_t Timer::ElapsedTicks()
 {
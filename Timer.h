@@ -22,4 +22,17 @@ class Timer
   TimerImpl* impl;
 };
 
+/** @brief Reads a fast cycle counter, for timing very short calls.
+ *
+ * This is the processor's time-stamp counter on x86, and a nanosecond
+ * monotonic clock elsewhere.  Only differences between readings are
+ * meaningful; convert them to seconds by dividing by CycleCounterFrequency().
+ */
+unsigned long long ReadCycleCounter();
+
+///Returns the number of cycle counter ticks per second.  On x86 this is
+///calibrated against the system clock on the first call, which takes a few
+///milliseconds.
+double CycleCounterFrequency();
+
 #endif
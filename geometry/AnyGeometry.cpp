@@ -1,6 +1,7 @@
 #include "AnyGeometry.h"
 #include <math3d/geometry3d.h>
 #include <meshing/VolumeGrid.h>
+#include <meshing/SparseVolumeGrid.h>
 #include <meshing/Voxelize.h>
 #include <GLdraw/GeometryAppearance.h>
 #include "CollisionPointCloud.h"
@@ -37,6 +38,10 @@ AnyGeometry3D::AnyGeometry3D(const Meshing::VolumeGrid& grid)
   :type(ImplicitSurface),data(grid)
 {}
 
+AnyGeometry3D::AnyGeometry3D(const Meshing::SparseVolumeGrid& grid)
+  :type(ImplicitSurface),data(grid)
+{}
+
 AnyGeometry3D::AnyGeometry3D(const vector<AnyGeometry3D>& group)
   :type(Group),data(group)
 {}
@@ -49,13 +54,17 @@ const GeometricPrimitive3D& AnyGeometry3D::AsPrimitive() const { return *AnyCast
 const Meshing::TriMesh& AnyGeometry3D::AsTriangleMesh() const { return *AnyCast_Raw<Meshing::TriMesh>(&data); }
 const Meshing::PointCloud3D& AnyGeometry3D::AsPointCloud() const { return *AnyCast_Raw<Meshing::PointCloud3D>(&data); }
 const Meshing::VolumeGrid& AnyGeometry3D::AsImplicitSurface() const { return *AnyCast_Raw<Meshing::VolumeGrid>(&data); }
+const Meshing::SparseVolumeGrid& AnyGeometry3D::AsSparseImplicitSurface() const { return *AnyCast_Raw<Meshing::SparseVolumeGrid>(&data); }
 const vector<AnyGeometry3D>& AnyGeometry3D::AsGroup() const { return *AnyCast_Raw<vector<AnyGeometry3D> >(&data); }
 GeometricPrimitive3D& AnyGeometry3D::AsPrimitive() { return *AnyCast_Raw<GeometricPrimitive3D>(&data); }
 Meshing::TriMesh& AnyGeometry3D::AsTriangleMesh() { return *AnyCast_Raw<Meshing::TriMesh>(&data); }
 Meshing::PointCloud3D& AnyGeometry3D::AsPointCloud() { return *AnyCast_Raw<Meshing::PointCloud3D>(&data); }
 Meshing::VolumeGrid& AnyGeometry3D::AsImplicitSurface() { return *AnyCast_Raw<Meshing::VolumeGrid>(&data); }
+Meshing::SparseVolumeGrid& AnyGeometry3D::AsSparseImplicitSurface() { return *AnyCast_Raw<Meshing::SparseVolumeGrid>(&data); }
 vector<AnyGeometry3D>& AnyGeometry3D::AsGroup() { return *AnyCast_Raw<vector<AnyGeometry3D> >(&data); }
 
+bool AnyGeometry3D::IsSparseImplicitSurface() const { return type == ImplicitSurface && AnyCast<Meshing::SparseVolumeGrid>(&data) != NULL; }
+
 //appearance casts
 GLDraw::GeometryAppearance* AnyGeometry3D::TriangleMeshAppearanceData() { return AnyCast<GLDraw::GeometryAppearance>(&appearanceData); }
 const GLDraw::GeometryAppearance* AnyGeometry3D::TriangleMeshAppearanceData() const { return AnyCast<GLDraw::GeometryAppearance>(&appearanceData); }
@@ -82,6 +91,7 @@ bool AnyGeometry3D::Empty() const
   case PointCloud:
     return AsPointCloud().points.empty();
   case ImplicitSurface:
+    if(IsSparseImplicitSurface()) return AsSparseImplicitSurface().IsEmpty();
     return false;
   case Group:
     return AsGroup().empty();
@@ -154,6 +164,8 @@ size_t AnyGeometry3D::NumElements() const
   case PointCloud:
     return AsPointCloud().points.size();
   case ImplicitSurface:
+    if(IsSparseImplicitSurface())
+      return AsSparseImplicitSurface().NumBlocks()*Meshing::SparseVolumeGrid::BlockCells;
     {
       IntTriple size = AsImplicitSurface().value.size();
       return size.a*size.b*size.c;
@@ -166,12 +178,12 @@ size_t AnyGeometry3D::NumElements() const
 
 bool AnyGeometry3D::CanLoadExt(const char* ext)
 {
-  return Meshing::CanLoadTriMeshExt(ext) || 0==strcmp(ext,"pcd") || 0==strcmp(ext,"vol") || 0==strcmp(ext,"geom");
+  return Meshing::CanLoadTriMeshExt(ext) || 0==strcmp(ext,"pcd") || 0==strcmp(ext,"vol") || 0==strcmp(ext,"svol") || 0==strcmp(ext,"geom");
 }
 
 bool AnyGeometry3D::CanSaveExt(const char* ext)
 {
-  return Meshing::CanSaveTriMeshExt(ext) || 0==strcmp(ext,"pcd") || 0==strcmp(ext,"vol") || 0==strcmp(ext,"geom");
+  return Meshing::CanSaveTriMeshExt(ext) || 0==strcmp(ext,"pcd") || 0==strcmp(ext,"vol") || 0==strcmp(ext,"svol") || 0==strcmp(ext,"geom");
 }
 
 bool AnyGeometry3D::Load(const char* fn)
@@ -203,6 +215,16 @@ bool AnyGeometry3D::Load(const char* fn)
     in.close();
     return true;
   }
+  else if(0==strcmp(ext,"svol")) {
+    type = ImplicitSurface;
+    data = Meshing::SparseVolumeGrid();
+    ifstream in(fn,ios::in);
+    if(!in) return false;
+    in >> this->AsSparseImplicitSurface();
+    if(!in) return false;
+    in.close();
+    return true;
+  }
   else if(0==strcmp(ext,"geom")) {
     ifstream in(fn,ios::in);
     if(!in) {
@@ -243,6 +265,15 @@ bool AnyGeometry3D::Save(const char* fn) const
     }
     break;
   case ImplicitSurface:
+    if(IsSparseImplicitSurface()) {
+      if(0!=strcmp(ext,"svol")) break;
+      ofstream out(fn,ios::out);
+      if(!out) return false;
+      out<<this->AsSparseImplicitSurface();
+      out<<endl;
+      out.close();
+      return true;
+    }
     {
     ofstream out(fn,ios::out);
     if(!out) return false;
@@ -296,6 +327,11 @@ bool AnyGeometry3D::Load(istream& in)
     data = Meshing::VolumeGrid();
     in >> this->AsImplicitSurface();
   }
+  else if(typestr == "SparseImplicitSurface") {
+    type = ImplicitSurface;
+    data = Meshing::SparseVolumeGrid();
+    in >> this->AsSparseImplicitSurface();
+  }
   else if(typestr == "Group") {
     fprintf(stderr,"AnyGeometry::Load(): TODO: groups\n");
     return false;
@@ -309,6 +345,11 @@ bool AnyGeometry3D::Load(istream& in)
 
 bool AnyGeometry3D::Save(ostream& out) const
 {
+  if(IsSparseImplicitSurface()) {
+    out<<"SparseImplicitSurface"<<endl;
+    out<<this->AsSparseImplicitSurface()<<endl;
+    return true;
+  }
   out<<TypeName()<<endl;
   switch(type) {
   case Primitive:
@@ -353,6 +394,14 @@ void AnyGeometry3D::Transform(const Matrix4& T)
       if(T(0,1) != 0 || T(0,2) != 0 || T(1,2) != 0 || T(1,0) != 0 || T(2,0) != 0 || T(2,1) != 0 ) {
 	FatalError("Cannot transform volume grid except via translation / scale");
       }
+      if(IsSparseImplicitSurface()) {
+	Meshing::SparseVolumeGrid& grid = AsSparseImplicitSurface();
+	grid.origin = T*grid.origin;
+	grid.cellSize.x *= T(0,0);
+	grid.cellSize.y *= T(1,1);
+	grid.cellSize.z *= T(2,2);
+	break;
+      }
       AsImplicitSurface().bb.bmin = T*AsImplicitSurface().bb.bmin;
       AsImplicitSurface().bb.bmax = T*AsImplicitSurface().bb.bmax;
     }
@@ -384,8 +433,9 @@ AABB3D AnyGeometry3D::GetAABB() const
     AsPointCloud().GetAABB(bb.bmin,bb.bmax);
     return bb;
   case ImplicitSurface:
-    AsImplicitSurface().bb;
-    break;
+    if(IsSparseImplicitSurface())
+      return AsSparseImplicitSurface().GetAABB();
+    return AsImplicitSurface().bb;
   case Group:
     {
       const vector<AnyGeometry3D>& items = AsGroup();
@@ -432,6 +482,12 @@ AnyCollisionGeometry3D::AnyCollisionGeometry3D(const Meshing::VolumeGrid& grid)
   currentTransform.setIdentity();
 }
 
+AnyCollisionGeometry3D::AnyCollisionGeometry3D(const Meshing::SparseVolumeGrid& grid)
+  :AnyGeometry3D(grid),margin(0)
+{
+  currentTransform.setIdentity();
+}
+
 
 AnyCollisionGeometry3D::AnyCollisionGeometry3D(const vector<AnyGeometry3D>& items)
   :AnyGeometry3D(items),margin(0)
@@ -602,7 +658,10 @@ Box3D AnyCollisionGeometry3D::GetBB() const
       ::GetBB(PointCloudCollisionData(),b);
       break;
     case ImplicitSurface:
-      b.setTransformed(AsImplicitSurface().bb,ImplicitSurfaceCollisionData());
+      if(IsSparseImplicitSurface())
+	b.setTransformed(AsSparseImplicitSurface().GetAABB(),ImplicitSurfaceCollisionData());
+      else
+	b.setTransformed(AsImplicitSurface().bb,ImplicitSurfaceCollisionData());
       break;
     case Group:
       {
@@ -659,6 +718,8 @@ Real AnyCollisionGeometry3D::Distance(const Vector3& pt)
   case Primitive:
     return Max(AsPrimitive().Distance(ptlocal)-margin,0.0);
   case ImplicitSurface:
+    if(IsSparseImplicitSurface())
+      return AsSparseImplicitSurface().TrilinearInterpolate(ptlocal);
     return AsImplicitSurface().TrilinearInterpolate(ptlocal);
   case TriangleMesh:
     {
@@ -772,6 +833,74 @@ bool Collides(const Meshing::VolumeGrid& grid,const GeometricPrimitive3D& a,Real
   return res;
 }
 
+//Returns the element index of the sparse grid cell containing pt, numbered
+//by block slot and cell within the block, or -1 if its block is unallocated
+static int SparseGridElement(const Meshing::SparseVolumeGrid& grid,const Vector3& pt)
+{
+  IntTriple cell,block,local;
+  grid.GetIndex(pt,cell);
+  Meshing::SparseVolumeGrid::GetBlockIndex(cell,block,local);
+  Meshing::SparseVolumeGrid::BlockHash::const_iterator i=grid.blockMap.find(block);
+  if(i == grid.blockMap.end()) return -1;
+  return i->second*Meshing::SparseVolumeGrid::BlockCells + (local.a*Meshing::SparseVolumeGrid::BlockSize + local.b)*Meshing::SparseVolumeGrid::BlockSize + local.c;
+}
+
+bool Collides(const Meshing::SparseVolumeGrid& grid,const GeometricPrimitive3D& a,Real margin,
+	      vector<int>& gridelements,size_t maxContacts)
+{
+  if(a.type != GeometricPrimitive3D::Point && a.type != GeometricPrimitive3D::Sphere) {
+    FatalError("Can't collide an implicit surface and a non-sphere primitive yet\n");
+  }
+  Vector3 c;
+  Real radius = 0;
+  if(a.type == GeometricPrimitive3D::Point)
+    c = *AnyCast_Raw<Vector3>(&a.data);
+  else {
+    const Sphere3D* s=AnyCast_Raw<Sphere3D>(&a.data);
+    c = s->center;
+    radius = s->radius;
+  }
+  //outside of the allocated blocks, the value is grid.defaultValue
+  bool res = (grid.TrilinearInterpolate(c) <= margin+radius);
+  if(res) {
+    gridelements.resize(0);
+    int element = SparseGridElement(grid,c);
+    if(element >= 0) gridelements.push_back(element);
+  }
+  return res;
+}
+
+//Tests the vertices of the mesh against the grid.  elements1 gets the grid
+//cells and elements2 the triangles incident to the colliding vertices.
+bool Collides(const Meshing::SparseVolumeGrid& a,const RigidTransform& Ta,const CollisionMesh& b,Real margin,
+	      vector<int>& elements1,vector<int>& elements2,size_t maxContacts)
+{
+  elements1.resize(0);
+  elements2.resize(0);
+  RigidTransform Tba;
+  Tba.mulInverseA(Ta,b.currentTransform);
+  bool res = false;
+  vector<bool> tested(b.verts.size(),false);
+  for(size_t t=0;t<b.tris.size();t++) {
+    for(int v=0;v<3;v++) {
+      int vi = b.tris[t][v];
+      if(tested[vi]) continue;
+      tested[vi] = true;
+      Vector3 plocal = Tba*b.verts[vi];
+      if(a.TrilinearInterpolate(plocal) <= margin) {
+	res = true;
+	//vertices in unallocated blocks collide but have no grid element
+	int element = SparseGridElement(a,plocal);
+	if(element < 0) continue;
+	elements1.push_back(element);
+	elements2.push_back((int)t);
+	if(elements1.size() >= maxContacts) return true;
+      }
+    }
+  }
+  return res;
+}
+
 bool Collides(const GeometricPrimitive3D& a,const GeometricPrimitive3D& b,Real margin)
 {
   if(margin==0) return a.Collides(b);
@@ -787,6 +916,15 @@ bool Collides(const GeometricPrimitive3D& a,const Meshing::VolumeGrid& b,const R
   return Collides(b,alocal,margin,gridelements,maxContacts);
 }
 
+bool Collides(const GeometricPrimitive3D& a,const Meshing::SparseVolumeGrid& b,const RigidTransform& Tb,Real margin,
+	      vector<int>& gridelements,size_t maxContacts)
+{
+  GeometricPrimitive3D alocal=a;
+  RigidTransform Tbinv; Tbinv.setInverse(Tb);
+  alocal.Transform(Tbinv);
+  return Collides(b,alocal,margin,gridelements,maxContacts);
+}
+
 bool Collides(const GeometricPrimitive3D& a,const CollisionMesh& c,Real margin,
 	      vector<int>& meshelements,size_t maxContacts)
 {
@@ -858,6 +996,13 @@ bool Collides(const GeometricPrimitive3D& a,const RigidTransform& Ta,Real margin
       return false;
     }
   case AnyCollisionGeometry3D::ImplicitSurface:
+    if(b.IsSparseImplicitSurface()) {
+      if(::Collides(aw,b.AsSparseImplicitSurface(),b.GetTransform(),margin+b.margin,elements2,maxContacts)) {
+	elements1.push_back(0);
+	return true;
+      }
+      return false;
+    }
     if(::Collides(aw,b.AsImplicitSurface(),b.GetTransform(),margin+b.margin,elements2,maxContacts)) {
       elements1.push_back(0);
       return true;
@@ -915,6 +1060,10 @@ bool Collides(const Meshing::VolumeGrid& a,const RigidTransform& Ta,Real margin,
       return false;
     }
   case AnyCollisionGeometry3D::ImplicitSurface:
+    if(b.IsSparseImplicitSurface()) {
+      FatalError("Volume grid to volume grid collisions not done\n");
+      return false;
+    }
     return ::Collides(a,Ta,b.AsImplicitSurface(),b.GetTransform(),margin+b.margin,elements1,elements2,maxContacts);
   case AnyCollisionGeometry3D::TriangleMesh:
     return ::Collides(a,Ta,b.TriangleMeshCollisionData(),margin+b.margin,elements1,elements2,maxContacts);
@@ -944,6 +1093,51 @@ bool Collides(const Meshing::VolumeGrid& a,const RigidTransform& Ta,Real margin,
   return false;
 }
 
+bool Collides(const Meshing::SparseVolumeGrid& a,const RigidTransform& Ta,Real margin,AnyCollisionGeometry3D& b,
+	      vector<int>& elements1,vector<int>& elements2,size_t maxContacts)
+{
+  switch(b.type) {
+  case AnyCollisionGeometry3D::Primitive:
+    {
+      GeometricPrimitive3D bw=b.AsPrimitive();
+      bw.Transform(b.GetTransform());
+      if(::Collides(bw,a,Ta,margin+b.margin,elements1,maxContacts)) {
+	elements2.push_back(0);
+	return true;
+      }
+      return false;
+    }
+  case AnyCollisionGeometry3D::ImplicitSurface:
+    FatalError("Volume grid to volume grid collisions not done\n");
+    break;
+  case AnyCollisionGeometry3D::TriangleMesh:
+    return ::Collides(a,Ta,b.TriangleMeshCollisionData(),margin+b.margin,elements1,elements2,maxContacts);
+  case AnyCollisionGeometry3D::PointCloud:
+    FatalError("Point cloud testing should be prioritized");
+    break;
+  case AnyCollisionGeometry3D::Group:
+    {
+      vector<AnyCollisionGeometry3D>& bitems = b.GroupCollisionData();
+      elements1.resize(0);
+      elements2.resize(0);
+      for(size_t i=0;i<bitems.size();i++) {
+	vector<int> e1,e2;
+	if(Collides(a,Ta,margin+b.margin,bitems[i],e1,e2,maxContacts)) {
+	  for(size_t j=0;j<e1.size();j++) {
+	    elements1.push_back(e1[j]);
+	    elements2.push_back((int)i);
+	  }
+	  if(elements2.size() >= maxContacts) return true;
+	}
+      }
+      return !elements1.empty();
+    }
+  default:
+    FatalError("Invalid type");
+  }
+  return false;
+}
+
 bool Collides(const CollisionMesh& a,Real margin,AnyCollisionGeometry3D& b,
 	      vector<int>& elements1,vector<int>& elements2,size_t maxContacts)
 {
@@ -959,6 +1153,8 @@ bool Collides(const CollisionMesh& a,Real margin,AnyCollisionGeometry3D& b,
       return false;
     }
   case AnyCollisionGeometry3D::ImplicitSurface:
+    if(b.IsSparseImplicitSurface())
+      return ::Collides(b.AsSparseImplicitSurface(),b.GetTransform(),a,margin+b.margin,elements2,elements1,maxContacts);
     return ::Collides(b.AsImplicitSurface(),b.GetTransform(),a,margin+b.margin,elements2,elements1,maxContacts);
   case AnyCollisionGeometry3D::TriangleMesh:
     return ::Collides(a,b.TriangleMeshCollisionData(),margin+b.margin,elements1,elements2,maxContacts);
@@ -1469,6 +1665,8 @@ bool AnyCollisionGeometry3D::Collides(AnyCollisionGeometry3D& geom,
   case Primitive:
     return ::Collides(AsPrimitive(),GetTransform(),margin,geom,elements1,elements2,maxContacts);
   case ImplicitSurface:
+    if(IsSparseImplicitSurface())
+      return ::Collides(AsSparseImplicitSurface(),GetTransform(),margin,geom,elements1,elements2,maxContacts);
     return ::Collides(AsImplicitSurface(),GetTransform(),margin,geom,elements1,elements2,maxContacts);
   case TriangleMesh:
     return ::Collides(TriangleMeshCollisionData(),margin,geom,elements1,elements2,maxContacts);
@@ -1515,6 +1713,8 @@ bool AnyCollisionGeometry3D::WithinDistance(AnyCollisionGeometry3D& geom,Real to
   case Primitive:
     return ::Collides(AsPrimitive(),GetTransform(),margin+tol,geom,elements1,elements2,maxContacts);
   case ImplicitSurface:
+    if(IsSparseImplicitSurface())
+      return ::Collides(AsSparseImplicitSurface(),GetTransform(),margin+tol,geom,elements1,elements2,maxContacts);
     return ::Collides(AsImplicitSurface(),GetTransform(),margin+tol,geom,elements1,elements2,maxContacts);
   case TriangleMesh:
     return ::Collides(TriangleMeshCollisionData(),margin+tol,geom,elements1,elements2,maxContacts);
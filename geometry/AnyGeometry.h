@@ -7,7 +7,7 @@
 class TiXmlElement;
 
 //forward declarations
-namespace Meshing { class VolumeGrid; class PointCloud3D; }
+namespace Meshing { class VolumeGrid; class SparseVolumeGrid; class PointCloud3D; }
 namespace Geometry { class CollisionPointCloud; }
 namespace Math3D { class GeometricPrimitive3D; }
 namespace GLDraw { class GeometryAppearance; }
@@ -37,8 +37,11 @@ class AnyGeometry3D
    * - Primitive: GeometricPrimitive3D
    * - TriangleMesh: TriMesh
    * - PointCloud: PointCloud3D
-   * - ImplicitSurface: VolumeGrid
+   * - ImplicitSurface: VolumeGrid or SparseVolumeGrid
    * - Group: vector<AnyGeometry3D>
+   *
+   * For the ImplicitSurface type, check IsSparseImplicitSurface() to
+   * determine whether to call AsImplicitSurface or AsSparseImplicitSurface.
    */
   enum Type { Primitive, TriangleMesh, PointCloud, ImplicitSurface, Group };
 
@@ -47,6 +50,7 @@ class AnyGeometry3D
   AnyGeometry3D(const Meshing::TriMesh& mesh);
   AnyGeometry3D(const Meshing::PointCloud3D& pc);
   AnyGeometry3D(const Meshing::VolumeGrid& grid);
+  AnyGeometry3D(const Meshing::SparseVolumeGrid& grid);
   AnyGeometry3D(const vector<AnyGeometry3D>& items);
   AnyGeometry3D(const AnyGeometry3D& geom);
   static const char* TypeName(Type type);
@@ -55,12 +59,16 @@ class AnyGeometry3D
   const Meshing::TriMesh& AsTriangleMesh() const;
   const Meshing::PointCloud3D& AsPointCloud() const;
   const Meshing::VolumeGrid& AsImplicitSurface() const;
+  const Meshing::SparseVolumeGrid& AsSparseImplicitSurface() const;
   const vector<AnyGeometry3D>& AsGroup() const;
   GeometricPrimitive3D& AsPrimitive();
   Meshing::TriMesh& AsTriangleMesh();
   Meshing::PointCloud3D& AsPointCloud();
   Meshing::VolumeGrid& AsImplicitSurface();
+  Meshing::SparseVolumeGrid& AsSparseImplicitSurface();
   vector<AnyGeometry3D>& AsGroup();
+  ///Returns true if this is an ImplicitSurface stored as a SparseVolumeGrid
+  bool IsSparseImplicitSurface() const;
   GLDraw::GeometryAppearance* TriangleMeshAppearanceData();
   const GLDraw::GeometryAppearance* TriangleMeshAppearanceData() const;
   static bool CanLoadExt(const char* ext);
@@ -96,6 +104,7 @@ class AnyCollisionGeometry3D : public AnyGeometry3D
   AnyCollisionGeometry3D(const Meshing::TriMesh& mesh);
   AnyCollisionGeometry3D(const Meshing::PointCloud3D& pc);
   AnyCollisionGeometry3D(const Meshing::VolumeGrid& grid);
+  AnyCollisionGeometry3D(const Meshing::SparseVolumeGrid& grid);
   AnyCollisionGeometry3D(const AnyGeometry3D& geom);
   AnyCollisionGeometry3D(const vector<AnyGeometry3D>& group);
   AnyCollisionGeometry3D(const AnyCollisionGeometry3D& geom);
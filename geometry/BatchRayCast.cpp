@@ -0,0 +1,407 @@
+#include "BatchRayCast.h"
+#include <KrisLibrary/utils/threadutils.h>
+#include <KrisLibrary/errors.h>
+#include "PQP/include/PQP.h"
+#include <utility>
+using namespace std;
+
+namespace Geometry {
+
+//image tiles are TileSize x TileSize pixels, and batches of rays are split
+//into chunks of RayChunkSize rays, which are handed out round-robin to the
+//threads
+const static int TileSize = 16;
+const static int RayChunkSize = 1024;
+
+inline void Copy(const PQP_REAL p[3],Vector3& x)
+{
+  x.set(p[0],p[1],p[2]);
+}
+
+//Moller-Trumbore ray-triangle intersection
+inline bool RayTriangle(const Vector3& o,const Vector3& d,const Vector3& a,const Vector3& e1,const Vector3& e2,Real& t)
+{
+  Vector3 p,q,s;
+  p.setCross(d,e2);
+  Real det = e1.dot(p);
+  if(det == 0) return false;
+  Real inv = 1.0/det;
+  s.sub(o,a);
+  Real u = s.dot(p)*inv;
+  if(u < 0 || u > 1) return false;
+  q.setCross(s,e1);
+  Real v = d.dot(q)*inv;
+  if(v < 0 || u+v > 1) return false;
+  t = e2.dot(q)*inv;
+  return t >= 0;
+}
+
+static void ComputePQPBoxes(const PQP_Model& m,int b,vector<AABB3D>& boxes)
+{
+  if(m.b[b].Leaf()) {
+    const Tri& tri = m.tris[-m.b[b].first_child-1];
+    Vector3 p;
+    Copy(tri.p1,p); boxes[b].setPoint(p);
+    Copy(tri.p2,p); boxes[b].expand(p);
+    Copy(tri.p3,p); boxes[b].expand(p);
+  }
+  else {
+    int c = m.b[b].first_child;
+    ComputePQPBoxes(m,c,boxes);
+    ComputePQPBoxes(m,c+1,boxes);
+    boxes[b] = boxes[c];
+    boxes[b].setUnion(boxes[c+1]);
+  }
+}
+
+static int BuildBVH4Node(const PQP_Model& m,int b,const vector<AABB3D>& boxes,Real tol,vector<MeshBVH4::Node>& nodes)
+{
+  int index = (int)nodes.size();
+  nodes.resize(nodes.size()+1);
+  //the children are the grandchildren of b in the PQP tree
+  int kids[4];
+  int numKids = 0;
+  if(m.b[b].Leaf())
+    kids[numKids++] = b;
+  else {
+    for(int c=m.b[b].first_child;c<m.b[b].first_child+2;c++) {
+      if(m.b[c].Leaf())
+        kids[numKids++] = c;
+      else {
+        kids[numKids++] = m.b[c].first_child;
+        kids[numKids++] = m.b[c].first_child+1;
+      }
+    }
+  }
+  for(int i=0;i<4;i++) {
+    MeshBVH4::Node& node = nodes[index];
+    if(i >= numKids) {
+      node.child[i] = MeshBVH4::EmptyChild;
+      for(int d=0;d<3;d++)
+        node.bmin[d][i] = node.bmax[d][i] = 0;
+      continue;
+    }
+    const AABB3D& bb = boxes[kids[i]];
+    for(int d=0;d<3;d++) {
+      node.bmin[d][i] = (float)(bb.bmin[d]-tol);
+      node.bmax[d][i] = (float)(bb.bmax[d]+tol);
+    }
+    if(m.b[kids[i]].Leaf())
+      node.child[i] = m.b[kids[i]].first_child;
+    else
+      node.child[i] = kids[i];
+  }
+  //recurse after the boxes are set, since nodes may be reallocated
+  for(int i=0;i<numKids;i++) {
+    if(nodes[index].child[i] >= 0) {
+      int c = BuildBVH4Node(m,kids[i],boxes,tol,nodes);
+      nodes[index].child[i] = c;
+    }
+  }
+  return index;
+}
+
+MeshBVH4::MeshBVH4()
+{}
+
+MeshBVH4::MeshBVH4(const CollisionMesh& mesh)
+{
+  Build(mesh);
+}
+
+void MeshBVH4::Clear()
+{
+  nodes.clear();
+  triOrigin.clear();
+  triEdge1.clear();
+  triEdge2.clear();
+  triIndex.clear();
+}
+
+void MeshBVH4::Build(const CollisionMesh& mesh)
+{
+  Clear();
+  if(!mesh.pqpModel) FatalError("MeshBVH4::Build: InitCollisions was not called on the mesh");
+  const PQP_Model& m = *mesh.pqpModel;
+  if(m.num_bvs == 0 || m.num_tris == 0) return;
+  triOrigin.resize(m.num_tris);
+  triEdge1.resize(m.num_tris);
+  triEdge2.resize(m.num_tris);
+  triIndex.resize(m.num_tris);
+  Vector3 b,c;
+  for(int t=0;t<m.num_tris;t++) {
+    Copy(m.tris[t].p1,triOrigin[t]);
+    Copy(m.tris[t].p2,b);
+    Copy(m.tris[t].p3,c);
+    triEdge1[t] = b-triOrigin[t];
+    triEdge2[t] = c-triOrigin[t];
+    triIndex[t] = m.tris[t].id;
+  }
+  vector<AABB3D> boxes(m.num_bvs);
+  ComputePQPBoxes(m,0,boxes);
+  //enlarge the boxes to cover rounding to single precision
+  Real tol = 1e-5*(boxes[0].bmin.maxAbsElement()+boxes[0].bmax.maxAbsElement()+1e-3);
+  nodes.reserve(m.num_tris/2+1);
+  BuildBVH4Node(m,0,boxes,tol,nodes);
+}
+
+int MeshBVH4::RayCastLocal(const Ray3D& r,Real& tbest) const
+{
+  vector<pair<int,float> > stack;
+  return RayCastLocal(r,tbest,stack);
+}
+
+int MeshBVH4::RayCastLocal(const Ray3D& r,Real& tbest,vector<pair<int,float> >& stack) const
+{
+  tbest = Inf;
+  int best = -1;
+  if(nodes.empty()) return -1;
+  float o[3],inv[3];
+  for(int d=0;d<3;d++) {
+    o[d] = (float)r.source[d];
+    if(r.direction[d] == 0) inv[d] = 1e30f;
+    else inv[d] = (float)(1.0/r.direction[d]);
+  }
+  stack.resize(0);
+  stack.push_back(pair<int,float>(0,0.0f));
+  float tfar = Inf;
+  while(!stack.empty()) {
+    pair<int,float> top = stack.back();
+    stack.pop_back();
+    if(top.second > tfar) continue;
+    const Node& node = nodes[top.first];
+    //slab test of the ray against each of the 4 children
+    float tnear[4];
+    bool hit[4];
+    for(int c=0;c<4;c++) {
+      float t0x = (node.bmin[0][c]-o[0])*inv[0], t1x = (node.bmax[0][c]-o[0])*inv[0];
+      float t0y = (node.bmin[1][c]-o[1])*inv[1], t1y = (node.bmax[1][c]-o[1])*inv[1];
+      float t0z = (node.bmin[2][c]-o[2])*inv[2], t1z = (node.bmax[2][c]-o[2])*inv[2];
+      float tmin = Max(Max(Min(t0x,t1x),Min(t0y,t1y)),Max(Min(t0z,t1z),0.0f));
+      float tmax = Min(Min(Max(t0x,t1x),Max(t0y,t1y)),Min(Max(t0z,t1z),tfar));
+      tnear[c] = tmin;
+      hit[c] = (tmin <= tmax);
+    }
+    //visit the hit children from near to far
+    int order[4];
+    int numHit = 0;
+    for(int c=0;c<4;c++) {
+      if(!hit[c] || node.child[c] == EmptyChild) continue;
+      int k = numHit++;
+      while(k > 0 && tnear[order[k-1]] > tnear[c]) {
+        order[k] = order[k-1];
+        k--;
+      }
+      order[k] = c;
+    }
+    for(int k=0;k<numHit;k++) {
+      int c = order[k];
+      if(node.child[c] >= 0) continue;
+      int t = -node.child[c]-1;
+      Real param;
+      if(RayTriangle(r.source,r.direction,triOrigin[t],triEdge1[t],triEdge2[t],param) && param < tbest) {
+        tbest = param;
+        tfar = (float)param;
+        best = triIndex[t];
+      }
+    }
+    for(int k=numHit-1;k>=0;k--) {
+      int c = order[k];
+      if(node.child[c] >= 0 && tnear[c] <= tfar)
+        stack.push_back(pair<int,float>(node.child[c],tnear[c]));
+    }
+  }
+  return best;
+}
+
+//A batch of ray casting work assigned to one thread.  Either mesh/bvh or pc
+//is given.
+struct RayCastTask
+{
+  const CollisionMesh* mesh;
+  const MeshBVH4* bvh;
+  const CollisionPointCloud* pc;
+  Real rad;
+  int thread,numThreads;
+
+  //for batches
+  const vector<Ray3D>* rays;
+  vector<int>* hits;
+  vector<Vector3>* pts;
+
+  //for depth cameras
+  const Camera::Viewport* vp;
+  Meshing::PointCloud3D* out;
+
+  //casts a world-space ray, returning the hit index and the world-space point
+  int Cast(const Ray3D& r,Vector3& pt,vector<pair<int,float> >& stack) const
+  {
+    if(bvh) {
+      Ray3D rlocal;
+      mesh->currentTransform.mulPointInverse(r.source,rlocal.source);
+      mesh->currentTransform.mulVectorInverse(r.direction,rlocal.direction);
+      Real t;
+      int res = bvh->RayCastLocal(rlocal,t,stack);
+      if(res >= 0) r.eval(t,pt);
+      return res;
+    }
+    else
+      return Geometry::RayCast(*pc,rad,r,pt);
+  }
+};
+
+static void RayCastBatch(RayCastTask& task)
+{
+  const vector<Ray3D>& rays = *task.rays;
+  vector<pair<int,float> > stack;
+  int numChunks = ((int)rays.size()+RayChunkSize-1)/RayChunkSize;
+  for(int chunk=task.thread;chunk<numChunks;chunk+=task.numThreads) {
+    int end = Min((chunk+1)*RayChunkSize,(int)rays.size());
+    for(int i=chunk*RayChunkSize;i<end;i++)
+      (*task.hits)[i] = task.Cast(rays[i],(*task.pts)[i],stack);
+  }
+}
+
+static void SimulateDepthCameraTiles(RayCastTask& task)
+{
+  const Camera::Viewport& vp = *task.vp;
+  Meshing::PointCloud3D& out = *task.out;
+  vector<pair<int,float> > stack;
+  int tilesWide = (vp.w+TileSize-1)/TileSize;
+  int tilesHigh = (vp.h+TileSize-1)/TileSize;
+  Ray3D r;
+  Vector3 pt,local;
+  for(int tile=task.thread;tile<tilesWide*tilesHigh;tile+=task.numThreads) {
+    int col0 = (tile%tilesWide)*TileSize, row0 = (tile/tilesWide)*TileSize;
+    int col1 = Min(col0+TileSize,vp.w), row1 = Min(row0+TileSize,vp.h);
+    for(int row=row0;row<row1;row++) {
+      for(int col=col0;col<col1;col++) {
+        //rows are top to bottom, while viewport coordinates are bottom to top
+        float mx = vp.x + col + 0.5f;
+        float my = vp.y + (vp.h-1-row) + 0.5f;
+        vp.getClickSource(mx,my,r.source);
+        vp.getClickVector(mx,my,r.direction);
+        Vector3& res = out.points[row*vp.w+col];
+        res.setZero();
+        if(task.Cast(r,pt,stack) < 0) continue;
+        vp.xform.mulInverse(pt,local);
+        if(-local.z < vp.n || -local.z > vp.f) continue;
+        res.set(local.x,-local.y,-local.z);
+      }
+    }
+  }
+}
+
+static void* RayCastBatchThread(void* data)
+{
+  RayCastBatch(*(RayCastTask*)data);
+  return NULL;
+}
+
+static void* SimulateDepthCameraThread(void* data)
+{
+  SimulateDepthCameraTiles(*(RayCastTask*)data);
+  return NULL;
+}
+
+static void RunRayCastTasks(RayCastTask& proto,int numThreads,void* (*fn)(void*))
+{
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  vector<RayCastTask> tasks(numThreads,proto);
+  for(int t=0;t<numThreads;t++) {
+    tasks[t].thread = t;
+    tasks[t].numThreads = numThreads;
+  }
+  if(numThreads == 1) {
+    fn(&tasks[0]);
+    return;
+  }
+  vector<Thread> threads(numThreads);
+  for(int t=0;t<numThreads;t++)
+    threads[t] = ThreadStart(fn,&tasks[t]);
+  for(int t=0;t<numThreads;t++)
+    ThreadJoin(threads[t]);
+}
+
+static void InitTask(RayCastTask& task)
+{
+  task.mesh = NULL;
+  task.bvh = NULL;
+  task.pc = NULL;
+  task.rad = 0;
+  task.thread = 0;
+  task.numThreads = 1;
+  task.rays = NULL;
+  task.hits = NULL;
+  task.pts = NULL;
+  task.vp = NULL;
+  task.out = NULL;
+}
+
+void RayCast(const CollisionMesh& mesh,const MeshBVH4& bvh,const vector<Ray3D>& rays,vector<int>& tris,vector<Vector3>& pts,int numThreads)
+{
+  tris.resize(rays.size());
+  pts.resize(rays.size());
+  RayCastTask task;
+  InitTask(task);
+  task.mesh = &mesh;
+  task.bvh = &bvh;
+  task.rays = &rays;
+  task.hits = &tris;
+  task.pts = &pts;
+  RunRayCastTasks(task,numThreads,RayCastBatchThread);
+}
+
+void RayCast(const CollisionPointCloud& pc,Real rad,const vector<Ray3D>& rays,vector<int>& points,vector<Vector3>& pts,int numThreads)
+{
+  points.resize(rays.size());
+  pts.resize(rays.size());
+  RayCastTask task;
+  InitTask(task);
+  task.pc = &pc;
+  task.rad = rad;
+  task.rays = &rays;
+  task.hits = &points;
+  task.pts = &pts;
+  RunRayCastTasks(task,numThreads,RayCastBatchThread);
+}
+
+static void SimulateDepthCamera(RayCastTask& task,const Camera::Viewport& vp,Meshing::PointCloud3D& out,int numThreads)
+{
+  out.Clear();
+  out.points.resize(vp.w*vp.h);
+  out.SetStructured(vp.w,vp.h);
+  //the point cloud camera frame has +z forward and +y down, which is the
+  //viewport frame rotated by 180 degrees about x
+  RigidTransform T = vp.xform;
+  Matrix3 flip;
+  flip.setZero();
+  flip(0,0) = 1;
+  flip(1,1) = -1;
+  flip(2,2) = -1;
+  T.R = vp.xform.R*flip;
+  out.SetViewport(T);
+  task.vp = &vp;
+  task.out = &out;
+  RunRayCastTasks(task,numThreads,SimulateDepthCameraThread);
+}
+
+void SimulateDepthCamera(const CollisionMesh& mesh,const MeshBVH4& bvh,const Camera::Viewport& vp,Meshing::PointCloud3D& out,int numThreads)
+{
+  RayCastTask task;
+  InitTask(task);
+  task.mesh = &mesh;
+  task.bvh = &bvh;
+  SimulateDepthCamera(task,vp,out,numThreads);
+}
+
+void SimulateDepthCamera(const CollisionPointCloud& pc,Real rad,const Camera::Viewport& vp,Meshing::PointCloud3D& out,int numThreads)
+{
+  RayCastTask task;
+  InitTask(task);
+  task.pc = &pc;
+  task.rad = rad;
+  SimulateDepthCamera(task,vp,out,numThreads);
+}
+
+} //namespace Geometry
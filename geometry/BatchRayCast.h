@@ -0,0 +1,97 @@
+#ifndef GEOMETRY_BATCH_RAY_CAST_H
+#define GEOMETRY_BATCH_RAY_CAST_H
+
+#include "CollisionMesh.h"
+#include "CollisionPointCloud.h"
+#include <KrisLibrary/camera/viewport.h>
+#include <vector>
+#include <utility>
+
+/** @file geometry/BatchRayCast.h
+ * @ingroup Geometry
+ * @brief Casting of large batches of rays, e.g., for simulating depth
+ * cameras.
+ */
+
+namespace Geometry {
+
+  using namespace Math3D;
+
+/** @ingroup Geometry
+ * @brief A 4-wide bounding volume hierarchy over a CollisionMesh, used to
+ * accelerate ray casting.
+ *
+ * The hierarchy is derived from the mesh's PQP tree by collapsing every
+ * other level, so it is half as deep, and each node stores the axis-aligned
+ * bounding boxes of its (up to) 4 children in structure-of-arrays layout.
+ * Rays are traced one at a time: at each node the ray is slab-tested
+ * against the 4 child boxes in a scalar loop, and the children that are hit
+ * are visited from near to far.  There is no packet traversal, so coherent
+ * rays gain only from the shallower tree and the compact nodes.  Boxes are
+ * single precision and slightly enlarged, while the triangle tests are done
+ * in double precision.
+ *
+ * Everything is stored in the local frame of the mesh.  The hierarchy must
+ * be rebuilt whenever the mesh geometry changes, but not when its
+ * currentTransform changes.  Queries are read-only and may be made from
+ * multiple threads.
+ */
+class MeshBVH4
+{
+ public:
+  enum { EmptyChild = INT_MIN };
+
+  struct Node
+  {
+    float bmin[3][4],bmax[3][4];
+    ///child index c>=0 is a node, c<0 (but not EmptyChild) is the triangle -c-1
+    int child[4];
+  };
+
+  MeshBVH4();
+  MeshBVH4(const CollisionMesh& mesh);
+  void Build(const CollisionMesh& mesh);
+  void Clear();
+  bool IsEmpty() const { return nodes.empty(); }
+  ///Casts a ray given in the mesh's local frame.  Returns the index of the
+  ///first triangle hit (-1 if none) and its ray parameter in t.
+  int RayCastLocal(const Ray3D& r,Real& t) const;
+  ///Same as above, but uses the given traversal stack to avoid allocation
+  int RayCastLocal(const Ray3D& r,Real& t,std::vector<std::pair<int,float> >& stack) const;
+
+  std::vector<Node> nodes;
+  ///Triangle origins and edge vectors, in the order of the PQP tree
+  std::vector<Vector3> triOrigin,triEdge1,triEdge2;
+  ///Original mesh index of each triangle
+  std::vector<int> triIndex;
+};
+
+///Casts a batch of world-space rays at the mesh, using numThreads threads
+///(or the number of hardware threads, if numThreads <= 0).  Each ray is
+///traced on its own with MeshBVH4::RayCastLocal, and the threads take
+///chunks of consecutive rays.  On output,
+///tris[i] is the triangle hit by rays[i] (-1 if none) and pts[i] is the
+///world-space hit point.
+void RayCast(const CollisionMesh& mesh,const MeshBVH4& bvh,const std::vector<Ray3D>& rays,std::vector<int>& tris,std::vector<Vector3>& pts,int numThreads=0);
+
+///Casts a batch of world-space rays at the point cloud, where each point
+///is fattened by radius rad.  Each ray is cast with the point cloud's own
+///octree RayCast, so this only adds multithreading.  Output is the same as
+///above, with points[i] the index of the point hit.
+void RayCast(const CollisionPointCloud& pc,Real rad,const std::vector<Ray3D>& rays,std::vector<int>& points,std::vector<Vector3>& pts,int numThreads=0);
+
+///Simulates a depth camera with the given viewport.  The output is a
+///structured point cloud of size vp.w x vp.h whose points are in the camera
+///frame (+z forward, +x right, +y down), with the viewpoint set to the camera
+///transform.  Pixels whose ray misses the mesh, or that hit outside of the
+///[vp.n,vp.f] depth range, are given the point (0,0,0).  The image is split
+///into 16x16 pixel tiles that are handed out to numThreads threads, and the
+///pixels' rays are traced one at a time.
+void SimulateDepthCamera(const CollisionMesh& mesh,const MeshBVH4& bvh,const Camera::Viewport& vp,Meshing::PointCloud3D& out,int numThreads=0);
+
+///Same as above, but for a point cloud whose points are fattened by rad
+void SimulateDepthCamera(const CollisionPointCloud& pc,Real rad,const Camera::Viewport& vp,Meshing::PointCloud3D& out,int numThreads=0);
+
+} //namespace Geometry
+
+#endif
@@ -2,12 +2,14 @@
 #include "CollisionMesh.h"
 #include <KrisLibrary/GLdraw/GeometryAppearance.h>
 #include <KrisLibrary/meshing/VolumeGrid.h>
+#include <KrisLibrary/meshing/SparseVolumeGrid.h>
 #include <KrisLibrary/meshing/PointCloud.h>
 #include <KrisLibrary/meshing/MeshPrimitives.h>
 #include <KrisLibrary/meshing/MarchingCubes.h>
 #include <KrisLibrary/meshing/Voxelize.h>
 #include <KrisLibrary/math3d/random.h>
 #include <KrisLibrary/math3d/basis.h>
+#include <KrisLibrary/utils/threadutils.h>
 
 namespace Geometry {
 	
@@ -336,6 +338,109 @@ void MeshToImplicitSurface_FMM(const CollisionMesh& mesh,Meshing::VolumeGrid& gr
 	Meshing::FastMarchingMethod(mesh,grid.value,gradient,grid.bb,surfaceCells);
 }
 
+//cells of the grid are processed in 8x8x8 blocks; a block is skipped if its
+//center is far enough from the mesh that none of its cells are near the
+//surface
+const static int SDFBlockSize = 8;
+
+struct SDFNearBandTask
+{
+	const CollisionMesh* mesh;
+	Meshing::VolumeGrid* grid;
+	Array3D<bool>* fixed;
+	Real bandwidth;
+	int i0,i1;
+};
+
+static void ComputeNearBand(SDFNearBandTask& task)
+{
+	Meshing::VolumeGrid& grid = *task.grid;
+	Vector3 h = grid.GetCellSize();
+	Real blockRadius = 0.5*SDFBlockSize*h.norm();
+	Vector3 c,cp;
+	for(int i0=task.i0;i0<task.i1;i0+=SDFBlockSize) {
+		int i1 = Min(i0+SDFBlockSize,task.i1);
+		for(int j0=0;j0<grid.value.n;j0+=SDFBlockSize) {
+			int j1 = Min(j0+SDFBlockSize,grid.value.n);
+			for(int k0=0;k0<grid.value.p;k0+=SDFBlockSize) {
+				int k1 = Min(k0+SDFBlockSize,grid.value.p);
+				c = grid.bb.bmin;
+				c.x += 0.5*Real(i0+i1)*h.x;
+				c.y += 0.5*Real(j0+j1)*h.y;
+				c.z += 0.5*Real(k0+k1)*h.z;
+				ClosestPoint(*task.mesh,c,cp);
+				cp = task.mesh->currentTransform*cp;
+				if(cp.distance(c) > blockRadius + task.bandwidth) continue;
+				for(int i=i0;i<i1;i++)
+					for(int j=j0;j<j1;j++)
+						for(int k=k0;k<k1;k++) {
+							grid.GetCellCenter(i,j,k,c);
+							ClosestPoint(*task.mesh,c,cp);
+							cp = task.mesh->currentTransform*cp;
+							grid.value(i,j,k) = cp.distance(c);
+							(*task.fixed)(i,j,k) = true;
+						}
+			}
+		}
+	}
+}
+
+static void* ComputeNearBandThread(void* data)
+{
+	ComputeNearBand(*(SDFNearBandTask*)data);
+	return NULL;
+}
+
+void MeshToImplicitSurface_FastSweep(const CollisionMesh& mesh,Meshing::VolumeGrid& grid,Real resolution,int numThreads)
+{
+	AABB3D aabb;
+	Box3D b;
+	GetBB(mesh,b);
+	b.getAABB(aabb);
+	FitGridToBB(aabb,grid,resolution);
+	grid.value.set(Inf);
+	if(mesh.tris.empty()) return;
+	if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+
+	//exact unsigned distances near the surface, in parallel over layers of blocks
+	Array3D<bool> fixed(grid.value.m,grid.value.n,grid.value.p,false);
+	int numBlockLayers = (grid.value.m+SDFBlockSize-1)/SDFBlockSize;
+	int numTasks = Min(numThreads,numBlockLayers);
+	vector<SDFNearBandTask> tasks(numTasks);
+	for(int t=0;t<numTasks;t++) {
+		tasks[t].mesh = &mesh;
+		tasks[t].grid = &grid;
+		tasks[t].fixed = &fixed;
+		tasks[t].bandwidth = grid.GetCellSize().norm();
+		tasks[t].i0 = Min((t*numBlockLayers/numTasks)*SDFBlockSize,grid.value.m);
+		tasks[t].i1 = Min(((t+1)*numBlockLayers/numTasks)*SDFBlockSize,grid.value.m);
+	}
+	if(numTasks == 1)
+		ComputeNearBand(tasks[0]);
+	else {
+		vector<Thread> threads(numTasks);
+		for(int t=0;t<numTasks;t++)
+			threads[t] = ThreadStart(ComputeNearBandThread,&tasks[t]);
+		for(int t=0;t<numTasks;t++)
+			ThreadJoin(threads[t]);
+	}
+
+	//propagate to the rest of the grid
+	Meshing::FastSweepingMethod(grid.value,fixed,grid.bb,numThreads);
+
+	//sign from the winding number of the world-space mesh
+	Meshing::TriMesh worldMesh = mesh;
+	Matrix4 T;
+	mesh.currentTransform.get(T);
+	worldMesh.Transform(T);
+	Array3D<bool> inside(grid.value.m,grid.value.n,grid.value.p);
+	Meshing::VolumeOccupancyGrid_Winding(worldMesh,inside,grid.bb,numThreads);
+	for(int i=0;i<grid.value.m;i++)
+		for(int j=0;j<grid.value.n;j++)
+			for(int k=0;k<grid.value.p;k++)
+				if(inside(i,j,k)) grid.value(i,j,k) = -grid.value(i,j,k);
+}
+
 void MeshToImplicitSurface_SpaceCarving(const CollisionMesh& mesh,Meshing::VolumeGrid& grid,Real resolution,int numViews)
 {
 	AABB3D aabb;
@@ -441,4 +546,26 @@ void ImplicitSurfaceToMesh(const Meshing::VolumeGrid& grid,Meshing::TriMesh& mes
     MarchingCubes(grid.value,0,center_bb,mesh);
 }
 
+void ImplicitSurfaceToMesh(const Meshing::SparseVolumeGrid& grid,Meshing::TriMesh& mesh)
+{
+	const int B = Meshing::SparseVolumeGrid::BlockSize;
+	vector<Meshing::TriMesh> blockMeshes(grid.blocks.size());
+	//samples the block's cells plus the next cell on each axis, so that
+	//the meshes of adjacent blocks meet
+	Array3D<Real> values(B+1,B+1,B+1);
+	for(size_t n=0;n<grid.blocks.size();n++) {
+		const IntTriple& index = grid.blocks[n].index;
+		IntTriple c0(index.a*B,index.b*B,index.c*B);
+		for(int i=0;i<=B;i++)
+			for(int j=0;j<=B;j++)
+				for(int k=0;k<=B;k++)
+					values(i,j,k) = grid.GetValue(c0.a+i,c0.b+j,c0.c+k);
+		AABB3D center_bb;
+		grid.GetCellCenter(c0.a,c0.b,c0.c,center_bb.bmin);
+		grid.GetCellCenter(c0.a+B,c0.b+B,c0.c+B,center_bb.bmax);
+		MarchingCubes(values,0,center_bb,blockMeshes[n],1);
+	}
+	mesh.Merge(blockMeshes);
+}
+
 } //namespace Geometry
\ No newline at end of file
@@ -51,6 +51,19 @@ void PrimitiveToImplicitSurface(const GeometricPrimitive3D& primitive,Meshing::V
  */
 void MeshToImplicitSurface_FMM(const CollisionMesh& mesh,Meshing::VolumeGrid& grid,Real resolution);
 
+/** @ingroup Geometry
+ * @brief Creates an implicit surface for a mesh using exact distances near
+ * the surface and the fast sweeping method elsewhere.
+ *
+ * Distances in the blocks of cells near the surface are computed exactly
+ * using the mesh's bounding volume hierarchy, and are then propagated to
+ * the rest of the grid by FastSweepingMethod.  The sign is determined by the
+ * winding number of each cell center, so the mesh should be closed.  Work is
+ * divided among numThreads threads (or the number of hardware threads, if
+ * numThreads <= 0).
+ */
+void MeshToImplicitSurface_FastSweep(const CollisionMesh& mesh,Meshing::VolumeGrid& grid,Real resolution,int numThreads=0);
+
 /** @ingroup Geometry
  * @brief Creates an implicit surface for a mesh using a space-carving technique.
  * The grid has resolution no less than resolution on each axis.  numViews views
@@ -67,6 +80,13 @@ void MeshToImplicitSurface_SpaceCarving(const CollisionMesh& mesh,Meshing::Volum
  */
 void ImplicitSurfaceToMesh(const Meshing::VolumeGrid& grid,Meshing::TriMesh& mesh);
 
+/** @ingroup Geometry
+ * @brief Creates a mesh from a sparse implicit surface via Marching Cubes.
+ * Each allocated block is meshed separately, so vertices are not shared
+ * across block boundaries.
+ */
+void ImplicitSurfaceToMesh(const Meshing::SparseVolumeGrid& grid,Meshing::TriMesh& mesh);
+
 
 } //namespace Geometry
 
@@ -211,6 +211,19 @@ KDTree* KDTree::Insert(const Vector& p,int id,int maxLeafPoints)
   return node;
 }
 
+bool KDTree::Remove(const Vector& p,int id)
+{
+  KDTree* node = Locate(p);
+  for(size_t i=0;i<node->pts.size();i++) {
+    if(node->pts[i].id == id) {
+      node->pts[i] = node->pts.back();
+      node->pts.resize(node->pts.size()-1);
+      return true;
+    }
+  }
+  return false;
+}
+
 KDTree* KDTree::Locate(const Vector& p)
 {
   if(IsLeaf()) return this;
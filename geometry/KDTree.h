@@ -55,6 +55,9 @@ class KDTree
 
   ///inserts a point, splitting leaf nodes with the indicated number of points
   KDTree* Insert(const Vector& p,int id,int maxLeafPoints=2);
+  ///removes the point with the given id, which must have been inserted at
+  ///location p.  Returns false if it is not found.
+  bool Remove(const Vector& p,int id);
   ///finds the kdtree leaf in which this point is located
   KDTree* Locate(const Vector& p);
 
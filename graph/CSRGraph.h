@@ -0,0 +1,298 @@
+#ifndef GRAPH_CSR_GRAPH_H
+#define GRAPH_CSR_GRAPH_H
+
+#include "Graph.h"
+#include <KrisLibrary/math/math.h>
+#include <KrisLibrary/structs/FixedSizeDaryHeap.h>
+#include <vector>
+#include <algorithm>
+
+namespace Graph {
+
+///Which adjacency lists a CSRGraph snapshot follows
+enum CSRDirection { CSROutgoing, CSRIncoming, CSRUndirected };
+
+///Gets the CSRDirection that matches the traversal of the edge iterator
+///type.  Returns false for other iterator types.
+template <class Iterator>
+inline bool GetCSRDirection(const Iterator&,CSRDirection& dir) { return false; }
+template <class Data>
+inline bool GetCSRDirection(const EdgeIterator<Data>&,CSRDirection& dir) { dir=CSROutgoing; return true; }
+template <class Data>
+inline bool GetCSRDirection(const CoEdgeIterator<Data>&,CSRDirection& dir) { dir=CSRIncoming; return true; }
+template <class Data>
+inline bool GetCSRDirection(const UndirectedEdgeIterator<Data>&,CSRDirection& dir) { dir=CSRUndirected; return true; }
+
+/** @ingroup Graph
+ * @brief An immutable compressed sparse row (CSR) snapshot of the
+ * adjacency lists of a Graph.
+ *
+ * The arcs leaving node n are stored at indices offsets[n],...,
+ * offsets[n+1]-1 of the flat arrays targets and edgeData, so a traversal
+ * reads contiguous memory rather than one map node per edge.  The arcs
+ * follow the outgoing edges, the incoming edges, or both, in the same order
+ * as EdgeIterator, CoEdgeIterator, and UndirectedEdgeIterator respectively.
+ *
+ * The snapshot stores the graph's changeCount, and Update() only rebuilds
+ * it if nodes or edges were added or deleted since.  Edge data is
+ * referenced by pointer, so changing the data itself does not require a
+ * rebuild.
+ *
+ * A WeightFunc passed to the search functions below is called as
+ * w(edgeData,n,m) when traversing the arc from n to m, like the iterators'
+ * w(*it,it.source(),it.target()).
+ */
+template <class Node,class Edge>
+class CSRGraph
+{
+public:
+  CSRGraph() : graph(NULL),changeCount(0),direction(CSROutgoing) {}
+  void Build(const Graph<Node,Edge>& g,CSRDirection dir);
+  ///Rebuilds the snapshot if it is stale.  Returns true if it was rebuilt.
+  bool Update(const Graph<Node,Edge>& g,CSRDirection dir);
+  bool IsCurrent(const Graph<Node,Edge>& g,CSRDirection dir) const;
+  void Clear();
+  inline int NumNodes() const { return (offsets.empty() ? 0 : (int)offsets.size()-1); }
+  inline int NumArcs() const { return (int)targets.size(); }
+  inline int Degree(int n) const { return offsets[n+1]-offsets[n]; }
+
+  const Graph<Node,Edge>* graph;
+  size_t changeCount;
+  CSRDirection direction;
+  std::vector<int> offsets;
+  std::vector<int> targets;
+  std::vector<Edge*> edgeData;
+};
+
+template <class Node,class Edge>
+void CSRGraph<Node,Edge>::Build(const Graph<Node,Edge>& g,CSRDirection dir)
+{
+  typedef typename Graph<Node,Edge>::ConstEdgeListIterator ConstEdgeListIterator;
+  graph = &g;
+  changeCount = g.changeCount;
+  direction = dir;
+  int nn = g.NumNodes();
+  bool out = (dir != CSRIncoming), in = (dir != CSROutgoing);
+  offsets.resize(nn+1);
+  offsets[0] = 0;
+  for(int i=0;i<nn;i++) {
+    int degree = 0;
+    if(out) degree += (int)g.edges[i].size();
+    if(in) degree += (int)g.co_edges[i].size();
+    offsets[i+1] = offsets[i]+degree;
+  }
+  targets.resize(offsets[nn]);
+  edgeData.resize(offsets[nn]);
+  for(int i=0;i<nn;i++) {
+    int k = offsets[i];
+    if(out) {
+      for(ConstEdgeListIterator e=g.edges[i].begin();e!=g.edges[i].end();e++,k++) {
+        targets[k] = e->first;
+        edgeData[k] = &(*e->second);
+      }
+    }
+    if(in) {
+      for(ConstEdgeListIterator e=g.co_edges[i].begin();e!=g.co_edges[i].end();e++,k++) {
+        targets[k] = e->first;
+        edgeData[k] = &(*e->second);
+      }
+    }
+    Assert(k == offsets[i+1]);
+  }
+}
+
+template <class Node,class Edge>
+bool CSRGraph<Node,Edge>::IsCurrent(const Graph<Node,Edge>& g,CSRDirection dir) const
+{
+  return graph == &g && changeCount == g.changeCount && direction == dir;
+}
+
+template <class Node,class Edge>
+bool CSRGraph<Node,Edge>::Update(const Graph<Node,Edge>& g,CSRDirection dir)
+{
+  if(IsCurrent(g,dir)) return false;
+  Build(g,dir);
+  return true;
+}
+
+template <class Node,class Edge>
+void CSRGraph<Node,Edge>::Clear()
+{
+  graph = NULL;
+  changeCount = 0;
+  offsets.clear();
+  targets.clear();
+  edgeData.clear();
+}
+
+///A heuristic that turns CSRBestFirstSearch into Dijkstra's algorithm
+struct ZeroHeuristic
+{
+  inline Weight operator () (int n) const { return 0; }
+};
+
+///Stops CSRBestFirstSearch at a single target (or never, if t=-1) and
+///stores distances and parents in d and p
+struct CSRSingleTargetVisitor
+{
+  CSRSingleTargetVisitor(int _t,std::vector<Weight>& _d,std::vector<int>& _p) : t(_t),d(_d),p(_p) {}
+  inline bool IsTarget(int n) const { return n == t; }
+  inline void SetDistance(int n,Weight dn,int pn) { d[n]=dn; p[n]=pn; }
+
+  int t;
+  std::vector<Weight>& d;
+  std::vector<int>& p;
+};
+
+/** @brief Best-first search on a CSR snapshot.
+ *
+ * The search starts from all nodes with finite d, and expands nodes in
+ * order of d[n]+h(n).  With h=ZeroHeuristic this is Dijkstra's algorithm,
+ * and otherwise it is A*.  Nodes are reopened if their distance decreases
+ * after they were expanded, so an inconsistent heuristic still gives
+ * shortest paths, just more slowly.
+ *
+ * The visitor decides where to stop with IsTarget(n), and
+ * SetDistance(n,dn,pn) must set d[n]=dn and the parent of n to pn.
+ * H is an empty heap with the interface of FixedSizeHeap and room for
+ * all nodes, e.g., FixedSizeDaryHeap or FixedSizeRadixHeap.
+ * Returns the target that was reached, or -1.
+ */
+template <class Node,class Edge,class WeightFunc,class Heuristic,class Visitor,class Heap>
+int CSRBestFirstSearch(const CSRGraph<Node,Edge>& G,WeightFunc w,Heuristic h,std::vector<Weight>& d,Visitor& visitor,Heap& H)
+{
+  int nn=G.NumNodes();
+  Assert((int)d.size() == nn);
+  Assert(H.empty() && H.maxObjects() >= nn);
+  if(nn == 0) return -1;
+  for(int i=0;i<nn;i++)
+    if(!Math::IsInf(d[i])) H.push(i,-(d[i]+h(i)));
+  const int* offsets = &G.offsets[0];
+  const int* targets = (G.targets.empty() ? NULL : &G.targets[0]);
+  Edge* const* edgeData = (G.edgeData.empty() ? NULL : &G.edgeData[0]);
+  while(!H.empty()) {
+    int u = H.top(); H.pop();
+    if(visitor.IsTarget(u)) return u;
+    Weight du = d[u];
+    for(int k=offsets[u];k<offsets[u+1];k++) {
+      int v=targets[k];
+      //relax distances
+      Weight dvu = du + w(*edgeData[k],u,v);
+      if(d[v] > dvu) {
+	visitor.SetDistance(v,dvu,u);
+	H.adjust(v,-(d[v]+h(v)));
+      }
+    }
+  }
+  return -1;
+}
+
+///Best-first search with a 4-ary heap, as above
+template <class Node,class Edge,class WeightFunc,class Heuristic,class Visitor>
+int CSRBestFirstSearch(const CSRGraph<Node,Edge>& G,WeightFunc w,Heuristic h,std::vector<Weight>& d,Visitor& visitor)
+{
+  FixedSizeDaryHeap<Weight,4> H(G.NumNodes());
+  return CSRBestFirstSearch(G,w,h,d,visitor,H);
+}
+
+///Dijkstra's algorithm from s, stopping when t is reached (all nodes if
+///t=-1).  Sets the distances d and the shortest path tree p.
+template <class Node,class Edge,class WeightFunc>
+void CSRDijkstra(const CSRGraph<Node,Edge>& G,int s,int t,WeightFunc w,std::vector<Weight>& d,std::vector<int>& p)
+{
+  d.resize(G.NumNodes());
+  p.resize(G.NumNodes());
+  std::fill(d.begin(),d.end(),Weight(Math::dInf));
+  std::fill(p.begin(),p.end(),-1);
+  d[s] = 0;
+  CSRSingleTargetVisitor visitor(t,d,p);
+  CSRBestFirstSearch(G,w,ZeroHeuristic(),d,visitor);
+}
+
+///A* search from s to t with the heuristic h(n), which should not
+///overestimate the distance from n to t.  Sets the distances d and the
+///search tree p, and returns d[t].
+template <class Node,class Edge,class WeightFunc,class Heuristic>
+Weight CSRAStar(const CSRGraph<Node,Edge>& G,int s,int t,WeightFunc w,Heuristic h,std::vector<Weight>& d,std::vector<int>& p)
+{
+  d.resize(G.NumNodes());
+  p.resize(G.NumNodes());
+  std::fill(d.begin(),d.end(),Weight(Math::dInf));
+  std::fill(p.begin(),p.end(),-1);
+  d[s] = 0;
+  CSRSingleTargetVisitor visitor(t,d,p);
+  CSRBestFirstSearch(G,w,h,d,visitor);
+  return d[t];
+}
+
+/** @brief Bidirectional Dijkstra's algorithm from s to t.
+ *
+ * Searches forward from s on G and backward from t on the reverse graph
+ * Grev, always expanding the side with the smaller tentative distance,
+ * and stops once the two frontiers' distances sum to at least the best
+ * path found so far.  For a directed graph, G should follow the outgoing
+ * edges and Grev the incoming edges.  For an undirected graph both may be
+ * the same snapshot.
+ *
+ * Returns the length of the shortest path and stores its nodes, from s to
+ * t, in path.  Returns inf and clears path if t is unreachable.
+ */
+template <class Node,class Edge,class WeightFunc>
+Weight CSRBidirectionalDijkstra(const CSRGraph<Node,Edge>& G,const CSRGraph<Node,Edge>& Grev,int s,int t,WeightFunc w,std::vector<int>& path)
+{
+  int nn=G.NumNodes();
+  Assert(Grev.NumNodes() == nn);
+  path.resize(0);
+  if(s == t) {
+    path.push_back(s);
+    return 0;
+  }
+  const CSRGraph<Node,Edge>* graphs[2] = {&G,&Grev};
+  std::vector<Weight> d[2];
+  std::vector<int> p[2];
+  FixedSizeDaryHeap<Weight,4> H[2];
+  for(int side=0;side<2;side++) {
+    d[side].resize(nn,Weight(Math::dInf));
+    p[side].resize(nn,-1);
+    H[side].init(nn);
+  }
+  d[0][s] = 0;
+  d[1][t] = 0;
+  H[0].push(s,0);
+  H[1].push(t,0);
+  //length of the best path found so far, and the node where its halves meet
+  Weight best = Math::dInf;
+  int meet = -1;
+  while(!H[0].empty() && !H[1].empty()) {
+    Weight top0 = -H[0].topPriority(), top1 = -H[1].topPriority();
+    if(top0 + top1 >= best) break;
+    int side = (top0 <= top1 ? 0 : 1);
+    const CSRGraph<Node,Edge>& Gs = *graphs[side];
+    std::vector<Weight>& ds = d[side];
+    const std::vector<Weight>& dother = d[1-side];
+    int u = H[side].top(); H[side].pop();
+    Weight du = ds[u];
+    for(int k=Gs.offsets[u];k<Gs.offsets[u+1];k++) {
+      int v=Gs.targets[k];
+      Weight dvu = du + w(*Gs.edgeData[k],u,v);
+      if(ds[v] > dvu) {
+        ds[v] = dvu;
+        p[side][v] = u;
+        H[side].adjust(v,-dvu);
+      }
+      if(ds[v] + dother[v] < best) {
+        best = ds[v] + dother[v];
+        meet = v;
+      }
+    }
+  }
+  if(meet < 0) return Math::dInf;
+  for(int n=meet;n!=-1;n=p[0][n]) path.push_back(n);
+  std::reverse(path.begin(),path.end());
+  for(int n=p[1][meet];n!=-1;n=p[1][n]) path.push_back(n);
+  return best;
+}
+
+} //namespace Graph
+
+#endif
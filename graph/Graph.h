@@ -41,6 +41,11 @@ namespace Graph {
  * Basic traversal functions (DFS,BFS) are provided.  More sophisticated
  * computations should be written in as algorithm classes 
  * (see ShortestPathProblem).
+ *
+ * changeCount is incremented whenever nodes or edges are added or deleted
+ * through the methods below, which lets snapshots of the adjacency lists
+ * (see CSRGraph) detect that they are stale.  Code that modifies 'edges' or
+ * 'co_edges' directly should increment it too.
  */
 template <class NodeData, class EdgeData>
 class Graph
@@ -48,7 +53,7 @@ class Graph
 public:
   typedef CallbackBase<int> Callback;
 
-  Graph() {}
+  Graph() : changeCount(0) {}
   ~Graph() { Cleanup(); }
 
   void Resize(int n);
@@ -130,11 +135,13 @@ public:
   std::vector<EdgeList> edges;
   std::vector<CoEdgeList> co_edges;
   std::list<EdgeData> edgeData;
+  size_t changeCount;
 };
 
 template <class NodeData,class EdgeData>
 void Graph<NodeData,EdgeData>::Resize(int n)
 {
+  changeCount++;
   nodeColor.resize(n,White);
   nodes.resize(n);
   edges.resize(n);
@@ -144,6 +151,7 @@ void Graph<NodeData,EdgeData>::Resize(int n)
 template <class NodeData,class EdgeData>
 void Graph<NodeData,EdgeData>::Copy(const Graph<NodeData,EdgeData>& g)
 {
+  changeCount++;
   nodeColor = g.nodeColor;
   nodes = g.nodes;
   edgeData.clear();
@@ -160,6 +168,7 @@ void Graph<NodeData,EdgeData>::Copy(const Graph<NodeData,EdgeData>& g)
 template <class NodeData,class EdgeData>
 void Graph<NodeData,EdgeData>::SetTranspose(const Graph<NodeData,EdgeData>& g)
 {
+  changeCount++;
   nodeColor = g.nodeColor;
   nodes = g.nodes;
   edgeData.clear();
@@ -177,6 +186,7 @@ void Graph<NodeData,EdgeData>::SetTranspose(const Graph<NodeData,EdgeData>& g)
 template <class NodeData,class EdgeData>
 int Graph<NodeData,EdgeData>::AddNode(const NodeData& n)
 {
+  changeCount++;
   nodeColor.push_back(White);
   nodes.push_back(n);
   edges.push_back(EdgeList());
@@ -190,6 +200,7 @@ void Graph<NodeData,EdgeData>::DeleteNode(int n)
   DeleteOutgoingEdges(n);
   DeleteIncomingEdges(n);
 
+  changeCount++;
   int rep = nodes.size()-1;
   //move all references from rep to n
   nodeColor[n] = nodeColor[rep];  nodeColor.resize(nodeColor.size()-1);
@@ -265,6 +276,7 @@ EdgeData& Graph<NodeData,EdgeData>::AddEdge(int i,int j,const EdgeData& d)
 {
   Assert(i!=j);
   Assert(!HasEdge(i,j));
+  changeCount++;
   edgeData.push_back(d);
   EdgeDataPtr ptr = --edgeData.end();
   edges[i][j]=ptr;
@@ -302,6 +314,7 @@ void Graph<NodeData,EdgeData>::DeleteEdge(int i,int j)
   }
   Assert(ptr == k_co->second);
   co_edges[j].erase(k_co);
+  changeCount++;
   edgeData.erase(ptr);
 }
 
@@ -322,6 +335,7 @@ void Graph<NodeData,EdgeData>::DeleteOutgoingEdges(int i)
     
   //delete edges
   edges[i].clear();
+  changeCount++;
 }
 
 template <class NodeData,class EdgeData>
@@ -338,11 +352,13 @@ void Graph<NodeData,EdgeData>::DeleteIncomingEdges(int i)
 
   //delete co-edges
   co_edges[i].clear();
+  changeCount++;
 }
 
 template<class NodeData,class EdgeData>
 void Graph<NodeData,EdgeData>::Cleanup()
 {
+  changeCount++;
   nodeColor.clear();
   nodes.clear();
   edges.clear();
@@ -2,6 +2,7 @@
 #define GRAPH_SHORTEST_PATHS_H
 
 #include "Graph.h"
+#include "CSRGraph.h"
 #include <KrisLibrary/math/math.h>
 #include <KrisLibrary/structs/FixedSizeHeap.h>
 #include <KrisLibrary/structs/Heap.h>
@@ -33,6 +34,11 @@ const static Weight inf = Math::dInf;
  * call DecreaseUpdate().  To remove an edge completely, call DeleteUpdate().
  * For a sequence of small graph changes these can save a lot of time over
  * running the shortest path algorithm from scratch.
+ *
+ * On graphs with at least csrMinEdges edges, FindPath and FindAPath with
+ * the standard edge iterators search a CSRGraph snapshot of g using a
+ * 4-ary heap.  The snapshot is kept in csr and is only rebuilt when g
+ * changes, so repeated queries on the same roadmap are cheapest.
  */
 template <class Node,class Edge>
 class ShortestPathProblem
@@ -142,10 +148,32 @@ class ShortestPathProblem
   ///Otherwise undefined behavior will result!
   virtual void SetDistance(int n,Real dn,int pn) { d[n]=dn; p[n]=pn; }
 
+  //Dijkstra's algorithm on the CSR snapshot, stopping at a node with
+  //isTarget set (or at t if isTarget is NULL)
+  template <typename WeightFunc>
+  int FindPath_CSR(int t,const std::vector<bool>* isTarget,WeightFunc w,CSRDirection dir);
+
   const Graph<Node,Edge>& g;
 
   std::vector<int> p;
   std::vector<Weight> d;
+
+  ///Graphs with fewer edges are searched through the adjacency maps
+  int csrMinEdges;
+  CSRGraph<Node,Edge> csr;
+};
+
+//Adapts a ShortestPathProblem to the visitor interface of CSRBestFirstSearch
+template <class Node,class Edge>
+struct ShortestPathVisitor
+{
+  ShortestPathVisitor(ShortestPathProblem<Node,Edge>& _spp,int _t,const std::vector<bool>* _isTarget) : spp(_spp),t(_t),isTarget(_isTarget) {}
+  inline bool IsTarget(int n) const { return (isTarget ? (bool)(*isTarget)[n] : n == t); }
+  inline void SetDistance(int n,Weight dn,int pn) { spp.SetDistance(n,dn,pn); }
+
+  ShortestPathProblem<Node,Edge>& spp;
+  int t;
+  const std::vector<bool>* isTarget;
 };
 
 
@@ -154,7 +182,7 @@ class ShortestPathProblem
 template <class Node,class Edge>
 ShortestPathProblem<Node,Edge>::
 ShortestPathProblem(const Graph<Node,Edge>& _g)
-  :g(_g)
+  :g(_g),csrMinEdges(10000)
 {}
 
 template <class Node,class Edge>
@@ -190,6 +218,11 @@ template <class Node,class Edge>
 template <typename WeightFunc,typename Iterator>
 void ShortestPathProblem<Node,Edge>::FindPath(int t,WeightFunc w,Iterator it)
 {
+  CSRDirection dir;
+  if(g.NumEdges() >= csrMinEdges && GetCSRDirection(it,dir)) {
+    FindPath_CSR(t,NULL,w,dir);
+    return;
+  }
   int nn=g.NumNodes();
   FixedSizeHeap<Weight> H(nn);  //O(n) init, worst case log n update
   for(int i=0;i<nn;i++) H.push(i,-d[i]);
@@ -215,6 +248,12 @@ template <class Node,class Edge>
 template <typename WeightFunc,typename Iterator>
 int ShortestPathProblem<Node,Edge>::FindAPath(const vector<int>& t,WeightFunc w,Iterator it)
 {
+  CSRDirection dir;
+  if(g.NumEdges() >= csrMinEdges && GetCSRDirection(it,dir)) {
+    std::vector<bool> isTarget(g.NumNodes(),false);
+    for(size_t i=0;i<t.size();i++) isTarget[t[i]] = true;
+    return FindPath_CSR(-1,&isTarget,w,dir);
+  }
   int nn=g.NumNodes();
   FixedSizeHeap<Weight> H(nn);  //O(n) init, worst case log n update
   for(int i=0;i<nn;i++) H.push(i,-d[i]);
@@ -240,6 +279,14 @@ int ShortestPathProblem<Node,Edge>::FindAPath(const vector<int>& t,WeightFunc w,
   return -1;
 }
 
+template <class Node,class Edge>
+template <typename WeightFunc>
+int ShortestPathProblem<Node,Edge>::FindPath_CSR(int t,const std::vector<bool>* isTarget,WeightFunc w,CSRDirection dir)
+{
+  csr.Update(g,dir);
+  ShortestPathVisitor<Node,Edge> visitor(*this,t,isTarget);
+  return CSRBestFirstSearch(csr,w,ZeroHeuristic(),d,visitor);
+}
 
 template <class Node,class Edge>
 template <typename WeightFunc,typename InIterator,typename OutIterator>
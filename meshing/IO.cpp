@@ -8,8 +8,12 @@
 #include <sstream>
 #include <fstream>
 #include <utils/SimpleFile.h>
+#include <utils/fileutils.h>
 #include <string.h>
 #include <errors.h>
+#include <utils/stl_tr1.h>
+#include <ctype.h>
+#include <stdlib.h>
 
 #if HAVE_ASSIMP
 #if ASSIMP_MAJOR_VERSION==2
@@ -31,13 +35,15 @@ using namespace GLDraw;
 namespace Meshing {
 
 static string gTexturePath;
-bool LoadOBJ(const char* fn,FILE* f,TriMesh& tri,GeometryAppearance& app);
 
 ///Returns true if the extension is a file type that we can load from
 bool CanLoadTriMeshExt(const char* ext)
 {
   if(0==strcmp(ext,"tri")) return true;
   else if(0==strcmp(ext,"off")) return true;
+  else if(0==strcmp(ext,"obj")) return true;
+  else if(0==strcmp(ext,"stl")) return true;
+  else if(0==strcmp(ext,"ply")) return true;
   else {
 #if HAVE_ASSIMP
     Assimp::Importer importer;
@@ -53,6 +59,8 @@ bool CanSaveTriMeshExt(const char* ext)
 {
   if(0==strcmp(ext,"tri")) return true;
   else if(0==strcmp(ext,"off")) return true;
+  else if(0==strcmp(ext,"stl")) return true;
+  else if(0==strcmp(ext,"ply")) return true;
   else {
 #if HAVE_ASSIMP
     //TODO: check exporter
@@ -74,6 +82,15 @@ bool Import(const char* fn,TriMesh& tri)
     if(!in) return false;
     return LoadOFF(in,tri);
   }
+  else if(0==strcmp(ext,"obj")) {
+    return LoadOBJ(fn,tri);
+  }
+  else if(0==strcmp(ext,"stl")) {
+    return LoadSTL(fn,tri);
+  }
+  else if(0==strcmp(ext,"ply")) {
+    return LoadPLY(fn,tri);
+  }
   else {
 #if HAVE_ASSIMP
     if(!LoadAssimp(fn,tri)) {
@@ -107,14 +124,19 @@ bool Import(const char* fn,TriMesh& tri,GeometryAppearance& app)
   }
   else {
     if(0==strcmp(ext,"obj")) {
-      FILE* f = fopen(fn,"r");
-      if(f && LoadOBJ(fn,f,tri,app)) return true;
+      if(LoadOBJ(fn,tri,app)) return true;
     }
     else if(0==strcmp(ext,"off")) {
       ifstream in(fn,ios::in);
       if(!in) return false;
       return LoadOFF(in,tri);
     }
+    else if(0==strcmp(ext,"stl")) {
+      return LoadSTL(fn,tri);
+    }
+    else if(0==strcmp(ext,"ply")) {
+      return LoadPLY(fn,tri);
+    }
 #if HAVE_ASSIMP
     //setup texture path to same directory as fn
     char* buf = new char[strlen(fn)+1];
@@ -159,6 +181,12 @@ bool Export(const char* fn,const TriMesh& tri)
       if(!out) return false;
       return SaveOFF(out,tri);
     }
+  else if(0==strcmp(ext,"stl")) {
+    return SaveSTL(fn,tri);
+  }
+  else if(0==strcmp(ext,"ply")) {
+    return SavePLY(fn,tri);
+  }
   else {
 #if HAVE_ASSIMP && 0
     //right now SaveAssimp is not working yet...
@@ -306,41 +334,6 @@ bool SaveOFF(std::ostream& out,const TriMesh& tri)
   return true;
 }
 
-//scans until endc is read
-bool fscanto(FILE* f, char endc)
-{
-  //read until end of line
-  int c;
-  while(true) {
-    c = fgetc(f);
-    if(c == EOF) return false;
-    if(c == endc) return true;
-  }
-  return false;
-}
-
-//scans until end of line is read
-bool fgetline(FILE* f, char* buf,int bufsize)
-{
-  //read until end of line
-  int c;
-  int i=0;
-  while(true) {
-    c = fgetc(f);
-    if(c == EOF) {
-      buf[i] = 0;
-      return false;
-    }
-    if(c == '\n') {
-      buf[i] = 0;
-      return true;
-    }
-    buf[i] = c;
-    i++;
-  }
-  return false;
-}
-
 bool LoadOBJMaterial(const char* path,const char* file,GeometryAppearance& app)
 {
   string fn = string(path)+string(file);
@@ -366,140 +359,696 @@ bool LoadOBJMaterial(const char* path,const char* file,GeometryAppearance& app)
   return true;
 }
 
-///Loads from the Wavefront OBJ format, with per-vertex colors?
-bool LoadOBJ(const char* fn,FILE* f,TriMesh& tri,GeometryAppearance& app)
+//Tokenizes text in place, without requiring it to be null-terminated
+struct TextCursor
+{
+  TextCursor(const char* data,size_t size) : p(data),end(data+size),line(1) {}
+  bool AtEnd() const { return p >= end; }
+  bool AtEOL() const { return p >= end || *p == '\n'; }
+  void SkipSpaces() { while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++; }
+  void SkipWhitespace() {
+    while(p < end && isspace(*p)) {
+      if(*p == '\n') line++;
+      p++;
+    }
+  }
+  void SkipLine() {
+    while(p < end && *p != '\n') p++;
+    if(p < end) { p++; line++; }
+  }
+  //reads a run of non-space characters
+  void ReadWord(const char*& word,size_t& len) {
+    SkipSpaces();
+    word = p;
+    while(p < end && !isspace(*p)) p++;
+    len = p-word;
+  }
+  bool ReadInt(int& x) {
+    SkipSpaces();
+    const char* q = p;
+    bool neg = false;
+    if(q < end && (*q == '-' || *q == '+')) { neg = (*q == '-'); q++; }
+    if(q >= end || !isdigit(*q)) return false;
+    long v = 0;
+    while(q < end && isdigit(*q)) { v = v*10 + (*q-'0'); q++; }
+    x = (int)(neg ? -v : v);
+    p = q;
+    return true;
+  }
+  bool ReadReal(Real& x);
+
+  const char* p;
+  const char* end;
+  int line;
+};
+
+bool TextCursor::ReadReal(Real& x)
+{
+  static const double pow10[23] = {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+  SkipSpaces();
+  const char* start = p;
+  const char* q = p;
+  bool neg = false;
+  if(q < end && (*q == '-' || *q == '+')) { neg = (*q == '-'); q++; }
+  unsigned long long mantissa = 0;
+  int digits = 0, exponent = 0;
+  bool any = false;
+  while(q < end && isdigit(*q)) {
+    any = true;
+    if(digits < 19) {
+      mantissa = mantissa*10 + (*q-'0');
+      if(mantissa != 0) digits++;
+    }
+    else exponent++;
+    q++;
+  }
+  if(q < end && *q == '.') {
+    q++;
+    while(q < end && isdigit(*q)) {
+      any = true;
+      if(digits < 19) {
+        mantissa = mantissa*10 + (*q-'0');
+        if(mantissa != 0) digits++;
+        exponent--;
+      }
+      q++;
+    }
+  }
+  if(!any) {
+    //may be nan or inf, let strtod figure it out
+    const char* w = q;
+    while(w < end && isalpha(*w)) w++;
+    if(w == q) return false;
+    q = w;
+  }
+  else if(q < end && (*q == 'e' || *q == 'E')) {
+    const char* r = q+1;
+    bool eneg = false;
+    if(r < end && (*r == '-' || *r == '+')) { eneg = (*r == '-'); r++; }
+    if(r < end && isdigit(*r)) {
+      int e = 0;
+      while(r < end && isdigit(*r)) { if(e < 10000) e = e*10 + (*r-'0'); r++; }
+      exponent += (eneg ? -e : e);
+      q = r;
+    }
+  }
+  p = q;
+  if(any && digits <= 15 && exponent >= -22 && exponent <= 22) {
+    //exact: both the mantissa and the power of 10 are representable
+    x = Real(mantissa);
+    if(exponent < 0) x /= pow10[-exponent];
+    else x *= pow10[exponent];
+    if(neg) x = -x;
+    return true;
+  }
+  char buf[128];
+  size_t n = Min((size_t)(q-start),sizeof(buf)-1);
+  memcpy(buf,start,n);
+  buf[n] = 0;
+  //strtod expects the C locale's decimal point, which may be a comma, so
+  //substitute it for the file's '.'
+  const char* point = localeconv()->decimal_point;
+  char* dot = strchr(buf,'.');
+  if(dot && strcmp(point,".") != 0) {
+    string local(buf,dot-buf);
+    local += point;
+    local += dot+1;
+    char* localend;
+    x = strtod(local.c_str(),&localend);
+    return localend != local.c_str();
+  }
+  char* bufend;
+  x = strtod(buf,&bufend);
+  return bufend != buf;
+}
+
+static bool ParseOBJ(const char* fn,const char* data,size_t size,TriMesh& tri,GeometryAppearance* app)
 {
-  setlocale(LC_NUMERIC, "en_US.UTF-8");
   tri.verts.resize(0);
   tri.tris.resize(0);
-  app.vertexColors.resize(0);
-  char buf[1025];
-  buf[1024]=0;
-  string line,item,vmf;
-  vector<char*> elements;
+  if(app) app->vertexColors.resize(0);
+  //guess the sizes from the file size to avoid reallocation
+  tri.verts.reserve(size/64);
+  tri.tris.reserve(size/32);
+  TextCursor cur(data,size);
   vector<int> face;
-  int lineno = 0;
   Vector3 pt;
   GLColor col;
-  col.rgba[3] = 1;
-  int c;
-  while((c=fgetc(f)) != EOF) {
-    lineno++;
-    if(c == '\n') continue;
-    else if(c == '#') fscanto(f,'\n');
-    else if(c == 'v') {
-      c = fgetc(f);
-      if(c == 'n')  fscanto(f,'\n'); ///normal 
-      else if(c == 't') { //texture coordinate
-        int n=fscanf(f," %lf %lf",&pt.x,&pt.y);
-        if(n != 2) {
-          fprintf(stderr,"LoadOBJ: erroneous vt line on line %d\n",lineno);
+  const char* word;
+  size_t len;
+  while(true) {
+    cur.SkipWhitespace();
+    if(cur.AtEnd()) break;
+    int lineno = cur.line;
+    cur.ReadWord(word,len);
+    if(len == 1 && word[0] == 'v') {
+      if(!cur.ReadReal(pt.x) || !cur.ReadReal(pt.y) || !cur.ReadReal(pt.z)) {
+        fprintf(stderr,"LoadOBJ: erroneous v line on line %d\n",lineno);
+        return false;
+      }
+      tri.verts.push_back(pt);
+      if(app) {
+        //optional per-vertex colors
+        Real c[4];
+        int n=0;
+        while(n < 4 && cur.ReadReal(c[n])) n++;
+        if(n >= 3) {
+          for(int i=0;i<3;i++) col.rgba[i] = (float)c[i];
+          col.rgba[3] = (n == 4 ? (float)c[3] : 1.0f);
+          app->vertexColors.push_back(col);
+          if(app->vertexColors.size() != tri.verts.size()) {
+            fprintf(stderr,"LoadOBJ: number of vertex colors not equal to number of vertices\n");
+            return false;
+          }
+        }
+      }
+    }
+    else if(len == 1 && word[0] == 'f') {
+      face.resize(0);
+      int v;
+      while(cur.ReadInt(v)) {
+        //elements can be of form %d, %d/%d, %d//%d, or %d/%d/%d.
+        //We only care about the first
+        while(!cur.AtEnd() && !isspace(*cur.p)) cur.p++;
+        if(v < 0) v += (int)tri.verts.size();  //relative index
+        else v -= 1;   //1 based
+        if(v < 0 || v >= (int)tri.verts.size()) {
+          fprintf(stderr,"LoadOBJ: vertex %d on f line %d is out of bounds 0,...,%d\n",v,lineno,(int)tri.verts.size());
           return false;
         }
-        app.texcoords.push_back(Vector2(pt.x,pt.y));
+        face.push_back(v);
       }
-      else if(isspace(c)) { ///just vertex
-	int n=fscanf(f," %lf %lf %lf",&pt.x,&pt.y,&pt.z);
-	if(n != 3) {
-	  fprintf(stderr,"LoadOBJ: erroneous v line on line %d\n",lineno);
-	  return false;
-	}
-	tri.verts.push_back(pt);
-	fgetline(f,buf,1024);
-	n=sscanf(buf,"%f %f %f %f",&col.rgba[0],&col.rgba[1],&col.rgba[2],&col.rgba[3]);
-	if(n == 3) col.rgba[3]=1;
-	if(n >= 3) {
-	  app.vertexColors.push_back(col);
-	  if(app.vertexColors.size() != tri.verts.size()) {
-	    fprintf(stderr,"LoadOBJ: number of vertex colors not equal to number of vertices\n");
-	    return false;
-	  }
-	}
+      cur.SkipSpaces();
+      if(face.size() < 3 || !cur.AtEOL()) {
+        fprintf(stderr,"LoadOBJ: invalid f line %d\n",lineno);
+        return false;
       }
+      for(size_t i=2;i<face.size();i++) 
+        tri.tris.push_back(IntTriple(face[0],face[i-1],face[i]));
     }
-    else if(c=='f') {
-      if(tri.tris.size()==0) tri.tris.reserve(tri.verts.size()/3);
-      face.resize(0);
-      elements.resize(0);
-      fgetline(f,buf,1024);
-      bool readingspace = true;
-      for(int i=0;i<1024;i++) {
-	if(!buf[i]) break;
-	if(readingspace) {
-	  if(isspace(buf[i])) buf[i]=0;
-	  else {
-	    readingspace = false;
-	    elements.push_back(&buf[i]);
-	  }
-	}
-	else {
-	  if(isspace(buf[i])) {
-	    buf[i]=0;
-	    readingspace = true;
-	  }
-	}
+    else if(len == 2 && word[0] == 'v' && word[1] == 't') {
+      if(!cur.ReadReal(pt.x) || !cur.ReadReal(pt.y)) {
+        fprintf(stderr,"LoadOBJ: erroneous vt line on line %d\n",lineno);
+        return false;
       }
-      //elements can be of form %d, %d/%d, or %d/%d/%d. 
-      //We only care about the first
-      face.resize(elements.size());
-      int f;
-      for(size_t i=0;i<elements.size();i++) {
-	char* c = elements[i];
-	while(*c) { if(*c=='/') { *c=0; break; }c++; }
-	int n=sscanf(elements[i],"%d",&f);
-	if(n != 1) {
-	  fprintf(stderr,"LoadOBJ: invalid vertex on f line %d, element %d\n",lineno,i);
-	  return false;
-	}
-	f-=1;   //1 based
-	if(f < 0 || f >= (int)tri.verts.size()) {
-	  fprintf(stderr,"LoadOBJ: vertex %d on f line %d is out of bounds 0,...,%d\n",f,lineno,(int)tri.verts.size());
-	  return false;
-	}
-	face[i] = f;
+      if(app) app->texcoords.push_back(Vector2(pt.x,pt.y));
+    }
+    else if(len == 6 && 0==strncmp(word,"mtllib",6)) {
+      if(app) {
+        cur.SkipSpaces();
+        const char* name = cur.p;
+        while(!cur.AtEOL()) cur.p++;
+        const char* nameend = cur.p;
+        while(nameend > name && isspace(nameend[-1])) nameend--;
+        string file(name,nameend);
+        char* path = new char [strlen(fn)+1];
+        GetFilePath(fn,path);
+        bool res = LoadOBJMaterial(path,file.c_str(),*app);
+        if(!res) 
+          fprintf(stderr,"LoadOBJ: error loading material file \"%s\" on line %d\n",(string(path)+"/"+file).c_str(),lineno);
+        delete [] path;
+        if(!res) return false;
       }
-      if(face.size() < 3) {
-	fprintf(stderr,"LoadOBJ: invalid f line %d\n",lineno);
-	return false;
+    }
+    else if(word[0] != '#' && !(len == 2 && word[0] == 'v' && word[1] == 'n') && !(len == 1 && (word[0] == 'o' || word[0] == 'g' || word[0] == 's')) && !(len == 6 && 0==strncmp(word,"usemtl",6))) {
+      fprintf(stderr,"LoadOBJ: unsupported command \"%s\" on line %d\n",string(word,len).c_str(),lineno);
+      return false;
+    }
+    //normals, comments, groups, and materials are skipped
+    cur.SkipLine();
+  }
+  return true;
+}
+
+bool LoadOBJ(const char* fn,TriMesh& tri)
+{
+  FileUtils::FileView file;
+  if(!file.Open(fn)) return false;
+  return ParseOBJ(fn,file.data,file.size,tri,NULL);
+}
+
+bool LoadOBJ(const char* fn,TriMesh& tri,GeometryAppearance& app)
+{
+  FileUtils::FileView file;
+  if(!file.Open(fn)) return false;
+  return ParseOBJ(fn,file.data,file.size,tri,&app);
+}
+
+static bool IsLittleEndian()
+{
+  int x = 1;
+  return *(char*)&x == 1;
+}
+
+static void ReverseBytes(char* p,int n)
+{
+  for(int i=0;i<n/2;i++) swap(p[i],p[n-1-i]);
+}
+
+//reads a little-endian value of type T from p
+template <class T>
+inline T ReadLittleEndian(const char* p,bool swapBytes)
+{
+  char buf[sizeof(T)];
+  memcpy(buf,p,sizeof(T));
+  if(swapBytes) ReverseBytes(buf,sizeof(T));
+  T x;
+  memcpy(&x,buf,sizeof(T));
+  return x;
+}
+
+template <class T>
+inline void WriteLittleEndian(T x,char* p,bool swapBytes)
+{
+  memcpy(p,&x,sizeof(T));
+  if(swapBytes) ReverseBytes(p,sizeof(T));
+}
+
+//Hash for merging vertices with identical coordinates
+struct VertexHash
+{
+  size_t operator () (const Vector3& v) const
+  {
+    size_t h = 0;
+    for(int i=0;i<3;i++) {
+      double x = v[i]+0.0;  //maps -0 to 0
+      unsigned long long bits;
+      memcpy(&bits,&x,sizeof(bits));
+      h ^= size_t(bits ^ (bits>>32)) + 0x9e3779b9 + (h<<6) + (h>>2);
+    }
+    return h;
+  }
+};
+
+typedef UNORDERED_MAP_TEMPLATE<Vector3,int,VertexHash> VertexMap;
+
+inline int MergeVertex(const Vector3& v,VertexMap& vertexMap,TriMesh& tri)
+{
+  Vector3 key(v.x+0.0,v.y+0.0,v.z+0.0);
+  pair<VertexMap::iterator,bool> res = vertexMap.insert(pair<Vector3,int>(key,(int)tri.verts.size()));
+  if(res.second) tri.verts.push_back(v);
+  return res.first->second;
+}
+
+bool LoadSTL(const char* fn,TriMesh& tri)
+{
+  FileUtils::FileView file;
+  if(!file.Open(fn)) return false;
+  tri.verts.resize(0);
+  tri.tris.resize(0);
+  VertexMap vertexMap;
+  bool swapBytes = !IsLittleEndian();
+  if(file.size >= 84) {
+    size_t numTris = ReadLittleEndian<unsigned int>(file.data+80,swapBytes);
+    if(file.size == 84 + 50*numTris) {
+      //binary: a 12 byte normal, 3 12 byte vertices, and a 2 byte attribute per triangle
+      tri.tris.resize(numTris);
+      tri.verts.reserve(numTris/2+3);
+      vertexMap.rehash(numTris/2+3);
+      const char* p = file.data+84;
+      Vector3 v;
+      for(size_t t=0;t<numTris;t++,p+=50) {
+        for(int k=0;k<3;k++) {
+          const char* pv = p+12+12*k;
+          v.x = ReadLittleEndian<float>(pv,swapBytes);
+          v.y = ReadLittleEndian<float>(pv+4,swapBytes);
+          v.z = ReadLittleEndian<float>(pv+8,swapBytes);
+          tri.tris[t][k] = MergeVertex(v,vertexMap,tri);
+        }
       }
-      for(size_t i=2;i<face.size();i++) 
-	tri.tris.push_back(IntTriple(face[0],face[i-1],face[i]));
-    }
-    else if(c=='m') {
-      int i=0;
-      while(!isspace(c) && i < 63) {
-        buf[i] = c;
-        i++;
-        c = fgetc(f);
+      return true;
+    }
+  }
+  //ASCII
+  TextCursor cur(file.data,file.size);
+  const char* word;
+  size_t len;
+  cur.SkipWhitespace();
+  cur.ReadWord(word,len);
+  if(len != 5 || 0!=strncmp(word,"solid",5)) {
+    fprintf(stderr,"LoadSTL: %s is not a binary or ASCII STL file\n",fn);
+    return false;
+  }
+  cur.SkipLine();
+  IntTriple t;
+  int k = 0;
+  Vector3 v;
+  while(true) {
+    cur.SkipWhitespace();
+    if(cur.AtEnd()) break;
+    int lineno = cur.line;
+    cur.ReadWord(word,len);
+    if(len == 6 && 0==strncmp(word,"vertex",6)) {
+      if(!cur.ReadReal(v.x) || !cur.ReadReal(v.y) || !cur.ReadReal(v.z)) {
+        fprintf(stderr,"LoadSTL: erroneous vertex on line %d\n",lineno);
+        return false;
+      }
+      t[k++] = MergeVertex(v,vertexMap,tri);
+      if(k == 3) {
+        tri.tris.push_back(t);
+        k = 0;
       }
-      if(i>=63) {
-        buf[64]=0;
-        fprintf(stderr,"LoadOBJ: unsupported command \"%s\" on line %d\n",buf,lineno);
+    }
+    //facet, outer loop, endloop, endfacet, and endsolid are skipped
+    cur.SkipLine();
+  }
+  if(k != 0) {
+    fprintf(stderr,"LoadSTL: number of vertices is not a multiple of 3\n");
+    return false;
+  }
+  return true;
+}
+
+bool SaveSTL(const char* fn,const TriMesh& tri)
+{
+  FILE* f = fopen(fn,"wb");
+  if(!f) return false;
+  bool swapBytes = !IsLittleEndian();
+  char header[84];
+  memset(header,0,84);
+  strcpy(header,"binary STL");
+  WriteLittleEndian<unsigned int>((unsigned int)tri.tris.size(),header+80,swapBytes);
+  if(fwrite(header,1,84,f) != 84) { fclose(f); return false; }
+  //write in chunks of triangles
+  const size_t chunkSize = 4096;
+  vector<char> buf(chunkSize*50);
+  Triangle3D t;
+  for(size_t start=0;start<tri.tris.size();start+=chunkSize) {
+    size_t n = Min(chunkSize,tri.tris.size()-start);
+    memset(&buf[0],0,n*50);
+    for(size_t i=0;i<n;i++) {
+      char* p = &buf[i*50];
+      tri.GetTriangle(int(start+i),t);
+      Vector3 normal = t.normal();
+      const Vector3* v[4] = {&normal,&t.a,&t.b,&t.c};
+      for(int k=0;k<4;k++) 
+        for(int d=0;d<3;d++)
+          WriteLittleEndian<float>((float)(*v[k])[d],p+12*k+4*d,swapBytes);
+    }
+    if(fwrite(&buf[0],50,n,f) != n) { fclose(f); return false; }
+  }
+  fclose(f);
+  return true;
+}
+
+//PLY scalar types
+enum { PLYChar, PLYUChar, PLYShort, PLYUShort, PLYInt, PLYUInt, PLYFloat, PLYDouble, PLYInvalid };
+
+static int PLYType(const string& name)
+{
+  if(name == "char" || name == "int8") return PLYChar;
+  if(name == "uchar" || name == "uint8") return PLYUChar;
+  if(name == "short" || name == "int16") return PLYShort;
+  if(name == "ushort" || name == "uint16") return PLYUShort;
+  if(name == "int" || name == "int32") return PLYInt;
+  if(name == "uint" || name == "uint32") return PLYUInt;
+  if(name == "float" || name == "float32") return PLYFloat;
+  if(name == "double" || name == "float64") return PLYDouble;
+  return PLYInvalid;
+}
+
+static const int PLYTypeSize[] = {1,1,2,2,4,4,4,8};
+
+inline double ReadPLYValue(const char* p,int type,bool swapBytes)
+{
+  switch(type) {
+  case PLYChar: return *(const signed char*)p;
+  case PLYUChar: return *(const unsigned char*)p;
+  case PLYShort: return ReadLittleEndian<short>(p,swapBytes);
+  case PLYUShort: return ReadLittleEndian<unsigned short>(p,swapBytes);
+  case PLYInt: return ReadLittleEndian<int>(p,swapBytes);
+  case PLYUInt: return ReadLittleEndian<unsigned int>(p,swapBytes);
+  case PLYFloat: return ReadLittleEndian<float>(p,swapBytes);
+  default: return ReadLittleEndian<double>(p,swapBytes);
+  }
+}
+
+struct PLYProperty
+{
+  string name;
+  int type;
+  int countType;   //PLYInvalid if not a list
+};
+
+struct PLYElement
+{
+  string name;
+  size_t count;
+  vector<PLYProperty> properties;
+};
+
+bool LoadPLY(const char* fn,TriMesh& tri)
+{
+  FileUtils::FileView file;
+  if(!file.Open(fn)) return false;
+  tri.verts.resize(0);
+  tri.tris.resize(0);
+  //parse the header
+  TextCursor cur(file.data,file.size);
+  const char* word;
+  size_t len;
+  cur.ReadWord(word,len);
+  if(len != 3 || 0!=strncmp(word,"ply",3)) {
+    fprintf(stderr,"LoadPLY: %s is not a PLY file\n",fn);
+    return false;
+  }
+  cur.SkipLine();
+  int format = -1;  //0: ascii, 1: binary little endian, 2: binary big endian
+  vector<PLYElement> elements;
+  while(true) {
+    if(cur.AtEnd()) {
+      fprintf(stderr,"LoadPLY: unexpected end of header\n");
+      return false;
+    }
+    int lineno = cur.line;
+    cur.ReadWord(word,len);
+    string cmd(word,len);
+    if(cmd == "end_header") {
+      cur.SkipLine();
+      break;
+    }
+    else if(cmd == "format") {
+      cur.ReadWord(word,len);
+      string fmt(word,len);
+      if(fmt == "ascii") format = 0;
+      else if(fmt == "binary_little_endian") format = 1;
+      else if(fmt == "binary_big_endian") format = 2;
+      else {
+        fprintf(stderr,"LoadPLY: unknown format %s\n",fmt.c_str());
         return false;
       }
-      buf[i]=0;
-      if(0==strcmp(buf,"mtllib")) {
-        fgetline(f,buf,1024);
-        char* path = new char [strlen(fn)];
-        GetFilePath(fn,path);
-        if(!LoadOBJMaterial(path,buf,app)) {
-          fprintf(stderr,"LoadOBJ: error loading material file \"%s\" on line %d\n",(string(path)+"/"+string(buf)).c_str(),lineno);
+    }
+    else if(cmd == "element") {
+      PLYElement e;
+      cur.ReadWord(word,len);
+      e.name = string(word,len);
+      int count;
+      if(!cur.ReadInt(count) || count < 0) {
+        fprintf(stderr,"LoadPLY: invalid element count on line %d\n",lineno);
+        return false;
+      }
+      e.count = count;
+      elements.push_back(e);
+    }
+    else if(cmd == "property") {
+      if(elements.empty()) {
+        fprintf(stderr,"LoadPLY: property without element on line %d\n",lineno);
+        return false;
+      }
+      PLYProperty prop;
+      prop.countType = PLYInvalid;
+      cur.ReadWord(word,len);
+      string type(word,len);
+      if(type == "list") {
+        cur.ReadWord(word,len);
+        prop.countType = PLYType(string(word,len));
+        cur.ReadWord(word,len);
+        type = string(word,len);
+        if(prop.countType == PLYInvalid) {
+          fprintf(stderr,"LoadPLY: invalid list count type on line %d\n",lineno);
           return false;
         }
       }
-      else {
-        fprintf(stderr,"LoadOBJ: unsupported command \"%s\" on line %d\n",buf,lineno);
+      prop.type = PLYType(type);
+      if(prop.type == PLYInvalid) {
+        fprintf(stderr,"LoadPLY: invalid property type %s on line %d\n",type.c_str(),lineno);
         return false;
       }
+      cur.ReadWord(word,len);
+      prop.name = string(word,len);
+      elements.back().properties.push_back(prop);
     }
-    else {
-      fprintf(stderr,"LoadOBJ: unsupported start character \"%c\" on line %d\n",c,lineno);
+    else if(cmd != "comment" && cmd != "obj_info" && !cmd.empty()) {
+      fprintf(stderr,"LoadPLY: unknown header line %s on line %d\n",cmd.c_str(),lineno);
       return false;
     }
+    cur.SkipLine();
+  }
+  if(format < 0) {
+    fprintf(stderr,"LoadPLY: no format specified\n");
+    return false;
+  }
+  bool swapBytes = ((format == 1) != IsLittleEndian());
+  const char* p = cur.p;
+  const char* end = file.data+file.size;
+  vector<int> face;
+  vector<double> values;
+  for(size_t e=0;e<elements.size();e++) {
+    const PLYElement& elem = elements[e];
+    bool isVertex = (elem.name == "vertex"), isFace = (elem.name == "face");
+    //locate the coordinates and the vertex index list
+    int xyz[3] = {-1,-1,-1};
+    int indexProp = -1;
+    for(size_t i=0;i<elem.properties.size();i++) {
+      const PLYProperty& prop = elem.properties[i];
+      if(isVertex && prop.countType == PLYInvalid) {
+        if(prop.name == "x") xyz[0] = (int)i;
+        else if(prop.name == "y") xyz[1] = (int)i;
+        else if(prop.name == "z") xyz[2] = (int)i;
+      }
+      if(isFace && prop.countType != PLYInvalid && (prop.name == "vertex_indices" || prop.name == "vertex_index"))
+        indexProp = (int)i;
+    }
+    if(isVertex) {
+      if(xyz[0] < 0 || xyz[1] < 0 || xyz[2] < 0) {
+        fprintf(stderr,"LoadPLY: vertex element does not have x, y, z properties\n");
+        return false;
+      }
+      tri.verts.resize(elem.count);
+    }
+    if(isFace) tri.tris.reserve(elem.count);
+    if(format == 0) {
+      cur.p = p;
+      for(size_t n=0;n<elem.count;n++) {
+        cur.SkipWhitespace();
+        face.resize(0);
+        for(size_t i=0;i<elem.properties.size();i++) {
+          const PLYProperty& prop = elem.properties[i];
+          int count = 1;
+          if(prop.countType != PLYInvalid && !cur.ReadInt(count)) {
+            fprintf(stderr,"LoadPLY: error reading list size on line %d\n",cur.line);
+            return false;
+          }
+          for(int k=0;k<count;k++) {
+            Real x;
+            if(!cur.ReadReal(x)) {
+              fprintf(stderr,"LoadPLY: error reading %s on line %d\n",prop.name.c_str(),cur.line);
+              return false;
+            }
+            if(isVertex) {
+              for(int d=0;d<3;d++)
+                if(xyz[d] == (int)i) tri.verts[n][d] = x;
+            }
+            else if((int)i == indexProp) face.push_back((int)x);
+          }
+        }
+        if(isFace && indexProp >= 0) {
+          for(size_t i=2;i<face.size();i++) 
+            tri.tris.push_back(IntTriple(face[0],face[i-1],face[i]));
+        }
+      }
+      p = cur.p;
+    }
+    else {
+      //binary: compute the offsets if the element has a fixed size
+      bool fixedSize = true;
+      int stride = 0;
+      vector<int> offsets(elem.properties.size());
+      for(size_t i=0;i<elem.properties.size();i++) {
+        offsets[i] = stride;
+        if(elem.properties[i].countType != PLYInvalid) fixedSize = false;
+        stride += PLYTypeSize[elem.properties[i].type];
+      }
+      if(fixedSize) {
+        if(p + stride*elem.count > end) {
+          fprintf(stderr,"LoadPLY: unexpected end of file in element %s\n",elem.name.c_str());
+          return false;
+        }
+        if(isVertex) {
+          for(size_t n=0;n<elem.count;n++,p+=stride) 
+            for(int d=0;d<3;d++)
+              tri.verts[n][d] = ReadPLYValue(p+offsets[xyz[d]],elem.properties[xyz[d]].type,swapBytes);
+        }
+        else
+          p += stride*elem.count;
+        continue;
+      }
+      for(size_t n=0;n<elem.count;n++) {
+        face.resize(0);
+        for(size_t i=0;i<elem.properties.size();i++) {
+          const PLYProperty& prop = elem.properties[i];
+          int size = PLYTypeSize[prop.type];
+          int count = 1;
+          if(prop.countType != PLYInvalid) {
+            if(p + PLYTypeSize[prop.countType] > end) {
+              fprintf(stderr,"LoadPLY: unexpected end of file in element %s\n",elem.name.c_str());
+              return false;
+            }
+            count = (int)ReadPLYValue(p,prop.countType,swapBytes);
+            p += PLYTypeSize[prop.countType];
+          }
+          if(count < 0 || p + size*count > end) {
+            fprintf(stderr,"LoadPLY: unexpected end of file in element %s\n",elem.name.c_str());
+            return false;
+          }
+          if((int)i == indexProp) {
+            for(int k=0;k<count;k++) 
+              face.push_back((int)ReadPLYValue(p+k*size,prop.type,swapBytes));
+          }
+          else if(isVertex) {
+            for(int d=0;d<3;d++)
+              if(xyz[d] == (int)i) tri.verts[n][d] = ReadPLYValue(p,prop.type,swapBytes);
+          }
+          p += size*count;
+        }
+        if(isFace && indexProp >= 0) {
+          for(size_t i=2;i<face.size();i++) 
+            tri.tris.push_back(IntTriple(face[0],face[i-1],face[i]));
+        }
+      }
+    }
+  }
+  for(size_t i=0;i<tri.tris.size();i++) {
+    for(int k=0;k<3;k++) {
+      if(tri.tris[i][k] < 0 || tri.tris[i][k] >= (int)tri.verts.size()) {
+        fprintf(stderr,"LoadPLY: face %d references invalid vertex %d\n",(int)i,tri.tris[i][k]);
+        return false;
+      }
+    }
   }
   return true;
 }
 
+bool SavePLY(const char* fn,const TriMesh& tri)
+{
+  FILE* f = fopen(fn,"wb");
+  if(!f) return false;
+  bool swapBytes = !IsLittleEndian();
+  fprintf(f,"ply\nformat binary_little_endian 1.0\n");
+  fprintf(f,"element vertex %d\nproperty double x\nproperty double y\nproperty double z\n",(int)tri.verts.size());
+  fprintf(f,"element face %d\nproperty list uchar int vertex_indices\nend_header\n",(int)tri.tris.size());
+  const size_t chunkSize = 4096;
+  vector<char> buf(chunkSize*24);
+  for(size_t start=0;start<tri.verts.size();start+=chunkSize) {
+    size_t n = Min(chunkSize,tri.verts.size()-start);
+    for(size_t i=0;i<n;i++)
+      for(int d=0;d<3;d++)
+        WriteLittleEndian<double>(tri.verts[start+i][d],&buf[i*24+d*8],swapBytes);
+    if(fwrite(&buf[0],24,n,f) != n) { fclose(f); return false; }
+  }
+  for(size_t start=0;start<tri.tris.size();start+=chunkSize) {
+    size_t n = Min(chunkSize,tri.tris.size()-start);
+    for(size_t i=0;i<n;i++) {
+      char* p = &buf[i*13];
+      *p = 3;
+      for(int k=0;k<3;k++)
+        WriteLittleEndian<int>(tri.tris[start+i][k],p+1+4*k,swapBytes);
+    }
+    if(fwrite(&buf[0],13,n,f) != n) { fclose(f); return false; }
+  }
+  fclose(f);
+  return true;
+}
 
 
 #if HAVE_ASSIMP
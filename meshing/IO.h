@@ -37,6 +37,25 @@ bool LoadOFF(std::istream& in,TriMesh& tri);
 ///Saves to the GeomView Object File Format (OFF)
 bool SaveOFF(std::ostream& out,const TriMesh& tri);
 
+///Loads from the Wavefront OBJ format.  The file is memory-mapped and
+///tokenized in place.  Normals, texture coordinates, and groups are ignored.
+bool LoadOBJ(const char* fn,TriMesh& tri);
+///Loads from the Wavefront OBJ format, also reading per-vertex colors,
+///texture coordinates, and the texture map of the material library.
+bool LoadOBJ(const char* fn,TriMesh& tri,GLDraw::GeometryAppearance& appearance);
+
+///Loads from the STL format, either binary or ASCII.  Vertices with
+///identical coordinates are merged.
+bool LoadSTL(const char* fn,TriMesh& tri);
+///Saves to the binary STL format (single precision)
+bool SaveSTL(const char* fn,const TriMesh& tri);
+
+///Loads the vertex and face elements of a Stanford PLY file, in ASCII or
+///binary format.  Polygonal faces are triangulated as fans.
+bool LoadPLY(const char* fn,TriMesh& tri);
+///Saves to the binary little-endian PLY format (double precision)
+bool SavePLY(const char* fn,const TriMesh& tri);
+
 ///Loads using Assimp if available on your system
 bool LoadAssimp(const char* fn,TriMesh& tri);
 ///Loads using Assimp if available on your system
@@ -5,6 +5,9 @@
 #include "MarchingCubes.h"
 #include <math3d/interpolate.h>
 #include <math/function.h>
+#include <KrisLibrary/utils/threadutils.h>
+#include <algorithm>
+using namespace std;
 
 namespace Meshing {
 
@@ -325,389 +328,306 @@ inline Vector3 MulCubeOffset(const Vector3& dx,int v)
 		 (cube[v][2]?dx.z:Zero));
 }
 
-void EvaluateCube(ScalarFieldFunction& f,const Vector3& x,const Vector3& dx,Real vals[8])
+Vector3 EvalCubeEdge(const Vector3& x0,const Vector3& dx,Real u,int v1,int v2)
 {
-  Vector v(3);
-  v.copy(x + MulCubeOffset(dx,0));  vals[0] = f(v);
-  v.copy(x + MulCubeOffset(dx,1));  vals[1] = f(v);
-  v.copy(x + MulCubeOffset(dx,2));  vals[2] = f(v);
-  v.copy(x + MulCubeOffset(dx,3));  vals[3] = f(v);
-  v.copy(x + MulCubeOffset(dx,4));  vals[4] = f(v);
-  v.copy(x + MulCubeOffset(dx,5));  vals[5] = f(v);
-  v.copy(x + MulCubeOffset(dx,6));  vals[6] = f(v);
-  v.copy(x + MulCubeOffset(dx,7));  vals[7] = f(v);
+  Vector3 d;
+  interpolate(MulCubeOffset(dx,v1),MulCubeOffset(dx,v2),u,d);
+  return x0+d;
 }
 
-void EvaluateCube(Real (*f)(Real,Real,Real),const Vector3& x,const Vector3& dx,Real vals[8])
+//number of cells on a side of a min/max block
+const static int MCBlockSize = 8;
+
+/* Grid edge that a cube edge lies on: the offset of its lower endpoint from
+ * the cube's origin and the axis along which it points.
+ */
+struct MCEdgeInfo
 {
-  Vector3 v;
-  v = x + MulCubeOffset(dx,0);  vals[0] = f(v.x,v.y,v.z);
-  v = x + MulCubeOffset(dx,1);  vals[1] = f(v.x,v.y,v.z);
-  v = x + MulCubeOffset(dx,2);  vals[2] = f(v.x,v.y,v.z);
-  v = x + MulCubeOffset(dx,3);  vals[3] = f(v.x,v.y,v.z);
-  v = x + MulCubeOffset(dx,4);  vals[4] = f(v.x,v.y,v.z);
-  v = x + MulCubeOffset(dx,5);  vals[5] = f(v.x,v.y,v.z);
-  v = x + MulCubeOffset(dx,6);  vals[6] = f(v.x,v.y,v.z);
-  v = x + MulCubeOffset(dx,7);  vals[7] = f(v.x,v.y,v.z);
+  int dx,dy,dz;
+  int axis;
+};
+
+//the edge info of each of the 12 marching cubes edges.  Edge e joins the
+//cube vertices (0,1),(1,2),(2,3),(3,0),(4,5),(5,6),(6,7),(7,4),(0,4),(1,5),
+//(2,6),(3,7) for e=0..11, and its entry is the lower of the two vertex
+//offsets in cube and the axis along which they differ.  It is a constant
+//table so that concurrent first calls don't race to fill it.
+const static MCEdgeInfo edgeInfo[12] = {
+  {0,0,0,0},{1,0,0,2},{0,0,1,0},{0,0,0,2},
+  {0,1,0,0},{1,1,0,2},{0,1,1,0},{0,1,0,2},
+  {0,0,0,1},{1,0,0,1},{1,0,1,1},{0,0,1,1}
+};
+
+/* Output of marching cubes on the cell layers [i0,i1) of a grid.
+ *
+ * Vertices are shared between cells of the slab.  firstPlane and lastPlane
+ * give the vertex indices on the y and z edges of the x=i0 and x=i1 grid
+ * planes (-1 if none), which are used to stitch adjacent slabs together.
+ * Entry (j*p+k)*2+axis-1 refers to the edge leaving vertex (j,k) along axis.
+ */
+struct MCSlab
+{
+  const Array3D<Real>* input;
+  Real isoLevel;
+  Vector3 origin,dh;
+  int i0,i1;
+
+  vector<Vector3> verts;
+  vector<IntTriple> tris;
+  vector<int> firstPlane,lastPlane;
+};
+
+/* Computes the range of values at the grid vertices of each block in the
+ * block layer bi.  Returns false if no block in the layer straddles isoLevel.
+ */
+static bool ComputeBlockRanges(const Array3D<Real>& input,Real isoLevel,int bi,int nbj,int nbk,vector<bool>& active)
+{
+  int m=input.m,n=input.n,p=input.p;
+  int ilo=bi*MCBlockSize, ihi=Min((bi+1)*MCBlockSize,m-1);
+  bool any = false;
+  for(int bj=0;bj<nbj;bj++) {
+    int jlo=bj*MCBlockSize, jhi=Min((bj+1)*MCBlockSize,n-1);
+    for(int bk=0;bk<nbk;bk++) {
+      int klo=bk*MCBlockSize, khi=Min((bk+1)*MCBlockSize,p-1);
+      Real vmin = input(ilo,jlo,klo), vmax = vmin;
+      for(int i=ilo;i<=ihi;i++)
+	for(int j=jlo;j<=jhi;j++) {
+	  const Real* row = &input(i,j,0);
+	  for(int k=klo;k<=khi;k++) {
+	    if(row[k] < vmin) vmin = row[k];
+	    else if(row[k] > vmax) vmax = row[k];
+	  }
+	}
+      //the cube index is computed with vals < isoLevel
+      bool a = (vmin < isoLevel && vmax >= isoLevel);
+      active[bj*nbk+bk] = a;
+      any = (any || a);
+    }
+  }
+  return any;
 }
 
-void EvaluateCube(const Array3D<Real>& a,int i,int j,int k,Real vals[8])
+/* Runs marching cubes on the slab, sharing vertices along grid edges.
+ * Edge vertex indices are cached for the two grid planes bounding the
+ * current cell layer and for the x edges between them.
+ */
+static void MarchingCubesSlab(MCSlab& slab)
 {
-  vals[0] = a(i  ,j  ,k  );
-  vals[1] = a(i+1,j  ,k  );
-  vals[2] = a(i+1,j  ,k+1);
-  vals[3] = a(i  ,j  ,k+1);
-  vals[4] = a(i  ,j+1,k  );
-  vals[5] = a(i+1,j+1,k  );
-  vals[6] = a(i+1,j+1,k+1);
-  vals[7] = a(i  ,j+1,k+1);
+  const Array3D<Real>& input = *slab.input;
+  Real isoLevel = slab.isoLevel;
+  int n=input.n,p=input.p;
+  int planeSize = n*p;
+  int nbj = (n-2)/MCBlockSize+1, nbk = (p-2)/MCBlockSize+1;
+  vector<int> lo(planeSize*2,-1),hi(planeSize*2,-1),xEdges(planeSize,-1);
+  vector<bool> active(nbj*nbk,false);
+  bool layerActive = false;
+  slab.firstPlane.resize(0);
+  slab.lastPlane.resize(0);
+
+  Real vals[8];
+  int vertMap[12];
+  IntTriple tri;
+  for(int i=slab.i0;i<slab.i1;i++) {
+    if(i == slab.i0 || i % MCBlockSize == 0)
+      layerActive = ComputeBlockRanges(input,isoLevel,i/MCBlockSize,nbj,nbk,active);
+    if(layerActive) {
+      for(int j=0;j+1<n;j++) {
+	int bj = j/MCBlockSize;
+	for(int k=0;k+1<p;k++) {
+	  if(!active[bj*nbk+k/MCBlockSize]) {
+	    k = (k/MCBlockSize+1)*MCBlockSize-1;
+	    continue;
+	  }
+	  vals[0] = input(i  ,j  ,k  );
+	  vals[1] = input(i+1,j  ,k  );
+	  vals[2] = input(i+1,j  ,k+1);
+	  vals[3] = input(i  ,j  ,k+1);
+	  vals[4] = input(i  ,j+1,k  );
+	  vals[5] = input(i+1,j+1,k  );
+	  vals[6] = input(i+1,j+1,k+1);
+	  vals[7] = input(i  ,j+1,k+1);
+
+	  int cubeIndex = 0;
+	  if (vals[0] < isoLevel) cubeIndex |= 1;
+	  if (vals[1] < isoLevel) cubeIndex |= 2;
+	  if (vals[2] < isoLevel) cubeIndex |= 4;
+	  if (vals[3] < isoLevel) cubeIndex |= 8;
+	  if (vals[4] < isoLevel) cubeIndex |= 16;
+	  if (vals[5] < isoLevel) cubeIndex |= 32;
+	  if (vals[6] < isoLevel) cubeIndex |= 64;
+	  if (vals[7] < isoLevel) cubeIndex |= 128;
+
+	  int edgeFlags = MCEdgeTable[cubeIndex];
+	  if (edgeFlags == 0) continue;
+
+	  for(int e=0;e<12;e++) {
+	    if(!(edgeFlags & (1<<e))) continue;
+	    const MCEdgeInfo& info = edgeInfo[e];
+	    int vj = j+info.dy, vk = k+info.dz;
+	    int* cache;
+	    if(info.axis == 0) cache = &xEdges[vj*p+vk];
+	    else if(info.dx == 0) cache = &lo[(vj*p+vk)*2+info.axis-1];
+	    else cache = &hi[(vj*p+vk)*2+info.axis-1];
+	    if(*cache < 0) {
+	      //evaluate the crossing on the grid edge from its lower endpoint,
+	      //so that both slabs touching a plane compute the same point
+	      int vi = i+info.dx;
+	      Real a = input(vi,vj,vk);
+	      Real b;
+	      if(info.axis == 0) b = input(vi+1,vj,vk);
+	      else if(info.axis == 1) b = input(vi,vj+1,vk);
+	      else b = input(vi,vj,vk+1);
+	      Real u = SegmentCrossing(a,b,isoLevel);
+	      Vector3 x(slab.origin.x+Real(vi)*slab.dh.x,
+			slab.origin.y+Real(vj)*slab.dh.y,
+			slab.origin.z+Real(vk)*slab.dh.z);
+	      if(info.axis == 0) x.x += u*slab.dh.x;
+	      else if(info.axis == 1) x.y += u*slab.dh.y;
+	      else x.z += u*slab.dh.z;
+	      *cache = (int)slab.verts.size();
+	      slab.verts.push_back(x);
+	    }
+	    vertMap[e] = *cache;
+	  }
+	  for(int* t=MCTriTable[cubeIndex];*t!=-1; t+=3) {
+	    tri.a = vertMap[*t];
+	    tri.b = vertMap[*(t+1)];
+	    tri.c = vertMap[*(t+2)];
+	    slab.tris.push_back(tri);
+	  }
+	}
+      }
+    }
+    if(i == slab.i0) slab.firstPlane = lo;
+    if(i+1 == slab.i1) slab.lastPlane = hi;
+    else {
+      swap(lo,hi);
+      fill(hi.begin(),hi.end(),-1);
+      fill(xEdges.begin(),xEdges.end(),-1);
+    }
+  }
 }
 
-Vector3 EvalCubeEdge(const Vector3& x0,const Vector3& dx,Real u,int v1,int v2)
+static void* MarchingCubesSlabThread(void* data)
 {
-  Vector3 d;
-  interpolate(MulCubeOffset(dx,v1),MulCubeOffset(dx,v2),u,d);
-  return x0+d;
+  MarchingCubesSlab(*(MCSlab*)data);
+  return NULL;
 }
 
 void MarchingCubes(ScalarFieldFunction& input,Real isoLevel,const AABB3D& bb,const int dims[3],TriMesh& m)
 {
-  m.verts.resize(0);
-  m.tris.resize(0);
-  m.verts.reserve(dims[0]*dims[1]);
-  m.tris.reserve(dims[0]*dims[1]);
-  Real vals[8];
-  Vector3 verts[12];
-  int vertMap[12];
-  Vector3 x;
   Vector3 dh(bb.bmax-bb.bmin);
   dh.x /= Real(dims[0]-1);
   dh.y /= Real(dims[1]-1);
   dh.z /= Real(dims[2]-1);
 
-  IntTriple tri;
-  x = bb.bmin;
-  for (int i=0;i<dims[0]-1;i++,x.x += dh.x) {
-    x.y = bb.bmin.y;
-    for (int j=0;j<dims[1]-1;j++,x.y += dh.y) {
-      x.z = bb.bmin.z;
-      for (int k=0;k<dims[2]-1;k++,x.z += dh.z) {
-	EvaluateCube(input,x,dh,vals);
-	
-	int cubeIndex = 0;
-	if (vals[0] < isoLevel) cubeIndex |= 1;
-	if (vals[1] < isoLevel) cubeIndex |= 2;
-	if (vals[2] < isoLevel) cubeIndex |= 4;
-	if (vals[3] < isoLevel) cubeIndex |= 8;
-	if (vals[4] < isoLevel) cubeIndex |= 16;
-	if (vals[5] < isoLevel) cubeIndex |= 32;
-	if (vals[6] < isoLevel) cubeIndex |= 64;
-	if (vals[7] < isoLevel) cubeIndex |= 128;
-
-	if (MCEdgeTable[cubeIndex] == 0) {
-	  continue;
-	}
-
-	int vertoffset = (int)m.verts.size();
-	if (MCEdgeTable[cubeIndex] & 1) {
-	  Real u=SegmentCrossing(vals[0], vals[1], isoLevel);
-	  verts[0] = EvalCubeEdge(x,dh,u,0,1);
-	}
-	if (MCEdgeTable[cubeIndex] & 2) {
-	  Real u=SegmentCrossing(vals[1], vals[2], isoLevel);
-	  verts[1] = EvalCubeEdge(x,dh,u,1,2);
-	}
-	if (MCEdgeTable[cubeIndex] & 4) {
-	  Real u=SegmentCrossing(vals[2], vals[3], isoLevel);
-	  verts[2] = EvalCubeEdge(x,dh,u,2,3);
-	}
-	if (MCEdgeTable[cubeIndex] & 8) {
-	  Real u=SegmentCrossing(vals[3], vals[0], isoLevel);
-	  verts[3] = EvalCubeEdge(x,dh,u,3,0);
-	}
-	if (MCEdgeTable[cubeIndex] & 16) {
-	  Real u=SegmentCrossing(vals[4], vals[5], isoLevel);
-	  verts[4] = EvalCubeEdge(x,dh,u,4,5);
-	}
-	if (MCEdgeTable[cubeIndex] & 32) {
-	  Real u=SegmentCrossing(vals[5], vals[6], isoLevel);
-	  verts[5] = EvalCubeEdge(x,dh,u,5,6);
-	}
-	if (MCEdgeTable[cubeIndex] & 64) {
-	  Real u=SegmentCrossing(vals[6], vals[7], isoLevel);
-	  verts[6] = EvalCubeEdge(x,dh,u,6,7);
-	}
-	if (MCEdgeTable[cubeIndex] & 128) {
-	  Real u=SegmentCrossing(vals[7], vals[4], isoLevel);
-	  verts[7] = EvalCubeEdge(x,dh,u,7,4);
-	}
-	if (MCEdgeTable[cubeIndex] & 256) {
-	  Real u=SegmentCrossing(vals[0], vals[4], isoLevel);
-	  verts[8] = EvalCubeEdge(x,dh,u,0,4);
-	}
-	if (MCEdgeTable[cubeIndex] & 512) {
-	  Real u=SegmentCrossing(vals[1], vals[5], isoLevel);
-	  verts[9] = EvalCubeEdge(x,dh,u,1,5);
-	}
-	if (MCEdgeTable[cubeIndex] & 1024) {
-	  Real u=SegmentCrossing(vals[2], vals[6], isoLevel);
-	  verts[10] = EvalCubeEdge(x,dh,u,2,6);
-	}
-	if (MCEdgeTable[cubeIndex] & 2048) {
-	  Real u=SegmentCrossing(vals[3], vals[7], isoLevel);
-	  verts[11] = EvalCubeEdge(x,dh,u,3,7);
-	}
-
-	//get the mapping from tri vertices to mesh vertices
-	for(int* t=MCTriTable[cubeIndex];*t!=-1; t++) {
-	  vertMap[*t] = (int)m.verts.size();
-	  m.verts.push_back(verts[*t]);
-	}
-	for(int* t=MCTriTable[cubeIndex];*t!=-1; t+=3) {
-	  tri.a = vertMap[*t];
-	  tri.b = vertMap[*(t+1)];
-	  tri.c = vertMap[*(t+2)];
-	  if(tri.a < vertoffset || tri.a >= (int)m.verts.size() ||
-	     tri.b < vertoffset || tri.b >= (int)m.verts.size() ||
-	     tri.c < vertoffset || tri.c >= (int)m.verts.size())
-	    {
-	      fprintf(stderr,"Internal Marching cubes error!\n");
-	      fprintf(stderr,"Triangle %d %d %d invalid\n",tri.a,tri.b,tri.c);
-	      fprintf(stderr,"Starting vertex size: %d ending vertex size %d\n",vertoffset,m.verts.size());
-	      fprintf(stderr,"cube index %d\n",cubeIndex);
-	      abort();
-	    }
-	  m.tris.push_back(tri);
-	}
+  //the function is evaluated once per grid vertex rather than 8 times per
+  //cell. Evaluation is serial since f is not assumed to be thread-safe
+  Array3D<Real> grid(dims[0],dims[1],dims[2]);
+  Vector v(3);
+  for (int i=0;i<dims[0];i++) {
+    v(0) = bb.bmin.x + Real(i)*dh.x;
+    for (int j=0;j<dims[1];j++) {
+      v(1) = bb.bmin.y + Real(j)*dh.y;
+      for (int k=0;k<dims[2];k++) {
+	v(2) = bb.bmin.z + Real(k)*dh.z;
+	grid(i,j,k) = input(v);
       }
     }
   }
-  assert(m.IsValid());
-
-  //TODO: merge vertices
+  MarchingCubes(grid,isoLevel,bb,m);
 }
 
 void MarchingCubes(Real (*input)(Real,Real,Real),Real isoLevel,const AABB3D& bb,const int dims[3],TriMesh& m)
 {
-  m.verts.resize(0);
-  m.tris.resize(0);
-  m.verts.reserve(dims[0]*dims[1]);
-  m.tris.reserve(dims[0]*dims[1]);
-  Real vals[8];
-  Vector3 verts[12];
-  int vertMap[12];
-  Vector3 x;
   Vector3 dh(bb.bmax-bb.bmin);
   dh.x /= Real(dims[0]-1);
   dh.y /= Real(dims[1]-1);
   dh.z /= Real(dims[2]-1);
 
-  IntTriple tri;
-  x = bb.bmin;
-  for (int i=0;i<dims[0]-1;i++,x.x += dh.x) {
-    x.y = bb.bmin.y;
-    for (int j=0;j<dims[1]-1;j++,x.y += dh.y) {
-      x.z = bb.bmin.z;
-      for (int k=0;k<dims[2]-1;k++,x.z += dh.z) {
-	EvaluateCube(input,x,dh,vals);
-	
-	int cubeIndex = 0;
-	if (vals[0] < isoLevel) cubeIndex |= 1;
-	if (vals[1] < isoLevel) cubeIndex |= 2;
-	if (vals[2] < isoLevel) cubeIndex |= 4;
-	if (vals[3] < isoLevel) cubeIndex |= 8;
-	if (vals[4] < isoLevel) cubeIndex |= 16;
-	if (vals[5] < isoLevel) cubeIndex |= 32;
-	if (vals[6] < isoLevel) cubeIndex |= 64;
-	if (vals[7] < isoLevel) cubeIndex |= 128;
-
-	if (MCEdgeTable[cubeIndex] == 0) {
-	  continue;
-	}
-
-	int vertoffset = (int)m.verts.size();
-	if (MCEdgeTable[cubeIndex] & 1) {
-	  Real u=SegmentCrossing(vals[0], vals[1], isoLevel);
-	  verts[0] = EvalCubeEdge(x,dh,u,0,1);
-	}
-	if (MCEdgeTable[cubeIndex] & 2) {
-	  Real u=SegmentCrossing(vals[1], vals[2], isoLevel);
-	  verts[1] = EvalCubeEdge(x,dh,u,1,2);
-	}
-	if (MCEdgeTable[cubeIndex] & 4) {
-	  Real u=SegmentCrossing(vals[2], vals[3], isoLevel);
-	  verts[2] = EvalCubeEdge(x,dh,u,2,3);
-	}
-	if (MCEdgeTable[cubeIndex] & 8) {
-	  Real u=SegmentCrossing(vals[3], vals[0], isoLevel);
-	  verts[3] = EvalCubeEdge(x,dh,u,3,0);
-	}
-	if (MCEdgeTable[cubeIndex] & 16) {
-	  Real u=SegmentCrossing(vals[4], vals[5], isoLevel);
-	  verts[4] = EvalCubeEdge(x,dh,u,4,5);
-	}
-	if (MCEdgeTable[cubeIndex] & 32) {
-	  Real u=SegmentCrossing(vals[5], vals[6], isoLevel);
-	  verts[5] = EvalCubeEdge(x,dh,u,5,6);
-	}
-	if (MCEdgeTable[cubeIndex] & 64) {
-	  Real u=SegmentCrossing(vals[6], vals[7], isoLevel);
-	  verts[6] = EvalCubeEdge(x,dh,u,6,7);
-	}
-	if (MCEdgeTable[cubeIndex] & 128) {
-	  Real u=SegmentCrossing(vals[7], vals[4], isoLevel);
-	  verts[7] = EvalCubeEdge(x,dh,u,7,4);
-	}
-	if (MCEdgeTable[cubeIndex] & 256) {
-	  Real u=SegmentCrossing(vals[0], vals[4], isoLevel);
-	  verts[8] = EvalCubeEdge(x,dh,u,0,4);
-	}
-	if (MCEdgeTable[cubeIndex] & 512) {
-	  Real u=SegmentCrossing(vals[1], vals[5], isoLevel);
-	  verts[9] = EvalCubeEdge(x,dh,u,1,5);
-	}
-	if (MCEdgeTable[cubeIndex] & 1024) {
-	  Real u=SegmentCrossing(vals[2], vals[6], isoLevel);
-	  verts[10] = EvalCubeEdge(x,dh,u,2,6);
-	}
-	if (MCEdgeTable[cubeIndex] & 2048) {
-	  Real u=SegmentCrossing(vals[3], vals[7], isoLevel);
-	  verts[11] = EvalCubeEdge(x,dh,u,3,7);
-	}
-
-	//get the mapping from tri vertices to mesh vertices
-	for(int* t=MCTriTable[cubeIndex];*t!=-1; t++) {
-	  vertMap[*t] = (int)m.verts.size();
-	  m.verts.push_back(verts[*t]);
-	}
-	for(int* t=MCTriTable[cubeIndex];*t!=-1; t+=3) {
-	  tri.a = vertMap[*t];
-	  tri.b = vertMap[*(t+1)];
-	  tri.c = vertMap[*(t+2)];
-	  if(tri.a < vertoffset || tri.a >= (int)m.verts.size() ||
-	     tri.b < vertoffset || tri.b >= (int)m.verts.size() ||
-	     tri.c < vertoffset || tri.c >= (int)m.verts.size())
-	    {
-	      fprintf(stderr,"Internal Marching cubes error!\n");
-	      fprintf(stderr,"Triangle %d %d %d invalid\n",tri.a,tri.b,tri.c);
-	      fprintf(stderr,"Starting vertex size: %d ending vertex size %d\n",vertoffset,m.verts.size());
-	      fprintf(stderr,"cube index %d\n",cubeIndex);
-	      abort();
-	    }
-	  m.tris.push_back(tri);
-	}
-      }
+  Array3D<Real> grid(dims[0],dims[1],dims[2]);
+  for (int i=0;i<dims[0];i++) {
+    Real x = bb.bmin.x + Real(i)*dh.x;
+    for (int j=0;j<dims[1];j++) {
+      Real y = bb.bmin.y + Real(j)*dh.y;
+      for (int k=0;k<dims[2];k++)
+	grid(i,j,k) = input(x,y,bb.bmin.z + Real(k)*dh.z);
     }
   }
-  assert(m.IsValid());
-
-  //TODO: merge vertices
+  MarchingCubes(grid,isoLevel,bb,m);
 }
 
 
-void MarchingCubes(const Array3D<Real>& input,Real isoLevel,const AABB3D& bb,TriMesh& m)
+void MarchingCubes(const Array3D<Real>& input,Real isoLevel,const AABB3D& bb,TriMesh& m,int numThreads)
 {
   m.verts.resize(0);
   m.tris.resize(0);
-  m.verts.reserve(input.m*input.n);
-  m.tris.reserve(input.m*input.n);
-  Real vals[8];
-  Vector3 verts[12];
-  int vertMap[12];
-  Vector3 x;
+  if(input.m < 2 || input.n < 2 || input.p < 2) return;
+
   Vector3 dh(bb.bmax-bb.bmin);
   dh.x /= Real(input.m-1);
   dh.y /= Real(input.n-1);
   dh.z /= Real(input.p-1);
 
-  IntTriple tri;
-  x = bb.bmin;
-  for (int i=0;i<input.m-1;i++,x.x += dh.x) {
-    x.y = bb.bmin.y;
-    for (int j=0;j<input.n-1;j++,x.y += dh.y) {
-      x.z = bb.bmin.z;
-      for (int k=0;k<input.p-1;k++,x.z += dh.z) {
-	EvaluateCube(input,i,j,k,vals);
-	
-	int cubeIndex = 0;
-	if (vals[0] < isoLevel) cubeIndex |= 1;
-	if (vals[1] < isoLevel) cubeIndex |= 2;
-	if (vals[2] < isoLevel) cubeIndex |= 4;
-	if (vals[3] < isoLevel) cubeIndex |= 8;
-	if (vals[4] < isoLevel) cubeIndex |= 16;
-	if (vals[5] < isoLevel) cubeIndex |= 32;
-	if (vals[6] < isoLevel) cubeIndex |= 64;
-	if (vals[7] < isoLevel) cubeIndex |= 128;
-
-	if (MCEdgeTable[cubeIndex] == 0) {
-	  continue;
-	}
-
-	if (MCEdgeTable[cubeIndex] & 1) {
-	  Real u=SegmentCrossing(vals[0], vals[1], isoLevel);
-	  verts[0] = EvalCubeEdge(x,dh,u,0,1);
-	}
-	if (MCEdgeTable[cubeIndex] & 2) {
-	  Real u=SegmentCrossing(vals[1], vals[2], isoLevel);
-	  verts[1] = EvalCubeEdge(x,dh,u,1,2);
-	}
-	if (MCEdgeTable[cubeIndex] & 4) {
-	  Real u=SegmentCrossing(vals[2], vals[3], isoLevel);
-	  verts[2] = EvalCubeEdge(x,dh,u,2,3);
-	}
-	if (MCEdgeTable[cubeIndex] & 8) {
-	  Real u=SegmentCrossing(vals[3], vals[0], isoLevel);
-	  verts[3] = EvalCubeEdge(x,dh,u,3,0);
-	}
-	if (MCEdgeTable[cubeIndex] & 16) {
-	  Real u=SegmentCrossing(vals[4], vals[5], isoLevel);
-	  verts[4] = EvalCubeEdge(x,dh,u,4,5);
-	}
-	if (MCEdgeTable[cubeIndex] & 32) {
-	  Real u=SegmentCrossing(vals[5], vals[6], isoLevel);
-	  verts[5] = EvalCubeEdge(x,dh,u,5,6);
-	}
-	if (MCEdgeTable[cubeIndex] & 64) {
-	  Real u=SegmentCrossing(vals[6], vals[7], isoLevel);
-	  verts[6] = EvalCubeEdge(x,dh,u,6,7);
-	}
-	if (MCEdgeTable[cubeIndex] & 128) {
-	  Real u=SegmentCrossing(vals[7], vals[4], isoLevel);
-	  verts[7] = EvalCubeEdge(x,dh,u,7,4);
-	}
-	if (MCEdgeTable[cubeIndex] & 256) {
-	  Real u=SegmentCrossing(vals[0], vals[4], isoLevel);
-	  verts[8] = EvalCubeEdge(x,dh,u,0,4);
-	}
-	if (MCEdgeTable[cubeIndex] & 512) {
-	  Real u=SegmentCrossing(vals[1], vals[5], isoLevel);
-	  verts[9] = EvalCubeEdge(x,dh,u,1,5);
-	}
-	if (MCEdgeTable[cubeIndex] & 1024) {
-	  Real u=SegmentCrossing(vals[2], vals[6], isoLevel);
-	  verts[10] = EvalCubeEdge(x,dh,u,2,6);
-	}
-	if (MCEdgeTable[cubeIndex] & 2048) {
-	  Real u=SegmentCrossing(vals[3], vals[7], isoLevel);
-	  verts[11] = EvalCubeEdge(x,dh,u,3,7);
-	}
+  //split the cell layers into slabs aligned to the min/max blocks
+  int numBlockLayers = (input.m-2)/MCBlockSize+1;
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  int numSlabs = Min(numThreads,numBlockLayers);
+  vector<MCSlab> slabs(numSlabs);
+  for(int s=0;s<numSlabs;s++) {
+    slabs[s].input = &input;
+    slabs[s].isoLevel = isoLevel;
+    slabs[s].origin = bb.bmin;
+    slabs[s].dh = dh;
+    slabs[s].i0 = Min((s*numBlockLayers/numSlabs)*MCBlockSize,input.m-1);
+    slabs[s].i1 = Min(((s+1)*numBlockLayers/numSlabs)*MCBlockSize,input.m-1);
+  }
+  if(numSlabs == 1)
+    MarchingCubesSlab(slabs[0]);
+  else {
+    vector<Thread> threads(numSlabs);
+    for(int s=0;s<numSlabs;s++)
+      threads[s] = ThreadStart(MarchingCubesSlabThread,&slabs[s]);
+    for(int s=0;s<numSlabs;s++)
+      ThreadJoin(threads[s]);
+  }
 
-	//get the mapping from tri vertices to mesh vertices
-	for(int* t=MCTriTable[cubeIndex];*t!=-1; t++) {
-	  vertMap[*t] = (int)m.verts.size();
-	  m.verts.push_back(verts[*t]);
-	}
-	for(int* t=MCTriTable[cubeIndex];*t!=-1; t+=3) {
-	  tri.a = vertMap[*t];
-	  tri.b = vertMap[*(t+1)];
-	  tri.c = vertMap[*(t+2)];
-	  m.tris.push_back(tri);
-	}
+  //stitch the slabs: vertices on a slab's first plane are replaced by the
+  //previous slab's vertices on its last plane
+  size_t nv=0,nt=0;
+  for(int s=0;s<numSlabs;s++) {
+    nv += slabs[s].verts.size();
+    nt += slabs[s].tris.size();
+  }
+  m.verts.reserve(nv);
+  m.tris.reserve(nt);
+  vector<int> remap,prevRemap;
+  for(int s=0;s<numSlabs;s++) {
+    MCSlab& slab = slabs[s];
+    remap.resize(slab.verts.size());
+    fill(remap.begin(),remap.end(),-1);
+    if(s > 0) {
+      const vector<int>& prevPlane = slabs[s-1].lastPlane;
+      for(size_t e=0;e<slab.firstPlane.size();e++)
+	if(slab.firstPlane[e] >= 0 && prevPlane[e] >= 0)
+	  remap[slab.firstPlane[e]] = prevRemap[prevPlane[e]];
+    }
+    for(size_t v=0;v<slab.verts.size();v++) {
+      if(remap[v] < 0) {
+	remap[v] = (int)m.verts.size();
+	m.verts.push_back(slab.verts[v]);
       }
     }
+    for(size_t t=0;t<slab.tris.size();t++)
+      m.tris.push_back(IntTriple(remap[slab.tris[t].a],remap[slab.tris[t].b],remap[slab.tris[t].c]));
+    swap(remap,prevRemap);
+    if(s > 0) {
+      //no longer needed
+      vector<Vector3>().swap(slabs[s-1].verts);
+      vector<IntTriple>().swap(slabs[s-1].tris);
+    }
   }
-
-  //TODO: merge vertices
+  assert(m.IsValid());
 }
 
 void CubeToMesh(const Real origvals[8],Real isoLevel,const AABB3D& bb,TriMesh& m)
@@ -19,16 +19,28 @@ namespace Meshing {
   /** @addtogroup Meshing */
   /*@{*/
 
-/// Takes a 3D function as input, meshes the isosurface at f(x)=isoval
+/// Takes a 3D function as input, meshes the isosurface at f(x)=isoval.
+/// f is sampled once at each of the dims[0] x dims[1] x dims[2] grid
+/// vertices, and then the grid version is run on the samples.
 void MarchingCubes(ScalarFieldFunction& f,Real isoval,const AABB3D& bb,const int dims[3],TriMesh& m);
 
-/// Takes a 3D function as input, meshes the isosurface at f(x)=isoval
+/// Takes a 3D function as input, meshes the isosurface at f(x)=isoval.
+/// f is sampled once at each of the dims[0] x dims[1] x dims[2] grid
+/// vertices, and then the grid version is run on the samples.
 void MarchingCubes(Real (*f)(Real,Real,Real),Real isoval,const AABB3D& bb,const int dims[3],TriMesh& m);
 
-/// Takes a 3D grid as input, meshes the isosurface at f(x)=isoval.
-/// Assumes the input values are defined at the vertices of a grid with
-/// m-1 x n-1 x p-1 cells
-void MarchingCubes(const Array3D<Real>& input,Real isoval,const AABB3D& bb,TriMesh& m);
+/** @brief Takes a 3D grid as input, meshes the isosurface at f(x)=isoval.
+ *
+ * Assumes the input values are defined at the vertices of a grid with
+ * m-1 x n-1 x p-1 cells.
+ *
+ * Vertices are shared between adjacent triangles, so the output mesh is
+ * connected.  Blocks of cells that do not straddle isoval are skipped.
+ * The grid is split into slabs along the first axis that are processed in
+ * parallel by numThreads threads (if <= 0, the number of hardware threads
+ * is used) and then stitched together.
+ */
+void MarchingCubes(const Array3D<Real>& input,Real isoval,const AABB3D& bb,TriMesh& m,int numThreads=0);
 
 /// Takes values of a function f at a cube's vertices as input,
 /// meshes the isosurface at f(x)=isoval
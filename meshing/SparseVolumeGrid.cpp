@@ -0,0 +1,333 @@
+#include "SparseVolumeGrid.h"
+#include <KrisLibrary/utils/ioutils.h>
+#include <iostream>
+#include <algorithm>
+using namespace std;
+
+namespace Meshing {
+
+//floor(a / SparseVolumeGrid::BlockSize) for possibly negative a
+inline int BlockDiv(int a)
+{
+  if(a >= 0) return a / SparseVolumeGrid::BlockSize;
+  return -((-a-1) / SparseVolumeGrid::BlockSize) - 1;
+}
+
+SparseVolumeGrid::SparseVolumeGrid(Real _defaultValue)
+  :origin(Zero),cellSize(One),defaultValue(_defaultValue)
+{}
+
+void SparseVolumeGrid::Clear()
+{
+  blocks.clear();
+  blockMap.clear();
+}
+
+void SparseVolumeGrid::Initialize(const Vector3& _origin,const Vector3& _cellSize)
+{
+  Assert(_cellSize.x > 0 && _cellSize.y > 0 && _cellSize.z > 0);
+  origin = _origin;
+  cellSize = _cellSize;
+  Clear();
+}
+
+void SparseVolumeGrid::GetCell(int i,int j,int k,AABB3D& cell) const
+{
+  cell.bmin.x = origin.x + Real(i)*cellSize.x;
+  cell.bmin.y = origin.y + Real(j)*cellSize.y;
+  cell.bmin.z = origin.z + Real(k)*cellSize.z;
+  cell.bmax = cell.bmin + cellSize;
+}
+
+void SparseVolumeGrid::GetCellCenter(int i,int j,int k,Vector3& center) const
+{
+  center.x = origin.x + (Real(i)+0.5)*cellSize.x;
+  center.y = origin.y + (Real(j)+0.5)*cellSize.y;
+  center.z = origin.z + (Real(k)+0.5)*cellSize.z;
+}
+
+void SparseVolumeGrid::GetIndex(const Vector3& pt,int& i,int& j,int& k) const
+{
+  i = (int)Floor((pt.x - origin.x)/cellSize.x);
+  j = (int)Floor((pt.y - origin.y)/cellSize.y);
+  k = (int)Floor((pt.z - origin.z)/cellSize.z);
+}
+
+void SparseVolumeGrid::GetIndexAndParams(const Vector3& pt,IntTriple& index,Vector3& params) const
+{
+  Real u=(pt.x - origin.x)/cellSize.x;
+  Real v=(pt.y - origin.y)/cellSize.y;
+  Real w=(pt.z - origin.z)/cellSize.z;
+  Real ri = Floor(u);
+  Real rj = Floor(v);
+  Real rk = Floor(w);
+  params.x = u - ri;
+  params.y = v - rj;
+  params.z = w - rk;
+  index.a = (int)ri;
+  index.b = (int)rj;
+  index.c = (int)rk;
+}
+
+void SparseVolumeGrid::GetBlockIndex(const IntTriple& cell,IntTriple& block,IntTriple& local)
+{
+  block.a = BlockDiv(cell.a);
+  block.b = BlockDiv(cell.b);
+  block.c = BlockDiv(cell.c);
+  local.a = cell.a - block.a*BlockSize;
+  local.b = cell.b - block.b*BlockSize;
+  local.c = cell.c - block.c*BlockSize;
+}
+
+bool SparseVolumeGrid::GetIndexRange(IntTriple& imin,IntTriple& imax) const
+{
+  if(blocks.empty()) return false;
+  imin = imax = blocks[0].index;
+  for(size_t b=1;b<blocks.size();b++) {
+    const IntTriple& index = blocks[b].index;
+    for(int i=0;i<3;i++) {
+      if(index[i] < imin[i]) imin[i] = index[i];
+      if(index[i] > imax[i]) imax[i] = index[i];
+    }
+  }
+  for(int i=0;i<3;i++) {
+    imin[i] = imin[i]*BlockSize;
+    imax[i] = imax[i]*BlockSize+BlockSize-1;
+  }
+  return true;
+}
+
+AABB3D SparseVolumeGrid::GetAABB() const
+{
+  AABB3D bb;
+  IntTriple imin,imax;
+  if(!GetIndexRange(imin,imax)) {
+    bb.minimize();
+    return bb;
+  }
+  AABB3D cmin,cmax;
+  GetCell(imin,cmin);
+  GetCell(imax,cmax);
+  bb.bmin = cmin.bmin;
+  bb.bmax = cmax.bmax;
+  return bb;
+}
+
+SparseVolumeGrid::Block* SparseVolumeGrid::GetBlock(const IntTriple& blockIndex)
+{
+  BlockHash::iterator i=blockMap.find(blockIndex);
+  if(i == blockMap.end()) return NULL;
+  return &blocks[i->second];
+}
+
+const SparseVolumeGrid::Block* SparseVolumeGrid::GetBlock(const IntTriple& blockIndex) const
+{
+  BlockHash::const_iterator i=blockMap.find(blockIndex);
+  if(i == blockMap.end()) return NULL;
+  return &blocks[i->second];
+}
+
+SparseVolumeGrid::Block* SparseVolumeGrid::MakeBlock(const IntTriple& blockIndex)
+{
+  BlockHash::iterator i=blockMap.find(blockIndex);
+  if(i != blockMap.end()) return &blocks[i->second];
+  blockMap[blockIndex] = (int)blocks.size();
+  blocks.resize(blocks.size()+1);
+  Block& b = blocks.back();
+  b.index = blockIndex;
+  fill(b.value,b.value+BlockCells,defaultValue);
+  return &b;
+}
+
+bool SparseVolumeGrid::EraseBlock(const IntTriple& blockIndex)
+{
+  BlockHash::iterator i=blockMap.find(blockIndex);
+  if(i == blockMap.end()) return false;
+  //move the last block into the erased slot
+  int slot = i->second;
+  blockMap.erase(i);
+  if(slot+1 != (int)blocks.size()) {
+    blocks[slot] = blocks.back();
+    blockMap[blocks[slot].index] = slot;
+  }
+  blocks.resize(blocks.size()-1);
+  return true;
+}
+
+Real SparseVolumeGrid::GetValue(const IntTriple& index) const
+{
+  IntTriple block,local;
+  GetBlockIndex(index,block,local);
+  const Block* b = GetBlock(block);
+  if(!b) return defaultValue;
+  return (*b)(local.a,local.b,local.c);
+}
+
+void SparseVolumeGrid::SetValue(const IntTriple& index,Real value)
+{
+  IntTriple block,local;
+  GetBlockIndex(index,block,local);
+  Block* b = MakeBlock(block);
+  (*b)(local.a,local.b,local.c) = value;
+}
+
+Real SparseVolumeGrid::TrilinearInterpolate(const Vector3& pt) const
+{
+  IntTriple index;
+  Vector3 params;
+  GetIndexAndParams(pt,index,params);
+  Real u=params.x, v=params.y, w=params.z;
+
+  //get the alternate cell indices, interpolation parameters
+  //(u interpolates between i1,i2, etc)
+  int i1=index.a,j1=index.b,k1=index.c;
+  int i2,j2,k2;
+  if(u > 0.5) { i2=i1+1; u = u-0.5; }
+  else { i2=i1; i1--; u = 0.5+u; }
+  if(v > 0.5) { j2=j1+1; v = v-0.5; }
+  else { j2=j1; j1--; v = 0.5+v; }
+  if(w > 0.5) { k2=k1+1; w = w-0.5; }
+  else { k2=k1; k1--; w = 0.5+w; }
+
+  Real v111,v112,v121,v122,v211,v212,v221,v222;
+  IntTriple b1,b2,l1,l2;
+  GetBlockIndex(IntTriple(i1,j1,k1),b1,l1);
+  GetBlockIndex(IntTriple(i2,j2,k2),b2,l2);
+  if(b1 == b2) {
+    //all 8 cells are in the same block, only one lookup is needed
+    const Block* b = GetBlock(b1);
+    if(!b) return defaultValue;
+    v111 = (*b)(l1.a,l1.b,l1.c);
+    v112 = (*b)(l1.a,l1.b,l2.c);
+    v121 = (*b)(l1.a,l2.b,l1.c);
+    v122 = (*b)(l1.a,l2.b,l2.c);
+    v211 = (*b)(l2.a,l1.b,l1.c);
+    v212 = (*b)(l2.a,l1.b,l2.c);
+    v221 = (*b)(l2.a,l2.b,l1.c);
+    v222 = (*b)(l2.a,l2.b,l2.c);
+  }
+  else {
+    v111 = GetValue(i1,j1,k1);
+    v112 = GetValue(i1,j1,k2);
+    v121 = GetValue(i1,j2,k1);
+    v122 = GetValue(i1,j2,k2);
+    v211 = GetValue(i2,j1,k1);
+    v212 = GetValue(i2,j1,k2);
+    v221 = GetValue(i2,j2,k1);
+    v222 = GetValue(i2,j2,k2);
+  }
+  //at the border of the allocated region some corners hold defaultValue,
+  //which may be infinite; blending those gives 0*Inf = NaN, so fall back to
+  //the value of the containing cell
+  if(!IsFinite(v111) || !IsFinite(v112) || !IsFinite(v121) || !IsFinite(v122) ||
+     !IsFinite(v211) || !IsFinite(v212) || !IsFinite(v221) || !IsFinite(v222))
+    return GetValue(index);
+  Real v11 = (1-w)*v111 + w*v112;
+  Real v12 = (1-w)*v121 + w*v122;
+  Real v21 = (1-w)*v211 + w*v212;
+  Real v22 = (1-w)*v221 + w*v222;
+  Real w1 = (1-v)*v11+v*v12;
+  Real w2 = (1-v)*v21+v*v22;
+  return (1-u)*w1 + u*w2;
+}
+
+void SparseVolumeGrid::FromDense(const VolumeGrid& grid,Real truncation)
+{
+  Initialize(grid.bb.bmin,grid.GetCellSize());
+  const Array3D<Real>& value = grid.value;
+  for(int bi=0;bi*BlockSize<value.m;bi++) {
+    int imax = Min((bi+1)*BlockSize,value.m);
+    for(int bj=0;bj*BlockSize<value.n;bj++) {
+      int jmax = Min((bj+1)*BlockSize,value.n);
+      for(int bk=0;bk*BlockSize<value.p;bk++) {
+	int kmax = Min((bk+1)*BlockSize,value.p);
+	bool keep = IsInf(truncation);
+	for(int i=bi*BlockSize;i<imax && !keep;i++)
+	  for(int j=bj*BlockSize;j<jmax && !keep;j++)
+	    for(int k=bk*BlockSize;k<kmax;k++)
+	      if(Abs(value(i,j,k)) < truncation) { keep=true; break; }
+	if(!keep) continue;
+	Block* b = MakeBlock(IntTriple(bi,bj,bk));
+	for(int i=bi*BlockSize;i<imax;i++)
+	  for(int j=bj*BlockSize;j<jmax;j++)
+	    for(int k=bk*BlockSize;k<kmax;k++)
+	      (*b)(i-bi*BlockSize,j-bj*BlockSize,k-bk*BlockSize) = value(i,j,k);
+      }
+    }
+  }
+}
+
+void SparseVolumeGrid::ToDense(VolumeGrid& grid) const
+{
+  IntTriple imin,imax;
+  if(!GetIndexRange(imin,imax)) {
+    grid.value.clear();
+    grid.bb.bmin = grid.bb.bmax = origin;
+    return;
+  }
+  ToDense(imin,imax,grid);
+}
+
+void SparseVolumeGrid::ToDense(const IntTriple& imin,const IntTriple& imax,VolumeGrid& grid) const
+{
+  AABB3D cmin,cmax;
+  GetCell(imin,cmin);
+  GetCell(imax,cmax);
+  grid.bb.bmin = cmin.bmin;
+  grid.bb.bmax = cmax.bmax;
+  grid.value.resize(imax.a-imin.a+1,imax.b-imin.b+1,imax.c-imin.c+1,defaultValue);
+  for(size_t n=0;n<blocks.size();n++) {
+    const Block& b = blocks[n];
+    int i0 = b.index.a*BlockSize, j0 = b.index.b*BlockSize, k0 = b.index.c*BlockSize;
+    int ilo = Max(i0,imin.a), ihi = Min(i0+BlockSize-1,imax.a);
+    int jlo = Max(j0,imin.b), jhi = Min(j0+BlockSize-1,imax.b);
+    int klo = Max(k0,imin.c), khi = Min(k0+BlockSize-1,imax.c);
+    for(int i=ilo;i<=ihi;i++)
+      for(int j=jlo;j<=jhi;j++)
+	for(int k=klo;k<=khi;k++)
+	  grid.value(i-imin.a,j-imin.b,k-imin.c) = b(i-i0,j-j0,k-k0);
+  }
+}
+
+istream& operator >> (istream& in,SparseVolumeGrid& grid)
+{
+  Vector3 origin,cellSize;
+  size_t numBlocks;
+  Real defaultValue;
+  in>>origin>>cellSize;
+  if(!SafeInputFloat(in,defaultValue)) return in;
+  in>>numBlocks;
+  if(!in) return in;
+  grid.defaultValue = defaultValue;
+  grid.Initialize(origin,cellSize);
+  grid.blocks.reserve(numBlocks);
+  IntTriple index;
+  for(size_t n=0;n<numBlocks;n++) {
+    in>>index;
+    if(!in) return in;
+    SparseVolumeGrid::Block* b = grid.MakeBlock(index);
+    for(int i=0;i<SparseVolumeGrid::BlockCells;i++)
+      if(!SafeInputFloat(in,b->value[i])) return in;
+  }
+  return in;
+}
+
+ostream& operator << (ostream& out,const SparseVolumeGrid& grid)
+{
+  out<<grid.origin<<"    "<<grid.cellSize<<"    ";
+  SafeOutputFloat(out,grid.defaultValue);
+  out<<endl;
+  out<<grid.blocks.size()<<endl;
+  for(size_t n=0;n<grid.blocks.size();n++) {
+    const SparseVolumeGrid::Block& b = grid.blocks[n];
+    out<<b.index<<endl;
+    for(int i=0;i<SparseVolumeGrid::BlockCells;i++) {
+      SafeOutputFloat(out,b.value[i]);
+      out<<" ";
+      if((i+1)%SparseVolumeGrid::BlockSize == 0) out<<endl;
+    }
+  }
+  return out;
+}
+
+} //namespace Meshing
@@ -0,0 +1,120 @@
+#ifndef SPARSE_VOLUME_GRID_H
+#define SPARSE_VOLUME_GRID_H
+
+#include "VolumeGrid.h"
+#include <KrisLibrary/utils/stl_tr1.h>
+#include <vector>
+#include <iosfwd>
+
+namespace Meshing {
+
+  using namespace Math3D;
+
+/** @ingroup Meshing
+ * @brief Hash function for block indices in a SparseVolumeGrid.
+ */
+struct BlockIndexHash
+{
+  size_t operator () (const IntTriple& x) const
+  {
+    //large primes, as in the spatial hashing of Teschner et al 2003
+    return (size_t(x.a)*73856093) ^ (size_t(x.b)*19349663) ^ (size_t(x.c)*83492791);
+  }
+};
+
+/** @ingroup Meshing
+ * @brief A sparse 3D grid over an unbounded volume, containing Real values.
+ *
+ * The grid is divided into blocks of BlockSize^3 cells, and only the blocks
+ * that have been written to are allocated.  The blocks are stored
+ * contiguously in the blocks array and located by a hash on their index.
+ * Cells outside of allocated blocks have the value defaultValue, e.g., the
+ * "far" value of a truncated signed distance field.
+ *
+ * Cell (i,j,k) spans the box [origin+(i,j,k)*cellSize,origin+(i+1,j+1,k+1)*cellSize],
+ * and indices may be negative.  As with VolumeGrid, values are interpreted
+ * as defined over an entire cell, and TrilinearInterpolate assumes they are
+ * sampled at cell centers.
+ *
+ * To iterate over allocated blocks, loop over the blocks array.  Note that
+ * MakeBlock may reallocate this array, which invalidates Block pointers.
+ */
+class SparseVolumeGrid
+{
+ public:
+  enum { BlockSize = 8, BlockCells = BlockSize*BlockSize*BlockSize };
+
+  struct Block
+  {
+    inline Real& operator()(int i,int j,int k) { return value[(i*BlockSize+j)*BlockSize+k]; }
+    inline const Real& operator()(int i,int j,int k) const { return value[(i*BlockSize+j)*BlockSize+k]; }
+
+    ///The block's index.  It contains cells index*BlockSize to index*BlockSize+BlockSize-1
+    IntTriple index;
+    Real value[BlockCells];
+  };
+
+  SparseVolumeGrid(Real defaultValue=Inf);
+  bool IsEmpty() const { return blocks.empty(); }
+  size_t NumBlocks() const { return blocks.size(); }
+  void Clear();
+  ///Sets the grid origin and the size of a cell.  Clears the grid.
+  void Initialize(const Vector3& origin,const Vector3& cellSize);
+  void GetCell(int i,int j,int k,AABB3D& cell) const;
+  void GetCellCenter(int i,int j,int k,Vector3& center) const;
+  void GetIndex(const Vector3& pt,int& i,int& j,int& k) const;
+  void GetIndexAndParams(const Vector3& pt,IntTriple& index,Vector3& params) const;
+  inline void GetCell(const IntTriple& index,AABB3D& cell) const { GetCell(index.a,index.b,index.c,cell); }
+  inline void GetCenter(const IntTriple& index,Vector3& center) const { GetCellCenter(index.a,index.b,index.c,center); }
+  inline void GetIndex(const Vector3& pt,IntTriple& index) const { GetIndex(pt,index.a,index.b,index.c); }
+  ///Splits a cell index into the index of its block and the index within the block
+  static void GetBlockIndex(const IntTriple& cell,IntTriple& block,IntTriple& local);
+  ///Returns the range of cells covered by allocated blocks.  Returns false if empty
+  bool GetIndexRange(IntTriple& imin,IntTriple& imax) const;
+  ///Returns the bounding box of the allocated blocks
+  AABB3D GetAABB() const;
+
+  ///Returns the block with the given block index, or NULL if not allocated
+  Block* GetBlock(const IntTriple& blockIndex);
+  const Block* GetBlock(const IntTriple& blockIndex) const;
+  ///Returns the block with the given block index, allocating it (and
+  ///filling it with defaultValue) if it doesn't exist
+  Block* MakeBlock(const IntTriple& blockIndex);
+  ///Deletes the given block.  Returns false if it isn't allocated
+  bool EraseBlock(const IntTriple& blockIndex);
+
+  ///Returns the value at the given cell, or defaultValue if not allocated
+  Real GetValue(const IntTriple& index) const;
+  inline Real GetValue(int i,int j,int k) const { return GetValue(IntTriple(i,j,k)); }
+  ///Sets the value at the given cell, allocating its block if necessary
+  void SetValue(const IntTriple& index,Real value);
+  inline void SetValue(int i,int j,int k,Real value) { SetValue(IntTriple(i,j,k),value); }
+
+  ///Computes the trilinear interpolation of the field at pt, assuming values are sampled exactly at cell centers.
+  ///If any of the 8 neighboring values is non-finite (e.g., an infinite defaultValue), returns the value of the
+  ///cell containing pt instead.
+  Real TrilinearInterpolate(const Vector3& pt) const;
+
+  ///Sets this to the cells of the dense grid, allocating only the blocks
+  ///that contain a value with absolute value less than truncation (if
+  ///truncation = Inf, all blocks are allocated).
+  void FromDense(const VolumeGrid& grid,Real truncation=Inf);
+  ///Converts to a dense grid spanning the allocated blocks
+  void ToDense(VolumeGrid& grid) const;
+  ///Converts to a dense grid over the given range of cells
+  void ToDense(const IntTriple& imin,const IntTriple& imax,VolumeGrid& grid) const;
+
+  Vector3 origin;
+  Vector3 cellSize;
+  Real defaultValue;
+  std::vector<Block> blocks;
+  typedef UNORDERED_MAP_TEMPLATE<IntTriple,int,BlockIndexHash> BlockHash;
+  BlockHash blockMap;
+};
+
+std::istream& operator >> (std::istream& in,SparseVolumeGrid& grid);
+std::ostream& operator << (std::ostream& out,const SparseVolumeGrid& grid);
+
+} //namespace Meshing
+
+#endif
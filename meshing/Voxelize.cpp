@@ -10,8 +10,10 @@
 #include <geometry/primitives.h>
 #include <math/random.h>
 #include <Timer.h>
+#include <KrisLibrary/utils/threadutils.h>
 #include <list>
 #include <set>
+#include <algorithm>
 using namespace Geometry;
 
 namespace Meshing {
@@ -1743,6 +1745,250 @@ void FastMarchingMethod_Fill(const TriMeshWithTopology& m,Array3D<Real>& distanc
 }
 
 
+//2x the signed area of the triangle (0,(x1,y1),(x2,y2)), with ties broken
+//consistently so that points on shared edges fall in exactly one triangle
+static int WindingOrientation(Real x1,Real y1,Real x2,Real y2,Real& twiceArea)
+{
+  twiceArea = y1*x2-x1*y2;
+  if(twiceArea > 0) return 1;
+  else if(twiceArea < 0) return -1;
+  else if(y2 > y1) return 1;
+  else if(y2 < y1) return -1;
+  else if(x1 > x2) return 1;
+  else if(x1 < x2) return -1;
+  return 0;
+}
+
+//Tests whether the yz-projection of tri contains (y,z).  If so, returns the
+//orientation of the projection and the x coordinate of the crossing
+static int WindingCrossing(const Triangle3D& tri,Real y,Real z,Real& x)
+{
+  Real y1=tri.a.y-y,z1=tri.a.z-z;
+  Real y2=tri.b.y-y,z2=tri.b.z-z;
+  Real y3=tri.c.y-y,z3=tri.c.z-z;
+  Real a,b,c;
+  int signa = WindingOrientation(y2,z2,y3,z3,a);
+  if(signa == 0) return 0;
+  if(WindingOrientation(y3,z3,y1,z1,b) != signa) return 0;
+  if(WindingOrientation(y1,z1,y2,z2,c) != signa) return 0;
+  Real sum = a+b+c;
+  if(sum == 0) return 0;
+  x = (a*tri.a.x+b*tri.b.x+c*tri.c.x)/sum;
+  return signa;
+}
+
+struct WindingRows
+{
+  const TriMesh* mesh;
+  const AABB3D* bb;
+  Array3D<bool>* inside;
+  int j0,j1;
+};
+
+static void VolumeOccupancyGrid_WindingRows(WindingRows& rows)
+{
+  const TriMesh& m = *rows.mesh;
+  const AABB3D& bb = *rows.bb;
+  Array3D<bool>& inside = *rows.inside;
+  Vector3 h = bb.bmax-bb.bmin;
+  h.x /= inside.m;
+  h.y /= inside.n;
+  h.z /= inside.p;
+  int nj = rows.j1-rows.j0;
+  //crossings of each row (j,k), stored as (x,orientation)
+  vector<vector<pair<Real,int> > > crossings(nj*inside.p);
+  Triangle3D tri;
+  for(size_t t=0;t<m.tris.size();t++) {
+    m.GetTriangle(t,tri);
+    Real ymin=Min(tri.a.y,tri.b.y,tri.c.y),ymax=Max(tri.a.y,tri.b.y,tri.c.y);
+    Real zmin=Min(tri.a.z,tri.b.z,tri.c.z),zmax=Max(tri.a.z,tri.b.z,tri.c.z);
+    //range of cell centers covered by the triangle's yz bounding box
+    int jmin = Max((int)Ceil((ymin-bb.bmin.y)/h.y-Half),rows.j0);
+    int jmax = Min((int)Floor((ymax-bb.bmin.y)/h.y-Half),rows.j1-1);
+    int kmin = Max((int)Ceil((zmin-bb.bmin.z)/h.z-Half),0);
+    int kmax = Min((int)Floor((zmax-bb.bmin.z)/h.z-Half),inside.p-1);
+    for(int j=jmin;j<=jmax;j++) {
+      Real y = bb.bmin.y+(Real(j)+Half)*h.y;
+      for(int k=kmin;k<=kmax;k++) {
+        Real z = bb.bmin.z+(Real(k)+Half)*h.z;
+        Real x;
+        int sign = WindingCrossing(tri,y,z,x);
+        if(sign != 0)
+          crossings[(j-rows.j0)*inside.p+k].push_back(pair<Real,int>(x,sign));
+      }
+    }
+  }
+  for(int j=rows.j0;j<rows.j1;j++) {
+    for(int k=0;k<inside.p;k++) {
+      vector<pair<Real,int> >& row = crossings[(j-rows.j0)*inside.p+k];
+      sort(row.begin(),row.end());
+      int winding = 0;
+      size_t next = 0;
+      for(int i=0;i<inside.m;i++) {
+        Real x = bb.bmin.x+(Real(i)+Half)*h.x;
+        while(next < row.size() && row[next].first < x) {
+          winding += row[next].second;
+          next++;
+        }
+        inside(i,j,k) = (winding != 0);
+      }
+    }
+  }
+}
+
+static void* VolumeOccupancyGrid_WindingThread(void* data)
+{
+  VolumeOccupancyGrid_WindingRows(*(WindingRows*)data);
+  return NULL;
+}
+
+void VolumeOccupancyGrid_Winding(const TriMesh& m,Array3D<bool>& inside,const AABB3D& bb,int numThreads)
+{
+  if(inside.m*inside.n*inside.p == 0) return;
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  int numTasks = Min(numThreads,inside.n);
+  vector<WindingRows> tasks(numTasks);
+  for(int t=0;t<numTasks;t++) {
+    tasks[t].mesh = &m;
+    tasks[t].bb = &bb;
+    tasks[t].inside = &inside;
+    tasks[t].j0 = t*inside.n/numTasks;
+    tasks[t].j1 = (t+1)*inside.n/numTasks;
+  }
+  if(numTasks == 1)
+    VolumeOccupancyGrid_WindingRows(tasks[0]);
+  else {
+    vector<Thread> threads(numTasks);
+    for(int t=0;t<numTasks;t++)
+      threads[t] = ThreadStart(VolumeOccupancyGrid_WindingThread,&tasks[t]);
+    for(int t=0;t<numTasks;t++)
+      ThreadJoin(threads[t]);
+  }
+}
+
+//Solves the upwind discretization of |grad d|=1 given the minimum neighbor
+//value a,b,c along each axis, where the grid spacing is ha,hb,hc
+static Real EikonalUpdate(Real a,Real ha,Real b,Real hb,Real c,Real hc)
+{
+  if(b < a) { swap(a,b); swap(ha,hb); }
+  if(c < b) { swap(b,c); swap(hb,hc); }
+  if(b < a) { swap(a,b); swap(ha,hb); }
+  if(IsInf(a)) return a;
+  Real u = a+ha;
+  if(u <= b) return u;
+  //two dimensional update
+  Real wa=1.0/Sqr(ha),wb=1.0/Sqr(hb),wc=1.0/Sqr(hc);
+  Real A = wa+wb;
+  Real B = a*wa+b*wb;
+  Real C = Sqr(a)*wa+Sqr(b)*wb-1.0;
+  Real disc = Sqr(B)-A*C;
+  if(disc < 0) return u;
+  u = (B+Sqrt(disc))/A;
+  if(u <= c) return u;
+  //three dimensional update
+  A += wc;
+  B += c*wc;
+  C += Sqr(c)*wc;
+  disc = Sqr(B)-A*C;
+  if(disc < 0) return u;
+  return (B+Sqrt(disc))/A;
+}
+
+struct SweepSlab
+{
+  Array3D<Real>* distance;
+  const Array3D<bool>* fixed;
+  Vector3 h;
+  int i0,i1;
+  Real maxChange;
+};
+
+static void FastSweepSlab(SweepSlab& slab)
+{
+  Array3D<Real>& d = *slab.distance;
+  const Array3D<bool>& fixed = *slab.fixed;
+  slab.maxChange = 0;
+  for(int sweep=0;sweep<8;sweep++) {
+    int di = (sweep&1 ? -1 : 1);
+    int dj = (sweep&2 ? -1 : 1);
+    int dk = (sweep&4 ? -1 : 1);
+    int istart = (di > 0 ? slab.i0 : slab.i1-1), iend = (di > 0 ? slab.i1 : slab.i0-1);
+    int jstart = (dj > 0 ? 0 : d.n-1), jend = (dj > 0 ? d.n : -1);
+    int kstart = (dk > 0 ? 0 : d.p-1), kend = (dk > 0 ? d.p : -1);
+    for(int i=istart;i!=iend;i+=di) {
+      for(int j=jstart;j!=jend;j+=dj) {
+        for(int k=kstart;k!=kend;k+=dk) {
+          if(fixed(i,j,k)) continue;
+          Real a = Inf,b = Inf,c = Inf;
+          if(i > 0) a = d(i-1,j,k);
+          if(i+1 < d.m) a = Min(a,d(i+1,j,k));
+          if(j > 0) b = d(i,j-1,k);
+          if(j+1 < d.n) b = Min(b,d(i,j+1,k));
+          if(k > 0) c = d(i,j,k-1);
+          if(k+1 < d.p) c = Min(c,d(i,j,k+1));
+          Real u = EikonalUpdate(a,slab.h.x,b,slab.h.y,c,slab.h.z);
+          Real& dijk = d(i,j,k);
+          if(u < dijk) {
+            if(IsInf(dijk)) slab.maxChange = Inf;
+            else slab.maxChange = Max(slab.maxChange,dijk-u);
+            dijk = u;
+          }
+        }
+      }
+    }
+  }
+}
+
+static void* FastSweepSlabThread(void* data)
+{
+  FastSweepSlab(*(SweepSlab*)data);
+  return NULL;
+}
+
+void FastSweepingMethod(Array3D<Real>& distance,const Array3D<bool>& fixed,const AABB3D& bb,int numThreads)
+{
+  Assert(fixed.m == distance.m && fixed.n == distance.n && fixed.p == distance.p);
+  if(distance.m*distance.n*distance.p == 0) return;
+  Vector3 h = bb.bmax-bb.bmin;
+  h.x /= distance.m;
+  h.y /= distance.n;
+  h.z /= distance.p;
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  //adjacent slabs are never swept at the same time, so a slab only reads
+  //its neighbors' values at the boundary after they have been written
+  int numSlabs = (numThreads == 1 ? 1 : Min(2*numThreads,distance.m/2));
+  if(numSlabs < 1) numSlabs = 1;
+  vector<SweepSlab> slabs(numSlabs);
+  for(int s=0;s<numSlabs;s++) {
+    slabs[s].distance = &distance;
+    slabs[s].fixed = &fixed;
+    slabs[s].h = h;
+    slabs[s].i0 = s*distance.m/numSlabs;
+    slabs[s].i1 = (s+1)*distance.m/numSlabs;
+  }
+  Real tol = 1e-8*Min(h.x,h.y,h.z);
+  vector<Thread> threads(numSlabs);
+  while(true) {
+    Real maxChange = 0;
+    if(numSlabs == 1) {
+      FastSweepSlab(slabs[0]);
+      maxChange = slabs[0].maxChange;
+    }
+    else {
+      for(int parity=0;parity<2;parity++) {
+        for(int s=parity;s<numSlabs;s+=2)
+          threads[s] = ThreadStart(FastSweepSlabThread,&slabs[s]);
+        for(int s=parity;s<numSlabs;s+=2) {
+          ThreadJoin(threads[s]);
+          maxChange = Max(maxChange,slabs[s].maxChange);
+        }
+      }
+    }
+    if(maxChange <= tol) break;
+  }
+}
+
+
 void DensityEstimate_FMM(const TriMeshWithTopology& m,Array3D<Real>& density,AABB3D& bb)
 {
   Array3D<Real> distance(density.m,density.n,density.p);
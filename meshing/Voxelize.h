@@ -61,6 +61,19 @@ void VolumeOccupancyGrid_FloodFill(const TriMesh& m,Array3D<bool>& occupied,AABB
  */
 void VolumeOccupancyGrid_CenterShooting(const TriMesh& m,Array3D<bool>& occupied,AABB3D& bb,int shootDirection=0);
 
+/** @ingroup Meshing
+ * @brief Sets cells of a boolean 3D grid (inside,bb) to true if the cell's
+ * center has a nonzero winding number with respect to m, and false otherwise.
+ *
+ * The winding number is accumulated from the signed crossings of an
+ * x-directed ray through each row of cell centers.  Crossings exactly on
+ * shared triangle edges and vertices are counted once, so the result is
+ * consistent even when mesh vertices are aligned with the grid.  Rows are
+ * processed by numThreads threads (or the number of hardware threads, if
+ * numThreads <= 0).
+ */
+void VolumeOccupancyGrid_Winding(const TriMesh& m,Array3D<bool>& inside,const AABB3D& bb,int numThreads=0);
+
 /** @ingroup Meshing
  * @brief From one "visible" side of the grid, sweeps the visibility across
  * the volume until a mesh surface is hit.  After that, visible is marked
@@ -93,6 +106,19 @@ void FastMarchingMethod(const TriMeshWithTopology& m,Array3D<Real>& distance,Arr
 void FastMarchingMethod_Fill(const TriMeshWithTopology& m,Array3D<Real>& distance,Array3D<Vector3>& gradient,AABB3D& bb,vector<IntTriple>& surfaceCells);
 
 
+/** @ingroup Meshing
+ * @brief Completes a distance field on a 3D grid (distance,bb) using the fast
+ * sweeping method.  Cells marked in fixed are kept at their values and
+ * the remaining cells, which should be initialized to Inf, are filled in with
+ * the solution to the eikonal equation |grad d|=1.
+ *
+ * The grid is divided into slabs along the x axis, and alternating slabs are
+ * swept in parallel until the values converge.  O(n^3) per iteration for a
+ * grid of size n x n x n.
+ */
+void FastSweepingMethod(Array3D<Real>& distance,const Array3D<bool>& fixed,const AABB3D& bb,int numThreads=0);
+
+
 /** @ingroup Meshing
  * @brief Estimates the object's density filling the grid using a shooting method.
  */
@@ -232,6 +232,11 @@ bool File::OpenData(int openmode)
 	return true;
 }
 
+bool File::IsTCPSocket() const
+{
+  return srctype == MODE_TCPSOCKET && impl->socket != INVALID_SOCKET;
+}
+
 void* File::FileObjectPointer()
 {
   if(srctype == MODE_MYDATA || srctype == MODE_EXTDATA)
@@ -87,6 +87,8 @@ public:
 
 	///Returns true if the file object is open
 	bool IsOpen() const;
+	///Returns true if the file object is a TCP socket
+	bool IsTCPSocket() const;
 	///In an internally managed memory buffer created via OpenData(),
 	///resizes the buffer to the given size.
 	void ResizeDataBuffer(int size);
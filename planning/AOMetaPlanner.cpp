@@ -340,11 +340,8 @@ void CostSpaceRRTPlanner::PruneTree()
   if(callback.deleteNodes.empty()) return;
   printf("CostSpaceRRTPlanner::PruneTree() Pruning %d nodes\n",(int)callback.deleteNodes.size());
   numPrunedNodes += (int)callback.deleteNodes.size();
-  for(size_t i=0;i+1<callback.deleteNodes.size();i++) {
-    Node* p = callback.deleteNodes[i]->getParent();
-    p->detachChild(callback.deleteNodes[i]);
-    delete callback.deleteNodes[i];
-  }
+  for(size_t i=0;i+1<callback.deleteNodes.size();i++)
+    tree.DeleteSubTree(callback.deleteNodes[i],false);
   //this will rebuild the point location data structure
   tree.DeleteSubTree(callback.deleteNodes.back());
 }
@@ -584,11 +581,8 @@ void CostSpaceESTPlanner::PruneTree()
   if(callback.deleteNodes.empty()) return;
   numPrunedNodes += (int)callback.deleteNodes.size();
   printf("CostSpaceESTPlanner::PruneTree() Pruning %d nodes\n",(int)callback.deleteNodes.size());
-  for(size_t i=0;i+1<callback.deleteNodes.size();i++) {
-    Node* p = callback.deleteNodes[i]->getParent();
-    p->detachChild(callback.deleteNodes[i]);
-    delete callback.deleteNodes[i];
-  }
+  for(size_t i=0;i+1<callback.deleteNodes.size();i++)
+    tree.DeleteSubTree(callback.deleteNodes[i],false);
   //this will rebuild the point location data structure
   tree.DeleteSubTree(callback.deleteNodes.back());
 
@@ -10,6 +10,8 @@
 #include "FMMMotionPlanner.h"
 #include "Timer.h"
 #include "CSpaceHelpers.h"
+#include "InstrumentedCSpace.h"
+#include <utils/threadutils.h>
 
 #if HAVE_TINYXML
 #include <tinyxml.h>
@@ -20,6 +22,7 @@ void ToCollection(const MotionPlannerFactory& factory,AnyCollection& items)
 {
   items["type"] = factory.type;
   items["knn"] = factory.knn;
+  items["batchSize"] = factory.batchSize;
   items["suboptimalityFactor"] = factory.suboptimalityFactor;
   items["connectionThreshold"] = factory.connectionThreshold;
   items["ignoreConnectedComponents"] = factory.ignoreConnectedComponents;
@@ -32,8 +35,11 @@ void ToCollection(const MotionPlannerFactory& factory,AnyCollection& items)
   items["pointLocation"] = factory.pointLocation;
   items["storeEdges"] = factory.storeEdges;
   items["shortcut"] = factory.shortcut;
+  items["shortcutThreads"] = factory.shortcutThreads;
   items["restart"] = factory.restart;
+  items["instrument"] = factory.instrument;
   items["restartTermCond"] = factory.restartTermCond;
+  items["portfolioTypes"] = factory.portfolioTypes;
 }
 
 /** @brief Helper class for higher-order planners -- passes all calls to another motion planner.
@@ -60,6 +66,8 @@ class PiggybackMotionPlanner : public MotionPlannerInterface
   virtual bool CheckPath(int ma,int mb) { return mp->CheckPath(ma,mb); }
   virtual void GetPath(int ma,int mb,MilestonePath& path) { mp->GetPath(ma,mb,path); }
   virtual void GetRoadmap(Roadmap& roadmap) const { mp->GetRoadmap(roadmap); }
+  virtual bool SaveRoadmap(const char* fn) { return mp->SaveRoadmap(fn); }
+  virtual bool LoadRoadmap(const char* fn,const vector<string>& changedConstraints=vector<string>()) { return mp->LoadRoadmap(fn,changedConstraints); }
   virtual bool IsSolved() { return mp->IsSolved(); }
   virtual void GetSolution(MilestonePath& path) { return mp->GetSolution(path); }
   virtual void GetStats(PropertyMap& stats) const { mp->GetStats(stats); }
@@ -67,6 +75,20 @@ class PiggybackMotionPlanner : public MotionPlannerInterface
   SmartPointer<MotionPlannerInterface> mp;
 };
 
+/** @brief Runs a planner on an InstrumentedCSpace and adds the space's
+ * counters to the planner's stats.
+ */
+class InstrumentedMotionPlanner : public PiggybackMotionPlanner
+{
+ public:
+  InstrumentedMotionPlanner(const SmartPointer<MotionPlannerInterface>& mp,const SmartPointer<InstrumentedCSpace>& space);
+  virtual ~InstrumentedMotionPlanner();
+  virtual std::string Plan(MilestonePath& path,const HaltingCondition& cond) { return mp->Plan(path,cond); }
+  virtual void GetStats(PropertyMap& stats) const;
+
+  SmartPointer<InstrumentedCSpace> space;
+};
+
 /** @brief Tries to produce a path between a start node and a goal space.
  * Does so via goal sampling.  NOTE: only works on base motion planners that
  * accept dynamic goal insertion, such as PRM or SBLPRT.  For other motion 
@@ -193,23 +215,86 @@ class RestartShortcutMotionPlanner : public RestartMotionPlanner
 };
 
 /** @brief Plans a path and then tries to shortcut it with the remaining time.
+ *
+ * If numThreads > 1, shortcutting is done in rounds of
+ * MilestonePath::ParallelShortcut, each of which counts as one iteration per
+ * candidate.
  */
 class ShortcutMotionPlanner : public PiggybackMotionPlanner
 {
  public:
-  ShortcutMotionPlanner(const SmartPointer<MotionPlannerInterface>& mp);
+  ShortcutMotionPlanner(const SmartPointer<MotionPlannerInterface>& mp,int numThreads=1);
   virtual bool IsOptimizing() const { return true; }
   virtual std::string Plan(MilestonePath& path,const HaltingCondition& cond);
   virtual int PlanMore();
   virtual bool IsSolved() { return !bestPath.edges.empty(); }
   virtual void GetSolution(MilestonePath& path) { path = bestPath; }
   virtual int NumIterations() const { return numIters; }
+  virtual void GetStats(PropertyMap& stats) const;
+  ///Does one round of shortcutting, returns the number of iterations used
+  int ShortcutRound(MilestonePath& path,Real timeLimit=Inf);
 
   MilestonePath bestPath;
   int numIters;
+  int numThreads;
+  ShortcutStats shortcutStats;
 };
 
 
+/** @brief Runs several motion planners concurrently and returns the first
+ * (or, in anytime mode, the best) solution found by any of them.
+ *
+ * If threaded is true, each planner runs in its own thread in Plan(), so
+ * every planner must have its own CSpace.  Otherwise Plan() steps the
+ * planners in turn on the calling thread.  PlanMore() steps each planner
+ * once, in sequence.
+ */
+class PortfolioMotionPlanner : public MotionPlannerInterface
+{
+ public:
+  PortfolioMotionPlanner(const vector<string>& types,const vector<SmartPointer<MotionPlannerInterface> >& planners,bool threaded);
+  virtual std::string Plan(MilestonePath& path,const HaltingCondition& cond);
+  virtual int PlanMore();
+  virtual int NumIterations() const;
+  virtual int NumMilestones() const;
+  virtual int NumComponents() const;
+  virtual bool CanAddMilestone() const;
+  virtual int AddMilestone(const Config& q);
+  virtual void GetMilestone(int i,Config& q) { planners[0]->GetMilestone(i,q); }
+  virtual bool IsConnected(int ma,int mb) const;
+  virtual bool IsPointToPoint() const;
+  virtual bool IsOptimizing() const;
+  virtual void GetPath(int ma,int mb,MilestonePath& path);
+  virtual bool IsSolved();
+  virtual void GetSolution(MilestonePath& path);
+  virtual void GetRoadmap(Roadmap& roadmap) const { planners[best >= 0 ? best : 0]->GetRoadmap(roadmap); }
+  virtual void GetStats(PropertyMap& stats) const;
+  ///Body of the planning thread for planner index
+  void PlanThread(int index);
+  ///Runs one iteration of planner index and checks the halting condition.
+  ///Returns false once the planner should stop.  solved records whether
+  ///the planner has found a solution.
+  bool PlanStep(int index,bool& solved);
+  ///Records a solution from the given planner; call with the mutex locked
+  void UpdateSolution(int index);
+
+  vector<string> types;
+  vector<SmartPointer<MotionPlannerInterface> > planners;
+  bool threaded;
+  ///Index of the planner with the best solution, or -1 if none
+  int best;
+  MilestonePath bestPath;
+  Real bestPathLength;
+
+  //state shared by the planning threads in Plan()
+  Mutex mutex;
+  const HaltingCondition* cond;
+  Timer timer;
+  bool stop;
+  string stopReason;
+  Real lastCheckTime,lastCheckValue;
+};
+
 
 void ReversePath(MilestonePath& path)
 {
@@ -379,6 +464,22 @@ class RoadmapPlannerInterface  : public MotionPlannerInterface
   virtual bool IsSolved() const { return IsConnected(0,1); }
   virtual void GetSolution(MilestonePath& path) { GetPath(0,1,path); }
   virtual void GetRoadmap(Roadmap& roadmap) const { roadmap = prm.roadmap; }
+  virtual bool SaveRoadmap(const char* fn) { return prm.SaveRoadmap(fn); }
+  virtual bool LoadRoadmap(const char* fn,const vector<string>& changedConstraints=vector<string>()) {
+    int n = prm.roadmap.NumNodes();
+    if(!prm.LoadRoadmap(fn,changedConstraints)) return false;
+    if(!storeEdges) {
+      for(int i=n;i<prm.roadmap.NumNodes();i++) {
+	RoadmapPlanner::Roadmap::Iterator e;
+	for(prm.roadmap.Begin(i,e);!e.end();++e)
+	  *e = NULL;
+      }
+    }
+    //connect the existing milestones to the loaded roadmap
+    for(int i=0;i<n;i++)
+      ConnectHint(i);
+    return true;
+  }
 
   RoadmapPlanner prm;
   int knn;
@@ -665,6 +766,11 @@ class PRMStarInterface  : public MotionPlannerInterface
       qGoal = q;
       planner.Init(qStart,qGoal);
       assert(planner.start == 0 && planner.goal == 1);
+      if(!roadmapFile.empty()) {
+        planner.LoadRoadmap(roadmapFile.c_str(),roadmapChangedConstraints);
+        roadmapFile.clear();
+        roadmapChangedConstraints.clear();
+      }
       return 1;
     }
     fprintf(stderr,"PRMStarInterface::AddMilestone: Warning, milestone is infeasible?\n");
@@ -716,8 +822,138 @@ class PRMStarInterface  : public MotionPlannerInterface
       stats.set("numFeasibleEdges",planner.roadmap.NumEdges());
   }
 
+  virtual bool SaveRoadmap(const char* fn) { return planner.SaveRoadmap(fn); }
+  virtual bool LoadRoadmap(const char* fn,const vector<string>& changedConstraints=vector<string>()) {
+    if(planner.start < 0 || planner.goal < 0) {
+      //loaded once the start and goal are added
+      roadmapFile = fn;
+      roadmapChangedConstraints = changedConstraints;
+      return true;
+    }
+    return planner.LoadRoadmap(fn,changedConstraints);
+  }
+
   PRMStarPlanner planner;
   Config qStart,qGoal;
+  string roadmapFile;
+  vector<string> roadmapChangedConstraints;
+};
+
+class FMTStarInterface  : public MotionPlannerInterface
+{
+ public:
+  FMTStarInterface(CSpace* space) : planner(space) {}
+  virtual ~FMTStarInterface() {}
+  virtual bool IsOptimizing() const { return true; }
+  virtual bool CanAddMilestone() const { if(qStart.n != 0 && qGoal.n != 0) return false; return true; }
+  virtual int AddMilestone(const Config& q) {
+    if(qStart.n == 0) {
+      qStart = q;
+      return 0;
+    }
+    else if(qGoal.n == 0) {
+      qGoal = q;
+      planner.Init(qStart,qGoal);
+      return 1;
+    }
+    AssertNotReached();
+    return -1;
+  }
+  virtual void GetMilestone(int i,Config& q) { q=planner.roadmap.nodes[i]; }
+  virtual int PlanMore() { 
+    if(planner.start < 0 || planner.goal < 0) {
+      fprintf(stderr,"AnyMotionPlanner::PlanMore(): FMT* is a point-to-point planner, AddMilestone() must be called to set the start and goal configuration\n");
+      return -1;
+    }
+    planner.PlanMore();
+    return -1;
+  }
+  virtual int NumIterations() const { return planner.numPlanSteps; }
+  virtual int NumMilestones() const { return planner.roadmap.nodes.size(); }
+  virtual int NumComponents() const { return 1; }
+  virtual bool IsConnected(int ma,int mb) const { 
+    Assert(ma==0 && mb==1);
+    return planner.HasPath();
+  }
+  virtual void GetPath(int ma,int mb,MilestonePath& path) {
+    Assert(ma==0 && mb==1);
+    planner.GetPath(path);
+  }
+  virtual void GetRoadmap(Roadmap& roadmap) const { roadmap = planner.roadmap; }
+  virtual void GetStats(PropertyMap& stats) const {
+    MotionPlannerInterface::GetStats(stats);
+    stats.set("configCheckTime",planner.tCheck);
+    stats.set("knnTime",planner.tKnn);
+    stats.set("connectTime",planner.tConnect);
+    stats.set("numConfigChecks",planner.numConfigChecks);
+    stats.set("numEdgeChecks",planner.numEdgeChecks);
+    stats.set("numBatches",planner.numBatches);
+    stats.set("connectionRadius",planner.radius);
+    if(planner.HasPath())
+      stats.set("bestCost",planner.bestCost);
+  }
+
+  FMTStarPlanner planner;
+  Config qStart,qGoal;
+};
+
+class BITStarInterface  : public MotionPlannerInterface
+{
+ public:
+  BITStarInterface(CSpace* space) : planner(space) {}
+  virtual ~BITStarInterface() {}
+  virtual bool IsOptimizing() const { return true; }
+  virtual bool CanAddMilestone() const { if(qStart.n != 0 && qGoal.n != 0) return false; return true; }
+  virtual int AddMilestone(const Config& q) {
+    if(qStart.n == 0) {
+      qStart = q;
+      return 0;
+    }
+    else if(qGoal.n == 0) {
+      qGoal = q;
+      planner.Init(qStart,qGoal);
+      return 1;
+    }
+    AssertNotReached();
+    return -1;
+  }
+  virtual void GetMilestone(int i,Config& q) { q=planner.roadmap.nodes[i]; }
+  virtual int PlanMore() { 
+    if(planner.start < 0 || planner.goal < 0) {
+      fprintf(stderr,"AnyMotionPlanner::PlanMore(): BIT* is a point-to-point planner, AddMilestone() must be called to set the start and goal configuration\n");
+      return -1;
+    }
+    planner.PlanMore();
+    return -1;
+  }
+  virtual int NumIterations() const { return planner.numPlanSteps; }
+  virtual int NumMilestones() const { return planner.roadmap.nodes.size(); }
+  virtual int NumComponents() const { return 1; }
+  virtual bool IsConnected(int ma,int mb) const { 
+    Assert(ma==0 && mb==1);
+    return planner.HasPath();
+  }
+  virtual void GetPath(int ma,int mb,MilestonePath& path) {
+    Assert(ma==0 && mb==1);
+    planner.GetPath(path);
+  }
+  virtual void GetRoadmap(Roadmap& roadmap) const { roadmap = planner.roadmap; }
+  virtual void GetStats(PropertyMap& stats) const {
+    MotionPlannerInterface::GetStats(stats);
+    stats.set("configCheckTime",planner.tCheck);
+    stats.set("knnTime",planner.tKnn);
+    stats.set("connectTime",planner.tConnect);
+    stats.set("numConfigChecks",planner.numConfigChecks);
+    stats.set("numEdgeChecks",planner.numEdgeChecks);
+    stats.set("numRewires",planner.numRewires);
+    stats.set("numBatches",planner.numBatches);
+    stats.set("connectionRadius",planner.radius);
+    if(planner.HasPath())
+      stats.set("bestCost",planner.cost[planner.goal]);
+  }
+
+  BITStarPlanner planner;
+  Config qStart,qGoal;
 };
 
 class FMMInterface  : public MotionPlannerInterface
@@ -1032,6 +1268,22 @@ PiggybackMotionPlanner::PiggybackMotionPlanner(const SmartPointer<MotionPlannerI
   :mp(_mp)
 {}
 
+InstrumentedMotionPlanner::InstrumentedMotionPlanner(const SmartPointer<MotionPlannerInterface>& _mp,const SmartPointer<InstrumentedCSpace>& _space)
+  :PiggybackMotionPlanner(_mp),space(_space)
+{}
+
+InstrumentedMotionPlanner::~InstrumentedMotionPlanner()
+{
+  //the planner refers to the space, so it must be deleted first
+  mp = NULL;
+}
+
+void InstrumentedMotionPlanner::GetStats(PropertyMap& stats) const
+{
+  mp->GetStats(stats);
+  space->GetStats(stats);
+}
+
 PointToSetMotionPlanner::PointToSetMotionPlanner(const SmartPointer<MotionPlannerInterface>& _mp,const Config& _qstart,CSet* _goal)
   :PiggybackMotionPlanner(_mp),goalSpace(_goal),sampleGoalPeriod(50),sampleGoalCounter(0)
 {
@@ -1336,20 +1588,32 @@ int PointToSetMotionPlannerAdaptor::AddMilestone(const Config& q)
 MotionPlannerFactory::MotionPlannerFactory()
   :type("any"),
    knn(10),
+   batchSize(100),
    connectionThreshold(Inf),
    suboptimalityFactor(0),
    ignoreConnectedComponents(false),
    perturbationRadius(0.1),perturbationIters(5),
    bidirectional(true),
    useGrid(true),gridResolution(0),randomizeFrequency(50),
-   storeEdges(true),shortcut(false),restart(false),
-   restartTermCond("{foundSolution:1,maxIters:1000}")
+   storeEdges(true),shortcut(false),shortcutThreads(1),restart(false),instrument(false),
+   restartTermCond("{foundSolution:1,maxIters:1000}"),
+   portfolioTypes("sbl rrt lazyrrg*")
 {}
 
 MotionPlannerInterface* MotionPlannerFactory::Create(const MotionPlanningProblem& problem)
 {
   if(problem.startSet) FatalError("MotionPlannerFactory: Cannot do start-set problems yet");
   if(problem.qstart.empty() && (!problem.qgoal.empty() || problem.goalSet!=NULL)) FatalError("MotionPlannerFactory: Goal set specified but start not specified");
+  if(instrument) {
+    SmartPointer<InstrumentedCSpace> space = new InstrumentedCSpace(problem.space);
+    MotionPlanningProblem iproblem = problem;
+    iproblem.space = space;
+    MotionPlannerFactory raw = *this;
+    raw.instrument = false;
+    MotionPlannerInterface* mp = raw.Create(iproblem);
+    if(!mp) return NULL;
+    return new InstrumentedMotionPlanner(mp,space);
+  }
   if(!problem.qstart.empty() && problem.goalSet) { //point-to-goal problem
     //pick a multi-query planner for the underlying planner
     string oldtype = type;
@@ -1410,7 +1674,7 @@ MotionPlannerInterface* MotionPlannerFactory::ApplyModifiers(MotionPlannerInterf
     return new RestartMotionPlanner(norestart,problem,iterTerm);
   }
   else if(shortcut) {
-    return new ShortcutMotionPlanner(planner);
+    return new ShortcutMotionPlanner(planner,shortcutThreads);
   }
   else
     return planner;
@@ -1456,9 +1720,46 @@ bool ReadPointLocation(const string& str,RoadmapPlanner& planner)
   }
 }
 
+//reads the point location string, and if the planner's space is
+//instrumented, counts the queries to the point location data structure
+static void SetupPointLocation(const string& str,RoadmapPlanner& planner)
+{
+  ReadPointLocation(str,planner);
+  InstrumentedCSpace* ispace = dynamic_cast<InstrumentedCSpace*>(planner.space);
+  if(ispace && ispace->enabled && planner.pointLocator)
+    planner.pointLocator = new InstrumentedPointLocation(planner.pointLocator,ispace->stats);
+}
+
 MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
 {
   Lowercase(type);
+  if(type=="portfolio") {
+    vector<string> types;
+    stringstream ss(portfolioTypes);
+    string subtype;
+    while(ss >> subtype) types.push_back(subtype);
+    if(types.empty()) {
+      fprintf(stderr,"MotionPlannerFactory: portfolioTypes is empty\n");
+      return NULL;
+    }
+    if(!portfolioSpaces.empty() && portfolioSpaces.size() != types.size()) {
+      fprintf(stderr,"MotionPlannerFactory: %d portfolio spaces given for %d planners\n",(int)portfolioSpaces.size(),(int)types.size());
+      return NULL;
+    }
+    vector<SmartPointer<MotionPlannerInterface> > planners(types.size());
+    for(size_t i=0;i<types.size();i++) {
+      MotionPlannerFactory sub = *this;
+      sub.type = types[i];
+      sub.portfolioSpaces.clear();
+      Lowercase(sub.type);
+      if(sub.type == "portfolio") FatalError("MotionPlannerFactory: portfolio planners cannot be nested");
+      MotionPlannerInterface* mp = sub.CreateRaw(portfolioSpaces.empty() ? space : portfolioSpaces[i]);
+      if(!mp) return NULL;
+      planners[i] = mp;
+    }
+    //only run the planners concurrently if each one has its own CSpace
+    return new PortfolioMotionPlanner(types,planners,!portfolioSpaces.empty());
+  }
 #if HAVE_OMPL
   if(StartsWith(type.c_str(),"ompl")) {
     string ompltype = type.substr(5,type.size()-5);
@@ -1478,7 +1779,7 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     prm->connectionThreshold = connectionThreshold;
     prm->ignoreConnectedComponents = ignoreConnectedComponents;
     prm->storeEdges=storeEdges;
-    ReadPointLocation(pointLocation,prm->prm);
+    SetupPointLocation(pointLocation,prm->prm);
     return prm;
   }
   else if(type=="any" || type=="sbl") {
@@ -1515,7 +1816,7 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     PRMStarInterface* prm = new PRMStarInterface(space);
     prm->planner.lazy = false;
     prm->planner.connectionThreshold = connectionThreshold;
-    ReadPointLocation(pointLocation,prm->planner);
+    SetupPointLocation(pointLocation,prm->planner);
     if(shortcut || restart) 
       printf("MotionPlannerInterface: Warning, shortcut and restart are incompatible with PRM* planner\n");
     return prm;
@@ -1527,7 +1828,7 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     prm->planner.bidirectional = bidirectional;
     prm->planner.connectionThreshold = connectionThreshold;
     prm->planner.suboptimalityFactor = suboptimalityFactor;
-    ReadPointLocation(pointLocation,prm->planner);
+    SetupPointLocation(pointLocation,prm->planner);
     if(shortcut || restart) 
       printf("MotionPlannerInterface: Warning, shortcut and restart are incompatible with RRT* planner\n");
     return prm;
@@ -1537,7 +1838,7 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     prm->planner.lazy = true;
     prm->planner.connectionThreshold = connectionThreshold;
     prm->planner.suboptimalityFactor = suboptimalityFactor;
-    ReadPointLocation(pointLocation,prm->planner);
+    SetupPointLocation(pointLocation,prm->planner);
     if(shortcut || restart) 
       printf("MotionPlannerInterface: Warning, shortcut and restart are incompatible with Lazy-PRM* planner\n");
     return prm;
@@ -1549,11 +1850,34 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     prm->planner.bidirectional = bidirectional;
     prm->planner.connectionThreshold = connectionThreshold;
     prm->planner.suboptimalityFactor = suboptimalityFactor;
-    ReadPointLocation(pointLocation,prm->planner);
+    SetupPointLocation(pointLocation,prm->planner);
     if(shortcut || restart) 
       printf("MotionPlannerInterface: Warning, shortcut and restart are incompatible with Lazy-RRG* planner\n");
     return prm;
   }
+  else if(type=="fmt*" || type=="bit*") {
+    bool fmt = (type=="fmt*");
+    RoadmapPlanner* rp;
+    MotionPlannerInterface* mp;
+    if(fmt) {
+      FMTStarInterface* fmtstar = new FMTStarInterface(space);
+      fmtstar->planner.batchSize = batchSize;
+      fmtstar->planner.connectionThreshold = connectionThreshold;
+      rp = &fmtstar->planner;
+      mp = fmtstar;
+    }
+    else {
+      BITStarInterface* bitstar = new BITStarInterface(space);
+      bitstar->planner.batchSize = batchSize;
+      bitstar->planner.connectionThreshold = connectionThreshold;
+      rp = &bitstar->planner;
+      mp = bitstar;
+    }
+    SetupPointLocation(pointLocation,*rp);
+    if(shortcut || restart) 
+      printf("MotionPlannerInterface: Warning, shortcut and restart are incompatible with %s planner\n",(fmt?"FMT*":"BIT*"));
+    return mp;
+  }
   else if(type=="fmm" || type=="fmm*") {
     FMMInterface* fmm = new FMMInterface(space,(type=="fmm*"));
     int d;
@@ -1636,6 +1960,7 @@ bool MotionPlannerFactory::Load(TiXmlElement* e)
     Lowercase(type);
   }
   e->QueryValueAttribute("knn",&knn);
+  e->QueryValueAttribute("batchSize",&batchSize);
   e->QueryValueAttribute("connectionThreshold",&connectionThreshold);
   e->QueryValueAttribute("suboptimalityFactor",&suboptimalityFactor);
   e->QueryValueAttribute("ignoreConnectedComponents",&ignoreConnectedComponents);
@@ -1647,8 +1972,12 @@ bool MotionPlannerFactory::Load(TiXmlElement* e)
   e->QueryValueAttribute("randomizeFrequency",&randomizeFrequency);
   e->QueryValueAttribute("storeEdges",&storeEdges);
   e->QueryValueAttribute("shortcut",&shortcut);
+  e->QueryValueAttribute("shortcutThreads",&shortcutThreads);
   e->QueryValueAttribute("restart",&restart);
+  e->QueryValueAttribute("instrument",&instrument);
   e->QueryValueAttribute("restartTermCond",&restartTermCond);
+  if(e->Attribute("portfolioTypes"))
+    portfolioTypes = e->Attribute("portfolioTypes");
   if(e->Attribute("pointLocation"))
     pointLocation = e->Attribute("pointLocation");
   return true;
@@ -1671,6 +2000,7 @@ bool MotionPlannerFactory::LoadJSON(const string& str)
   if(!items["type"].as(typestr)) return false;
   type = typestr;
   items["knn"].as(knn);
+  items["batchSize"].as(batchSize);
   items["suboptimalityFactor"].as(suboptimalityFactor);
   items["connectionThreshold"].as(connectionThreshold);
   items["ignoreConnectedComponents"].as(ignoreConnectedComponents);
@@ -1683,8 +2013,11 @@ bool MotionPlannerFactory::LoadJSON(const string& str)
   items["randomizeFrequency"].as(randomizeFrequency);
   items["storeEdges"].as(storeEdges);
   items["shortcut"].as(shortcut);
+  items["shortcutThreads"].as(shortcutThreads);
   items["restart"].as(restart);
+  items["instrument"].as(instrument);
   items["restartTermCond"].as(restartTermCond);
+  items["portfolioTypes"].as(portfolioTypes);
   return true;
 }
 
@@ -2011,10 +2344,36 @@ void RestartShortcutMotionPlanner::GetRoadmap(Roadmap& roadmap) const
 }
 
 
-ShortcutMotionPlanner::ShortcutMotionPlanner(const SmartPointer<MotionPlannerInterface>& mp)
-  :PiggybackMotionPlanner(mp),numIters(0)
+ShortcutMotionPlanner::ShortcutMotionPlanner(const SmartPointer<MotionPlannerInterface>& mp,int _numThreads)
+  :PiggybackMotionPlanner(mp),numIters(0),numThreads(_numThreads)
 {}
 
+int ShortcutMotionPlanner::ShortcutRound(MilestonePath& path,Real timeLimit)
+{
+  if(numThreads <= 1) {
+    Timer timer;
+    if(shortcutStats.numRounds == 0) shortcutStats.initialLength = path.Length();
+    shortcutStats.numShortcuts += path.Reduce(1);
+    shortcutStats.numRounds++;
+    shortcutStats.numCandidates++;
+    shortcutStats.time += timer.ElapsedTime();
+    shortcutStats.finalLength = path.Length();
+    return 1;
+  }
+  int numCandidates = shortcutStats.numCandidates;
+  path.ParallelShortcut(1,0,numThreads,timeLimit,&shortcutStats);
+  return Max(shortcutStats.numCandidates - numCandidates,1);
+}
+
+void ShortcutMotionPlanner::GetStats(PropertyMap& stats) const
+{
+  PiggybackMotionPlanner::GetStats(stats);
+  stats.set("numShortcuts",shortcutStats.numShortcuts);
+  stats.set("shortcutTime",shortcutStats.time);
+  stats.set("shortcutCostReduction",shortcutStats.initialLength-shortcutStats.finalLength);
+  stats.set("shortcutCostReductionRate",shortcutStats.CostReductionRate());
+}
+
 std::string ShortcutMotionPlanner::Plan(MilestonePath& path,const HaltingCondition& cond)
 {
   Timer timer;
@@ -2028,7 +2387,7 @@ std::string ShortcutMotionPlanner::Plan(MilestonePath& path,const HaltingConditi
   int itersLeft = cond.maxIters - mp->NumIterations(); 
   Real lastCheckTime = timer.ElapsedTime(), lastCheckValue = path.Length();
   printf("Beginning shortcutting with %d iters and %g seconds left\n",itersLeft,cond.timeLimit-timer.ElapsedTime());
-  for(int iters=0;iters<itersLeft;iters++) {
+  for(int iters=0;iters<itersLeft;) {
     Real t = timer.ElapsedTime();
     if(t >= cond.timeLimit) {
       bestPath = path;
@@ -2043,8 +2402,9 @@ std::string ShortcutMotionPlanner::Plan(MilestonePath& path,const HaltingConditi
       lastCheckValue = len;
     }
     //do shortcutting
-    path.Reduce(1);
-    numIters ++;
+    int n = ShortcutRound(path,cond.timeLimit-t);
+    iters += n;
+    numIters += n;
   }
   bestPath = path;
   return "maxIters";
@@ -2061,7 +2421,250 @@ int ShortcutMotionPlanner::PlanMore()
     return res;
   }
   else {
-    bestPath.Reduce(1);
+    ShortcutRound(bestPath);
     return -1;
   }
 }
+
+
+
+PortfolioMotionPlanner::PortfolioMotionPlanner(const vector<string>& _types,const vector<SmartPointer<MotionPlannerInterface> >& _planners,bool _threaded)
+  :types(_types),planners(_planners),threaded(_threaded),best(-1),bestPathLength(Inf),cond(NULL),stop(false),lastCheckTime(0),lastCheckValue(0)
+{
+  Assert(!planners.empty());
+  Assert(types.size() == planners.size());
+}
+
+int PortfolioMotionPlanner::NumIterations() const
+{
+  int n=0;
+  for(size_t i=0;i<planners.size();i++) n += planners[i]->NumIterations();
+  return n;
+}
+
+int PortfolioMotionPlanner::NumMilestones() const
+{
+  int n=0;
+  for(size_t i=0;i<planners.size();i++) n += planners[i]->NumMilestones();
+  return n;
+}
+
+int PortfolioMotionPlanner::NumComponents() const
+{
+  return planners[best >= 0 ? best : 0]->NumComponents();
+}
+
+bool PortfolioMotionPlanner::CanAddMilestone() const
+{
+  for(size_t i=0;i<planners.size();i++)
+    if(!planners[i]->CanAddMilestone()) return false;
+  return true;
+}
+
+int PortfolioMotionPlanner::AddMilestone(const Config& q)
+{
+  int m = planners[0]->AddMilestone(q);
+  for(size_t i=1;i<planners.size();i++) {
+    int mi = planners[i]->AddMilestone(q);
+    if(mi != m) FatalError("PortfolioMotionPlanner: planner %s returned milestone %d rather than %d",types[i].c_str(),mi,m);
+  }
+  return m;
+}
+
+bool PortfolioMotionPlanner::IsConnected(int ma,int mb) const
+{
+  for(size_t i=0;i<planners.size();i++)
+    if(planners[i]->IsConnected(ma,mb)) return true;
+  return false;
+}
+
+bool PortfolioMotionPlanner::IsPointToPoint() const
+{
+  for(size_t i=0;i<planners.size();i++)
+    if(planners[i]->IsPointToPoint()) return true;
+  return false;
+}
+
+bool PortfolioMotionPlanner::IsOptimizing() const
+{
+  for(size_t i=0;i<planners.size();i++)
+    if(planners[i]->IsOptimizing()) return true;
+  return false;
+}
+
+void PortfolioMotionPlanner::GetPath(int ma,int mb,MilestonePath& path)
+{
+  if(ma == 0 && mb == 1 && best >= 0) {
+    path = bestPath;
+    return;
+  }
+  for(size_t i=0;i<planners.size();i++)
+    if(planners[i]->IsConnected(ma,mb)) {
+      planners[i]->GetPath(ma,mb,path);
+      return;
+    }
+  path.edges.clear();
+}
+
+bool PortfolioMotionPlanner::IsSolved()
+{
+  if(best >= 0) return true;
+  for(size_t i=0;i<planners.size();i++)
+    if(planners[i]->IsSolved()) return true;
+  return false;
+}
+
+void PortfolioMotionPlanner::GetSolution(MilestonePath& path)
+{
+  for(size_t i=0;i<planners.size();i++)
+    if(planners[i]->IsSolved()) UpdateSolution(i);
+  path = bestPath;
+}
+
+void PortfolioMotionPlanner::UpdateSolution(int index)
+{
+  MilestonePath path;
+  planners[index]->GetSolution(path);
+  if(path.edges.empty()) return;
+  Real len = path.Length();
+  if(best < 0 || len < bestPathLength) {
+    best = index;
+    bestPath = path;
+    bestPathLength = len;
+  }
+}
+
+int PortfolioMotionPlanner::PlanMore()
+{
+  int res = -1;
+  for(size_t i=0;i<planners.size();i++) {
+    int r = planners[i]->PlanMore();
+    if(i == 0) res = r;
+    if(planners[i]->IsSolved()) UpdateSolution(i);
+  }
+  return res;
+}
+
+struct PortfolioThreadData
+{
+  PortfolioMotionPlanner* planner;
+  int index;
+};
+
+void* PortfolioPlanThread(void* data)
+{
+  PortfolioThreadData* d = (PortfolioThreadData*)data;
+  d->planner->PlanThread(d->index);
+  return NULL;
+}
+
+void PortfolioMotionPlanner::PlanThread(int index)
+{
+  bool solved = false;
+  for(int iters=0;iters<cond->maxIters;iters++)
+    if(!PlanStep(index,solved)) return;
+}
+
+bool PortfolioMotionPlanner::PlanStep(int index,bool& solved)
+{
+  MotionPlannerInterface* mp = planners[index];
+  mp->PlanMore();
+  bool nowSolved = mp->IsSolved();
+  ScopedLock lock(mutex);
+  if(stop) return false;
+  Real t = timer.ElapsedTime();
+  if(nowSolved) {
+    UpdateSolution(index);
+    if(!solved && cond->foundSolution) {
+      stop = true;
+      stopReason = "foundSolution";
+      return false;
+    }
+    if(!solved && lastCheckTime == 0) {
+      lastCheckTime = t;
+      lastCheckValue = bestPathLength;
+    }
+    solved = true;
+    //the solution of a feasible planner won't improve, so free up the thread
+    if(!mp->IsOptimizing()) return false;
+  }
+  if(t > cond->timeLimit) {
+    stop = true;
+    stopReason = "timeLimit";
+    return false;
+  }
+  if(best >= 0) {
+    if(bestPathLength < cond->costThreshold) {
+      stop = true;
+      stopReason = "costThreshold";
+      return false;
+    }
+    if(t > lastCheckTime + cond->costImprovementPeriod) {
+      if(lastCheckValue - bestPathLength < cond->costImprovementThreshold) {
+        stop = true;
+        stopReason = "costImprovementThreshold";
+        return false;
+      }
+      lastCheckTime = t;
+      lastCheckValue = bestPathLength;
+    }
+  }
+  return true;
+}
+
+std::string PortfolioMotionPlanner::Plan(MilestonePath& path,const HaltingCondition& _cond)
+{
+  path.edges.clear();
+  cond = &_cond;
+  stop = false;
+  stopReason = "maxIters";
+  lastCheckTime = lastCheckValue = 0;
+  timer.Reset();
+  if(!threaded) {
+    //step the planners in turn until all of them stop
+    vector<bool> solved(planners.size(),false),active(planners.size(),true);
+    for(int iters=0;iters<cond->maxIters && !stop;iters++) {
+      bool any = false;
+      for(size_t i=0;i<planners.size() && !stop;i++) {
+        if(!active[i]) continue;
+        bool isSolved = solved[i];
+        active[i] = PlanStep((int)i,isSolved);
+        solved[i] = isSolved;
+        if(active[i]) any = true;
+      }
+      if(!any) break;
+    }
+    cond = NULL;
+    path = bestPath;
+    return stopReason;
+  }
+  vector<PortfolioThreadData> data(planners.size());
+  vector<Thread> threads(planners.size());
+  for(size_t i=0;i<planners.size();i++) {
+    data[i].planner = this;
+    data[i].index = (int)i;
+    threads[i] = ThreadStart(PortfolioPlanThread,&data[i]);
+  }
+  for(size_t i=0;i<planners.size();i++)
+    ThreadJoin(threads[i]);
+  cond = NULL;
+  path = bestPath;
+  return stopReason;
+}
+
+void PortfolioMotionPlanner::GetStats(PropertyMap& stats) const
+{
+  MotionPlannerInterface::GetStats(stats);
+  stats.set("numPlanners",(int)planners.size());
+  stats.set("bestPlanner",(best >= 0 ? types[best] : string("none")));
+  stats.set("bestPathLength",bestPathLength);
+  for(size_t i=0;i<planners.size();i++) {
+    PropertyMap substats;
+    planners[i]->GetStats(substats);
+    stringstream prefix;
+    prefix<<"planner"<<i<<".";
+    stats.set(prefix.str()+"type",types[i]);
+    for(PropertyMap::const_iterator j=substats.begin();j!=substats.end();j++)
+      stats[prefix.str()+j->first] = j->second;
+  }
+}
@@ -116,6 +116,14 @@ class MotionPlannerInterface
   virtual void GetSolution(MilestonePath& path) { return GetPath(0,1,path); }
   ///Returns a full-blown roadmap representation of the roadmap
   virtual void GetRoadmap(Roadmap& roadmap) const {}
+  ///Saves the roadmap to a file that can be loaded with LoadRoadmap to
+  ///warm-start a later planner.  Returns false if not supported.
+  virtual bool SaveRoadmap(const char* fn) { return false; }
+  ///Adds a roadmap saved by SaveRoadmap, revalidated against the current
+  ///constraints of the space.  The constraints named in changedConstraints
+  ///are treated as changed since the roadmap was saved, as in
+  ///RoadmapFile::Validate.  Returns false if not supported.
+  virtual bool LoadRoadmap(const char* fn,const std::vector<std::string>& changedConstraints=std::vector<std::string>()) { return false; }
   ///Returns some named statistics about the planner, implementation-dependent
   virtual void GetStats(PropertyMap& stats) const;
 };
@@ -197,8 +205,17 @@ class MotionPlanningProblem
  * - prm*: the PRM* algorithm for optimal motion planning
  * - lazyprm*: the Lazy-PRM* algorithm for optimal motion planning
  * - lazyrrg*: the Lazy-RRG* algorithm for optimal motion planning
+ * - fmt*: the Fast Marching Tree algorithm, run over batches of increasing
+ *   size and sampling the informed set once a solution is found
+ * - bit*: the Batch Informed Trees algorithm for optimal motion planning
  * - fmm: the fast marching method algorithm for resolution-complete optimal motion planning
  * - fmm*: an anytime fast marching method algorithm for optimal motion planning
+ * - portfolio: runs each of the planner types listed in portfolioTypes,
+ *   and stops when the first one finds a solution.  If the halting
+ *   condition has foundSolution=false, the planners keep running and the
+ *   best solution is kept.  If portfolioSpaces gives an independent CSpace
+ *   for each planner, each planner runs in its own thread.  Otherwise the
+ *   planners share the CSpace and take turns on the calling thread.
  * 
  * If KrisLibrary is built with OMPL support, you can also use the type specifier
  * "ompl:[X]" where [X] is one of:
@@ -221,7 +238,8 @@ class MotionPlanningProblem
  * try to find a better solution.  Specifically:
  * - With shortcut=true, the path produced by the planner is shrunk
  *   in a postprocessing stage by repeatedly shortcutting until the
- *   remaining time is up.
+ *   remaining time is up.  Setting shortcutThreads > 1 checks batches of
+ *   candidate shortcuts in parallel.
  * - With restart=true, planning proceeds in rounds, each round completely
  *   restarting from scratch, and only the best path is stored.
  *   To govern how long each of the rounds lasts, you must set the
@@ -229,6 +247,12 @@ class MotionPlanningProblem
  *   for that round.
  * - Good results are often obtained by setting both restart=true and
 *    shortcut=true. 
+ *
+ * With instrument=true, the planner runs on an InstrumentedCSpace, and its
+ * GetStats also reports the number of feasibility checks, edge checks,
+ * distance calls, and point location queries and the time spent in them,
+ * both in total and per constraint.  The counters are atomic, so this may be
+ * combined with shortcutThreads > 1; the times are then summed over threads.
  */
 class MotionPlannerFactory
 {
@@ -258,7 +282,8 @@ class MotionPlannerFactory
 
   string type;
   int knn;                 ///<for PRM (default 10)
-  Real connectionThreshold;///<for PRM,RRT,SBL,SBLPRT,RRT*,PRM*,LazyPRM*,LazyRRG* (default Inf)
+  int batchSize;           ///<for FMT*, BIT* (default 100): the number of samples in each batch
+  Real connectionThreshold;///<for PRM,RRT,SBL,SBLPRT,RRT*,PRM*,LazyPRM*,LazyRRG*,FMT*,BIT* (default Inf)
   Real suboptimalityFactor;///<for RRT*, LazyPRM*, LazyRRG* (default 0)
   bool ignoreConnectedComponents; //for PRM (default false)
   Real perturbationRadius; ///<for Perturbation,EST,RRT,SBL,SBLPRT (default 0.1)
@@ -267,11 +292,15 @@ class MotionPlannerFactory
   bool useGrid;            ///<for SBL, SBLPRT (default true): for SBL, uses grid-based random point selection
   Real gridResolution;     ///<for SBL, SBLPRT, FMM, FMM* (default 0): if nonzero, for SBL, specifies point selection grid size (default 0.1), for FMM / FMM*, specifies resolution (default 1/8 of domain)
   int randomizeFrequency;  ///<for SBL, SBLPRT (default 50): how often the grid projection is randomly perturbed
-  string pointLocation;    ///<for PRM, RRT*, PRM*, LazyPRM*, LazyRRG* (default ""): specifies a point location data structure ("random", "randombest [k]", "kdtree" supported)
+  string pointLocation;    ///<for PRM, RRT*, PRM*, LazyPRM*, LazyRRG*, FMT*, BIT* (default ""): specifies a point location data structure ("random", "randombest [k]", "kdtree" supported)
   bool storeEdges;         ///<true if local planner data is stored during planning (false may save memory, default)
   bool shortcut;           ///<true if you wish to perform shortcutting afterwards (default false)
+  int shortcutThreads;     ///<if shortcut is true and this is > 1, candidate shortcuts are checked in parallel by this many threads (default 1).  The CSpace must then be safe to use from multiple threads.
   bool restart;            ///<true if you wish to restart the planner to get better paths with the remaining time (default false)
+  bool instrument;         ///<true if calls to the CSpace and point location data structure should be counted and timed in GetStats (default false)
   string restartTermCond;  ///<used if restart is true, JSON string defining termination condition (default "{foundSolution:1;maxIters:1000}")
+  string portfolioTypes;   ///<for portfolio: space-separated list of planner types to run concurrently (default "sbl rrt lazyrrg*")
+  vector<CSpace*> portfolioSpaces; ///<for portfolio: if nonempty, an independent CSpace for each planner in portfolioTypes (not saved)
 };
 
 
@@ -57,7 +57,7 @@ void CSpace::CopyConstraints(const CSpace* space,const std::string& prefix)
 std::string CSpace::VariableName(int i)
 {
   stringstream ss;
-  ss<<"x"<<i<<endl;
+  ss<<"x"<<i;
   return ss.str();
 }
 
@@ -2,32 +2,40 @@
 #include <KrisLibrary/utils/permutation.h>
 #include <KrisLibrary/math/sample.h>
 #include <KrisLibrary/math/random.h>
+#include <list>
 using namespace std;
-using namespace Geometry;
+using namespace Statistics;
 using namespace Math;
 
 GridDensityEstimator::GridDensityEstimator()
-:subdiv(1,1)
-{}
+{
+  InitKeys();
+}
 
 GridDensityEstimator::GridDensityEstimator(const std::vector<int>& _mappedDims,Math::Real _h)
-:mappedDims(_mappedDims),h(_mappedDims.size(),_h),subdiv(h)
-{}
+:mappedDims(_mappedDims),h(_mappedDims.size(),_h)
+{
+  InitKeys();
+}
 
 GridDensityEstimator::GridDensityEstimator(const std::vector<int>& _mappedDims,const Math::Vector& _h)
-:mappedDims(_mappedDims),h(_h),subdiv(_h)
-{}
+:mappedDims(_mappedDims),h(_h)
+{
+  Assert(h.n == (int)mappedDims.size());
+  InitKeys();
+}
 
 void GridDensityEstimator::Randomize(int numSourceDims,int numMapped,const Vector& hsource)
 {
-  subdiv.Clear();
+  buckets.clear();
+  indexBuckets.clear();
   flattenedBuckets.clear();
   if(numSourceDims <= numMapped) {
     //just do identity
     mappedDims.resize(numSourceDims);
     IdentityPermutation(mappedDims);
     h = hsource;
-    subdiv = GridSubdivision(hsource);
+    InitKeys();
     return;
   }
   vector<int> dims(numSourceDims);
@@ -38,7 +46,7 @@ void GridDensityEstimator::Randomize(int numSourceDims,int numMapped,const Vecto
   h.resize(numMapped);
   for(int i=0;i<numMapped;i++) 
     h[i] = hsource[mappedDims[i]];
-  subdiv = GridSubdivision(h);
+  InitKeys();
 }
 
 void GridDensityEstimator::Randomize(int numSourceDims,int numMapped,Real hsource)
@@ -49,42 +57,68 @@ void GridDensityEstimator::Randomize(int numSourceDims,int numMapped,Real hsourc
 
 void GridDensityEstimator::Clear()
 {
-  subdiv.Clear();
+  buckets.clear();
+  indexBuckets.clear();
   flattenedBuckets.clear();
 }
 
-void GridDensityEstimator::Add(const Math::Vector& x,void* data)
+void GridDensityEstimator::InitKeys()
 {
-  temp.resize(mappedDims.size());
+  packed = packer.InitUnbounded((int)mappedDims.size());
+}
+
+void GridDensityEstimator::GetIndex(const Math::Vector& x)
+{
+  tempIndex.resize(mappedDims.size());
   for(size_t i=0;i<mappedDims.size();i++)
-    temp[i] = x[mappedDims[i]];
+    tempIndex[i] = (int)Floor(x[mappedDims[i]]/h[i]);
+}
 
-  GridSubdivision::Index index;
-  subdiv.PointToIndex(temp,index);
-  subdiv.Insert(index,data);
+GridDensityEstimator::ObjectSet* GridDensityEstimator::GetObjectSet(const Math::Vector& x)
+{
+  GetIndex(x);
+  if(packed) {
+    HashTable::iterator bucket = buckets.find(packer.Pack(tempIndex.empty() ? NULL : &tempIndex[0]));
+    if(bucket == buckets.end()) return NULL;
+    return &bucket->second;
+  }
+  IndexHashTable::iterator bucket = indexBuckets.find(tempIndex);
+  if(bucket == indexBuckets.end()) return NULL;
+  return &bucket->second;
 }
 
-void GridDensityEstimator::Remove(const Math::Vector& x,void* data)
+void GridDensityEstimator::Add(const Math::Vector& x,void* data)
 {
-  temp.resize(mappedDims.size());
-  for(size_t i=0;i<mappedDims.size();i++)
-    temp[i] = x[mappedDims[i]];
+  GetIndex(x);
+  ObjectSet& objs = (packed ? buckets[packer.Pack(tempIndex.empty() ? NULL : &tempIndex[0])] : indexBuckets[tempIndex]);
+  //a new cell invalidates the flattened list
+  if(objs.empty()) flattenedBuckets.clear();
+  objs.push_back(data);
+}
 
-  GridSubdivision::Index index;
-  subdiv.PointToIndex(temp,index);
-  bool res=subdiv.Erase(index,data);
-  Assert(res == true);
+void GridDensityEstimator::Remove(const Math::Vector& x,void* data)
+{
+  ObjectSet* objs = GetObjectSet(x);
+  Assert(objs != NULL);
+  for(size_t i=0;i<objs->size();i++) {
+    if((*objs)[i] == data) {
+      (*objs)[i] = objs->back();
+      objs->resize(objs->size()-1);
+      if(objs->empty()) {
+        //GetObjectSet left the cell's index in tempIndex
+        if(packed) buckets.erase(packer.Pack(tempIndex.empty() ? NULL : &tempIndex[0]));
+        else indexBuckets.erase(tempIndex);
+        flattenedBuckets.clear();
+      }
+      return;
+    }
+  }
+  FatalError("GridDensityEstimator::Remove: data not found in its cell");
 }
 
 double GridDensityEstimator::Density(const Config& x)
 {
-  temp.resize(mappedDims.size());
-  for(size_t i=0;i<mappedDims.size();i++)
-    temp[i] = x[mappedDims[i]];
-
-  GridSubdivision::Index index;
-  subdiv.PointToIndex(temp,index);
-  GridSubdivision::ObjectSet* objs = subdiv.GetObjectSet(index);
+  ObjectSet* objs = GetObjectSet(x);
   if(!objs) return 0;
   return objs->size();
 }
@@ -111,38 +145,42 @@ void* RandomObject(const vector<void*>& objs)
 
 void* GridDensityEstimator::RandomNear(const Math::Vector& x)
 {
-  temp.resize(mappedDims.size());
-  for(size_t i=0;i<mappedDims.size();i++)
-    temp[i] = x[mappedDims[i]];
-
-  GridSubdivision::Index index;
-  subdiv.PointToIndex(temp,index);
-  GridSubdivision::ObjectSet* objs = subdiv.GetObjectSet(index);
+  ObjectSet* objs = GetObjectSet(x);
   if(!objs) return NULL;
 
   return RandomObject(*objs); 
 }
 
-void* GridDensityEstimator::Random()
+//Returns the k'th cell of table.  If advancing to it is slow, flattens the
+//table into flattened first.
+template <class Hash>
+static GridDensityEstimator::ObjectSet* KthCell(Hash& table,int k,vector<GridDensityEstimator::ObjectSet*>& flattened)
 {
-  size_t n=subdiv.buckets.size();
-  Assert(n > 0);
-  int k=RandInt((int)n);
-  if(n != flattenedBuckets.size()) {
+  size_t n=table.size();
+  if(n != flattened.size()) {
     if(k >= 32 || (1<<k) > (int)n) {
-      flattenedBuckets.resize(n);
-      GridSubdivision::HashTable::iterator bucket=subdiv.buckets.begin();
+      flattened.resize(n);
+      typename Hash::iterator bucket=table.begin();
       for(size_t i=0;i<n;i++,bucket++)
-        flattenedBuckets[i] = &bucket->second;
+        flattened[i] = &bucket->second;
     }
     else  {
       //advance
-      GridSubdivision::HashTable::iterator bucket=subdiv.buckets.begin();
+      typename Hash::iterator bucket=table.begin();
       for(int i=0;i<k;i++,bucket++);
-      return RandomObject(bucket->second);
+      return &bucket->second;
     }
   }
-  return RandomObject(*flattenedBuckets[k]);
+  return flattened[k];
+}
+
+void* GridDensityEstimator::Random()
+{
+  size_t n=(packed ? buckets.size() : indexBuckets.size());
+  Assert(n > 0);
+  int k=RandInt((int)n);
+  if(packed) return RandomObject(*KthCell(buckets,k,flattenedBuckets));
+  return RandomObject(*KthCell(indexBuckets,k,flattenedBuckets));
 }
 
 
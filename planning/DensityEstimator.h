@@ -2,7 +2,7 @@
 #define PLANNING_DENSITY_ESTIMATOR_H
 
 #include <KrisLibrary/math/vector.h>
-#include <KrisLibrary/geometry/GridSubdivision.h>
+#include <KrisLibrary/statistics/HistogramND.h>
 #include "PointLocation.h"
 
 /** @ingroup MotionPlanning
@@ -38,6 +38,10 @@ public:
  * Due to data fragmentation, the number of mapped dimensions
  * should be relatively small. <= 3 is usually a good choice.
  *
+ * With up to 2 mapped dimensions, cells are keyed by their indices packed
+ * into 64 bits, like the buckets of Statistics::HistogramND.  With more,
+ * they are keyed by their full indices in indexBuckets.
+ *
  * Note: Randomize will destroy the contents of the estimator.
  */
 class GridDensityEstimator : public DensityEstimatorBase
@@ -55,13 +59,29 @@ public:
   virtual void* RandomNear(const Math::Vector& x);
   virtual void* Random();
   
+  typedef Statistics::BinIndexPacker::Key Key;
+  typedef std::vector<void*> ObjectSet;
+  typedef UNORDERED_MAP_TEMPLATE<Key,ObjectSet,Statistics::BinKeyHash> HashTable;
+  typedef UNORDERED_MAP_TEMPLATE<std::vector<int>,ObjectSet,Statistics::IndexHash> IndexHashTable;
+
+  ///Returns the objects in the cell containing x, or NULL if it's empty
+  ObjectSet* GetObjectSet(const Math::Vector& x);
+
   std::vector<int> mappedDims;
   Math::Vector h;
-  Geometry::GridSubdivision subdiv;
+  Statistics::BinIndexPacker packer;
+  ///Whether the cells are in buckets (true) or indexBuckets (false)
+  bool packed;
+  HashTable buckets;
+  IndexHashTable indexBuckets;
 
   //temporary
-  Math::Vector temp;
-  std::vector<Geometry::GridSubdivision::ObjectSet*> flattenedBuckets;
+  std::vector<int> tempIndex;
+  std::vector<ObjectSet*> flattenedBuckets;
+
+private:
+  void InitKeys();
+  void GetIndex(const Math::Vector& x);
 };
 
 /** @ingroup MotionPlanning
@@ -10,6 +10,8 @@
 #include <Timer.h>
 #include <iostream>
 #include <algorithm>
+#include <set>
+#include <limits.h>
 using namespace std;
 using namespace Math;
 
@@ -794,10 +796,249 @@ bool FMMSearch(const Vector& startorig,const Vector& goalorig,
 
 
 
+void SparseFMMGrid::Init(const vector<int>& _dims)
+{
+  dims = _dims;
+  strides.resize(dims.size());
+  long long n = 1;
+  for(int i=(int)dims.size()-1;i>=0;i--) {
+    strides[i] = n;
+    if(dims[i] > 0 && n > LLONG_MAX/dims[i])
+      FatalError("SparseFMMGrid: grid with %d dimensions is too large to index",(int)dims.size());
+    n *= dims[i];
+  }
+  Clear();
+}
+
+void SparseFMMGrid::Clear()
+{
+  keys.resize(0);
+  values.resize(0);
+  slots.clear();
+}
+
+long long SparseFMMGrid::IndexToKey(const vector<int>& index) const
+{
+  Assert(index.size() == dims.size());
+  long long key = 0;
+  for(size_t i=0;i<index.size();i++)
+    key += strides[i]*index[i];
+  return key;
+}
+
+void SparseFMMGrid::KeyToIndex(long long key,vector<int>& index) const
+{
+  index.resize(dims.size());
+  for(size_t i=0;i<dims.size();i++) {
+    index[i] = int(key / strides[i]);
+    key -= strides[i]*index[i];
+  }
+}
+
+int SparseFMMGrid::Find(long long key) const
+{
+  UNORDERED_MAP_TEMPLATE<long long,int>::const_iterator i=slots.find(key);
+  if(i == slots.end()) return -1;
+  return i->second;
+}
+
+int SparseFMMGrid::Insert(long long key)
+{
+  int n = (int)keys.size();
+  std::pair<UNORDERED_MAP_TEMPLATE<long long,int>::iterator,bool> res = slots.insert(std::pair<long long,int>(key,n));
+  if(!res.second) return res.first->second;
+  keys.push_back(key);
+  values.push_back(Inf);
+  return n;
+}
+
+Real SparseFMMGrid::operator [] (const vector<int>& index) const
+{
+  int n = Find(IndexToKey(index));
+  if(n < 0) return Inf;
+  return values[n];
+}
+
+/** Solves the Eikonal update sum_i (u-a_i)^2 = c^2 using the smallest
+ * upwind values a, which are sorted on output.  Equivalent to the best
+ * simplex in SimplexEnumerator, but takes O(n log n) rather than
+ * exponential time.
+ */
+static Real EikonalUpdate(vector<Real>& a,Real c)
+{
+  Assert(!a.empty());
+  sort(a.begin(),a.end());
+  Real u = a[0]+c;
+  Real s1 = a[0], s2 = Sqr(a[0]);
+  for(size_t k=1;k<a.size();k++) {
+    if(u <= a[k]) break;
+    s1 += a[k];
+    s2 += Sqr(a[k]);
+    Real n = Real(k+1);
+    Real det = Sqr(s1) - n*(s2-Sqr(c));
+    if(det < 0) break;
+    u = (s1 + Sqrt(det))/n;
+  }
+  return u;
+}
+
+//status of cells in SparseFMMSearch
+#define SPARSE_FMM_FAR 0
+#define SPARSE_FMM_QUEUED 1
+#define SPARSE_FMM_VISITED -1
+
+bool SparseFMMSearch(const Vector& startorig,const Vector& goalorig,
+		     const Vector& bmin,const Vector& bmax,const Vector& res,
+		     Real (*costFn)(const Vector& coords),SparseFMMGrid& distances,
+		     Real bound,Real costLowerBound)
+{
+  int numVisited = 0;
+  assert(startorig.size() == res.size());
+  assert(startorig.size() == bmin.size());
+  assert(startorig.size() == bmax.size());
+  vector<int> dims(res.size());
+  for(int i=0;i<res.n;i++) {
+    dims[i] = (int)Ceil((bmax[i]-bmin[i])/res[i]);
+    if(dims[i] == ((bmax[i]-bmin[i])/res[i])) //upper bound is identically an integer
+      dims[i] ++;
+  }
+  //normalize start and goal
+  Vector start,goal;
+  start.resize(startorig.n);
+  for(int i=0;i<res.n;i++)
+    start[i] = (startorig[i] - bmin[i])/res[i];
+  goal.resize(goalorig.n);
+  for(int i=0;i<goal.n;i++)
+    goal[i] = (goalorig[i] - bmin[i])/res[i];
+  bool prune = (goal.n == start.n && !IsInf(bound));
+
+  distances.Init(dims);
+  //per-slot search status and cached cost
+  vector<signed char> status;
+  vector<Real> costs;
+  vector<vector<int> > scells, gcells;
+  CoordinatesToGridPoints(start,dims,scells);
+  CoordinatesToGridPoints(goal,dims,gcells);
+  //all of the (up to 2^d) start cells are pushed before the heap can grow
+  int capacity = Max(1024,2*(int)scells.size());
+  FixedSizeHeap<Real> q;
+  q.init(capacity);
+  vector<int> node;
+  Vector pt(start.n);
+  for(size_t i=0;i<scells.size();i++) {
+    int n = distances.Insert(distances.IndexToKey(scells[i]));
+    for(int k=0;k<pt.n;k++)
+      pt[k] = bmin(k) + scells[i][k]*res[k];
+    status.push_back(SPARSE_FMM_QUEUED);
+    costs.push_back(costFn(pt));
+    q.push(n,0);
+  }
+  set<long long> gKeys;
+  for(size_t i=0;i<gcells.size();i++)
+    gKeys.insert(distances.IndexToKey(gcells[i]));
+  vector<Real> upwind;
+
+  while(!q.empty()) {
+    int n = q.top();
+    Real npriority = q.topPriority();
+    q.pop();
+    numVisited++;
+
+    long long key = distances.keys[n];
+    if(gKeys.count(key) != 0) {
+      gKeys.erase(key);
+      if(gKeys.empty()) {
+	printf("%d nodes visited, %d cells allocated\n",numVisited,(int)distances.NumCells());
+	return true;
+      }
+    }
+
+    //set to visited
+    status[n] = SPARSE_FMM_VISITED;
+    distances.KeyToIndex(key,node);
+    Real c = costs[n];
+    Real best;
+    if (npriority == 0) //it's a start node
+      best = Distance(start,node)*c;
+    else {
+      //look at visited neighbors, taking the smallest on each axis
+      upwind.resize(0);
+      for(size_t i=0;i<node.size();i++) {
+	Real ai = Inf;
+	for(int dir=-1;dir<=1;dir+=2) {
+	  int x = node[i]+dir;
+	  if(x < 0 || x >= dims[i]) continue;
+	  int m = distances.Find(key + dir*distances.strides[i]);
+	  if(m >= 0 && status[m] == SPARSE_FMM_VISITED && distances.values[m] < ai)
+	    ai = distances.values[m];
+	}
+	if(!IsInf(ai)) upwind.push_back(ai);
+      }
+      best = EikonalUpdate(upwind,c);
+    }
+    distances.values[n] = best;
+
+    //propagate to neighbors, allocating them as necessary
+    for(size_t i=0;i<node.size();i++) {
+      for(int dir=-1;dir<=1;dir+=2) {
+	int x = node[i]+dir;
+	if(x < 0 || x >= dims[i]) continue;
+	long long nextkey = key + dir*distances.strides[i];
+	node[i] = x;
+	Real goalDist = (prune ? costLowerBound*Distance(goal,node) : 0);
+	int m = distances.Find(nextkey);
+	if(m < 0) {
+	  if(prune && best + costLowerBound + goalDist > bound) {
+	    node[i] -= dir;
+	    continue;
+	  }
+	  m = distances.Insert(nextkey);
+	  for(int k=0;k<pt.n;k++)
+	    pt[k] = bmin(k) + node[k]*res[k];
+	  status.push_back(SPARSE_FMM_FAR);
+	  costs.push_back(costFn(pt));
+	  if(m >= capacity) {
+	    capacity = 2*m;
+	    q.increaseCapacity(capacity);
+	  }
+	}
+	node[i] -= dir;
+	Real ncost = best+costs[m];
+	if(IsInf(ncost)) continue;
+	if(prune && ncost + goalDist > bound) continue;
+	if(status[m]==SPARSE_FMM_FAR) {
+	  q.push(m,-ncost);
+	  distances.values[m] = ncost;
+	  status[m] = SPARSE_FMM_QUEUED;
+	}
+	else if(status[m]==SPARSE_FMM_QUEUED) {
+	  if (ncost < distances.values[m]) {
+	    distances.values[m] = ncost;
+	    q.adjust(m,-ncost);
+	  }
+	}
+	else {
+	  if(ncost < distances.values[m])
+	    distances.values[m] = ncost;
+	}
+      }
+    }
+  }
+  printf("%d nodes visited, %d cells allocated, goal not reached\n",numVisited,(int)distances.NumCells());
+  //couldn't find goal
+  return false;
+}
+
+
+
+
 /** Multilinear interpolation of an ND field.
 * Sensitive to Inf's in the field -- will ignore them
+*
+* Field is either an ArrayND<Real> or a SparseFMMGrid
 */
-Real EvalMultilinear(const ArrayND<Real>& field,const Vector& point)
+template <class Field>
+Real EvalMultilinear(const Field& field,const Vector& point)
 {
   vector<int> low(point.size());
   Vector u(point.n);
@@ -846,7 +1087,8 @@ Real EvalMultilinear(const ArrayND<Real>& field,const Vector& point)
 #define INF_POS 1
 #define INF_NEG 2
 
-Vector FiniteDifference(const ArrayND<Real>& field,const Vector& x,vector<int>& infDirs)
+template <class Field>
+Vector FiniteDifference(const Field& field,const Vector& x,vector<int>& infDirs)
 {
   infDirs.resize(x.n);
   fill(infDirs.begin(),infDirs.end(),0);
@@ -883,7 +1125,8 @@ Vector FiniteDifference(const ArrayND<Real>& field,const Vector& x,vector<int>&
 }
 
 /** Gradient descent of an ND field */
-vector<Vector> GradientDescent(const ArrayND<Real>& field,const Vector& start)
+template <class Field>
+vector<Vector> GradientDescentT(const Field& field,const Vector& start)
 {
   Vector pt = start;
   vector<Vector> path;
@@ -924,7 +1167,7 @@ vector<Vector> GradientDescent(const ArrayND<Real>& field,const Vector& start)
     }
     Vector next = pt-grad*t;
     //round to nearest grid cell
-    next[bdry] = Real(int(next[bdry]));
+    next[bdry] = Floor(next[bdry]+0.5);
     /*
     for(size_t i=0;i<next.size();i++) {
       if(next[i] < 0.0) next[i] = 0.0;
@@ -932,7 +1175,9 @@ vector<Vector> GradientDescent(const ArrayND<Real>& field,const Vector& start)
     }
     */
     Real curValue = EvalMultilinear(field,pt);
-    if (EvalMultilinear(field,next) >= curValue) {
+    //tiny decreases can happen when the step is cut off by roundoff, and
+    //would make the descent creep
+    if (EvalMultilinear(field,next) >= curValue - Epsilon) {
       //just go to the best nearest gridpoint
       vector<vector<int> > gridpts;
       CoordinatesToGridPoints(pt,field.dims,gridpts,1);
@@ -973,6 +1218,16 @@ vector<Vector> GradientDescent(const ArrayND<Real>& field,const Vector& start)
   return path;
 }
 
+vector<Vector> GradientDescent(const ArrayND<Real>& field,const Vector& start)
+{
+  return GradientDescentT(field,start);
+}
+
+vector<Vector> GradientDescent(const SparseFMMGrid& field,const Vector& start)
+{
+  return GradientDescentT(field,start);
+}
+
 
 /*
 
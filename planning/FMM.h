@@ -3,8 +3,42 @@
 
 #include <KrisLibrary/structs/arraynd.h>
 #include <KrisLibrary/math/vector.h>
+#include <KrisLibrary/utils/stl_tr1.h>
 using namespace Math;
 
+/** @brief A sparse N-dimensional grid of distances, as produced by
+ * SparseFMMSearch.
+ *
+ * The grid has the same domain [0,d1-1] x ... x [0,dN-1] as the ArrayND
+ * used by FMMSearch, but only the cells that the front has reached are
+ * stored.  A cell's key is its offset in the full grid, and each stored
+ * cell occupies a slot in the keys and values arrays.  Cells that are not
+ * stored have the value Inf.
+ */
+class SparseFMMGrid
+{
+ public:
+  ///Sets the domain and removes all cells
+  void Init(const std::vector<int>& dims);
+  void Clear();
+  inline size_t NumCells() const { return keys.size(); }
+  long long IndexToKey(const std::vector<int>& index) const;
+  void KeyToIndex(long long key,std::vector<int>& index) const;
+  ///Returns the slot of the given cell, or -1 if it isn't stored
+  int Find(long long key) const;
+  ///Stores the given cell with value Inf if it isn't stored already, and
+  ///returns its slot
+  int Insert(long long key);
+  ///Returns the value of the given cell
+  Real operator [] (const std::vector<int>& index) const;
+
+  std::vector<int> dims;
+  std::vector<long long> strides;
+  std::vector<long long> keys;
+  std::vector<Real> values;
+  UNORDERED_MAP_TEMPLATE<long long,int> slots;
+};
+
 /** @brief Performs an N-dimensional Fast Marching Method search on a variable-
  * cost grid.
  * 
@@ -37,6 +71,28 @@ bool FMMSearch(const Vector& start,const Vector& goal,
 	       Real (*costFn) (const Vector& coords),
 	       ArrayND<Real>& distances);
 
+/** @brief Performs an N-dimensional Fast Marching Method search in an N-D
+ * box with a variable cost function, storing only the cells that the front
+ * reaches.
+ *
+ * Input and output are the same as the box version of FMMSearch, except
+ * that distances is sparse.  Each cell's cost is evaluated once.  Memory
+ * is proportional to the number of cells reached rather than the volume of
+ * the box, so this is practical in higher dimensions.
+ *
+ * If bound is finite, the search is restricted to cells that could be on a
+ * path of cost less than bound: a cell is not reached if its distance from
+ * the start plus costLowerBound times its straight-line distance to the goal
+ * exceeds bound (both in grid units).  costLowerBound must be a lower bound on
+ * costFn.  This is used for coarse-to-fine refinement around a known
+ * solution.
+ */
+bool SparseFMMSearch(const Vector& start,const Vector& goal,
+		     const Vector& bmin,const Vector& bmax,const Vector& res,
+		     Real (*costFn) (const Vector& coords),
+		     SparseFMMGrid& distances,
+		     Real bound=Inf,Real costLowerBound=1);
+
 /** @brief Perform gradient descent on an ND field, starting from some coordinates.
  * Returns the path traced, ending at a local minimum.
  * 
@@ -47,4 +103,7 @@ bool FMMSearch(const Vector& start,const Vector& goal,
  */
 std::vector<Vector> GradientDescent(const ArrayND<Real>& field,const Vector& start);
 
+///Same as above, but for a sparse field as produced by SparseFMMSearch
+std::vector<Vector> GradientDescent(const SparseFMMGrid& field,const Vector& start);
+
 #endif
@@ -12,11 +12,11 @@ Real FMMCost(const Vector& coords)
 }
 
 FMMMotionPlanner::FMMMotionPlanner(CSpace* _space)
-  :space(_space),dynamicDomain(true)
+  :space(_space),dynamicDomain(true),refineFactor(1.25)
 {}
 
 FMMMotionPlanner::FMMMotionPlanner(CSpace* _space,const Vector& _bmin,const Vector& _bmax,int divs)
-  :space(_space),bmin(_bmin),bmax(_bmax),dynamicDomain(false)
+  :space(_space),bmin(_bmin),bmax(_bmax),dynamicDomain(false),refineFactor(1.25)
 {
   resolution = bmax-bmin;
   resolution *= 1.0/divs;
@@ -27,6 +27,7 @@ void FMMMotionPlanner::Init(const Config& a,const Config& b)
   start = a;
   goal = b;
   distances.clear();
+  sparseDistances.Clear();
   solution.edges.clear();
 
   if(dynamicDomain) {
@@ -84,6 +85,24 @@ bool FreeUpper(const ArrayND<Real>& distances,int axis)
   return false;
 }
 
+//determines which sides of the domain are reached by free cells
+void FreeBoundaries(const SparseFMMGrid& distances,vector<bool>& lower,vector<bool>& upper)
+{
+  lower.resize(distances.dims.size());
+  upper.resize(distances.dims.size());
+  fill(lower.begin(),lower.end(),false);
+  fill(upper.begin(),upper.end(),false);
+  vector<int> index;
+  for(size_t k=0;k<distances.keys.size();k++) {
+    if(IsInf(distances.values[k])) continue;
+    distances.KeyToIndex(distances.keys[k],index);
+    for(size_t i=0;i<index.size();i++) {
+      if(index[i] == 0) lower[i] = true;
+      if(index[i] == distances.dims[i]-1) upper[i] = true;
+    }
+  }
+}
+
 Vector FMMMotionPlanner::ToGrid(const Vector& q) const
 {
   Vector res = q-bmin;
@@ -138,7 +157,45 @@ bool FMMMotionPlanner::SolveFMM()
     return false;
   }
   vector<Vector> pts = GradientDescent(distances,ToGrid(goal));
-  reverse(pts.begin(),pts.end());
+  return UpdateSolution(pts);
+}
+
+bool FMMMotionPlanner::SolveSparseFMM(Real bound)
+{
+  Assert(start.n == goal.n);
+  Assert(start.n == bmin.n);
+  Assert(start.n == bmax.n);
+  Assert(start.n == resolution.n);
+
+  if(dynamicDomain && sparseDistances.NumCells() > 0) {
+    //if there are any free cells along an edge then that edge should be expanded
+    vector<bool> lower,upper;
+    FreeBoundaries(sparseDistances,lower,upper);
+    for(size_t i=0;i<lower.size();i++) {
+      Real w=(bmax[i]-bmin[i]);
+      if(lower[i]) {
+	bmin[i] -= w*0.25;
+	printf("Decreasing bottom domain %d by %g\n",(int)i,w*0.25);
+      }
+      if(upper[i]) {
+	bmax[i] += w*0.25;
+	printf("Increasing top domain %d by %g\n",(int)i,w*0.25);
+      }
+    }
+  }
+
+  currentFMMSpace = space;
+  if(!SparseFMMSearch(start,goal,bmin,bmax,resolution,FMMCost,sparseDistances,bound)) {
+    printf("Sparse FMM search failed\n");
+    return false;
+  }
+  vector<Vector> pts = GradientDescent(sparseDistances,ToGrid(goal));
+  return UpdateSolution(pts);
+}
+
+bool FMMMotionPlanner::UpdateSolution(const vector<Vector>& gridPath)
+{
+  vector<Vector> pts(gridPath.rbegin(),gridPath.rend());
   //convert these grid-space coordinates to configuration space coordinates
   for(size_t i=0;i<pts.size();i++) {
     pts[i] = FromGrid(pts[i]);
@@ -181,6 +238,17 @@ bool FMMMotionPlanner::SolveFMM()
   return true;
 }
 
+Real FMMMotionPlanner::GridLength(const MilestonePath& path) const
+{
+  Real len = 0;
+  for(int i=0;i<path.NumEdges();i++) {
+    Vector a = ToGrid(path.GetMilestone(i));
+    Vector b = ToGrid(path.GetMilestone(i+1));
+    len += a.distance(b);
+  }
+  return len;
+}
+
 bool FMMMotionPlanner::SolveAnytime(Real time)
 {
   int d=start.n;
@@ -189,7 +257,10 @@ bool FMMMotionPlanner::SolveAnytime(Real time)
   Timer timer;
   while(timer.ElapsedTime() < time) {
     resolution *= scaleFactor;
-    if(SolveFMM())
+    Real bound = Inf;
+    if(!solution.edges.empty()) //allow a few cells of slack at the endpoints
+      bound = refineFactor*GridLength(solution) + 2*Sqrt(Real(d));
+    if(SolveSparseFMM(bound))
       hasSolution = true;
   }
   return hasSolution;
@@ -17,10 +17,21 @@ class FMMMotionPlanner
   ///returns true if successful.  (Be sure the set the resolution!
   ///The default is very coarse.)
   bool SolveFMM();
-  ///Runs instances of the FMM at increasingly fine resolutions.
+  ///Same as SolveFMM, but uses the sparse FMM, which only allocates the
+  ///cells that the front reaches.  If bound is finite, only paths of cost
+  ///less than bound (in grid units) are considered.
+  bool SolveSparseFMM(Real bound=Inf);
+  ///Runs instances of the sparse FMM at increasingly fine resolutions.
+  ///Once a solution is found, finer searches are restricted to the region
+  ///around it that could contain paths at most refineFactor times as long.
   ///Returns true if a new feasible path was successfully found within
   ///the given time cutoff.  Safe to call this multiple times.
   bool SolveAnytime(Real time);
+  ///Helper: checks the path given by the grid points and saves it as the
+  ///solution if it is feasible and better than the current one
+  bool UpdateSolution(const vector<Vector>& gridPath);
+  ///Returns the length of the path in grid units at the current resolution
+  Real GridLength(const MilestonePath& path) const;
 
   Vector ToGrid(const Vector& q) const;
   Vector FromGrid(const Vector& q) const;
@@ -30,8 +41,11 @@ class FMMMotionPlanner
   Vector bmin,bmax;
   bool dynamicDomain;
   Vector resolution;
+  ///For SolveAnytime, the slack on the refinement region (default 1.25)
+  Real refineFactor;
   Config start,goal;
   ArrayND<Real> distances;
+  SparseFMMGrid sparseDistances;
   MilestonePath solution;
   //debug: a path that failed the secondary feasibility check
   MilestonePath failedCheck;
@@ -32,6 +32,7 @@ bool Geometric2DObstacleFreeSet::Contains(const Config& x)
   else {
     T.t.set(x[0],x[1]);
     T.R.setRotate(x[2]);
+    trobot.Transform(T);
   }
   return !trobot.Collides(obstacle);
 }
@@ -675,7 +676,7 @@ EdgePlanner* Geometric2DCSpace::PathChecker(const Config& a,const Config& b,int
   Segment2D s;
   s.a.set(a(0),a(1));
   s.b.set(b(0),b(1));
-  if(Geometric2DCollection::Collides(s,constraint-1))
+  if(Geometric2DCollection::Collides(s,constraint-2))
     return new FalseEdgeChecker(this,a,b);
   else
     return new TrueEdgeChecker(this,a,b);
@@ -141,6 +141,13 @@ bool Grid2DCSpace::IsFeasible(const Config& x)
   return !occupied(i,j);
 }
 
+EdgePlanner* Grid2DCSpace::PathChecker(const Config& a,const Config& b)
+{
+  Real res = Min((domain.bmax.x-domain.bmin.x)/Real(occupied.m),
+		 (domain.bmax.y-domain.bmin.y)/Real(occupied.n));
+  return new EpsilonEdgeChecker(this,a,b,res);
+}
+
 EdgePlanner* Grid2DCSpace::PathChecker(const SmartPointer<Interpolator>& path)
 {
   Real res = Min((domain.bmax.x-domain.bmin.x)/Real(occupied.m),
@@ -0,0 +1,381 @@
+#ifndef AI_INCREMENTAL_ASTAR_H
+#define AI_INCREMENTAL_ASTAR_H
+
+#include <vector>
+#include <map>
+#include <KrisLibrary/utils/stl_tr1.h>
+#include <KrisLibrary/errors.h>
+#include <KrisLibrary/math/infnan.h>
+#include <KrisLibrary/structs/IndexedPriorityQueue.h>
+
+namespace AI {
+
+/** @brief An incremental version of GeneralizedAStar, implementing the
+ * D* Lite algorithm (Koenig and Likhachev, 2002).
+ *
+ * After a search, the costs of edges may change and the start may move,
+ * and the next search repairs the previous one rather than starting over.
+ * Only the states whose cost-to-goal is affected by the change are
+ * re-expanded.  With a fixed start this is equivalent to LPA* run from the
+ * goal.
+ *
+ * The search proceeds backward from the goal, so the user must subclass this
+ * and overload both Successors() and Predecessors().  On undirected graphs
+ * the default Predecessors() (which calls Successors()) is sufficient.  The
+ * heuristic Heuristic(a,b) estimates the cost from a to b and must be
+ * consistent.
+ *
+ * States are stored in a flat table of Nodes and referred to by index.  To
+ * look up the index of a state, the user must implement ClearNodeIndex(),
+ * SetNodeIndex(), and NodeIndex().  The convenience classes
+ * IncrementalAStarWithMap and IncrementalAStarWithHashMap provide simple
+ * implementations.
+ *
+ * To run the search, call SetStartAndGoal() and then Search().  When the
+ * cost of edge u->v changes, first change the costs returned by
+ * Successors() and Predecessors(), and then call UpdateEdgeCost(u,v), or
+ * UpdateState(s) if all edges entering or leaving s have changed.  When the
+ * agent moves, call MoveStart().  Then call Search() again.  UpdateState
+ * finds the edges into s by calling Predecessors(), so edges that become
+ * untraversable should be given cost infinity rather than being omitted.
+ *
+ * The cost C class is required to implement the same operations as for
+ * GeneralizedAStar.  Additionally, the member infinity must be set to a value
+ * greater than any path cost.
+ */
+template <class S,class C>
+struct IncrementalAStar
+{
+  //a node in the state table
+  struct Node
+  {
+    ///state data
+    S data;
+    ///cost to goal as of the last expansion
+    C g;
+    ///one-step lookahead cost to goal
+    C rhs;
+  };
+  typedef std::pair<C,C> Key;
+
+  IncrementalAStar();
+  virtual ~IncrementalAStar() {}
+  /// Resets the search with the given start and goal states
+  void SetStartAndGoal(const S& start,const S& goal);
+  /// Moves the start state, keeping the results of the previous searches
+  void MoveStart(const S& start);
+  /// Must be called after the cost of the edge u->v changes
+  void UpdateEdgeCost(const S& u,const S& v);
+  /// Must be called after the costs of all edges into and out of s change
+  void UpdateState(const S& s);
+  /// Repairs the search.  Returns true if the start can reach the goal.
+  bool Search();
+  /// Returns the number of states in the table
+  inline int NumNodes() const { return (int)nodes.size(); }
+  /// Returns the number of expansions over all searches
+  inline int NumExpanded() const { return numExpanded; }
+  /// Returns the number of expansions in the last call to Search()
+  inline int NumLastExpanded() const { return numLastExpanded; }
+
+  /// Returns true if the last search reached the goal
+  inline bool GoalFound() const { return !path.empty(); }
+  /// Returns cost from the start to the goal
+  C GoalCost() const;
+  /// Returns the cost from s to the goal, or infinity if unknown
+  C CostToGoal(const S& s);
+  /// Returns path of states to the goal
+  inline const std::vector<S>& GoalPath() const { return path; }
+
+  ///The following must be overloaded by the subclass.  costs[i] is the
+  ///cost of the edge s->successors[i]
+  virtual void Successors(const S& s,std::vector<S>& successors,std::vector<C>& costs) =0;
+  ///costs[i] is the cost of the edge predecessors[i]->s.  By default,
+  ///assumes an undirected graph and calls Successors.
+  virtual void Predecessors(const S& s,std::vector<S>& predecessors,std::vector<C>& costs) { Successors(s,predecessors,costs); }
+  virtual C Heuristic(const S& a,const S& b) { return zero; }
+  ///These must be overloaded to map states to indices in the table
+  virtual void ClearNodeIndex() =0;
+  virtual void SetNodeIndex(const S& s,int index) =0;
+  ///Returns -1 if s is not in the table
+  virtual int NodeIndex(const S& s) =0;
+
+  ///Helpers
+  int GetNode(const S& s);
+  Key CalculateKey(int n);
+  void UpdateQueue(int n);
+  C Lookahead(int n);
+  void ExtractPath();
+
+  /// The zero element of type C.  By default this is uninitialized!  Be
+  /// careful if you are using plain old data types (int, float, double)
+  C zero;
+  /// A value of type C greater than all path costs.  Also uninitialized.
+  C infinity;
+
+  ///The state table
+  std::vector<Node> nodes;
+  int start,goal;
+  ///The accumulated heuristic offset due to start motion
+  C km;
+  ///The queue of inconsistent nodes
+  std::IndexedPriorityQueue<int,Key> queue;
+  ///Temporary variables -- slightly reduces the number of memory allocations
+  std::vector<S> neighbors,neighbors2;
+  std::vector<C> costs,costs2;
+  int numExpanded,numLastExpanded;
+
+  ///Upon successful termination, path contains the path from start to goal
+  std::vector<S> path;
+};
+
+///Defines standard D* Lite as an IncrementalAStar instance with double-valued
+///costs.
+template <class S>
+struct DStarLite : public IncrementalAStar<S,double>
+{
+  DStarLite() { this->zero = 0.0; this->infinity = Math::dInf; }
+  virtual ~DStarLite() {}
+};
+
+///Convenience class: uses a std::map to index states.  Requires
+///S to be a mappable type (e.g., implement ==, <, copy constructor).
+template <class S,class C>
+class IncrementalAStarWithMap : public IncrementalAStar<S,C>
+{
+ public:
+  std::map<S,int> index;
+  virtual ~IncrementalAStarWithMap() {}
+  virtual void ClearNodeIndex() { index.clear(); }
+  virtual void SetNodeIndex(const S& s,int n) { index[s]=n; }
+  virtual int NodeIndex(const S& s) {
+    typename std::map<S,int>::const_iterator i=index.find(s);
+    if(i==index.end()) return -1;
+    return i->second;
+  }
+};
+
+///Convenience class: uses a std::unordered_map to index states.
+///Requires S to be a hashable type.
+template <class S,class C>
+class IncrementalAStarWithHashMap : public IncrementalAStar<S,C>
+{
+ public:
+  UNORDERED_MAP_TEMPLATE<S,int> index;
+  virtual ~IncrementalAStarWithHashMap() {}
+  virtual void ClearNodeIndex() { index.clear(); }
+  virtual void SetNodeIndex(const S& s,int n) { index[s]=n; }
+  virtual int NodeIndex(const S& s) {
+    typename UNORDERED_MAP_TEMPLATE<S,int>::const_iterator i=index.find(s);
+    if(i==index.end()) return -1;
+    return i->second;
+  }
+};
+
+
+template <class S,class C>
+IncrementalAStar<S,C>::IncrementalAStar()
+  :start(-1),goal(-1),numExpanded(0),numLastExpanded(0)
+{
+}
+
+template <class S,class C>
+void IncrementalAStar<S,C>::SetStartAndGoal(const S& _start,const S& _goal)
+{
+  ClearNodeIndex();
+  nodes.resize(0);
+  queue.clear();
+  path.resize(0);
+  numExpanded = numLastExpanded = 0;
+  km = zero;
+  start = GetNode(_start);
+  goal = GetNode(_goal);
+  nodes[goal].rhs = zero;
+  queue.insert(goal,CalculateKey(goal));
+}
+
+template <class S,class C>
+void IncrementalAStar<S,C>::MoveStart(const S& s)
+{
+  Assert(goal >= 0);
+  //rather than recomputing the keys in the queue, offset all new keys
+  km = km + Heuristic(nodes[start].data,s);
+  start = GetNode(s);
+}
+
+template <class S,class C>
+void IncrementalAStar<S,C>::UpdateEdgeCost(const S& u,const S& v)
+{
+  Assert(goal >= 0);
+  int n = NodeIndex(u);
+  //nodes not yet in the table have g=rhs=infinity, which doesn't change
+  if(n < 0 || n == goal) return;
+  nodes[n].rhs = Lookahead(n);
+  UpdateQueue(n);
+}
+
+template <class S,class C>
+void IncrementalAStar<S,C>::UpdateState(const S& s)
+{
+  Assert(goal >= 0);
+  std::vector<S> preds;
+  std::vector<C> predCosts;
+  Predecessors(s,preds,predCosts);
+  for(size_t i=0;i<preds.size();i++)
+    UpdateEdgeCost(preds[i],s);
+  UpdateEdgeCost(s,s);
+}
+
+template <class S,class C>
+bool IncrementalAStar<S,C>::Search()
+{
+  Assert(goal >= 0);
+  numLastExpanded = 0;
+  while(!queue.empty()) {
+    if(!(queue.top().first < CalculateKey(start)) && !(nodes[start].g < nodes[start].rhs) && !(nodes[start].rhs < nodes[start].g))
+      break;
+    int n = queue.top().second;
+    Key kold = queue.top().first;
+    Key knew = CalculateKey(n);
+    if(kold < knew) {
+      queue.refresh(n,knew);
+      continue;
+    }
+    numLastExpanded++;
+    queue.pop();
+    neighbors.resize(0);
+    costs.resize(0);
+    Predecessors(nodes[n].data,neighbors,costs);
+    Assert(neighbors.size()==costs.size());
+    if(nodes[n].rhs < nodes[n].g) {
+      //overconsistent: the cost to goal decreased
+      nodes[n].g = nodes[n].rhs;
+      for(size_t i=0;i<neighbors.size();i++) {
+        int p = GetNode(neighbors[i]);
+        if(p == goal) continue;
+        C c = costs[i] + nodes[n].g;
+        if(c < nodes[p].rhs) {
+          nodes[p].rhs = c;
+          UpdateQueue(p);
+        }
+      }
+    }
+    else {
+      //underconsistent: the cost to goal increased
+      C gold = nodes[n].g;
+      nodes[n].g = infinity;
+      for(size_t i=0;i<neighbors.size();i++) {
+        int p = NodeIndex(neighbors[i]);
+        if(p < 0 || p == goal) continue;
+        if(!(nodes[p].rhs < costs[i] + gold) && !(costs[i] + gold < nodes[p].rhs)) {
+          nodes[p].rhs = Lookahead(p);
+          UpdateQueue(p);
+        }
+      }
+      if(n != goal) nodes[n].rhs = Lookahead(n);
+      UpdateQueue(n);
+    }
+  }
+  numExpanded += numLastExpanded;
+  ExtractPath();
+  return GoalFound();
+}
+
+template <class S,class C>
+C IncrementalAStar<S,C>::GoalCost() const
+{
+  if(start < 0) return infinity;
+  return nodes[start].g;
+}
+
+template <class S,class C>
+C IncrementalAStar<S,C>::CostToGoal(const S& s)
+{
+  int n = NodeIndex(s);
+  if(n < 0) return infinity;
+  return nodes[n].g;
+}
+
+template <class S,class C>
+int IncrementalAStar<S,C>::GetNode(const S& s)
+{
+  int n = NodeIndex(s);
+  if(n >= 0) return n;
+  n = (int)nodes.size();
+  nodes.resize(nodes.size()+1);
+  nodes[n].data = s;
+  nodes[n].g = infinity;
+  nodes[n].rhs = infinity;
+  SetNodeIndex(s,n);
+  return n;
+}
+
+template <class S,class C>
+typename IncrementalAStar<S,C>::Key IncrementalAStar<S,C>::CalculateKey(int n)
+{
+  const Node& node = nodes[n];
+  const C& m = (node.rhs < node.g ? node.rhs : node.g);
+  if(!(m < infinity)) return Key(infinity,infinity);
+  return Key(m + Heuristic(nodes[start].data,node.data) + km,m);
+}
+
+template <class S,class C>
+void IncrementalAStar<S,C>::UpdateQueue(int n)
+{
+  const Node& node = nodes[n];
+  if(node.g < node.rhs || node.rhs < node.g)
+    queue.refresh(n,CalculateKey(n));
+  else {
+    typename std::IndexedPriorityQueue<int,Key>::iterator i=queue.find(n);
+    if(i != queue.end()) queue.erase(i);
+  }
+}
+
+template <class S,class C>
+C IncrementalAStar<S,C>::Lookahead(int n)
+{
+  neighbors2.resize(0);
+  costs2.resize(0);
+  Successors(nodes[n].data,neighbors2,costs2);
+  Assert(neighbors2.size()==costs2.size());
+  C best = infinity;
+  for(size_t i=0;i<neighbors2.size();i++) {
+    int s = NodeIndex(neighbors2[i]);
+    if(s < 0 || !(nodes[s].g < infinity)) continue;
+    C c = costs2[i] + nodes[s].g;
+    if(c < best) best = c;
+  }
+  return best;
+}
+
+template <class S,class C>
+void IncrementalAStar<S,C>::ExtractPath()
+{
+  path.resize(0);
+  if(!(nodes[start].g < infinity)) return;
+  int n = start;
+  path.push_back(nodes[n].data);
+  while(n != goal) {
+    neighbors.resize(0);
+    costs.resize(0);
+    Successors(nodes[n].data,neighbors,costs);
+    int next = -1;
+    C best = infinity;
+    for(size_t i=0;i<neighbors.size();i++) {
+      int s = NodeIndex(neighbors[i]);
+      if(s < 0 || !(nodes[s].g < infinity)) continue;
+      C c = costs[i] + nodes[s].g;
+      if(c < best) { best = c; next = s; }
+    }
+    if(next < 0 || path.size() > nodes.size()) {
+      //shouldn't happen if the search is consistent
+      path.resize(0);
+      return;
+    }
+    n = next;
+    path.push_back(nodes[n].data);
+  }
+}
+
+} //namespace AI
+
+#endif
@@ -0,0 +1,266 @@
+#include "InstrumentedCSpace.h"
+#include <Timer.h>
+#include <errors.h>
+#include <stdio.h>
+using namespace std;
+
+double InstrumentationCounter::Time() const
+{
+  return double(cycles)/CycleCounterFrequency();
+}
+
+CSpaceInstrumentation::CSpaceInstrumentation()
+{}
+
+void CSpaceInstrumentation::Reset()
+{
+  feasible.Reset();
+  visible.Reset();
+  distance.Reset();
+  interpolate.Reset();
+  sample.Reset();
+  pointLocation.Reset();
+  for(size_t i=0;i<constraintFeasible.size();i++) {
+    constraintFeasible[i].Reset();
+    constraintVisible[i].Reset();
+    constraintInfeasible[i] = 0;
+  }
+}
+
+void CSpaceInstrumentation::ResizeConstraints(int n)
+{
+  int nold = (int)constraintNames.size();
+  constraintNames.resize(n);
+  for(int i=nold;i<n;i++) {
+    if(constraintNames[i].empty()) {
+      char buf[32];
+      sprintf(buf,"%d",i);
+      constraintNames[i] = buf;
+    }
+  }
+  constraintFeasible.resize(n);
+  constraintVisible.resize(n);
+  constraintInfeasible.resize(n,0);
+}
+
+void CSpaceInstrumentation::GetStats(PropertyMap& stats) const
+{
+  stats.set("numFeasibleChecks",feasible.count);
+  stats.set("feasibleTime",feasible.Time());
+  stats.set("numVisibleChecks",visible.count);
+  stats.set("visibleTime",visible.Time());
+  stats.set("numDistanceCalls",distance.count);
+  stats.set("distanceTime",distance.Time());
+  stats.set("numInterpolateCalls",interpolate.count);
+  stats.set("interpolateTime",interpolate.Time());
+  stats.set("numSampleCalls",sample.count);
+  stats.set("sampleTime",sample.Time());
+  stats.set("numPointLocationQueries",pointLocation.count);
+  stats.set("pointLocationTime",pointLocation.Time());
+  for(size_t i=0;i<constraintFeasible.size();i++) {
+    string suffix = "[" + constraintNames[i] + "]";
+    if(constraintFeasible[i].count > 0) {
+      stats.set("numFeasibleChecks"+suffix,constraintFeasible[i].count);
+      stats.set("feasibleTime"+suffix,constraintFeasible[i].Time());
+      stats.set("numInfeasible"+suffix,constraintInfeasible[i]);
+    }
+    if(constraintVisible[i].count > 0) {
+      stats.set("numVisibleChecks"+suffix,constraintVisible[i].count);
+      stats.set("visibleTime"+suffix,constraintVisible[i].Time());
+    }
+  }
+}
+
+
+InstrumentedCSpace::InstrumentedCSpace(CSpace* baseSpace)
+  :PiggybackCSpace(baseSpace),enabled(true),perConstraint(true),stats(new CSpaceInstrumentation)
+{
+  Assert(baseSpace != NULL);
+  int n = baseSpace->NumConstraints();
+  stats->constraintNames.resize(n);
+  for(int i=0;i<n;i++)
+    stats->constraintNames[i] = baseSpace->ConstraintName(i);
+  stats->ResizeConstraints(n);
+}
+
+void InstrumentedCSpace::Sample(Config& x)
+{
+  if(!enabled) {
+    baseSpace->Sample(x);
+    return;
+  }
+  unsigned long long t0 = ReadCycleCounter();
+  baseSpace->Sample(x);
+  stats->sample.Add(ReadCycleCounter()-t0);
+}
+
+EdgePlanner* InstrumentedCSpace::LocalPlanner(const Config& a,const Config& b)
+{
+  EdgePlanner* e = baseSpace->LocalPlanner(a,b);
+  if(!enabled || e == NULL) return e;
+  return new InstrumentedEdgePlanner(e,stats);
+}
+
+EdgePlanner* InstrumentedCSpace::PathChecker(const Config& a,const Config& b)
+{
+  EdgePlanner* e = baseSpace->PathChecker(a,b);
+  if(!enabled || e == NULL) return e;
+  return new InstrumentedEdgePlanner(e,stats);
+}
+
+EdgePlanner* InstrumentedCSpace::PathChecker(const Config& a,const Config& b,int constraint)
+{
+  EdgePlanner* e = baseSpace->PathChecker(a,b,constraint);
+  if(!enabled || e == NULL) return e;
+  return new InstrumentedEdgePlanner(e,stats,constraint);
+}
+
+bool InstrumentedCSpace::IsFeasible(const Config& x)
+{
+  if(!enabled) return baseSpace->IsFeasible(x);
+  unsigned long long t0 = ReadCycleCounter();
+  if(!perConstraint || baseSpace->constraints.empty()) {
+    bool res = baseSpace->IsFeasible(x);
+    stats->feasible.Add(ReadCycleCounter()-t0);
+    return res;
+  }
+  //check the constraints one by one, stopping at the first violation
+  bool res = true;
+  unsigned long long tprev = t0;
+  stats->CheckConstraint((int)baseSpace->constraints.size()-1);
+  for(size_t i=0;i<baseSpace->constraints.size();i++) {
+    bool ok = baseSpace->IsFeasible(x,(int)i);
+    unsigned long long t = ReadCycleCounter();
+    stats->constraintFeasible[i].Add(t-tprev);
+    tprev = t;
+    if(!ok) {
+      AtomicAdd(&stats->constraintInfeasible[i],1);
+      res = false;
+      break;
+    }
+  }
+  stats->feasible.Add(tprev-t0);
+  return res;
+}
+
+bool InstrumentedCSpace::IsFeasible(const Config& x,int constraint)
+{
+  if(!enabled) return baseSpace->IsFeasible(x,constraint);
+  stats->CheckConstraint(constraint);
+  unsigned long long t0 = ReadCycleCounter();
+  bool res = baseSpace->IsFeasible(x,constraint);
+  stats->constraintFeasible[constraint].Add(ReadCycleCounter()-t0);
+  if(!res) AtomicAdd(&stats->constraintInfeasible[constraint],1);
+  return res;
+}
+
+Real InstrumentedCSpace::Distance(const Config& x, const Config& y)
+{
+  if(!enabled) return baseSpace->Distance(x,y);
+  unsigned long long t0 = ReadCycleCounter();
+  Real d = baseSpace->Distance(x,y);
+  stats->distance.Add(ReadCycleCounter()-t0);
+  return d;
+}
+
+void InstrumentedCSpace::Interpolate(const Config& x,const Config& y,Real u,Config& out)
+{
+  if(!enabled) {
+    baseSpace->Interpolate(x,y,u,out);
+    return;
+  }
+  unsigned long long t0 = ReadCycleCounter();
+  baseSpace->Interpolate(x,y,u,out);
+  stats->interpolate.Add(ReadCycleCounter()-t0);
+}
+
+
+InstrumentedEdgePlanner::InstrumentedEdgePlanner(SmartPointer<EdgePlanner> e,const SmartPointer<CSpaceInstrumentation>& _stats,int _constraint)
+  :PiggybackEdgePlanner(e),stats(_stats),constraint(_constraint)
+{
+  if(constraint >= 0) stats->CheckConstraint(constraint);
+}
+
+bool InstrumentedEdgePlanner::IsVisible()
+{
+  unsigned long long t0 = ReadCycleCounter();
+  bool res = e->IsVisible();
+  unsigned long long t = ReadCycleCounter()-t0;
+  if(constraint >= 0) stats->constraintVisible[constraint].Add(t);
+  else stats->visible.Add(t);
+  return res;
+}
+
+EdgePlanner* InstrumentedEdgePlanner::Copy() const
+{
+  return new InstrumentedEdgePlanner(e->Copy(),stats,constraint);
+}
+
+EdgePlanner* InstrumentedEdgePlanner::ReverseCopy() const
+{
+  return new InstrumentedEdgePlanner(e->ReverseCopy(),stats,constraint);
+}
+
+bool InstrumentedEdgePlanner::Plan()
+{
+  unsigned long long t0 = ReadCycleCounter();
+  bool res = e->Plan();
+  unsigned long long t = ReadCycleCounter()-t0;
+  InstrumentationCounter& counter = (constraint >= 0 ? stats->constraintVisible[constraint] : stats->visible);
+  counter.cycles += t;
+  if(e->Done()) counter.count++;
+  return res;
+}
+
+
+InstrumentedPointLocation::InstrumentedPointLocation(const SmartPointer<PointLocationBase>& _base,const SmartPointer<CSpaceInstrumentation>& _stats)
+  :PointLocationBase(_base->points),base(_base),stats(_stats)
+{}
+
+bool InstrumentedPointLocation::NN(const Vector& p,int& nn,Real& distance)
+{
+  unsigned long long t0 = ReadCycleCounter();
+  bool res = base->NN(p,nn,distance);
+  stats->pointLocation.Add(ReadCycleCounter()-t0);
+  return res;
+}
+
+bool InstrumentedPointLocation::KNN(const Vector& p,int k,vector<int>& nn,vector<Real>& distances)
+{
+  unsigned long long t0 = ReadCycleCounter();
+  bool res = base->KNN(p,k,nn,distances);
+  stats->pointLocation.Add(ReadCycleCounter()-t0);
+  return res;
+}
+
+bool InstrumentedPointLocation::Close(const Vector& p,Real r,vector<int>& neighbors,vector<Real>& distances)
+{
+  unsigned long long t0 = ReadCycleCounter();
+  bool res = base->Close(p,r,neighbors,distances);
+  stats->pointLocation.Add(ReadCycleCounter()-t0);
+  return res;
+}
+
+bool InstrumentedPointLocation::FilteredNN(const Vector& p,bool (*filter)(int),int& nn,Real& distance)
+{
+  unsigned long long t0 = ReadCycleCounter();
+  bool res = base->FilteredNN(p,filter,nn,distance);
+  stats->pointLocation.Add(ReadCycleCounter()-t0);
+  return res;
+}
+
+bool InstrumentedPointLocation::FilteredKNN(const Vector& p,int k,bool (*filter)(int),vector<int>& nn,vector<Real>& distances)
+{
+  unsigned long long t0 = ReadCycleCounter();
+  bool res = base->FilteredKNN(p,k,filter,nn,distances);
+  stats->pointLocation.Add(ReadCycleCounter()-t0);
+  return res;
+}
+
+bool InstrumentedPointLocation::FilteredClose(const Vector& p,Real r,bool (*filter)(int),vector<int>& neighbors,vector<Real>& distances)
+{
+  unsigned long long t0 = ReadCycleCounter();
+  bool res = base->FilteredClose(p,r,filter,neighbors,distances);
+  stats->pointLocation.Add(ReadCycleCounter()-t0);
+  return res;
+}
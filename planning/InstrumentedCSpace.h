@@ -0,0 +1,155 @@
+#ifndef INSTRUMENTED_CSPACE_H
+#define INSTRUMENTED_CSPACE_H
+
+#include "CSpaceHelpers.h"
+#include "EdgePlannerHelpers.h"
+#include "PointLocation.h"
+#include <KrisLibrary/utils/PropertyMap.h>
+#include <KrisLibrary/utils/SmartPointer.h>
+#include <KrisLibrary/utils/threadutils.h>
+#include <vector>
+#include <string>
+
+/** @ingroup MotionPlanning
+ * @brief A count of calls and the cycle counter ticks spent in them.
+ *
+ * Add is atomic, so a counter may be updated by several threads at once.
+ * The totals are size_t, so on 32-bit platforms the cycle total wraps after
+ * a few seconds of instrumented calls.
+ */
+struct InstrumentationCounter
+{
+  InstrumentationCounter() : count(0),cycles(0) {}
+  inline void Add(unsigned long long c) { AtomicAdd(&count,1); AtomicAdd(&cycles,(size_t)c); }
+  void Reset() { count = 0; cycles = 0; }
+  ///Returns the total time in seconds
+  double Time() const;
+
+  size_t count;
+  size_t cycles;
+};
+
+/** @ingroup MotionPlanning
+ * @brief The counters of an InstrumentedCSpace, shared with the edge
+ * planners and point locators that it creates.
+ *
+ * GetStats writes, for each kind of call, the number of calls
+ * ("numFeasibleChecks", "numVisibleChecks", "numDistanceCalls",
+ * "numInterpolateCalls", "numSampleCalls", "numPointLocationQueries")
+ * and the time spent in them ("feasibleTime", "visibleTime", etc.).
+ * Per-constraint counts and times are written with the constraint name in
+ * brackets, e.g., "numFeasibleChecks[obstacle]", "feasibleTime[obstacle]",
+ * "numInfeasible[obstacle]", and "visibleTime[obstacle]".
+ */
+class CSpaceInstrumentation
+{
+ public:
+  CSpaceInstrumentation();
+  void Reset();
+  void GetStats(PropertyMap& stats) const;
+  ///Makes sure there are counters for constraint i
+  inline void CheckConstraint(int i) {
+    if(i >= (int)constraintFeasible.size()) ResizeConstraints(i+1);
+  }
+  void ResizeConstraints(int n);
+
+  InstrumentationCounter feasible,visible,distance,interpolate,sample,pointLocation;
+  std::vector<std::string> constraintNames;
+  std::vector<InstrumentationCounter> constraintFeasible,constraintVisible;
+  std::vector<size_t> constraintInfeasible;
+};
+
+/** @ingroup MotionPlanning
+ * @brief A CSpace decorator that counts and times the calls a planner makes
+ * to IsFeasible, Distance, Interpolate and Sample, and to the IsVisible
+ * and Plan methods of the edge planners it returns.
+ *
+ * Timing uses the cycle counter from Timer.h, which costs a few tens of
+ * cycles per call.  Setting enabled to false turns the counters off, leaving
+ * only a branch per call.
+ *
+ * If perConstraint is true and the base space lists its constraints in
+ * CSpace::constraints, IsFeasible(x) checks the constraints one at a time
+ * (which is what CSpace::IsFeasible does) to time each one.  Spaces that
+ * override IsFeasible(x) with a different test should set perConstraint to
+ * false.
+ *
+ * The counters are updated atomically, so an instrumented space may be
+ * shared by several threads (e.g., by MilestonePath::ParallelShortcut) as
+ * long as the base space is thread-safe and the per-constraint counters are
+ * already sized, which the constructor does for the base space's
+ * constraints.  Reset and GetStats should only be called while no other
+ * thread uses the space.  Edge planners keep a reference to the counters
+ * and report the base space from Space(), so paths remain valid after this
+ * space is deleted.
+ */
+class InstrumentedCSpace : public PiggybackCSpace
+{
+ public:
+  InstrumentedCSpace(CSpace* baseSpace);
+  virtual ~InstrumentedCSpace() {}
+  void Reset() { stats->Reset(); }
+  void GetStats(PropertyMap& map) const { stats->GetStats(map); }
+
+  virtual void Sample(Config& x);
+  virtual EdgePlanner* LocalPlanner(const Config& a,const Config& b);
+  virtual EdgePlanner* PathChecker(const Config& a,const Config& b);
+  virtual EdgePlanner* PathChecker(const Config& a,const Config& b,int constraint);
+  virtual bool IsFeasible(const Config& x);
+  virtual bool IsFeasible(const Config& x,int constraint);
+  virtual Real Distance(const Config& x, const Config& y);
+  virtual void Interpolate(const Config& x,const Config& y,Real u,Config& out);
+
+  bool enabled;
+  bool perConstraint;
+  SmartPointer<CSpaceInstrumentation> stats;
+};
+
+/** @ingroup MotionPlanning
+ * @brief Counts and times the IsVisible and Plan calls of another edge
+ * planner.
+ *
+ * If constraint >= 0, the calls are counted toward that constraint, and
+ * otherwise toward the whole space.  Incremental checks are counted once,
+ * when they are done.
+ */
+class InstrumentedEdgePlanner : public PiggybackEdgePlanner
+{
+ public:
+  InstrumentedEdgePlanner(SmartPointer<EdgePlanner> e,const SmartPointer<CSpaceInstrumentation>& stats,int constraint=-1);
+  virtual ~InstrumentedEdgePlanner() {}
+  virtual bool IsVisible();
+  virtual EdgePlanner* Copy() const;
+  virtual EdgePlanner* ReverseCopy() const;
+  virtual bool Plan();
+
+  SmartPointer<CSpaceInstrumentation> stats;
+  int constraint;
+};
+
+/** @ingroup MotionPlanning
+ * @brief Counts and times the queries made to another point location data
+ * structure.
+ */
+class InstrumentedPointLocation : public PointLocationBase
+{
+ public:
+  InstrumentedPointLocation(const SmartPointer<PointLocationBase>& base,const SmartPointer<CSpaceInstrumentation>& stats);
+  virtual ~InstrumentedPointLocation() {}
+  virtual void OnBuild() { base->OnBuild(); }
+  virtual void OnAppend() { base->OnAppend(); }
+  virtual bool OnDelete(int id) { return base->OnDelete(id); }
+  virtual bool OnClear() { return base->OnClear(); }
+  virtual bool Exact() { return base->Exact(); }
+  virtual bool NN(const Vector& p,int& nn,Real& distance);
+  virtual bool KNN(const Vector& p,int k,std::vector<int>& nn,std::vector<Real>& distances);
+  virtual bool Close(const Vector& p,Real r,std::vector<int>& neighbors,std::vector<Real>& distances);
+  virtual bool FilteredNN(const Vector& p,bool (*filter)(int),int& nn,Real& distance);
+  virtual bool FilteredKNN(const Vector& p,int k,bool (*filter)(int),std::vector<int>& nn,std::vector<Real>& distances);
+  virtual bool FilteredClose(const Vector& p,Real r,bool (*filter)(int),std::vector<int>& neighbors,std::vector<Real>& distances);
+
+  SmartPointer<PointLocationBase> base;
+  SmartPointer<CSpaceInstrumentation> stats;
+};
+
+#endif
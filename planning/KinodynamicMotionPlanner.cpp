@@ -30,7 +30,7 @@ struct VectorizeCallback : public Node::Callback
 
 
 KinodynamicTree::KinodynamicTree(KinodynamicSpace* s)
-  :space(s),root(NULL)
+  :space(s),root(NULL),numDeletedPoints(0),numBuiltPoints(0),stateBlockSize(1024)
 {
 }
 
@@ -44,12 +44,8 @@ void KinodynamicTree::Init(const State& initialState)
   Clear();
   root = new Node(initialState);
 
-  if(pointLocation) {
-    index.push_back(root);
-    pointRefs.resize(pointRefs.size()+1);
-    pointRefs.back().setRef(*root);
-    pointLocation->OnAppend();
-  }
+  if(pointLocation) 
+    AddPoint(root);
 }
 
 void KinodynamicTree::EnablePointLocation(const char* type)
@@ -76,18 +72,7 @@ void KinodynamicTree::EnablePointLocation(const char* type)
   else
     FatalError("Invalid point location method %s\n",type);
   //rebuild point location data structures
-  printf("Rebuilding point location data structures\n");
-  VectorizeCallback callback;
-  if(root) root->DFS(callback);
-  index = callback.nodes;
-  pointRefs.clear();
-  pointRefs.reserve(index.size());
-  pointLocation->OnClear();
-  for(size_t i=0;i<index.size();i++) {
-    pointRefs.resize(pointRefs.size()+1);
-    pointRefs[i].setRef(*index[i]);
-    pointLocation->OnAppend();
-  }
+  RebuildPointLocation();
 }
 
 void KinodynamicTree::Clear()
@@ -95,10 +80,47 @@ void KinodynamicTree::Clear()
   index.clear();
   SafeDelete(root);
   pointRefs.clear();
+  nodeIndex.clear();
+  stateBlocks.clear();
+  numDeletedPoints = numBuiltPoints = 0;
   if(pointLocation)
     pointLocation->OnClear();
 }
 
+void KinodynamicTree::AddPoint(Node* n,bool append)
+{
+  int id = (int)index.size();
+  int d = n->n;
+  int block = id / stateBlockSize, offset = (id % stateBlockSize)*d;
+  if(block >= (int)stateBlocks.size()) 
+    stateBlocks.push_back(new vector<Real>(stateBlockSize*d));
+  Real* x = &(*stateBlocks[block])[offset];
+  for(int i=0;i<d;i++) x[i] = (*n)(i);
+
+  if(pointRefs.size() == pointRefs.capacity()) {
+    //grow by hand -- copying the references would allocate new vectors
+    vector<Vector> newRefs;
+    newRefs.reserve(Max(pointRefs.size()*2,(size_t)16));
+    newRefs.resize(pointRefs.size());
+    for(size_t i=0;i<pointRefs.size();i++)
+      newRefs[i].setRef(pointRefs[i]);
+    pointRefs.swap(newRefs);
+  }
+  pointRefs.resize(pointRefs.size()+1);
+  pointRefs.back().setRef(x,d,0,1,d);
+  index.push_back(n);
+  nodeIndex[n] = id;
+  if(append) {
+    pointLocation->OnAppend();
+    if((int)index.size() >= 2*Max(numBuiltPoints,64)) {
+      //incremental insertion unbalances the K-D tree as the planner grows
+      //outward, so rebuild it every time the size doubles
+      if(dynamic_cast<KDTreePointLocation*>(&*pointLocation)) RebuildPointLocation();
+      else numBuiltPoints = (int)index.size();
+    }
+  }
+}
+
 
 Node* KinodynamicTree::AddMilestone(Node* parent, const ControlInput& u)
 {
@@ -121,12 +143,8 @@ Node* KinodynamicTree::AddMilestone(Node* parent,const ControlInput& u,const Sma
   }
   c->edgeFromParent().path = KinodynamicMilestonePath(u,path);
   c->edgeFromParent().checker = e;
-  if(pointLocation) {
-    index.push_back(c);
-    pointRefs.resize(pointRefs.size()+1);
-    pointRefs.back().setRef(*c);
-    pointLocation->OnAppend();
-  }
+  if(pointLocation)
+    AddPoint(c);
   return c;
 }
 
@@ -138,12 +156,8 @@ Node* KinodynamicTree::AddMilestone(Node* parent,KinodynamicMilestonePath& path,
   c->edgeFromParent().path = path;
   if(e == NULL) c->edgeFromParent().checker = space->TrajectoryChecker(c->edgeFromParent().path);
   else c->edgeFromParent().checker = e;
-  if(pointLocation) {
-    index.push_back(c);
-    pointRefs.resize(pointRefs.size()+1);
-    pointRefs.back().setRef(*c);
-    pointLocation->OnAppend();
-  }
+  if(pointLocation)
+    AddPoint(c);
   return c;
 }
 
@@ -180,7 +194,13 @@ Node* KinodynamicTree::PickRandom()
     fprintf(stderr,"KinodynamicTree::PickRandom: Warning, point location not enabled, now enabling it\n");
     EnablePointLocation();
   }
-  return index[RandInt(index.size())];
+  if(index.empty()) return NULL;
+  //fewer than half of the entries are deleted, so this takes < 2 tries on average
+  Node* n;
+  do {
+    n = index[RandInt(index.size())];
+  } while(n == NULL);
+  return n;
 }
 
 void KinodynamicTree::GetPath(Node* start,Node* goal,KinodynamicMilestonePath& path)
@@ -204,18 +224,32 @@ void KinodynamicTree::GetPath(Node* start,Node* goal,KinodynamicMilestonePath& p
 void KinodynamicTree::DeleteSubTree(Node* n,bool rebuild)
 {
   //EZCallTrace tr("KinodynamicTree::DeleteSubTree()");
+  KDTreePointLocation* kdtree = NULL;
+  if(pointLocation) kdtree = dynamic_cast<KDTreePointLocation*>(&*pointLocation);
+  if(kdtree) {
+    //remove the subtree's points from the K-D tree, leaving the ids intact
+    VectorizeCallback callback;
+    n->DFS(callback);
+    for(size_t i=0;i<callback.nodes.size();i++) {
+      UNORDERED_MAP_TEMPLATE<Node*,int>::iterator it = nodeIndex.find(callback.nodes[i]);
+      if(it == nodeIndex.end()) continue;
+      kdtree->Remove(it->second);
+      index[it->second] = NULL;
+      nodeIndex.erase(it);
+      numDeletedPoints++;
+    }
+  }
   if(n == root) root = NULL;
   Node* p=n->getParent();
   if(p) p->detachChild(n);
-  Node* c = p->getFirstChild();
-  while(c) {
-    Assert(c != n);
-    c = c->getNextSibling();
-  }
   delete n;  //this automatically deletes n and all children
 
-  if(rebuild && pointLocation) {
-    printf("Rebuilding point location data structure on subtree delete..\n");
+  if(kdtree) {
+    //compact the point list once most of it is deleted
+    if(numDeletedPoints*2 > (int)index.size())
+      RebuildPointLocation();
+  }
+  else if(rebuild && pointLocation) {
     RebuildPointLocation();
   }
 }
@@ -223,25 +257,38 @@ void KinodynamicTree::DeleteSubTree(Node* n,bool rebuild)
 void KinodynamicTree::RebuildPointLocation()
 {
   if(pointLocation) {
-    //TODO: faster deletion, if this is a small subtree
     VectorizeCallback callback;
     if(root) root->DFS(callback);
-    index = callback.nodes;
 
     //rebuild point location data structures
+    index.clear();
     pointRefs.clear();
-    pointRefs.reserve(index.size());
+    nodeIndex.clear();
+    stateBlocks.clear();
+    numDeletedPoints = 0;
+    numBuiltPoints = (int)callback.nodes.size();
     pointLocation->OnClear();
-    for(size_t i=0;i<index.size();i++) {
-      pointRefs.resize(pointRefs.size()+1);
-      pointRefs[i].setRef(*index[i]);
-      pointLocation->OnAppend();
-    }
+    pointRefs.reserve(callback.nodes.size());
+    for(size_t i=0;i<callback.nodes.size();i++)
+      AddPoint(callback.nodes[i],false);
+    pointLocation->OnBuild();
   }
 }
 
 
 
+//true if the state space reports a (possibly weighted) euclidean metric
+static bool IsEuclidean(KinodynamicSpace* space)
+{
+  PropertyMap props;
+  space->Properties(props);
+  int euclidean;
+  string metric;
+  if(props.get("euclidean",euclidean)) return euclidean != 0;
+  if(props.get("metric",metric)) return (metric == "euclidean" || metric == "weighted euclidean");
+  return false;
+}
+
 KinodynamicPlannerBase::KinodynamicPlannerBase(KinodynamicSpace* s)
   :space(s),goalSet(NULL)
 {}
@@ -301,8 +348,8 @@ void RRTKinodynamicPlanner::Init(const State& xinit,CSet* _goalSet)
   goalSet = _goalSet;
   if(goalSet->Contains(xinit)) goalNode = tree.root;
   if(!tree.pointLocation) {
-    //tree.EnablePointLocation("kdtree");
-    tree.EnablePointLocation(NULL);
+    if(IsEuclidean(space)) tree.EnablePointLocation("kdtree");
+    else tree.EnablePointLocation(NULL);
   }
   overheadTime += timer.ElapsedTime();
 }
@@ -370,9 +417,9 @@ Node* RRTKinodynamicPlanner::ExtendToward(const State& xdest)
     numSuccessfulExtensions++;
     visibleTime += timer.ElapsedTime();
     timer.Reset();
-    Node * n = tree.AddMilestone(n,path,e);
+    Node* c = tree.AddMilestone(n,path,e);
     overheadTime += timer.ElapsedTime();
-    return n;
+    return c;
   }
   else {
     //printf("Edge is not visible\n");
@@ -7,6 +7,7 @@
 #include "DensityEstimator.h"
 #include "Objective.h"
 #include <KrisLibrary/graph/Tree.h>
+#include <KrisLibrary/utils/stl_tr1.h>
 #include <queue>
 typedef Vector State;
 typedef Vector ControlInput;
@@ -19,7 +20,11 @@ typedef Vector ControlInput;
  * x2=f(x1,u), the trace from x1->x2, and the edge planner for that trace.
  * This data can be retrieved using x2->getEdgeFromParent().
  *
- * Potential improvement can speed up point location using Kd trees.
+ * With EnablePointLocation("kdtree"), FindClosest uses an incremental K-D
+ * tree with the state space's metric weights, and subtrees are deleted from
+ * it in O(k log N) time.  The states seen by the point location structure
+ * are copied into a block-allocated pool so the K-D tree scans contiguous
+ * memory rather than one heap allocation per node.
  */
 class KinodynamicTree
 {
@@ -43,12 +48,17 @@ public:
   void Reroot(Node* n);
   Node* PickRandom();
   Node* FindClosest(const State& x);
-  ///Deletes n and its subtree.  If point location is not enabled or rebuild=true, cost is O(k)
-  ///where k is the size of the subtree.  Otherwise, cost is O(N) where N is the number of nodes!
-  ///If you plan to make several deletions, delete the subtrees with rebuild=false, then call
-  ///RebuildPointLocation before calling FindClosest() or PickRandom() again.
+  ///Deletes n and its subtree.  If point location is not enabled or rebuild=false, cost is O(k)
+  ///where k is the size of the subtree.  With a K-D tree point location, the cost is
+  ///O(k log N).  Otherwise, the cost is O(N) where N is the number of nodes!
+  ///If you plan to make several deletions with a non-K-D tree point location, delete the
+  ///subtrees with rebuild=false, then call RebuildPointLocation before calling FindClosest()
+  ///or PickRandom() again.
   void DeleteSubTree(Node* n,bool rebuild=true);
   void RebuildPointLocation();
+  ///Helper: adds n to the point location data structure.  If append=false, the
+  ///caller must call pointLocation->OnBuild() afterwards.
+  void AddPoint(Node* n,bool append=true);
 
   static void GetPath(Node* start,Node* goal,KinodynamicMilestonePath& path);
 
@@ -57,8 +67,17 @@ public:
 
   ///If point location is enabled, this will contain a point location data structure
   SmartPointer<PointLocationBase> pointLocation;
+  ///The node for each point in pointRefs.  With a K-D tree, deleted nodes are
+  ///left as NULL until more than half are deleted, and the structure is
+  ///rebuilt (and rebalanced) whenever this happens or the number of points
+  ///doubles.
   std::vector<Node*> index;
   std::vector<Vector> pointRefs;
+  int numDeletedPoints,numBuiltPoints;
+  UNORDERED_MAP_TEMPLATE<Node*,int> nodeIndex;
+  ///Pool of states referenced by pointRefs, in blocks of stateBlockSize states
+  std::vector<SmartPointer<std::vector<Real> > > stateBlocks;
+  int stateBlockSize;
 };
 
 class KinodynamicPlannerBase
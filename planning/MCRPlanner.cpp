@@ -14,11 +14,12 @@ const static double gSubdivideThreshold = 1e-3;
 //on some platforms, timing takes a non-negligible amount of time
 #define DO_TIMING 1
 
-inline Real WeightedCost(const Subset& s,const vector<Real>& weights)
+template <class SubsetType>
+inline Real WeightedCost(const SubsetType& s,const vector<Real>& weights)
 {
+  if(weights.empty()) return Real(s.size());
   Real sum=0.0;
-  //for(set<int>::const_iterator i=s.items.begin();i!=s.items.end();i++) {
-  for(vector<int>::const_iterator i=s.items.begin();i!=s.items.end();i++) {
+  for(typename SubsetType::const_iterator i=s.begin();i!=s.end();i++) {
     sum += weights[*i];
     if(IsInf(sum)) return sum;
   }
@@ -26,15 +27,17 @@ inline Real WeightedCost(const Subset& s,const vector<Real>& weights)
 }
 
 
-Subset Violations(CSpace* space,const Config& q)
+template <class SubsetType>
+SubsetType Violations(CSpace* space,const Config& q)
 {
   vector<bool> vis;
   space->CheckConstraints(q,vis);
   for(size_t i=0;i<vis.size();i++) vis[i] = !vis[i];
-  return Subset(vis);
+  return SubsetType(vis);
 }
 
-Subset Violations(CSpace* space,const Config& a,const Config& b)
+template <class SubsetType>
+SubsetType Violations(CSpace* space,const Config& a,const Config& b)
 {
   vector<bool> vis(space->NumConstraints());
   for(size_t i=0;i<vis.size();i++) {
@@ -42,13 +45,14 @@ Subset Violations(CSpace* space,const Config& a,const Config& b)
     vis[i] = !e->IsVisible();
     delete e;
   }
-  return Subset(vis);
+  return SubsetType(vis);
 }
 
 
 
 
-MCRPlanner::MCRPlanner(CSpace* _space)
+template <class SubsetType>
+MCRPlannerTemplate<SubsetType>::MCRPlannerTemplate(CSpace* _space)
   :space(_space),
    updatePathsComplete(false),updatePathsDynamic(true),updatePathsMax(INT_MAX),
    numExpands(0),numRefinementAttempts(0),numRefinementSuccesses(0),numExplorationAttempts(0),
@@ -65,13 +69,15 @@ MCRPlanner::MCRPlanner(CSpace* _space)
   bidirectional = false;
 }
 
-Real MCRPlanner::Cost(const Subset& s) const
+template <class SubsetType>
+Real MCRPlannerTemplate<SubsetType>::Cost(const SubsetType& s) const
 {
-  if(obstacleWeights.empty()) return Real(s.items.size());
+  if(obstacleWeights.empty()) return Real(s.size());
   return WeightedCost(s,obstacleWeights);
 }
 
-void MCRPlanner::Init(const Config& _start,const Config& _goal)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::Init(const Config& _start,const Config& _goal)
 {
   roadmap.Cleanup();
   modeGraph.Cleanup();
@@ -92,7 +98,8 @@ void MCRPlanner::Init(const Config& _start,const Config& _goal)
   else UpdatePathsGreedy();
 }
 
-void MCRPlanner::UpdateMinCost(Mode& m)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::UpdateMinCost(Mode& m)
 {
   if(m.pathCovers.empty())
     m.minCost = DBL_MAX;
@@ -104,7 +111,8 @@ void MCRPlanner::UpdateMinCost(Mode& m)
   }
 }
 
-void MCRPlanner::UpdatePathsGreedy()
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::UpdatePathsGreedy()
 {
   numUpdatePaths++; 
 
@@ -116,7 +124,7 @@ void MCRPlanner::UpdatePathsGreedy()
 
   int m0=roadmap.nodes[0].mode;
   int mg=roadmap.nodes[1].mode;
-  Subset sgCover = modeGraph.nodes[m0].subset+modeGraph.nodes[mg].subset;;
+  SubsetType sgCover = modeGraph.nodes[m0].subset+modeGraph.nodes[mg].subset;;
   modeGraph.nodes[m0].pathCovers.resize(1);
   modeGraph.nodes[m0].pathCovers[0] = sgCover;
   Real c0=Cost(sgCover);
@@ -137,7 +145,7 @@ void MCRPlanner::UpdatePathsGreedy()
     for(modeGraph.Begin(m,e);!e.end();e++) {
       //compute propagated cost
       Mode& modet=modeGraph.nodes[e.target()];
-      Subset s = modet.subset+modeGraph.nodes[m].pathCovers[0];
+      SubsetType s = modet.subset+modeGraph.nodes[m].pathCovers[0];
       Real cs=Cost(s);
       if(modet.minCost <= cs)
 	continue;
@@ -160,7 +168,8 @@ void MCRPlanner::UpdatePathsGreedy()
   */
 }
 
-void MCRPlanner::UpdatePathsGreedy2(int nstart)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::UpdatePathsGreedy2(int nstart)
 {
   numUpdatePaths++; 
 
@@ -169,7 +178,7 @@ void MCRPlanner::UpdatePathsGreedy2(int nstart)
   int mg=roadmap.nodes[1].mode;
   if(nstart <= 0) {
     int m0=roadmap.nodes[0].mode;
-    Subset sgCover = modeGraph.nodes[m0].subset+modeGraph.nodes[mg].subset;
+    SubsetType sgCover = modeGraph.nodes[m0].subset+modeGraph.nodes[mg].subset;
     modeGraph.nodes[m0].pathCovers.resize(1);
     modeGraph.nodes[m0].pathCovers[0] = sgCover;
     Real c0=Cost(sgCover);
@@ -182,11 +191,11 @@ void MCRPlanner::UpdatePathsGreedy2(int nstart)
     assert(!mode0.pathCovers.empty());
 
     //start looking for better paths into nstart
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(m0,e);!e.end();e++) {
       Mode& modet = modeGraph.nodes[e.target()];
       if(modet.minCost >= mode0.minCost) continue;
-      Subset s = mode0.subset+modet.pathCovers[0];
+      SubsetType s = mode0.subset+modet.pathCovers[0];
       Real cs=Cost(s);
       if(cs < mode0.minCost) {
 	mode0.pathCovers[0] = s;
@@ -204,11 +213,11 @@ void MCRPlanner::UpdatePathsGreedy2(int nstart)
     //reached goal
     if(m == mg) break;
 
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(m,e);!e.end();e++) {
       //compute propagated cost
       Mode& modet=modeGraph.nodes[e.target()];
-      Subset s = modet.subset+modeGraph.nodes[m].pathCovers[0];
+      SubsetType s = modet.subset+modeGraph.nodes[m].pathCovers[0];
       Real cs=Cost(s);
 
       if(!modet.pathCovers.empty()) {
@@ -238,7 +247,8 @@ void MCRPlanner::UpdatePathsGreedy2(int nstart)
   */
 }
 
-void MCRPlanner::UpdatePathsComplete()
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::UpdatePathsComplete()
 {
   numUpdatePaths++; 
 
@@ -254,7 +264,7 @@ void MCRPlanner::UpdatePathsComplete()
 
   int m0=roadmap.nodes[0].mode;
   int mg=roadmap.nodes[1].mode;
-  Subset sgCover = modeGraph.nodes[m0].subset+modeGraph.nodes[mg].subset;
+  SubsetType sgCover = modeGraph.nodes[m0].subset+modeGraph.nodes[mg].subset;
   modeGraph.nodes[m0].pathCovers.resize(1);
   modeGraph.nodes[m0].pathCovers[0] = sgCover;
   q.insert(pair<int,int>(m0,0),Cost(sgCover));
@@ -270,7 +280,7 @@ void MCRPlanner::UpdatePathsComplete()
     //reached goal
     if(m == mg) break;
 
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(m,e);!e.end();e++) {
       //compute propagated cost
       Mode& modet = modeGraph.nodes[e.target()];
@@ -278,7 +288,7 @@ void MCRPlanner::UpdatePathsComplete()
       if((int)modet.pathCovers.size() >= updatePathsMax)
 	continue;
 
-      Subset s = modet.subset+modeGraph.nodes[m].pathCovers[subsetIndex];
+      SubsetType s = modet.subset+modeGraph.nodes[m].pathCovers[subsetIndex];
 
       if(visited[e.target()] == 1) { //visited already, look to see if the mode contains a subset of s
 	bool skip=false;
@@ -332,7 +342,8 @@ void MCRPlanner::UpdatePathsComplete()
   }
 }
 
-void MCRPlanner::UpdatePathsComplete2(int nstart)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::UpdatePathsComplete2(int nstart)
 {
   numUpdatePaths++; 
 
@@ -345,7 +356,7 @@ void MCRPlanner::UpdatePathsComplete2(int nstart)
     for(size_t i=0;i<modeGraph.nodes.size();i++)
       modeGraph.nodes[i].pathCovers.resize(0);
     int m0=roadmap.nodes[0].mode;
-    Subset sgCover = modeGraph.nodes[m0].subset+modeGraph.nodes[mg].subset;
+    SubsetType sgCover = modeGraph.nodes[m0].subset+modeGraph.nodes[mg].subset;
     modeGraph.nodes[m0].pathCovers.resize(1);
     modeGraph.nodes[m0].pathCovers[0] = sgCover;
     Real c0=Cost(sgCover);
@@ -358,12 +369,12 @@ void MCRPlanner::UpdatePathsComplete2(int nstart)
     assert(!mode0.pathCovers.empty());
 
     //start looking for better paths into nstart
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(m0,e);!e.end();e++) {
       Mode& modet = modeGraph.nodes[e.target()];
       if(modet.minCost > mode0.minCost) continue;
       for(size_t j=0;j<modet.pathCovers.size();j++) {
-	Subset s = mode0.subset+modet.pathCovers[j];
+	SubsetType s = mode0.subset+modet.pathCovers[j];
 	bool skip=false;
 	for(size_t i=0;i<mode0.pathCovers.size();i++) {
 	  if(s.is_subset(mode0.pathCovers[i])) {
@@ -395,7 +406,7 @@ void MCRPlanner::UpdatePathsComplete2(int nstart)
     //reached goal
     if(m == roadmap.nodes[1].mode) break;
 
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(m,e);!e.end();e++) {
       //compute propagated cost
       Mode& modet = modeGraph.nodes[e.target()];
@@ -403,7 +414,7 @@ void MCRPlanner::UpdatePathsComplete2(int nstart)
       if((int)modet.pathCovers.size() >= updatePathsMax)
 	continue;
 
-      Subset s = modet.subset+modeGraph.nodes[m].pathCovers[subsetIndex];
+      SubsetType s = modet.subset+modeGraph.nodes[m].pathCovers[subsetIndex];
 
       bool skip=false;
       vector<int> replace;
@@ -441,13 +452,14 @@ void MCRPlanner::UpdatePathsComplete2(int nstart)
   }
 }
 
-bool MCRPlanner::CanImproveConnectivity(const Mode& ma,const Mode& mb,Real maxExplanationCost)
+template <class SubsetType>
+bool MCRPlannerTemplate<SubsetType>::CanImproveConnectivity(const Mode& ma,const Mode& mb,Real maxExplanationCost)
 {
   //return true;
   if(&ma == &mb) return false;
   if(ma.pathCovers.empty() || mb.pathCovers.empty()) return true;
   for(size_t i=0;i<ma.pathCovers.size();i++) {
-    Subset next=(ma.pathCovers[i] + mb.subset);
+    SubsetType next=(ma.pathCovers[i] + mb.subset);
     Real cnext = Cost(next);
     if(cnext <= maxExplanationCost) {
       if(updatePathsComplete) {
@@ -462,7 +474,7 @@ bool MCRPlanner::CanImproveConnectivity(const Mode& ma,const Mode& mb,Real maxEx
     }
   }
   for(size_t i=0;i<mb.pathCovers.size();i++) {
-    Subset next=(mb.pathCovers[i] + ma.subset);
+    SubsetType next=(mb.pathCovers[i] + ma.subset);
     Real cnext = Cost(next);
     if(cnext <= maxExplanationCost) {
       if(updatePathsComplete) {
@@ -482,7 +494,8 @@ bool MCRPlanner::CanImproveConnectivity(const Mode& ma,const Mode& mb,Real maxEx
 
 //If there are more violations than the limit, return true.
 //Otherwise, return false and compute the subset of violations
-bool MCRPlanner::ExceedsCostLimit(const Config& q,Real limit,Subset& violations)
+template <class SubsetType>
+bool MCRPlannerTemplate<SubsetType>::ExceedsCostLimit(const Config& q,Real limit,SubsetType& violations)
 {
   int n=(int)space->NumConstraints();
   /*
@@ -503,13 +516,14 @@ bool MCRPlanner::ExceedsCostLimit(const Config& q,Real limit,Subset& violations)
     else
       vis[i] = false;
   }
-  violations = Subset(vis);
+  violations = SubsetType(vis);
   return false;
 }
 
 //If there are more violations than the limit, return true.
 //Otherwise, return false and compute the subset of violations
-bool MCRPlanner::ExceedsCostLimit(const Config& a,const Config& b,Real limit,Subset& violations)
+template <class SubsetType>
+bool MCRPlannerTemplate<SubsetType>::ExceedsCostLimit(const Config& a,const Config& b,Real limit,SubsetType& violations)
 {
   int n=(int)space->NumConstraints();
   /*
@@ -535,17 +549,19 @@ bool MCRPlanner::ExceedsCostLimit(const Config& a,const Config& b,Real limit,Sub
       if(vcount > limit) return true;
     }
   }
-  violations = Subset(vis);
+  violations = SubsetType(vis);
   return false;
 }
 
 
-int MCRPlanner::AddNode(const Config& q,int parent)
+template <class SubsetType>
+int MCRPlannerTemplate<SubsetType>::AddNode(const Config& q,int parent)
 {
-  return AddNode(q,Violations(space,q),parent);
+  return AddNode(q,Violations<SubsetType>(space,q),parent);
 }
 
-int MCRPlanner::AddNode(const Config& q,const Subset& subset,int parent)
+template <class SubsetType>
+int MCRPlannerTemplate<SubsetType>::AddNode(const Config& q,const SubsetType& subset,int parent)
 {
 #if DO_TIMING
   Timer timer;
@@ -556,7 +572,7 @@ int MCRPlanner::AddNode(const Config& q,const Subset& subset,int parent)
 
   /*
   //Sanity check?
-  assert(subset == Violations(space,q));
+  assert(subset == Violations<SubsetType>(space,q));
   */
 
   if(parent < 0 || modeGraph.nodes[roadmap.nodes[parent].mode].subset != subset)  {
@@ -603,7 +619,8 @@ int MCRPlanner::AddNode(const Config& q,const Subset& subset,int parent)
   return index;
 }
 
-bool MCRPlanner::AddEdge(int i,int j,int depth)
+template <class SubsetType>
+bool MCRPlannerTemplate<SubsetType>::AddEdge(int i,int j,int depth)
 {
   if(depth >= 10) return false;
   assert(i != j);
@@ -611,7 +628,7 @@ bool MCRPlanner::AddEdge(int i,int j,int depth)
   assert(j >= 0 && j < (int)roadmap.nodes.size());
   assert(!roadmap.HasEdge(i,j));
   numEdgeChecks++;
-  Subset ev=Violations(space,roadmap.nodes[i].q,roadmap.nodes[j].q);
+  SubsetType ev=Violations<SubsetType>(space,roadmap.nodes[i].q,roadmap.nodes[j].q);
   int mi = roadmap.nodes[i].mode;
   int mj = roadmap.nodes[j].mode;
   assert(mi >= 0 && mi < (int)modeGraph.nodes.size());
@@ -632,12 +649,14 @@ bool MCRPlanner::AddEdge(int i,int j,int depth)
   return true;
 }
 
-bool WithinThreshold(const MCRPlanner::Mode& mode,Real maxExplanationCost)
+template <class ModeType>
+bool WithinThreshold(const ModeType& mode,Real maxExplanationCost)
 {
   return mode.minCost <= maxExplanationCost;
 }
 
-bool WithinThreshold(const MCRPlanner::Mode& mode,const Subset& extra,Real maxExplanationCost,const vector<Real>& weights)
+template <class ModeType,class SubsetType>
+bool WithinThreshold(const ModeType& mode,const SubsetType& extra,Real maxExplanationCost,const vector<Real>& weights)
 {
   if(mode.minCost > maxExplanationCost) return false;
   for(size_t i=0;i<mode.pathCovers.size();i++) {
@@ -647,10 +666,11 @@ bool WithinThreshold(const MCRPlanner::Mode& mode,const Subset& extra,Real maxEx
 }
 
 
-int MCRPlanner::AddEdge(int i,const Config& q,Real maxExplanationCost)
+template <class SubsetType>
+int MCRPlannerTemplate<SubsetType>::AddEdge(int i,const Config& q,Real maxExplanationCost)
 {
   numEdgeChecks++;
-  Subset ev,qv;
+  SubsetType ev,qv;
   numConfigChecks++;
   if(ExceedsCostLimit(q,maxExplanationCost,qv))
     return -1;
@@ -662,7 +682,7 @@ int MCRPlanner::AddEdge(int i,const Config& q,Real maxExplanationCost)
     return -1;
   if(!WithinThreshold(modeGraph.nodes[mi],ev,maxExplanationCost,obstacleWeights)) 
     return -1;
-  const Subset& qiv = modeGraph.nodes[mi].subset;
+  const SubsetType& qiv = modeGraph.nodes[mi].subset;
   if(Cost((qiv + qv)) < Cost(ev)) {
     if(space->Distance(roadmap.nodes[i].q,q) < gSubdivideThreshold)
       return -1;
@@ -683,7 +703,8 @@ int MCRPlanner::AddEdge(int i,const Config& q,Real maxExplanationCost)
 }
 
 
-void MCRPlanner::AddEdgeRaw(int i,int j)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::AddEdgeRaw(int i,int j)
 {
 #if DO_TIMING
   Timer timer;
@@ -732,7 +753,7 @@ void MCRPlanner::AddEdgeRaw(int i,int j)
     */
     if(updatePathsComplete) {
       //do a proper update of the irreducible covers
-      vector<Subset> newCovers;
+      vector<SubsetType> newCovers;
       for(size_t p=0;p<ma.pathCovers.size();p++) {
 	bool subset = false;
 	bool equal = false;
@@ -778,7 +799,7 @@ void MCRPlanner::AddEdgeRaw(int i,int j)
       }
     }
     ma.minCost = Min(ma.minCost,mb.minCost);
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(mj,e);!e.end();e++) {
       Transition* t=modeGraph.FindEdge(mi,e.target());
       if(t) {
@@ -845,15 +866,16 @@ void MCRPlanner::AddEdgeRaw(int i,int j)
 #endif //DO_TIMING
 }
 
-int MCRPlanner::ExtendToward(int i,const Config& qdest,Real maxExplorationCost)
+template <class SubsetType>
+int MCRPlannerTemplate<SubsetType>::ExtendToward(int i,const Config& qdest,Real maxExplorationCost)
 {
   int mi = roadmap.nodes[i].mode;
-  const Subset& ei = modeGraph.nodes[mi].subset;
+  const SubsetType& ei = modeGraph.nodes[mi].subset;
 
   assert(gMaxExtendTowardIters == 1);
 
   numConfigChecks++;
-  Subset qv,ev;
+  SubsetType qv,ev;
   if(ExceedsCostLimit(qdest,maxExplorationCost,qv))
     return -1;
   if(!WithinThreshold(modeGraph.nodes[mi],qv,maxExplorationCost,obstacleWeights)) 
@@ -883,7 +905,8 @@ int MCRPlanner::ExtendToward(int i,const Config& qdest,Real maxExplorationCost)
 }
 
 
-void MCRPlanner::KNN(const Config& q,int k,vector<int>& neighbors,vector<Real>& distances)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::KNN(const Config& q,int k,vector<int>& neighbors,vector<Real>& distances)
 {
   //int maxIdx=0;
   distances.resize(0);
@@ -927,7 +950,8 @@ void MCRPlanner::KNN(const Config& q,int k,vector<int>& neighbors,vector<Real>&
   }
 }
 
-void MCRPlanner::KNN(const Config& q,Real maxExplanationCost,int k,vector<int>& neighbors,vector<Real>& distances)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::KNN(const Config& q,Real maxExplanationCost,int k,vector<int>& neighbors,vector<Real>& distances)
 {
   //int maxIdx=0;
   distances.resize(0);
@@ -975,7 +999,8 @@ void MCRPlanner::KNN(const Config& q,Real maxExplanationCost,int k,vector<int>&
   }
 }
 
-void MCRPlanner::Expand(Real maxExplanationCost,vector<int>& newNodes)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::Expand(Real maxExplanationCost,vector<int>& newNodes)
 {
   numExpands++;
 #if DO_TIMING
@@ -1008,7 +1033,7 @@ void MCRPlanner::Expand(Real maxExplanationCost,vector<int>& newNodes)
   //attempt connections
   bool didRefine = false;
   newNodes.resize(0);
-  Subset qsubset;
+  SubsetType qsubset;
   Real minDist = Inf;
   size_t closestIndex = 0;
   for(size_t j=0;j<kclosest.size();j++) 
@@ -1021,7 +1046,7 @@ void MCRPlanner::Expand(Real maxExplanationCost,vector<int>& newNodes)
     
     //do a direct connection
     numConfigChecks++;
-    qsubset = Violations(space,q);
+    qsubset = Violations<SubsetType>(space,q);
     
     int nearmode = roadmap.nodes[kneighbors[closestIndex]].mode;
     if(WithinThreshold(modeGraph.nodes[nearmode],qsubset,maxExplanationCost,obstacleWeights)) { //if config itself violates too many constraints, we're not going to connect any nodes
@@ -1114,7 +1139,8 @@ void MCRPlanner::Expand(Real maxExplanationCost,vector<int>& newNodes)
   }
 }
 
-void MCRPlanner::Expand2(Real maxExplanationCost,vector<int>& newNodes)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::Expand2(Real maxExplanationCost,vector<int>& newNodes)
 {
   numExpands++;
 #if DO_TIMING
@@ -1144,13 +1170,13 @@ void MCRPlanner::Expand2(Real maxExplanationCost,vector<int>& newNodes)
   //attempt connections
   bool didRefine = false;
   newNodes.resize(0);
-  Subset qsubset;
+  SubsetType qsubset;
   if(closest[0] < expandDistance) {
     numRefinementAttempts++;
     
     //do a direct connection
     numConfigChecks++;
-    qsubset = Violations(space,q);
+    qsubset = Violations<SubsetType>(space,q);
 
     int nearmode = roadmap.nodes[neighbor[0]].mode;    
     if(WithinThreshold(modeGraph.nodes[nearmode],qsubset,maxExplanationCost,obstacleWeights)) { //if config itself violates too many constraints, we're not going to connect any nodes
@@ -1233,9 +1259,9 @@ void MCRPlanner::Expand2(Real maxExplanationCost,vector<int>& newNodes)
 	    printf("Added edge to goal!\n");
 	    printf("Cost to node %g\n",modeGraph.nodes[mode].minCost);
 	    printf("Cost to goal %g\n",modeGraph.nodes[gmode].minCost);
-	    Subset vn = Violations(space,roadmap.nodes[newNodes[i]].q);
-	    Subset vg = Violations(space,roadmap.nodes[1].q);
-	    Subset ve = Violations(space,roadmap.nodes[1].q,roadmap.nodes[newNodes[i]].q);
+	    SubsetType vn = Violations<SubsetType>(space,roadmap.nodes[newNodes[i]].q);
+	    SubsetType vg = Violations<SubsetType>(space,roadmap.nodes[1].q);
+	    SubsetType ve = Violations<SubsetType>(space,roadmap.nodes[1].q,roadmap.nodes[newNodes[i]].q);
 	    cout<<"Vn "<<vn<<endl;
 	    cout<<"Vg "<<vg<<endl;
 	    cout<<"Ve "<<ve<<endl;
@@ -1271,14 +1297,15 @@ void MCRPlanner::Expand2(Real maxExplanationCost,vector<int>& newNodes)
   }
 }
 
-void MCRPlanner::Plan(int initialLimit,const vector<int>& expansionSchedule,vector<int>& bestPath,Subset& bestCover)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::Plan(int initialLimit,const vector<int>& expansionSchedule,vector<int>& bestPath,SubsetType& bestCover)
 {
   Completion(0,0,1,bestCover);
 
-  Subset lowerCover;
+  SubsetType lowerCover;
   numConfigChecks += 2;
-  lowerCover=Violations(space,start);
-  lowerCover=lowerCover+Violations(space,goal);
+  lowerCover=Violations<SubsetType>(space,start);
+  lowerCover=lowerCover+Violations<SubsetType>(space,goal);
 
   Real lowerCost = Cost(lowerCover);
   Real bestCost = Cost(bestCover);
@@ -1362,7 +1389,8 @@ void MCRPlanner::Plan(int initialLimit,const vector<int>& expansionSchedule,vect
   */
 }
 
-void MCRPlanner::BuildRoadmap(Real maxExplanationCost,RoadmapPlanner& prm)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::BuildRoadmap(Real maxExplanationCost,RoadmapPlanner& prm)
 {
   vector<bool> useMode(modeGraph.nodes.size());
   for(size_t i=0;i<modeGraph.nodes.size();i++) 
@@ -1384,20 +1412,22 @@ void MCRPlanner::BuildRoadmap(Real maxExplanationCost,RoadmapPlanner& prm)
   }
 }
 
-void UniformModeDFS(MCRPlanner* eep,int mode,int vertex,vector<bool>& marked,vector<int>& visited)
+template <class SubsetType>
+void UniformModeDFS(MCRPlannerTemplate<SubsetType>* eep,int mode,int vertex,vector<bool>& marked,vector<int>& visited)
 {
   if(marked[vertex]) return;
   if(eep->roadmap.nodes[vertex].mode != mode) return;
 
   marked[vertex]=true;
   visited.push_back(vertex);
-  Graph::UndirectedEdgeIterator<MCRPlanner::Edge> e;
+  Graph::UndirectedEdgeIterator<typename MCRPlannerTemplate<SubsetType>::Edge> e;
   for(eep->roadmap.Begin(vertex,e);!e.end();++e) {
     UniformModeDFS(eep,mode,e.target(),marked,visited);
   }
 }
 
-void MCRPlanner::BuildCCGraph(Graph::UndirectedGraph<Subset,int>& G)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::BuildCCGraph(Graph::UndirectedGraph<SubsetType,int>& G)
 {
   vector<int> nodeCCs(roadmap.nodes.size(),-1);
   vector<bool> marked(roadmap.nodes.size(),false);
@@ -1434,28 +1464,30 @@ void MCRPlanner::BuildCCGraph(Graph::UndirectedGraph<Subset,int>& G)
 
 
 
+template <class SubsetType>
 struct CoverageLimitedPathCallback: public Graph::PathIntCallback
 {
-  MCRPlanner* planner;
-  const Subset& cover;
+  MCRPlannerTemplate<SubsetType>* planner;
+  const SubsetType& cover;
 
-  CoverageLimitedPathCallback(MCRPlanner* _planner,const Subset& _cover,int _target=-1)
+  CoverageLimitedPathCallback(MCRPlannerTemplate<SubsetType>* _planner,const SubsetType& _cover,int _target=-1)
     :PathIntCallback(_planner->roadmap.nodes.size(),_target),planner(_planner),cover(_cover)
   {}
 
   virtual bool ForwardEdge(int i,int j) {
     int modej = planner->roadmap.nodes[j].mode;
-    const Subset& subj = planner->modeGraph.nodes[modej].subset;
+    const SubsetType& subj = planner->modeGraph.nodes[modej].subset;
     return subj.is_subset(cover);
   }
 };
 
-bool MCRPlanner::CoveragePath(int s,int t,const Subset& cover,vector<int>& path,Subset& pathCover)
+template <class SubsetType>
+bool MCRPlannerTemplate<SubsetType>::CoveragePath(int s,int t,const SubsetType& cover,vector<int>& path,SubsetType& pathCover)
 {
   CoverageLimitedPathCallback callback(this,cover,t);
   roadmap._DFS(s,callback);
   if(Graph::GetAncestorPath(callback.parents,t,s,path)) {
-    pathCover = Subset();
+    pathCover = SubsetType();
     for(size_t i=0;i<path.size();i++)
       pathCover = pathCover + modeGraph.nodes[roadmap.nodes[path[i]].mode].subset;
     return true;
@@ -1467,9 +1499,10 @@ bool MCRPlanner::CoveragePath(int s,int t,const Subset& cover,vector<int>& path,
 /** Uses size comparisons for a partial ordering,
  * rather than element comparisons
  */
+template <class SubsetType>
 struct SubsetCost
 {
-  Subset subset;
+  SubsetType subset;
   Real pathCost;
   vector<Real>* weights;
 
@@ -1477,15 +1510,15 @@ struct SubsetCost
     :subset(maxItem),pathCost(cost),weights(_weights)
   {}
 
-  SubsetCost(const Subset& s,Real cost=0,vector<Real>* _weights=NULL)
+  SubsetCost(const SubsetType& s,Real cost=0,vector<Real>* _weights=NULL)
     :subset(s),pathCost(cost),weights(_weights)
   {}
 
-  SubsetCost(const SubsetCost& s)
+  SubsetCost(const SubsetCost<SubsetType>& s)
     :subset(s.subset),pathCost(s.pathCost),weights(s.weights)
   {}
 
-  bool operator < (const SubsetCost& s) const
+  bool operator < (const SubsetCost<SubsetType>& s) const
   {
     assert(weights==s.weights);
     if(weights) {
@@ -1500,12 +1533,12 @@ struct SubsetCost
     }
   }
 
-  bool operator > (const SubsetCost& s) const
+  bool operator > (const SubsetCost<SubsetType>& s) const
   {
     return s < *this;
   }
 
-  bool operator == (const SubsetCost& s) const
+  bool operator == (const SubsetCost<SubsetType>& s) const
   {
     if(weights)
       return WeightedCost(subset,*weights) == WeightedCost(s.subset,*weights) && pathCost == s.pathCost;
@@ -1513,42 +1546,43 @@ struct SubsetCost
       return subset.size() == s.subset.size() && pathCost == s.pathCost;
   }
   
-  bool operator != (const SubsetCost& s) const
+  bool operator != (const SubsetCost<SubsetType>& s) const
   {
     return !(operator == (s));
   }
 
-  SubsetCost operator + (const SubsetCost& s) const
+  SubsetCost<SubsetType> operator + (const SubsetCost<SubsetType>& s) const
   {
-    return SubsetCost(subset+s.subset,pathCost + s.pathCost,weights);
+    return SubsetCost<SubsetType>(subset+s.subset,pathCost + s.pathCost,weights);
   }
 
-  SubsetCost operator - () const
+  SubsetCost<SubsetType> operator - () const
   {
-    return SubsetCost (-subset,-pathCost,weights);
+    return SubsetCost<SubsetType> (-subset,-pathCost,weights);
   }
 };
 
 
-struct GreedySubsetAStar : public GeneralizedAStar<int,SubsetCost>
+template <class SubsetType>
+struct GreedySubsetAStar : public GeneralizedAStar<int,SubsetCost<SubsetType> >
 {
-  typedef GeneralizedAStar<int,SubsetCost>::Node Node;
-  MCRPlanner* planner;
+  typedef typename GeneralizedAStar<int,SubsetCost<SubsetType> >::Node Node;
+  MCRPlannerTemplate<SubsetType>* planner;
   int startNode,targetNode;
   vector<Node*> visited;
 
-  GreedySubsetAStar(MCRPlanner* _planner,int _start,int _target)
+  GreedySubsetAStar(MCRPlannerTemplate<SubsetType>* _planner,int _start,int _target)
     :planner(_planner),startNode(_start),targetNode(_target)
   {
-    SetStart(_start);
-    root.g = SubsetCost(planner->modeGraph.nodes[planner->roadmap.nodes[startNode].mode].subset,0,&planner->obstacleWeights);
-    root.f = root.g;
+    this->SetStart(_start);
+    this->root.g = SubsetCost<SubsetType>(planner->modeGraph.nodes[planner->roadmap.nodes[startNode].mode].subset,0,&planner->obstacleWeights);
+    this->root.f = this->root.g;
   }
 
   virtual bool IsGoal(const int& s) { return s==targetNode; }
 
-  virtual void Successors(const int& s,vector<int>& successors,vector<SubsetCost>& cost) {
-    Graph::UndirectedEdgeIterator<MCRPlanner::Edge> e;
+  virtual void Successors(const int& s,vector<int>& successors,vector<SubsetCost<SubsetType> >& cost) {
+    Graph::UndirectedEdgeIterator<typename MCRPlannerTemplate<SubsetType>::Edge> e;
     successors.resize(0);
     cost.resize(0);
     for(planner->roadmap.Begin(s,e);!e.end();e++) {
@@ -1557,12 +1591,12 @@ struct GreedySubsetAStar : public GeneralizedAStar<int,SubsetCost>
       successors.push_back(e.target());
       int mode=planner->roadmap.nodes[e.target()].mode;
       if(mode != planner->roadmap.nodes[s].mode) { //transition
-	SubsetCost c(planner->modeGraph.nodes[mode].subset,dist,&planner->obstacleWeights);
+	SubsetCost<SubsetType> c(planner->modeGraph.nodes[mode].subset,dist,&planner->obstacleWeights);
 	cost.push_back(c);
       }
       else {
 	//same subset
-	SubsetCost c(planner->space->NumConstraints(),dist);
+	SubsetCost<SubsetType> c(planner->space->NumConstraints(),dist);
 	cost.push_back(c);
       }
     }
@@ -1586,27 +1620,28 @@ struct GreedySubsetAStar : public GeneralizedAStar<int,SubsetCost>
 };
 
 
-struct OptimalSubsetAStar : public GeneralizedAStar<pair<int,Subset>,SubsetCost>
+template <class SubsetType>
+struct OptimalSubsetAStar : public GeneralizedAStar<pair<int,SubsetType>,SubsetCost<SubsetType> >
 {
-  typedef pair<int,Subset> State;
-  typedef GeneralizedAStar<State,SubsetCost>::Node Node;
-  MCRPlanner* planner;
+  typedef pair<int,SubsetType> State;
+  typedef typename GeneralizedAStar<State,SubsetCost<SubsetType> >::Node Node;
+  MCRPlannerTemplate<SubsetType>* planner;
   int startNode,targetNode;
-  vector<vector<pair<Subset,Node*> > > visited;
+  vector<vector<pair<SubsetType,Node*> > > visited;
 
-  OptimalSubsetAStar(MCRPlanner* _planner,int _start,int _target)
+  OptimalSubsetAStar(MCRPlannerTemplate<SubsetType>* _planner,int _start,int _target)
     :planner(_planner),startNode(_start),targetNode(_target)
   {
-    const Subset& m0=planner->modeGraph.nodes[planner->roadmap.nodes[startNode].mode].subset;
-    SetStart(pair<int,Subset>(_start,m0));
-    root.g = SubsetCost(m0,0,&planner->obstacleWeights);
-    root.f = root.g;
+    const SubsetType& m0=planner->modeGraph.nodes[planner->roadmap.nodes[startNode].mode].subset;
+    this->SetStart(pair<int,SubsetType>(_start,m0));
+    this->root.g = SubsetCost<SubsetType>(m0,0,&planner->obstacleWeights);
+    this->root.f = this->root.g;
   }
 
   virtual bool IsGoal(const State& s) { return s.first==targetNode; }
 
-  virtual void Successors(const State& s,vector<State>& successors,vector<SubsetCost>& cost) {
-    Graph::UndirectedEdgeIterator<MCRPlanner::Edge> e;
+  virtual void Successors(const State& s,vector<State>& successors,vector<SubsetCost<SubsetType> >& cost) {
+    Graph::UndirectedEdgeIterator<typename MCRPlannerTemplate<SubsetType>::Edge> e;
     successors.resize(0);
     cost.resize(0);
     for(planner->roadmap.Begin(s.first,e);!e.end();e++) {
@@ -1614,15 +1649,15 @@ struct OptimalSubsetAStar : public GeneralizedAStar<pair<int,Subset>,SubsetCost>
 
       int mode=planner->roadmap.nodes[e.target()].mode;
       if(mode != planner->roadmap.nodes[s.first].mode) { //transition
-	SubsetCost c(planner->modeGraph.nodes[mode].subset,dist,&planner->obstacleWeights);
+	SubsetCost<SubsetType> c(planner->modeGraph.nodes[mode].subset,dist,&planner->obstacleWeights);
 	cost.push_back(c);
       }
       else {
 	//same subset
-	SubsetCost c(planner->space->NumConstraints(),dist,&planner->obstacleWeights);
+	SubsetCost<SubsetType> c(planner->space->NumConstraints(),dist,&planner->obstacleWeights);
 	cost.push_back(c);
       }
-      successors.push_back(pair<int,Subset>(e.target(),cost.back().subset+s.second));
+      successors.push_back(pair<int,SubsetType>(e.target(),cost.back().subset+s.second));
     }
   }
 
@@ -1634,7 +1669,7 @@ struct OptimalSubsetAStar : public GeneralizedAStar<pair<int,Subset>,SubsetCost>
 
   virtual void Visit(const State& s,Node* n)
   {
-    visited[s.first].push_back(pair<Subset,Node*>(s.second,n));
+    visited[s.first].push_back(pair<SubsetType,Node*>(s.second,n));
   }
 
   virtual Node* VisitedStateNode(const State& s)
@@ -1648,15 +1683,16 @@ struct OptimalSubsetAStar : public GeneralizedAStar<pair<int,Subset>,SubsetCost>
 };
 
 
-bool MCRPlanner::GreedyPath(int s,int t,vector<int>& path,Subset& pathCover)
+template <class SubsetType>
+bool MCRPlannerTemplate<SubsetType>::GreedyPath(int s,int t,vector<int>& path,SubsetType& pathCover)
 {
-  GreedySubsetAStar astar(this,s,t);
+  GreedySubsetAStar<SubsetType> astar(this,s,t);
   if(!astar.Search()) {
     path.clear();
     return false;
   }
   else {
-    GreedySubsetAStar::Node* n=astar.goal;
+    typename GreedySubsetAStar<SubsetType>::Node* n=astar.goal;
     path.resize(0);
     while(n) {
       path.push_back(n->data);
@@ -1669,15 +1705,16 @@ bool MCRPlanner::GreedyPath(int s,int t,vector<int>& path,Subset& pathCover)
 }
 
 
-bool MCRPlanner::OptimalPath(int s,int t,vector<int>& path,Subset& pathCover)
+template <class SubsetType>
+bool MCRPlannerTemplate<SubsetType>::OptimalPath(int s,int t,vector<int>& path,SubsetType& pathCover)
 {
-  OptimalSubsetAStar astar(this,s,t);
+  OptimalSubsetAStar<SubsetType> astar(this,s,t);
   if(!astar.Search()) {
     path.clear();
     return false;
   }
   else {
-    OptimalSubsetAStar::Node* n=astar.goal;
+    typename OptimalSubsetAStar<SubsetType>::Node* n=astar.goal;
     path.resize(0);
     while(n) {
       path.push_back(n->data.first);
@@ -1689,18 +1726,20 @@ bool MCRPlanner::OptimalPath(int s,int t,vector<int>& path,Subset& pathCover)
   }
 }
 
-void MCRPlanner::Completion(int s,int node,int t,Subset& pathCover)
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::Completion(int s,int node,int t,SubsetType& pathCover)
 {
-  GreedySubsetAStar astar(this,s,node);
+  GreedySubsetAStar<SubsetType> astar(this,s,node);
   if(!astar.Search()) {
-    pathCover = (Violations(space,roadmap.nodes[s].q,roadmap.nodes[node].q)+Violations(space,roadmap.nodes[node].q,roadmap.nodes[t].q));
+    pathCover = (Violations<SubsetType>(space,roadmap.nodes[s].q,roadmap.nodes[node].q)+Violations<SubsetType>(space,roadmap.nodes[node].q,roadmap.nodes[t].q));
   }
   else {
-    pathCover = (astar.goal->g.subset + Violations(space,roadmap.nodes[node].q,roadmap.nodes[t].q));
+    pathCover = (astar.goal->g.subset + Violations<SubsetType>(space,roadmap.nodes[node].q,roadmap.nodes[t].q));
   }
 }
 
-void MCRPlanner::GetMilestonePath(const std::vector<int>& path,MilestonePath& mpath) const
+template <class SubsetType>
+void MCRPlannerTemplate<SubsetType>::GetMilestonePath(const std::vector<int>& path,MilestonePath& mpath) const
 {
   mpath.edges.resize(path.size()-1);
   for(size_t i=0;i+1<path.size();i++) {
@@ -1713,3 +1752,10 @@ void MCRPlanner::GetMilestonePath(const std::vector<int>& path,MilestonePath& mp
     assert(mpath.edges[i]->End()==roadmap.nodes[path[i+1]].q);
   }
 }
+
+template Subset Violations<Subset>(CSpace* space,const Config& q);
+template Subset Violations<Subset>(CSpace* space,const Config& a,const Config& b);
+template BitSubset Violations<BitSubset>(CSpace* space,const Config& q);
+template BitSubset Violations<BitSubset>(CSpace* space,const Config& a,const Config& b);
+template class MCRPlannerTemplate<Subset>;
+template class MCRPlannerTemplate<BitSubset>;
@@ -25,8 +25,15 @@
  *   //output best path
  *   MilestonePath path;
  *   planner.GetMilestonePath(bestPlan,path);
+ *
+ * The planner is templated on the type used to store the sets of violated
+ * constraints, which are united and compared on every roadmap update.
+ * MCRPlanner uses the sparse Subset, and BitMCRPlanner uses the dense
+ * BitSubset, which is usually faster when the space has few constraints or
+ * the covers are large.
  */
-class MCRPlanner
+template <class SubsetType>
+class MCRPlannerTemplate
 {
  public:
   struct Milestone {
@@ -40,9 +47,9 @@ class MCRPlanner
   typedef Graph::UndirectedGraph<Milestone,Edge> Roadmap;
 
   struct Mode {
-    Subset subset;      //subset covered by this mode
+    SubsetType subset;      //subset covered by this mode
     std::vector<int> roadmapNodes;
-    std::vector<Subset> pathCovers;   //minimal covers leading from the start to this mode
+    std::vector<SubsetType> pathCovers;   //minimal covers leading from the start to this mode
     Real minCost;
   };
   struct Transition {
@@ -50,33 +57,33 @@ class MCRPlanner
   };
   typedef Graph::UndirectedGraph<Mode,Transition> ModeGraph;
 
-  MCRPlanner(CSpace* space);
+  MCRPlannerTemplate(CSpace* space);
   void Init(const Config& start,const Config& goal);
   ///Performs one iteration of planning given a limit on the explanation size
   void Expand(Real maxExplanationCost,vector<int>& newNodes);
   void Expand2(Real maxExplanationCost,vector<int>& newNodes);
   ///Performs bottom-up planning according to a given limit expansion schedule
-  void Plan(int initialLimit,const vector<int>& expansionSchedule,vector<int>& bestPath,Subset& cover);
+  void Plan(int initialLimit,const vector<int>& expansionSchedule,vector<int>& bestPath,SubsetType& cover);
   ///Outputs the graph with the given explanation limit
   void BuildRoadmap(Real maxExplanationCost,RoadmapPlanner& prm);
   ///Outputs the CC graph.  Each node is a connected component of the roadmap
   ///within the same subset.
-  void BuildCCGraph(Graph::UndirectedGraph<Subset,int>& G);
+  void BuildCCGraph(Graph::UndirectedGraph<SubsetType,int>& G);
   ///A search that finds a path subject to a coverage constraint
-  bool CoveragePath(int s,int t,const Subset& cover,std::vector<int>& path,Subset& pathCover);
+  bool CoveragePath(int s,int t,const SubsetType& cover,std::vector<int>& path,SubsetType& pathCover);
   ///A greedy heuristic that performs smallest cover given predecessor
-  bool GreedyPath(int s,int t,std::vector<int>& path,Subset& pathCover);
+  bool GreedyPath(int s,int t,std::vector<int>& path,SubsetType& pathCover);
   ///An optimal search
-  bool OptimalPath(int s,int t,std::vector<int>& path,Subset& pathCover);
+  bool OptimalPath(int s,int t,std::vector<int>& path,SubsetType& pathCover);
   ///Returns the cover of the path from s->node + completion(node,goal)
   ///where the path cover is determined using the greedy
   ///heuristic
-  void Completion(int s,int node,int t,Subset& pathCover);
+  void Completion(int s,int node,int t,SubsetType& pathCover);
 
   //helpers
-  Real Cost(const Subset& s) const;
+  Real Cost(const SubsetType& s) const;
   int AddNode(const Config& q,int parent=-1);
-  int AddNode(const Config& q,const Subset& subset,int parent=-1);
+  int AddNode(const Config& q,const SubsetType& subset,int parent=-1);
   bool AddEdge(int i,int j,int depth=0);
   int AddEdge(int i,const Config& q,Real maxExplanationCost);  //returns index of q
   void AddEdgeRaw(int i,int j);
@@ -94,13 +101,13 @@ class MCRPlanner
   void UpdateMinCost(Mode& m);
   //fast checking of whether the cost of the local constraints at q exceed the
   //given limit
-  bool ExceedsCostLimit(const Config& q,Real limit,Subset& violations);
+  bool ExceedsCostLimit(const Config& q,Real limit,SubsetType& violations);
   //fast checking of whether the cost of the local constraints violated on 
   //the edge ab exceed the given limit
-  bool ExceedsCostLimit(const Config& a,const Config& b,Real limit,Subset& violations);
+  bool ExceedsCostLimit(const Config& a,const Config& b,Real limit,SubsetType& violations);
 
   ///Computes the cover of the path
-  void GetCover(const std::vector<int>& path,Subset& cover) const;
+  void GetCover(const std::vector<int>& path,SubsetType& cover) const;
   ///Computes the length of the path
   Real GetLength(const std::vector<int>& path) const;
   ///Returns the MilestonePath
@@ -138,4 +145,7 @@ class MCRPlanner
   double timeNearestNeighbors,timeRefine,timeExplore,timeUpdatePaths,timeOverhead;
 };
 
+typedef MCRPlannerTemplate<Subset> MCRPlanner;
+typedef MCRPlannerTemplate<BitSubset> BitMCRPlanner;
+
 #endif
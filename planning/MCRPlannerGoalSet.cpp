@@ -17,28 +17,33 @@ const static double gSubdivideThreshold = 1e-3;
 
 
 //defined in MCRPlanner.cpp
-Subset Violations(CSpace* space,const Config& q);
-Subset Violations(CSpace* space,const Config& a,const Config& b);
+template <class SubsetType>
+SubsetType Violations(CSpace* space,const Config& q);
+template <class SubsetType>
+SubsetType Violations(CSpace* space,const Config& a,const Config& b);
 
 
-inline Real WeightedCost(const Subset& s,const vector<Real>& weights)
+template <class SubsetType>
+inline Real WeightedCost(const SubsetType& s,const vector<Real>& weights)
 {
+  if(weights.empty()) return Real(s.size());
   Real sum=0.0;
-  //for(set<int>::const_iterator i=s.items.begin();i!=s.items.end();i++) {
-  for(vector<int>::const_iterator i=s.items.begin();i!=s.items.end();i++) {
+  for(typename SubsetType::const_iterator i=s.begin();i!=s.end();i++) {
     sum += weights[*i];
     if(IsInf(sum)) return sum;
   }
   return sum;
 }
 
-bool WithinThreshold(const MCRPlannerGoalSet::Mode& mode,Real maxExplanationCost)
+template <class ModeType>
+bool WithinThreshold(const ModeType& mode,Real maxExplanationCost)
 {
   return mode.minCost <= maxExplanationCost;
 }
 
 //checks whether the mode's cover + the extra cover exceed the given cost
-bool WithinThreshold(const MCRPlannerGoalSet::Mode& mode,const Subset& extra,Real maxExplanationCost,const vector<Real>& weights)
+template <class ModeType,class SubsetType>
+bool WithinThreshold(const ModeType& mode,const SubsetType& extra,Real maxExplanationCost,const vector<Real>& weights)
 {
   if(mode.minCost > maxExplanationCost) return false;
   for(size_t i=0;i<mode.pathCovers.size();i++) {
@@ -67,7 +72,8 @@ Real MaxError(Optimization::NonlinearProgram* p,const Config& x)
 }
 
 
-MCRPlannerGoalSet::MCRPlannerGoalSet(CSpace* _space)
+template <class SubsetType>
+MCRPlannerGoalSetTemplate<SubsetType>::MCRPlannerGoalSetTemplate(CSpace* _space)
   :space(_space),goalSet(NULL),goalNumeric(NULL),
    updatePathsComplete(false),updatePathsDynamic(true),updatePathsMax(INT_MAX),
    numExpands(0),numRefinementAttempts(0),numRefinementSuccesses(0),numExplorationAttempts(0),
@@ -84,13 +90,15 @@ MCRPlannerGoalSet::MCRPlannerGoalSet(CSpace* _space)
   bidirectional = false;
 }
 
-Real MCRPlannerGoalSet::Cost(const Subset& s) const
+template <class SubsetType>
+Real MCRPlannerGoalSetTemplate<SubsetType>::Cost(const SubsetType& s) const
 {
-  if(obstacleWeights.empty()) return Real(s.items.size());
+  if(obstacleWeights.empty()) return Real(s.size());
   return WeightedCost(s,obstacleWeights);
 }
 
-void MCRPlannerGoalSet::Init(const Config& _start,CSet* _goal)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::Init(const Config& _start,CSet* _goal)
 {
   roadmap.Cleanup();
   modeGraph.Cleanup();
@@ -112,7 +120,8 @@ void MCRPlannerGoalSet::Init(const Config& _start,CSet* _goal)
   else UpdatePathsGreedy();
 }
 
-void MCRPlannerGoalSet::UpdateMinCost(Mode& m)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::UpdateMinCost(Mode& m)
 {
   if(m.pathCovers.empty())
     m.minCost = DBL_MAX;
@@ -124,7 +133,8 @@ void MCRPlannerGoalSet::UpdateMinCost(Mode& m)
   }
 }
 
-void MCRPlannerGoalSet::UpdatePathsGreedy()
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::UpdatePathsGreedy()
 {
   numUpdatePaths++; 
 
@@ -138,7 +148,7 @@ void MCRPlannerGoalSet::UpdatePathsGreedy()
   set<int> mg;
   for(size_t i=0;i<goalNodes.size();i++)
     mg.insert(roadmap.nodes[goalNodes[i]].mode);
-  Subset sgCover = modeGraph.nodes[m0].subset;
+  SubsetType sgCover = modeGraph.nodes[m0].subset;
   modeGraph.nodes[m0].pathCovers.resize(1);
   modeGraph.nodes[m0].pathCovers[0] = sgCover;
   Real c0=Cost(sgCover);
@@ -159,7 +169,7 @@ void MCRPlannerGoalSet::UpdatePathsGreedy()
     for(modeGraph.Begin(m,e);!e.end();e++) {
       //compute propagated cost
       Mode& modet=modeGraph.nodes[e.target()];
-      Subset s = modet.subset+modeGraph.nodes[m].pathCovers[0];
+      SubsetType s = modet.subset+modeGraph.nodes[m].pathCovers[0];
       Real cs=Cost(s);
       if(modet.minCost <= cs)
 	continue;
@@ -182,7 +192,8 @@ void MCRPlannerGoalSet::UpdatePathsGreedy()
   */
 }
 
-void MCRPlannerGoalSet::UpdatePathsGreedy2(int nstart)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::UpdatePathsGreedy2(int nstart)
 {
   numUpdatePaths++; 
 
@@ -193,7 +204,7 @@ void MCRPlannerGoalSet::UpdatePathsGreedy2(int nstart)
     mg.insert(roadmap.nodes[goalNodes[i]].mode);
   if(nstart <= 0) {
     int m0=roadmap.nodes[0].mode;
-    Subset sgCover = modeGraph.nodes[m0].subset;
+    SubsetType sgCover = modeGraph.nodes[m0].subset;
     modeGraph.nodes[m0].pathCovers.resize(1);
     modeGraph.nodes[m0].pathCovers[0] = sgCover;
     Real c0=Cost(sgCover);
@@ -206,11 +217,11 @@ void MCRPlannerGoalSet::UpdatePathsGreedy2(int nstart)
     assert(!mode0.pathCovers.empty());
 
     //start looking for better paths into nstart
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(m0,e);!e.end();e++) {
       Mode& modet = modeGraph.nodes[e.target()];
       if(modet.minCost >= mode0.minCost) continue;
-      Subset s = mode0.subset+modet.pathCovers[0];
+      SubsetType s = mode0.subset+modet.pathCovers[0];
       Real cs=Cost(s);
       if(cs < mode0.minCost) {
 	mode0.pathCovers[0] = s;
@@ -228,11 +239,11 @@ void MCRPlannerGoalSet::UpdatePathsGreedy2(int nstart)
     //reached goal
     if(mg.count(m)==0) break;
 
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(m,e);!e.end();e++) {
       //compute propagated cost
       Mode& modet=modeGraph.nodes[e.target()];
-      Subset s = modet.subset+modeGraph.nodes[m].pathCovers[0];
+      SubsetType s = modet.subset+modeGraph.nodes[m].pathCovers[0];
       Real cs=Cost(s);
 
       if(!modet.pathCovers.empty()) {
@@ -262,7 +273,8 @@ void MCRPlannerGoalSet::UpdatePathsGreedy2(int nstart)
   */
 }
 
-void MCRPlannerGoalSet::UpdatePathsComplete()
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::UpdatePathsComplete()
 {
   numUpdatePaths++; 
 
@@ -280,7 +292,7 @@ void MCRPlannerGoalSet::UpdatePathsComplete()
   set<int> mg;
   for(size_t i=0;i<goalNodes.size();i++)
     mg.insert(roadmap.nodes[goalNodes[i]].mode);
-  Subset sgCover = modeGraph.nodes[m0].subset;
+  SubsetType sgCover = modeGraph.nodes[m0].subset;
   modeGraph.nodes[m0].pathCovers.resize(1);
   modeGraph.nodes[m0].pathCovers[0] = sgCover;
   q.insert(pair<int,int>(m0,0),Cost(sgCover));
@@ -296,7 +308,7 @@ void MCRPlannerGoalSet::UpdatePathsComplete()
     //reached goal
     if(mg.count(m)!=0) break;
 
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(m,e);!e.end();e++) {
       //compute propagated cost
       Mode& modet = modeGraph.nodes[e.target()];
@@ -304,7 +316,7 @@ void MCRPlannerGoalSet::UpdatePathsComplete()
       if((int)modet.pathCovers.size() >= updatePathsMax)
 	continue;
 
-      Subset s = modet.subset+modeGraph.nodes[m].pathCovers[subsetIndex];
+      SubsetType s = modet.subset+modeGraph.nodes[m].pathCovers[subsetIndex];
 
       if(visited[e.target()] == 1) { //visited already, look to see if the mode contains a subset of s
 	bool skip=false;
@@ -358,7 +370,8 @@ void MCRPlannerGoalSet::UpdatePathsComplete()
   }
 }
 
-void MCRPlannerGoalSet::UpdatePathsComplete2(int nstart)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::UpdatePathsComplete2(int nstart)
 {
   numUpdatePaths++; 
 
@@ -373,7 +386,7 @@ void MCRPlannerGoalSet::UpdatePathsComplete2(int nstart)
     for(size_t i=0;i<modeGraph.nodes.size();i++)
       modeGraph.nodes[i].pathCovers.resize(0);
     int m0=roadmap.nodes[0].mode;
-    Subset sgCover = modeGraph.nodes[m0].subset;
+    SubsetType sgCover = modeGraph.nodes[m0].subset;
     modeGraph.nodes[m0].pathCovers.resize(1);
     modeGraph.nodes[m0].pathCovers[0] = sgCover;
     Real c0=Cost(sgCover);
@@ -386,12 +399,12 @@ void MCRPlannerGoalSet::UpdatePathsComplete2(int nstart)
     assert(!mode0.pathCovers.empty());
 
     //start looking for better paths into nstart
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(m0,e);!e.end();e++) {
       Mode& modet = modeGraph.nodes[e.target()];
       if(modet.minCost > mode0.minCost) continue;
       for(size_t j=0;j<modet.pathCovers.size();j++) {
-	Subset s = mode0.subset+modet.pathCovers[j];
+	SubsetType s = mode0.subset+modet.pathCovers[j];
 	bool skip=false;
 	for(size_t i=0;i<mode0.pathCovers.size();i++) {
 	  if(s.is_subset(mode0.pathCovers[i])) {
@@ -423,7 +436,7 @@ void MCRPlannerGoalSet::UpdatePathsComplete2(int nstart)
     //reached goal
     if(mg.count(m)!=0) break;
 
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(m,e);!e.end();e++) {
       //compute propagated cost
       Mode& modet = modeGraph.nodes[e.target()];
@@ -431,7 +444,7 @@ void MCRPlannerGoalSet::UpdatePathsComplete2(int nstart)
       if((int)modet.pathCovers.size() >= updatePathsMax)
 	continue;
 
-      Subset s = modet.subset+modeGraph.nodes[m].pathCovers[subsetIndex];
+      SubsetType s = modet.subset+modeGraph.nodes[m].pathCovers[subsetIndex];
 
       bool skip=false;
       vector<int> replace;
@@ -469,13 +482,14 @@ void MCRPlannerGoalSet::UpdatePathsComplete2(int nstart)
   }
 }
 
-bool MCRPlannerGoalSet::CanImproveConnectivity(const Mode& ma,const Mode& mb,Real maxExplanationCost)
+template <class SubsetType>
+bool MCRPlannerGoalSetTemplate<SubsetType>::CanImproveConnectivity(const Mode& ma,const Mode& mb,Real maxExplanationCost)
 {
   //return true;
   if(&ma == &mb) return false;
   if(ma.pathCovers.empty() || mb.pathCovers.empty()) return true;
   for(size_t i=0;i<ma.pathCovers.size();i++) {
-    Subset next=(ma.pathCovers[i] + mb.subset);
+    SubsetType next=(ma.pathCovers[i] + mb.subset);
     Real cnext = Cost(next);
     if(cnext <= maxExplanationCost) {
       if(updatePathsComplete) {
@@ -490,7 +504,7 @@ bool MCRPlannerGoalSet::CanImproveConnectivity(const Mode& ma,const Mode& mb,Rea
     }
   }
   for(size_t i=0;i<mb.pathCovers.size();i++) {
-    Subset next=(mb.pathCovers[i] + ma.subset);
+    SubsetType next=(mb.pathCovers[i] + ma.subset);
     Real cnext = Cost(next);
     if(cnext <= maxExplanationCost) {
       if(updatePathsComplete) {
@@ -510,7 +524,8 @@ bool MCRPlannerGoalSet::CanImproveConnectivity(const Mode& ma,const Mode& mb,Rea
 
 //If there are more violations than the limit, return true.
 //Otherwise, return false and compute the subset of violations
-bool MCRPlannerGoalSet::ExceedsCostLimit(const Config& q,Real limit,Subset& violations)
+template <class SubsetType>
+bool MCRPlannerGoalSetTemplate<SubsetType>::ExceedsCostLimit(const Config& q,Real limit,SubsetType& violations)
 {
   int n=(int)space->constraints.size();
   /*
@@ -531,13 +546,14 @@ bool MCRPlannerGoalSet::ExceedsCostLimit(const Config& q,Real limit,Subset& viol
     else
       vis[i] = false;
   }
-  violations = Subset(vis);
+  violations = SubsetType(vis);
   return false;
 }
 
 //If there are more violations than the limit, return true.
 //Otherwise, return false and compute the subset of violations
-bool MCRPlannerGoalSet::ExceedsCostLimit(const Config& a,const Config& b,Real limit,Subset& violations)
+template <class SubsetType>
+bool MCRPlannerGoalSetTemplate<SubsetType>::ExceedsCostLimit(const Config& a,const Config& b,Real limit,SubsetType& violations)
 {
   int n=(int)space->constraints.size();
   /*
@@ -563,17 +579,19 @@ bool MCRPlannerGoalSet::ExceedsCostLimit(const Config& a,const Config& b,Real li
       if(vcount > limit) return true;
     }
   }
-  violations = Subset(vis);
+  violations = SubsetType(vis);
   return false;
 }
 
 
-int MCRPlannerGoalSet::AddNode(const Config& q,int parent)
+template <class SubsetType>
+int MCRPlannerGoalSetTemplate<SubsetType>::AddNode(const Config& q,int parent)
 {
-  return AddNode(q,Violations(space,q),parent);
+  return AddNode(q,Violations<SubsetType>(space,q),parent);
 }
 
-int MCRPlannerGoalSet::AddNode(const Config& q,const Subset& subset,int parent)
+template <class SubsetType>
+int MCRPlannerGoalSetTemplate<SubsetType>::AddNode(const Config& q,const SubsetType& subset,int parent)
 {
 #if DO_TIMING
   Timer timer;
@@ -584,7 +602,7 @@ int MCRPlannerGoalSet::AddNode(const Config& q,const Subset& subset,int parent)
 
   /*
   //Sanity check?
-  assert(subset == Violations(space,q));
+  assert(subset == Violations<SubsetType>(space,q));
   */
 
   if(parent < 0 || modeGraph.nodes[roadmap.nodes[parent].mode].subset != subset)  {
@@ -631,7 +649,8 @@ int MCRPlannerGoalSet::AddNode(const Config& q,const Subset& subset,int parent)
   return index;
 }
 
-bool MCRPlannerGoalSet::AddEdge(int i,int j,int depth)
+template <class SubsetType>
+bool MCRPlannerGoalSetTemplate<SubsetType>::AddEdge(int i,int j,int depth)
 {
   if(depth >= 10) return false;
   assert(i != j);
@@ -639,7 +658,7 @@ bool MCRPlannerGoalSet::AddEdge(int i,int j,int depth)
   assert(j >= 0 && j < (int)roadmap.nodes.size());
   assert(!roadmap.HasEdge(i,j));
   numEdgeChecks++;
-  Subset ev=Violations(space,roadmap.nodes[i].q,roadmap.nodes[j].q);
+  SubsetType ev=Violations<SubsetType>(space,roadmap.nodes[i].q,roadmap.nodes[j].q);
   int mi = roadmap.nodes[i].mode;
   int mj = roadmap.nodes[j].mode;
   assert(mi >= 0 && mi < (int)modeGraph.nodes.size());
@@ -660,10 +679,11 @@ bool MCRPlannerGoalSet::AddEdge(int i,int j,int depth)
   return true;
 }
 
-int MCRPlannerGoalSet::AddEdge(int i,const Config& q,Real maxExplanationCost)
+template <class SubsetType>
+int MCRPlannerGoalSetTemplate<SubsetType>::AddEdge(int i,const Config& q,Real maxExplanationCost)
 {
   numEdgeChecks++;
-  Subset ev,qv;
+  SubsetType ev,qv;
   numConfigChecks++;
   if(ExceedsCostLimit(q,maxExplanationCost,qv))
     return -1;
@@ -675,7 +695,7 @@ int MCRPlannerGoalSet::AddEdge(int i,const Config& q,Real maxExplanationCost)
     return -1;
   if(!WithinThreshold(modeGraph.nodes[mi],ev,maxExplanationCost,obstacleWeights)) 
     return -1;
-  const Subset& qiv = modeGraph.nodes[mi].subset;
+  const SubsetType& qiv = modeGraph.nodes[mi].subset;
   if(Cost((qiv + qv)) < Cost(ev)) {
     if(space->Distance(roadmap.nodes[i].q,q) < gSubdivideThreshold)
       return -1;
@@ -696,7 +716,8 @@ int MCRPlannerGoalSet::AddEdge(int i,const Config& q,Real maxExplanationCost)
 }
 
 
-void MCRPlannerGoalSet::AddEdgeRaw(int i,int j)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::AddEdgeRaw(int i,int j)
 {
 #if DO_TIMING
   Timer timer;
@@ -745,7 +766,7 @@ void MCRPlannerGoalSet::AddEdgeRaw(int i,int j)
     */
     if(updatePathsComplete) {
       //do a proper update of the irreducible covers
-      vector<Subset> newCovers;
+      vector<SubsetType> newCovers;
       for(size_t p=0;p<ma.pathCovers.size();p++) {
 	bool subset = false;
 	bool equal = false;
@@ -791,7 +812,7 @@ void MCRPlannerGoalSet::AddEdgeRaw(int i,int j)
       }
     }
     ma.minCost = Min(ma.minCost,mb.minCost);
-    ModeGraph::Iterator e;
+    typename ModeGraph::Iterator e;
     for(modeGraph.Begin(mj,e);!e.end();e++) {
       Transition* t=modeGraph.FindEdge(mi,e.target());
       if(t) {
@@ -858,15 +879,16 @@ void MCRPlannerGoalSet::AddEdgeRaw(int i,int j)
 #endif //DO_TIMING
 }
 
-int MCRPlannerGoalSet::ExtendToward(int i,const Config& qdest,Real maxExplorationCost)
+template <class SubsetType>
+int MCRPlannerGoalSetTemplate<SubsetType>::ExtendToward(int i,const Config& qdest,Real maxExplorationCost)
 {
   int mi = roadmap.nodes[i].mode;
-  const Subset& ei = modeGraph.nodes[mi].subset;
+  const SubsetType& ei = modeGraph.nodes[mi].subset;
 
   assert(gMaxExtendTowardIters == 1);
 
   numConfigChecks++;
-  Subset qv,ev;
+  SubsetType qv,ev;
   if(ExceedsCostLimit(qdest,maxExplorationCost,qv))
     return -1;
   if(!WithinThreshold(modeGraph.nodes[mi],qv,maxExplorationCost,obstacleWeights)) 
@@ -896,7 +918,8 @@ int MCRPlannerGoalSet::ExtendToward(int i,const Config& qdest,Real maxExploratio
 }
 
 
-void MCRPlannerGoalSet::KNN(const Config& q,int k,vector<int>& neighbors,vector<Real>& distances)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::KNN(const Config& q,int k,vector<int>& neighbors,vector<Real>& distances)
 {
   //int maxIdx=0;
   distances.resize(0);
@@ -940,7 +963,8 @@ void MCRPlannerGoalSet::KNN(const Config& q,int k,vector<int>& neighbors,vector<
   }
 }
 
-void MCRPlannerGoalSet::KNN(const Config& q,Real maxExplanationCost,int k,vector<int>& neighbors,vector<Real>& distances)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::KNN(const Config& q,Real maxExplanationCost,int k,vector<int>& neighbors,vector<Real>& distances)
 {
   //int maxIdx=0;
   distances.resize(0);
@@ -988,7 +1012,8 @@ void MCRPlannerGoalSet::KNN(const Config& q,Real maxExplanationCost,int k,vector
   }
 }
 
-void MCRPlannerGoalSet::Expand(Real maxExplanationCost,vector<int>& newNodes)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::Expand(Real maxExplanationCost,vector<int>& newNodes)
 {
   numExpands++;
 #if DO_TIMING
@@ -1021,7 +1046,7 @@ void MCRPlannerGoalSet::Expand(Real maxExplanationCost,vector<int>& newNodes)
   //attempt connections
   bool didRefine = false;
   newNodes.resize(0);
-  Subset qsubset;
+  SubsetType qsubset;
   Real minDist = Inf;
   size_t closestIndex = 0;
   for(size_t j=0;j<kclosest.size();j++) 
@@ -1034,7 +1059,7 @@ void MCRPlannerGoalSet::Expand(Real maxExplanationCost,vector<int>& newNodes)
     
     //do a direct connection
     numConfigChecks++;
-    qsubset = Violations(space,q);
+    qsubset = Violations<SubsetType>(space,q);
     
     int nearmode = roadmap.nodes[kneighbors[closestIndex]].mode;
     if(WithinThreshold(modeGraph.nodes[nearmode],qsubset,maxExplanationCost,obstacleWeights)) { //if config itself violates too many constraints, we're not going to connect any nodes
@@ -1148,7 +1173,8 @@ void MCRPlannerGoalSet::Expand(Real maxExplanationCost,vector<int>& newNodes)
   }
 }
 
-void MCRPlannerGoalSet::Expand2(Real maxExplanationCost,vector<int>& newNodes)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::Expand2(Real maxExplanationCost,vector<int>& newNodes)
 {
   numExpands++;
 #if DO_TIMING
@@ -1182,13 +1208,13 @@ void MCRPlannerGoalSet::Expand2(Real maxExplanationCost,vector<int>& newNodes)
   //attempt connections
   bool didRefine = false;
   newNodes.resize(0);
-  Subset qsubset;
+  SubsetType qsubset;
   if(closest[0] < expandDistance) {
     numRefinementAttempts++;
     
     //do a direct connection
     numConfigChecks++;
-    qsubset = Violations(space,q);
+    qsubset = Violations<SubsetType>(space,q);
 
     int nearmode = roadmap.nodes[neighbor[0]].mode;    
     if(WithinThreshold(modeGraph.nodes[nearmode],qsubset,maxExplanationCost,obstacleWeights)) { //if config itself violates too many constraints, we're not going to connect any nodes
@@ -1316,16 +1342,15 @@ void MCRPlannerGoalSet::Expand2(Real maxExplanationCost,vector<int>& newNodes)
   }
 }
 
-void MCRPlannerGoalSet::Plan(int initialLimit,const vector<int>& expansionSchedule,vector<int>& bestPath,Subset& bestCover)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::Plan(int initialLimit,const vector<int>& expansionSchedule,vector<int>& bestPath,SubsetType& bestCover)
 {
-  bestCover.maxItem = space->constraints.size();
-  bestCover.items.resize(bestCover.maxItem);
-  for(int i=0;i<bestCover.maxItem;i++)
-    bestCover.items[i] = (int)i;
+  //start with the cover of all constraints
+  bestCover = -SubsetType((int)space->constraints.size());
 
-  Subset lowerCover;
+  SubsetType lowerCover;
   numConfigChecks += 1;
-  lowerCover=Violations(space,start);
+  lowerCover=Violations<SubsetType>(space,start);
 
   Real lowerCost = Cost(lowerCover);
   Real bestCost = Cost(bestCover);
@@ -1414,7 +1439,8 @@ void MCRPlannerGoalSet::Plan(int initialLimit,const vector<int>& expansionSchedu
   */
 }
 
-void MCRPlannerGoalSet::BuildRoadmap(Real maxExplanationCost,RoadmapPlanner& prm)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::BuildRoadmap(Real maxExplanationCost,RoadmapPlanner& prm)
 {
   vector<bool> useMode(modeGraph.nodes.size());
   for(size_t i=0;i<modeGraph.nodes.size();i++) 
@@ -1436,20 +1462,22 @@ void MCRPlannerGoalSet::BuildRoadmap(Real maxExplanationCost,RoadmapPlanner& prm
   }
 }
 
-void UniformModeDFS(MCRPlannerGoalSet* eep,int mode,int vertex,vector<bool>& marked,vector<int>& visited)
+template <class SubsetType>
+void UniformModeDFS(MCRPlannerGoalSetTemplate<SubsetType>* eep,int mode,int vertex,vector<bool>& marked,vector<int>& visited)
 {
   if(marked[vertex]) return;
   if(eep->roadmap.nodes[vertex].mode != mode) return;
 
   marked[vertex]=true;
   visited.push_back(vertex);
-  Graph::UndirectedEdgeIterator<MCRPlannerGoalSet::Edge> e;
+  Graph::UndirectedEdgeIterator<typename MCRPlannerGoalSetTemplate<SubsetType>::Edge> e;
   for(eep->roadmap.Begin(vertex,e);!e.end();++e) {
     UniformModeDFS(eep,mode,e.target(),marked,visited);
   }
 }
 
-void MCRPlannerGoalSet::BuildCCGraph(Graph::UndirectedGraph<Subset,int>& G)
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::BuildCCGraph(Graph::UndirectedGraph<SubsetType,int>& G)
 {
   vector<int> nodeCCs(roadmap.nodes.size(),-1);
   vector<bool> marked(roadmap.nodes.size(),false);
@@ -1486,28 +1514,30 @@ void MCRPlannerGoalSet::BuildCCGraph(Graph::UndirectedGraph<Subset,int>& G)
 
 
 
+template <class SubsetType>
 struct CoverageLimitedPathCallback: public Graph::PathIntCallback
 {
-  MCRPlannerGoalSet* planner;
-  const Subset& cover;
+  MCRPlannerGoalSetTemplate<SubsetType>* planner;
+  const SubsetType& cover;
 
-  CoverageLimitedPathCallback(MCRPlannerGoalSet* _planner,const Subset& _cover,int _target=-1)
+  CoverageLimitedPathCallback(MCRPlannerGoalSetTemplate<SubsetType>* _planner,const SubsetType& _cover,int _target=-1)
     :PathIntCallback(_planner->roadmap.nodes.size(),_target),planner(_planner),cover(_cover)
   {}
 
   virtual bool ForwardEdge(int i,int j) {
     int modej = planner->roadmap.nodes[j].mode;
-    const Subset& subj = planner->modeGraph.nodes[modej].subset;
+    const SubsetType& subj = planner->modeGraph.nodes[modej].subset;
     return subj.is_subset(cover);
   }
 };
 
-bool MCRPlannerGoalSet::CoveragePath(int s,int t,const Subset& cover,vector<int>& path,Subset& pathCover)
+template <class SubsetType>
+bool MCRPlannerGoalSetTemplate<SubsetType>::CoveragePath(int s,int t,const SubsetType& cover,vector<int>& path,SubsetType& pathCover)
 {
   CoverageLimitedPathCallback callback(this,cover,t);
   roadmap._DFS(s,callback);
   if(Graph::GetAncestorPath(callback.parents,t,s,path)) {
-    pathCover = Subset();
+    pathCover = SubsetType();
     for(size_t i=0;i<path.size();i++)
       pathCover = pathCover + modeGraph.nodes[roadmap.nodes[path[i]].mode].subset;
     return true;
@@ -1519,9 +1549,10 @@ bool MCRPlannerGoalSet::CoveragePath(int s,int t,const Subset& cover,vector<int>
 /** Uses size comparisons for a partial ordering,
  * rather than element comparisons
  */
+template <class SubsetType>
 struct SubsetCost
 {
-  Subset subset;
+  SubsetType subset;
   Real pathCost;
   vector<Real>* weights;
 
@@ -1529,15 +1560,15 @@ struct SubsetCost
     :subset(maxItem),pathCost(cost),weights(_weights)
   {}
 
-  SubsetCost(const Subset& s,Real cost=0,vector<Real>* _weights=NULL)
+  SubsetCost(const SubsetType& s,Real cost=0,vector<Real>* _weights=NULL)
     :subset(s),pathCost(cost),weights(_weights)
   {}
 
-  SubsetCost(const SubsetCost& s)
+  SubsetCost(const SubsetCost<SubsetType>& s)
     :subset(s.subset),pathCost(s.pathCost),weights(s.weights)
   {}
 
-  bool operator < (const SubsetCost& s) const
+  bool operator < (const SubsetCost<SubsetType>& s) const
   {
     assert(weights==s.weights);
     if(weights) {
@@ -1552,12 +1583,12 @@ struct SubsetCost
     }
   }
 
-  bool operator > (const SubsetCost& s) const
+  bool operator > (const SubsetCost<SubsetType>& s) const
   {
     return s < *this;
   }
 
-  bool operator == (const SubsetCost& s) const
+  bool operator == (const SubsetCost<SubsetType>& s) const
   {
     if(weights)
       return WeightedCost(subset,*weights) == WeightedCost(s.subset,*weights) && pathCost == s.pathCost;
@@ -1565,43 +1596,44 @@ struct SubsetCost
       return subset.size() == s.subset.size() && pathCost == s.pathCost;
   }
   
-  bool operator != (const SubsetCost& s) const
+  bool operator != (const SubsetCost<SubsetType>& s) const
   {
     return !(operator == (s));
   }
 
-  SubsetCost operator + (const SubsetCost& s) const
+  SubsetCost<SubsetType> operator + (const SubsetCost<SubsetType>& s) const
   {
-    return SubsetCost(subset+s.subset,pathCost + s.pathCost,weights);
+    return SubsetCost<SubsetType>(subset+s.subset,pathCost + s.pathCost,weights);
   }
 
-  SubsetCost operator - () const
+  SubsetCost<SubsetType> operator - () const
   {
-    return SubsetCost (-subset,-pathCost,weights);
+    return SubsetCost<SubsetType> (-subset,-pathCost,weights);
   }
 };
 
 
-struct GreedySubsetAStar2 : public GeneralizedAStar<int,SubsetCost>
+template <class SubsetType>
+struct GreedySubsetAStar2 : public GeneralizedAStar<int,SubsetCost<SubsetType> >
 {
-  typedef GeneralizedAStar<int,SubsetCost>::Node Node;
-  MCRPlannerGoalSet* planner;
+  typedef typename GeneralizedAStar<int,SubsetCost<SubsetType> >::Node Node;
+  MCRPlannerGoalSetTemplate<SubsetType>* planner;
   int startNode;
   set<int> targetNodes;
   vector<Node*> visited;
 
-  GreedySubsetAStar2(MCRPlannerGoalSet* _planner,int _start,const vector<int> _targets)
+  GreedySubsetAStar2(MCRPlannerGoalSetTemplate<SubsetType>* _planner,int _start,const vector<int> _targets)
     :planner(_planner),startNode(_start),targetNodes(_targets.begin(),_targets.end())
   {
-    SetStart(_start);
-    root.g = SubsetCost(planner->modeGraph.nodes[planner->roadmap.nodes[startNode].mode].subset,0,&planner->obstacleWeights);
-    root.f = root.g;
+    this->SetStart(_start);
+    this->root.g = SubsetCost<SubsetType>(planner->modeGraph.nodes[planner->roadmap.nodes[startNode].mode].subset,0,&planner->obstacleWeights);
+    this->root.f = this->root.g;
   }
 
   virtual bool IsGoal(const int& s) { return targetNodes.count(s)!=0; }
 
-  virtual void Successors(const int& s,vector<int>& successors,vector<SubsetCost>& cost) {
-    Graph::UndirectedEdgeIterator<MCRPlannerGoalSet::Edge> e;
+  virtual void Successors(const int& s,vector<int>& successors,vector<SubsetCost<SubsetType> >& cost) {
+    Graph::UndirectedEdgeIterator<typename MCRPlannerGoalSetTemplate<SubsetType>::Edge> e;
     successors.resize(0);
     cost.resize(0);
     for(planner->roadmap.Begin(s,e);!e.end();e++) {
@@ -1610,12 +1642,12 @@ struct GreedySubsetAStar2 : public GeneralizedAStar<int,SubsetCost>
       successors.push_back(e.target());
       int mode=planner->roadmap.nodes[e.target()].mode;
       if(mode != planner->roadmap.nodes[s].mode) { //transition
-	SubsetCost c(planner->modeGraph.nodes[mode].subset,dist,&planner->obstacleWeights);
+	SubsetCost<SubsetType> c(planner->modeGraph.nodes[mode].subset,dist,&planner->obstacleWeights);
 	cost.push_back(c);
       }
       else {
 	//same subset
-	SubsetCost c(planner->space->constraints.size(),dist);
+	SubsetCost<SubsetType> c(planner->space->constraints.size(),dist);
 	cost.push_back(c);
       }
     }
@@ -1639,28 +1671,29 @@ struct GreedySubsetAStar2 : public GeneralizedAStar<int,SubsetCost>
 };
 
 
-struct OptimalSubsetAStar2 : public GeneralizedAStar<pair<int,Subset>,SubsetCost>
+template <class SubsetType>
+struct OptimalSubsetAStar2 : public GeneralizedAStar<pair<int,SubsetType>,SubsetCost<SubsetType> >
 {
-  typedef pair<int,Subset> State;
-  typedef GeneralizedAStar<State,SubsetCost>::Node Node;
-  MCRPlannerGoalSet* planner;
+  typedef pair<int,SubsetType> State;
+  typedef typename GeneralizedAStar<State,SubsetCost<SubsetType> >::Node Node;
+  MCRPlannerGoalSetTemplate<SubsetType>* planner;
   int startNode;
   set<int> targetNodes;
-  vector<vector<pair<Subset,Node*> > > visited;
+  vector<vector<pair<SubsetType,Node*> > > visited;
 
-  OptimalSubsetAStar2(MCRPlannerGoalSet* _planner,int _start,const vector<int>& _targets)
+  OptimalSubsetAStar2(MCRPlannerGoalSetTemplate<SubsetType>* _planner,int _start,const vector<int>& _targets)
     :planner(_planner),startNode(_start),targetNodes(_targets.begin(),_targets.end())
   {
-    const Subset& m0=planner->modeGraph.nodes[planner->roadmap.nodes[startNode].mode].subset;
-    SetStart(pair<int,Subset>(_start,m0));
-    root.g = SubsetCost(m0,0,&planner->obstacleWeights);
-    root.f = root.g;
+    const SubsetType& m0=planner->modeGraph.nodes[planner->roadmap.nodes[startNode].mode].subset;
+    this->SetStart(pair<int,SubsetType>(_start,m0));
+    this->root.g = SubsetCost<SubsetType>(m0,0,&planner->obstacleWeights);
+    this->root.f = this->root.g;
   }
 
   virtual bool IsGoal(const State& s) { return targetNodes.count(s.first)!=0; }
 
-  virtual void Successors(const State& s,vector<State>& successors,vector<SubsetCost>& cost) {
-    Graph::UndirectedEdgeIterator<MCRPlannerGoalSet::Edge> e;
+  virtual void Successors(const State& s,vector<State>& successors,vector<SubsetCost<SubsetType> >& cost) {
+    Graph::UndirectedEdgeIterator<typename MCRPlannerGoalSetTemplate<SubsetType>::Edge> e;
     successors.resize(0);
     cost.resize(0);
     for(planner->roadmap.Begin(s.first,e);!e.end();e++) {
@@ -1668,15 +1701,15 @@ struct OptimalSubsetAStar2 : public GeneralizedAStar<pair<int,Subset>,SubsetCost
 
       int mode=planner->roadmap.nodes[e.target()].mode;
       if(mode != planner->roadmap.nodes[s.first].mode) { //transition
-	SubsetCost c(planner->modeGraph.nodes[mode].subset,dist,&planner->obstacleWeights);
+	SubsetCost<SubsetType> c(planner->modeGraph.nodes[mode].subset,dist,&planner->obstacleWeights);
 	cost.push_back(c);
       }
       else {
 	//same subset
-	SubsetCost c(planner->space->constraints.size(),dist,&planner->obstacleWeights);
+	SubsetCost<SubsetType> c(planner->space->constraints.size(),dist,&planner->obstacleWeights);
 	cost.push_back(c);
       }
-      successors.push_back(pair<int,Subset>(e.target(),cost.back().subset+s.second));
+      successors.push_back(pair<int,SubsetType>(e.target(),cost.back().subset+s.second));
     }
   }
 
@@ -1688,7 +1721,7 @@ struct OptimalSubsetAStar2 : public GeneralizedAStar<pair<int,Subset>,SubsetCost
 
   virtual void Visit(const State& s,Node* n)
   {
-    visited[s.first].push_back(pair<Subset,Node*>(s.second,n));
+    visited[s.first].push_back(pair<SubsetType,Node*>(s.second,n));
   }
 
   virtual Node* VisitedStateNode(const State& s)
@@ -1702,16 +1735,17 @@ struct OptimalSubsetAStar2 : public GeneralizedAStar<pair<int,Subset>,SubsetCost
 };
 
 
-bool MCRPlannerGoalSet::GreedyPath(int s,int t,vector<int>& path,Subset& pathCover)
+template <class SubsetType>
+bool MCRPlannerGoalSetTemplate<SubsetType>::GreedyPath(int s,int t,vector<int>& path,SubsetType& pathCover)
 {
   vector<int> tgts(1,t);
-  GreedySubsetAStar2 astar(this,s,tgts);
+  GreedySubsetAStar2<SubsetType> astar(this,s,tgts);
   if(!astar.Search()) {
     path.clear();
     return false;
   }
   else {
-    GreedySubsetAStar2::Node* n=astar.goal;
+    typename GreedySubsetAStar2<SubsetType>::Node* n=astar.goal;
     path.resize(0);
     while(n) {
       path.push_back(n->data);
@@ -1724,16 +1758,17 @@ bool MCRPlannerGoalSet::GreedyPath(int s,int t,vector<int>& path,Subset& pathCov
 }
 
 
-bool MCRPlannerGoalSet::OptimalPath(int s,int t,vector<int>& path,Subset& pathCover)
+template <class SubsetType>
+bool MCRPlannerGoalSetTemplate<SubsetType>::OptimalPath(int s,int t,vector<int>& path,SubsetType& pathCover)
 {
   vector<int> tgts(1,t);
-  OptimalSubsetAStar2 astar(this,s,tgts);
+  OptimalSubsetAStar2<SubsetType> astar(this,s,tgts);
   if(!astar.Search()) {
     path.clear();
     return false;
   }
   else {
-    OptimalSubsetAStar2::Node* n=astar.goal;
+    typename OptimalSubsetAStar2<SubsetType>::Node* n=astar.goal;
     path.resize(0);
     while(n) {
       path.push_back(n->data.first);
@@ -1746,15 +1781,16 @@ bool MCRPlannerGoalSet::OptimalPath(int s,int t,vector<int>& path,Subset& pathCo
 }
 
 
-bool MCRPlannerGoalSet::GreedyPath(vector<int>& path,Subset& pathCover)
+template <class SubsetType>
+bool MCRPlannerGoalSetTemplate<SubsetType>::GreedyPath(vector<int>& path,SubsetType& pathCover)
 {
-  GreedySubsetAStar2 astar(this,0,goalNodes);
+  GreedySubsetAStar2<SubsetType> astar(this,0,goalNodes);
   if(!astar.Search()) {
     path.clear();
     return false;
   }
   else {
-    GreedySubsetAStar2::Node* n=astar.goal;
+    typename GreedySubsetAStar2<SubsetType>::Node* n=astar.goal;
     path.resize(0);
     while(n) {
       path.push_back(n->data);
@@ -1767,15 +1803,16 @@ bool MCRPlannerGoalSet::GreedyPath(vector<int>& path,Subset& pathCover)
 }
 
 
-bool MCRPlannerGoalSet::OptimalPath(vector<int>& path,Subset& pathCover)
+template <class SubsetType>
+bool MCRPlannerGoalSetTemplate<SubsetType>::OptimalPath(vector<int>& path,SubsetType& pathCover)
 {
-  OptimalSubsetAStar2 astar(this,0,goalNodes);
+  OptimalSubsetAStar2<SubsetType> astar(this,0,goalNodes);
   if(!astar.Search()) {
     path.clear();
     return false;
   }
   else {
-    OptimalSubsetAStar2::Node* n=astar.goal;
+    typename OptimalSubsetAStar2<SubsetType>::Node* n=astar.goal;
     path.resize(0);
     while(n) {
       path.push_back(n->data.first);
@@ -1788,7 +1825,8 @@ bool MCRPlannerGoalSet::OptimalPath(vector<int>& path,Subset& pathCover)
 }
 
 
-void MCRPlannerGoalSet::GetMilestonePath(const std::vector<int>& path,MilestonePath& mpath) const
+template <class SubsetType>
+void MCRPlannerGoalSetTemplate<SubsetType>::GetMilestonePath(const std::vector<int>& path,MilestonePath& mpath) const
 {
   mpath.edges.resize(path.size()-1);
   for(size_t i=0;i+1<path.size();i++) {
@@ -1801,3 +1839,6 @@ void MCRPlannerGoalSet::GetMilestonePath(const std::vector<int>& path,MilestoneP
     assert(mpath.edges[i]->End()==roadmap.nodes[path[i+1]].q);
   }
 }
+
+template class MCRPlannerGoalSetTemplate<Subset>;
+template class MCRPlannerGoalSetTemplate<BitSubset>;
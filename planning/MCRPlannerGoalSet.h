@@ -26,8 +26,15 @@
  *   //output best path
  *   MilestonePath path;
  *   planner.GetMilestonePath(bestPlan,path);
+ *
+ * The planner is templated on the type used to store the sets of violated
+ * constraints, which are united and compared on every roadmap update.
+ * MCRPlannerGoalSet uses the sparse Subset, and BitMCRPlannerGoalSet uses
+ * the dense BitSubset, which is usually faster when the space has few
+ * constraints or the covers are large.
  */
-class MCRPlannerGoalSet
+template <class SubsetType>
+class MCRPlannerGoalSetTemplate
 {
  public:
   struct Milestone {
@@ -41,9 +48,9 @@ class MCRPlannerGoalSet
   typedef Graph::UndirectedGraph<Milestone,Edge> Roadmap;
 
   struct Mode {
-    Subset subset;      //subset covered by this mode
+    SubsetType subset;      //subset covered by this mode
     std::vector<int> roadmapNodes;
-    std::vector<Subset> pathCovers;   //minimal covers leading from the start to this mode
+    std::vector<SubsetType> pathCovers;   //minimal covers leading from the start to this mode
     Real minCost;
   };
   struct Transition {
@@ -51,33 +58,33 @@ class MCRPlannerGoalSet
   };
   typedef Graph::UndirectedGraph<Mode,Transition> ModeGraph;
 
-  MCRPlannerGoalSet(CSpace* space);
+  MCRPlannerGoalSetTemplate(CSpace* space);
   void Init(const Config& start,CSet* goal);
   ///Performs one iteration of planning given a limit on the explanation size
   void Expand(Real maxExplanationCost,vector<int>& newNodes);
   void Expand2(Real maxExplanationCost,vector<int>& newNodes);
   ///Performs bottom-up planning according to a given limit expansion schedule
-  void Plan(int initialLimit,const vector<int>& expansionSchedule,vector<int>& bestPath,Subset& cover);
+  void Plan(int initialLimit,const vector<int>& expansionSchedule,vector<int>& bestPath,SubsetType& cover);
   ///Outputs the graph with the given explanation limit
   void BuildRoadmap(Real maxExplanationCost,RoadmapPlanner& prm);
   ///Outputs the CC graph.  Each node is a connected component of the roadmap
   ///within the same subset.
-  void BuildCCGraph(Graph::UndirectedGraph<Subset,int>& G);
+  void BuildCCGraph(Graph::UndirectedGraph<SubsetType,int>& G);
   ///A search that finds a path subject to a coverage constraint
-  bool CoveragePath(int s,int t,const Subset& cover,std::vector<int>& path,Subset& pathCover);
+  bool CoveragePath(int s,int t,const SubsetType& cover,std::vector<int>& path,SubsetType& pathCover);
   ///A greedy heuristic that performs smallest cover given predecessor
-  bool GreedyPath(int s,int t,std::vector<int>& path,Subset& pathCover);
+  bool GreedyPath(int s,int t,std::vector<int>& path,SubsetType& pathCover);
   ///An optimal search
-  bool OptimalPath(int s,int t,std::vector<int>& path,Subset& pathCover);
+  bool OptimalPath(int s,int t,std::vector<int>& path,SubsetType& pathCover);
   /// Returns the best GreedyPath out of any start->goal path
-  bool GreedyPath(std::vector<int>& path,Subset& pathCover);
+  bool GreedyPath(std::vector<int>& path,SubsetType& pathCover);
   /// Returns the best OptimalPath out of any start->goal path
-  bool OptimalPath(std::vector<int>& path,Subset& pathCover);
+  bool OptimalPath(std::vector<int>& path,SubsetType& pathCover);
 
   //helpers
-  Real Cost(const Subset& s) const;
+  Real Cost(const SubsetType& s) const;
   int AddNode(const Config& q,int parent=-1);
-  int AddNode(const Config& q,const Subset& subset,int parent=-1);
+  int AddNode(const Config& q,const SubsetType& subset,int parent=-1);
   bool AddEdge(int i,int j,int depth=0);
   int AddEdge(int i,const Config& q,Real maxExplanationCost);  //returns index of q
   void AddEdgeRaw(int i,int j);
@@ -95,13 +102,13 @@ class MCRPlannerGoalSet
   void UpdateMinCost(Mode& m);
   //fast checking of whether the cost of the local constraints at q exceed the
   //given limit
-  bool ExceedsCostLimit(const Config& q,Real limit,Subset& violations);
+  bool ExceedsCostLimit(const Config& q,Real limit,SubsetType& violations);
   //fast checking of whether the cost of the local constraints violated on 
   //the edge ab exceed the given limit
-  bool ExceedsCostLimit(const Config& a,const Config& b,Real limit,Subset& violations);
+  bool ExceedsCostLimit(const Config& a,const Config& b,Real limit,SubsetType& violations);
 
   ///Computes the cover of the path
-  void GetCover(const std::vector<int>& path,Subset& cover) const;
+  void GetCover(const std::vector<int>& path,SubsetType& cover) const;
   ///Computes the length of the path
   Real GetLength(const std::vector<int>& path) const;
   ///Returns the MilestonePath
@@ -142,4 +149,7 @@ class MCRPlannerGoalSet
   double timeNearestNeighbors,timeRefine,timeExplore,timeUpdatePaths,timeOverhead;
 };
 
+typedef MCRPlannerGoalSetTemplate<Subset> MCRPlannerGoalSet;
+typedef MCRPlannerGoalSetTemplate<BitSubset> BitMCRPlannerGoalSet;
+
 #endif
@@ -1,5 +1,6 @@
 #include "MotionPlanner.h"
 #include "PointLocation.h"
+#include "RoadmapFile.h"
 #include <graph/Path.h>
 #include <graph/ShortestPaths.h>
 #include <math/random.h>
@@ -71,6 +72,7 @@ void RoadmapPlanner::Cleanup()
   roadmap.Cleanup();
   ccs.Clear();
   pointLocator->OnClear();
+  infeasibleEdges.clear();
 }
 
 void RoadmapPlanner::GenerateConfig(Config& x)
@@ -100,12 +102,15 @@ void RoadmapPlanner::ConnectEdge(int i,int j,const SmartPointer<EdgePlanner>& e)
 
 SmartPointer<EdgePlanner> RoadmapPlanner::TestAndConnectEdge(int i,int j)
 {
+  pair<int,int> key(Min(i,j),Max(i,j));
+  if(infeasibleEdges.count(key) != 0) return NULL;
   SmartPointer<EdgePlanner> e=space->LocalPlanner(roadmap.nodes[i],roadmap.nodes[j]);
   if(e->IsVisible()) {
     ConnectEdge(i,j,e);
     return e;
   }
   else {
+    infeasibleEdges.insert(key);
     e=NULL;
     return NULL;
   }
@@ -247,6 +252,58 @@ void RoadmapPlanner::CreatePath(int i,int j,MilestonePath& path)
   Assert(path.IsValid());
 }
 
+bool RoadmapPlanner::SaveRoadmap(const char* fn)
+{
+  vector<pair<int,int> > edges;
+  vector<unsigned char> status;
+  for(size_t i=0;i<roadmap.nodes.size();i++) {
+    for(Roadmap::EdgeListIterator e=roadmap.edges[i].begin();e!=roadmap.edges[i].end();e++) {
+      edges.push_back(pair<int,int>((int)i,e->first));
+      status.push_back(RoadmapFile::Feasible);
+    }
+  }
+  for(set<pair<int,int> >::const_iterator i=infeasibleEdges.begin();i!=infeasibleEdges.end();i++) {
+    edges.push_back(*i);
+    status.push_back(RoadmapFile::Infeasible);
+  }
+  return RoadmapFile::Save(fn,roadmap.nodes,edges,status,space->constraintNames);
+}
+
+bool RoadmapPlanner::LoadRoadmap(const char* fn,const vector<string>& changedConstraints)
+{
+  RoadmapFile file;
+  if(!file.Open(fn)) return false;
+  if(!roadmap.nodes.empty() && file.numMilestones > 0 && file.dimension != roadmap.nodes[0].n) {
+    fprintf(stderr,"RoadmapPlanner::LoadRoadmap: file has dimension %d, roadmap has dimension %d\n",file.dimension,roadmap.nodes[0].n);
+    return false;
+  }
+  vector<bool> valid;
+  vector<unsigned char> status;
+  file.Validate(space,changedConstraints,true,valid,status);
+
+  vector<int> index(file.numMilestones,-1);
+  Config q;
+  roadmap.nodes.reserve(roadmap.nodes.size()+file.numMilestones);
+  for(int i=0;i<file.numMilestones;i++) {
+    if(!valid[i]) continue;
+    file.GetMilestone(i,q);
+    index[i] = roadmap.AddNode(q);
+    ccs.AddNode();
+  }
+  for(int i=0;i<file.numEdges;i++) {
+    int a=index[file.EdgeStart(i)],b=index[file.EdgeEnd(i)];
+    if(a < 0 || b < 0 || a == b) continue;
+    if(status[i] == RoadmapFile::Feasible) {
+      if(!roadmap.HasEdge(a,b))
+        ConnectEdge(a,b,space->LocalPlanner(roadmap.nodes[a],roadmap.nodes[b]));
+    }
+    else if(status[i] == RoadmapFile::Infeasible)
+      infeasibleEdges.insert(pair<int,int>(Min(a,b),Max(a,b)));
+  }
+  pointLocator->OnBuild();
+  return true;
+}
+
 
 
 TreeRoadmapPlanner::TreeRoadmapPlanner(CSpace* s)
@@ -7,6 +7,8 @@
 #include <KrisLibrary/utils/SmartPointer.h>
 #include <vector>
 #include <list>
+#include <set>
+#include <string>
 #include "CSpace.h"
 #include "EdgePlanner.h"
 #include "Path.h"
@@ -42,11 +44,21 @@ public:
   virtual void ConnectToNearestNeighbors(int i,int k,bool ccReject=true);
   virtual void Generate(int numSamples,Real connectionThreshold); 
   virtual void CreatePath(int i,int j,MilestonePath& path);
+  ///Saves the roadmap, including the edges known to be infeasible, to a
+  ///file in the RoadmapFile format
+  virtual bool SaveRoadmap(const char* fn);
+  ///Appends a roadmap saved by SaveRoadmap.  The roadmap is revalidated
+  ///against the constraints of the space (see RoadmapFile::Validate) and
+  ///unchecked edges are dropped.  The point locator is rebuilt once at the
+  ///end.
+  virtual bool LoadRoadmap(const char* fn,const std::vector<std::string>& changedConstraints=std::vector<std::string>());
 
   CSpace* space;
   Roadmap roadmap;
   Graph::ConnectedComponents ccs;
   SmartPointer<PointLocationBase> pointLocator;
+  ///Edges (i,j), i<j, that TestAndConnectEdge found to be infeasible
+  std::set<std::pair<int,int> > infeasibleEdges;
 };
 
 
@@ -1,9 +1,13 @@
 #include "OptimalMotionPlanner.h"
 #include "PointLocation.h"
 #include "GeneralizedAStar.h"
+#include "RoadmapFile.h"
 #include <math/random.h>
+#include <math/sample.h>
 #include <graph/Path.h>
+#include <utils/PropertyMap.h>
 #include <Timer.h>
+#include <algorithm>
 
 //if this is on, this will check any optimal edges as they are added
 #define PRECHECK_OPTIMAL_EDGES 1
@@ -457,6 +461,107 @@ void PRMStarPlanner::PlanMore()
   }
 }
 
+bool PRMStarPlanner::SaveRoadmap(const char* fn)
+{
+  bool useSppLB = (lazy || (rrg && suboptimalityFactor > 0));
+  const Roadmap& g = (useSppLB ? LBroadmap : roadmap);
+  vector<pair<int,int> > edges;
+  vector<unsigned char> status;
+  for(size_t i=0;i<g.nodes.size();i++) {
+    for(Roadmap::ConstEdgeListIterator e=g.edges[i].begin();e!=g.edges[i].end();e++) {
+      edges.push_back(pair<int,int>((int)i,e->first));
+      if(useSppLB && !roadmap.HasEdge((int)i,e->first))
+        status.push_back(RoadmapFile::Unchecked);
+      else
+        status.push_back(RoadmapFile::Feasible);
+    }
+  }
+  return RoadmapFile::Save(fn,roadmap.nodes,edges,status,space->constraintNames);
+}
+
+bool PRMStarPlanner::LoadRoadmap(const char* fn,const vector<string>& changedConstraints)
+{
+  if(start < 0 || goal < 0) {
+    fprintf(stderr,"PRMStarPlanner::LoadRoadmap(): Init() must be called before loading\n");
+    return false;
+  }
+  RoadmapFile file;
+  if(!file.Open(fn)) return false;
+  if(file.numMilestones > 0 && file.dimension != roadmap.nodes[start].n) {
+    fprintf(stderr,"PRMStarPlanner::LoadRoadmap: file has dimension %d, roadmap has dimension %d\n",file.dimension,roadmap.nodes[start].n);
+    return false;
+  }
+  bool useSppLB = (lazy || (rrg && suboptimalityFactor > 0));
+  bool useSppGoal = (bidirectional || (lazy && PRECHECK_OPTIMAL_EDGES));
+  vector<bool> valid;
+  vector<unsigned char> status;
+  file.Validate(space,changedConstraints,!useSppLB,valid,status);
+
+  //add the milestones all at once, as in AddMilestone
+  vector<int> index(file.numMilestones,-1);
+  Config q;
+  for(int i=0;i<file.numMilestones;i++) {
+    if(!valid[i]) continue;
+    file.GetMilestone(i,q);
+    index[i] = roadmap.AddNode(q);
+    ccs.AddNode();
+    if(useSppLB) LBroadmap.AddNode(q);
+  }
+  int n = (int)roadmap.nodes.size();
+  spp.p.resize(n,-1);
+  spp.d.resize(n,Inf);
+  if(useSppLB) {
+    sppLB.p.resize(n,-1);
+    sppLB.d.resize(n,Inf);
+  }
+  if(useSppGoal) {
+    sppGoal.p.resize(n,-1);
+    sppGoal.d.resize(n,Inf);
+    if(useSppLB) {
+      sppLBGoal.p.resize(n,-1);
+      sppLBGoal.d.resize(n,Inf);
+    }
+  }
+  pointLocator->OnBuild();
+
+  for(int i=0;i<file.numEdges;i++) {
+    int a=index[file.EdgeStart(i)],b=index[file.EdgeEnd(i)];
+    if(a < 0 || b < 0 || a == b) continue;
+    if(status[i] == RoadmapFile::Feasible)
+      ConnectEdge(a,b,space->LocalPlanner(roadmap.nodes[a],roadmap.nodes[b]));
+    else if(status[i] == RoadmapFile::Unchecked && useSppLB)
+      ConnectEdgeLazy(a,b,space->LocalPlanner(roadmap.nodes[a],roadmap.nodes[b]));
+  }
+
+  //connect the start and goal to the loaded roadmap
+  int terminals[2] = {start,goal};
+  for(int k=0;k<2;k++) {
+    int m = terminals[k];
+    const Config& x = roadmap.nodes[m];
+    int kmax = int(connectNeighborsConstant*((1.0+1.0/x.n)*E)*Log(Real(n)));
+    if(kmax <= 0) kmax = 1;
+    if(kmax > n-1) kmax = n-1;
+    vector<int> neighbors;
+    KNN(x,kmax,neighbors);
+    for(size_t i=0;i<neighbors.size();i++) {
+      int j = neighbors[i];
+      if(j == m || roadmap.HasEdge(m,j) || (useSppLB && LBroadmap.HasEdge(m,j))) continue;
+      if(space->Distance(x,roadmap.nodes[j]) > connectionThreshold) continue;
+      SmartPointer<EdgePlanner> e = space->LocalPlanner(x,roadmap.nodes[j]);
+      if(lazy)
+        ConnectEdgeLazy(m,j,e);
+      else {
+        numEdgeChecks++;
+        if(e->IsVisible())
+          ConnectEdge(m,j,e);
+      }
+    }
+  }
+  if(lazy && !IsInf(sppLB.d[goal]))
+    CheckPath(start,goal);
+  return true;
+}
+
 int PRMStarPlanner::AddMilestone(const Config& x)
 {
   bool useSppLB = (lazy || (rrg && suboptimalityFactor > 0));
@@ -856,3 +961,690 @@ bool PRMStarPlanner::CheckPath(int a,int b)
   }
   return false;
 }
+
+
+//volume of the unit ball in d dimensions, by the recurrence V(d) = 2pi/d V(d-2)
+static Real UnitBallVolume(int d)
+{
+  if(d <= 0) return 1;
+  if(d == 1) return 2;
+  return TwoPi/Real(d)*UnitBallVolume(d-2);
+}
+
+InformedSampler::InformedSampler(CSpace* _space)
+  :space(_space),cmin(0),maxRejections(100),dimension(0),euclidean(false),volume(1)
+{}
+
+void InformedSampler::Init(const Config& _start,const Config& _goal)
+{
+  start = _start;
+  goal = _goal;
+  cmin = space->Distance(start,goal);
+
+  PropertyMap props;
+  space->Properties(props);
+  if(!props.get("intrinsicDimension",dimension))
+    dimension = start.n;
+  string metric;
+  int euc;
+  euclidean = false;
+  if(props.get("euclidean",euc)) euclidean = (euc != 0);
+  else if(props.get("metric",metric)) euclidean = (metric == "euclidean" || metric == "weighted euclidean");
+  if(dimension != start.n) euclidean = false;
+  vector<Real> vmin,vmax,w;
+  bmin.clear();
+  bmax.clear();
+  weights.clear();
+  if(props.getArray("minimum",vmin) && props.getArray("maximum",vmax) && (int)vmin.size()==start.n && (int)vmax.size()==start.n) {
+    bmin = vmin;
+    bmax = vmax;
+  }
+  if(props.getArray("metricWeights",w) && (int)w.size()==start.n)
+    weights = w;
+  if(!props.get("volume",volume)) {
+    Real diameter;
+    if(!bmin.empty()) {
+      volume = 1;
+      for(int i=0;i<bmin.n;i++) volume *= bmax[i]-bmin[i];
+    }
+    else if(props.get("diameter",diameter))
+      volume = Pow(diameter,Real(dimension));
+    else
+      volume = 1;
+  }
+
+  if(euclidean) {
+    //work in coordinates z = sqrt(w)*x, in which the metric is L2
+    Vector zs=start,zg=goal;
+    for(int i=0;i<weights.n;i++) {
+      zs[i] *= Sqrt(weights[i]);
+      zg[i] *= Sqrt(weights[i]);
+    }
+    center = (zs+zg)*0.5;
+    Vector axis = zg-zs;
+    Real len = axis.norm();
+    householder.resize(start.n,0.0);
+    if(len > 0) {
+      axis /= len;
+      householder = axis;
+      householder *= -1.0;
+      householder[0] += 1.0;
+    }
+  }
+}
+
+Real InformedSampler::Heuristic(const Config& x) const
+{
+  return space->Distance(start,x) + space->Distance(x,goal);
+}
+
+Real InformedSampler::Measure(Real cbest) const
+{
+  if(IsInf(cbest) || !euclidean) return volume;
+  if(cbest <= cmin) return 0;
+  int n = start.n;
+  Real m = UnitBallVolume(n)*0.5*cbest*Pow(0.5*Sqrt(Sqr(cbest)-Sqr(cmin)),Real(n-1));
+  for(int i=0;i<weights.n;i++)
+    m /= Sqrt(weights[i]);
+  return Min(m,volume);
+}
+
+bool InformedSampler::Sample(Real cbest,Config& x)
+{
+  if(IsInf(cbest)) {
+    space->Sample(x);
+    return true;
+  }
+  if(cbest <= cmin) return false;
+  //only sample the hyperspheroid directly if it's smaller than the space
+  bool direct = (euclidean && !bmin.empty() && Measure(cbest) < volume);
+  int n = start.n;
+  vector<Real> y(n);
+  Real r1 = 0.5*cbest, r2 = 0.5*Sqrt(Sqr(cbest)-Sqr(cmin));
+  Real hh = householder.normSquared();
+  for(int iters=0;iters<maxRejections;iters++) {
+    if(direct) {
+      SampleHyperBall(1.0,y);
+      x.resize(n);
+      x[0] = y[0]*r1;
+      for(int i=1;i<n;i++) x[i] = y[i]*r2;
+      if(hh > 0) {
+        Real scale = 2.0*x.dot(householder)/hh;
+        x.madd(householder,-scale);
+      }
+      x += center;
+      for(int i=0;i<weights.n;i++)
+        x[i] /= Sqrt(weights[i]);
+      bool inside = true;
+      for(int i=0;i<n;i++)
+        if(x[i] < bmin[i] || x[i] > bmax[i]) { inside = false; break; }
+      if(!inside) continue;
+    }
+    else
+      space->Sample(x);
+    if(Heuristic(x) < cbest) return true;
+  }
+  return false;
+}
+
+Real InformedSampler::ConnectionRadius(Real cbest,int n,Real rewireFactor) const
+{
+  Real d = Real(dimension);
+  if(n < 2) n = 2;
+  Real gamma = 2.0*Pow(1.0+1.0/d,1.0/d)*Pow(Measure(cbest)/UnitBallVolume(dimension),1.0/d);
+  return rewireFactor*gamma*Pow(Log(Real(n))/Real(n),1.0/d);
+}
+
+
+//Gets the indices and distances of the points within distance r of
+//roadmap node i, excluding i itself
+static void CloseNeighbors(RoadmapPlanner& planner,int i,Real r,vector<int>& nn,vector<Real>& distances)
+{
+  nn.resize(0);
+  distances.resize(0);
+  const Config& x = planner.roadmap.nodes[i];
+  if(!planner.pointLocator->Close(x,r,nn,distances)) {
+    nn.resize(0);
+    distances.resize(0);
+    for(size_t j=0;j<planner.roadmap.nodes.size();j++) {
+      Real d = planner.space->Distance(x,planner.roadmap.nodes[j]);
+      if(d < r) {
+        nn.push_back((int)j);
+        distances.push_back(d);
+      }
+    }
+  }
+  for(size_t k=0;k<nn.size();k++) {
+    if(nn[k] == i) {
+      nn[k] = nn.back();
+      distances[k] = distances.back();
+      nn.resize(nn.size()-1);
+      distances.resize(distances.size()-1);
+      break;
+    }
+  }
+}
+
+//Extracts the path from the root to n in a tree stored in the planner's
+//roadmap, with edges starting at the parent
+static void GetTreePath(RoadmapPlanner& planner,const vector<int>& parent,int n,MilestonePath& path)
+{
+  path.edges.resize(0);
+  while(parent[n] >= 0) {
+    SmartPointer<EdgePlanner>* e = planner.roadmap.FindEdge(parent[n],n);
+    Assert(e != NULL);
+    path.edges.push_back(*e);
+    n = parent[n];
+  }
+  reverse(path.edges.begin(),path.edges.end());
+}
+
+
+FMTStarPlanner::FMTStarPlanner(CSpace* space)
+  :RoadmapPlanner(space),batchSize(100),rewireFactor(1.1),connectionThreshold(Inf),informed(true),start(-1),goal(-1),sampler(space),bestCost(Inf),numBatches(0),radius(0)
+{
+  numPlanSteps = 0;
+  numConfigChecks = 0;
+  numEdgeChecks = 0;
+  tCheck=tKnn=tConnect=0;
+}
+
+void FMTStarPlanner::Cleanup()
+{
+  RoadmapPlanner::Cleanup();
+  status.clear();
+  cost.clear();
+  parent.clear();
+  neighbors.clear();
+  neighborDistances.clear();
+  neighborsComputed.clear();
+  while(!open.empty()) open.pop();
+  failedEdges.clear();
+}
+
+void FMTStarPlanner::Init(const Config& qstart,const Config& qgoal)
+{
+  Cleanup();
+  sampler.Init(qstart,qgoal);
+  start = AddMilestone(qstart);
+  goal = AddMilestone(qgoal);
+  Assert(start == 0 && goal == 1);
+  bestPath.edges.clear();
+  bestCost = Inf;
+  numBatches = 0;
+  numPlanSteps = 0;
+  numConfigChecks = 0;
+  numEdgeChecks = 0;
+  tCheck=tKnn=tConnect=0;
+}
+
+void FMTStarPlanner::NewBatch()
+{
+  Real cbest = (informed ? bestCost : Inf);
+  int n = batchSize;
+  for(int i=0;i<numBatches && n < (1<<28);i++) n *= 2;
+  numBatches++;
+
+  //keep the old samples that are in the informed set: they are distributed
+  //uniformly over it, just like the new ones
+  Timer timer;
+  vector<Config> samples;
+  vector<int> index(roadmap.nodes.size(),-1);
+  index[start] = (int)samples.size();
+  samples.push_back(roadmap.nodes[start]);
+  index[goal] = (int)samples.size();
+  samples.push_back(roadmap.nodes[goal]);
+  for(size_t i=0;i<roadmap.nodes.size();i++) {
+    if((int)i == start || (int)i == goal) continue;
+    if(IsInf(cbest) || sampler.Heuristic(roadmap.nodes[i]) < cbest) {
+      index[i] = (int)samples.size();
+      samples.push_back(roadmap.nodes[i]);
+    }
+  }
+  //infeasible edges between kept samples stay infeasible, so carry them over
+  set<pair<int,int> > newFailedEdges;
+  for(set<pair<int,int> >::const_iterator i=failedEdges.begin();i!=failedEdges.end();i++) {
+    int a=index[i->first],b=index[i->second];
+    if(a >= 0 && b >= 0)
+      newFailedEdges.insert(pair<int,int>(Min(a,b),Max(a,b)));
+  }
+  Config x;
+  for(int k=(int)samples.size()-2;k<n;k++) {
+    if(!sampler.Sample(cbest,x)) continue;
+    numConfigChecks++;
+    if(space->IsFeasible(x))
+      samples.push_back(x);
+  }
+  tCheck += timer.ElapsedTime();
+
+  timer.Reset();
+  RoadmapPlanner::Cleanup();
+  for(size_t i=0;i<samples.size();i++) {
+    roadmap.AddNode(samples[i]);
+    ccs.AddNode();
+  }
+  pointLocator->OnBuild();
+  tKnn += timer.ElapsedTime();
+  start = 0;
+  goal = 1;
+
+  int N = (int)roadmap.nodes.size();
+  status.resize(0);
+  status.resize(N,Unvisited);
+  cost.resize(0);
+  cost.resize(N,Inf);
+  parent.resize(0);
+  parent.resize(N,-1);
+  neighbors.resize(0);
+  neighbors.resize(N);
+  neighborDistances.resize(0);
+  neighborDistances.resize(N);
+  neighborsComputed.resize(0);
+  neighborsComputed.resize(N,0);
+  swap(failedEdges,newFailedEdges);
+  while(!open.empty()) open.pop();
+  radius = Min(sampler.ConnectionRadius(cbest,N-2,rewireFactor),connectionThreshold);
+
+  cost[start] = 0;
+  status[start] = Open;
+  open.push(pair<Real,int>(0,start));
+}
+
+void FMTStarPlanner::GetNeighbors(int i)
+{
+  if(neighborsComputed[i]) return;
+  Timer timer;
+  CloseNeighbors(*this,i,radius,neighbors[i],neighborDistances[i]);
+  neighborsComputed[i] = 1;
+  tKnn += timer.ElapsedTime();
+}
+
+void FMTStarPlanner::PlanMore()
+{
+  if(start < 0 || goal < 0) {
+    fprintf(stderr,"FMTStarPlanner::PlanMore(): Init() must be called before planning\n");
+    return;
+  }
+  numPlanSteps++;
+  if(open.empty()) {
+    NewBatch();
+    return;
+  }
+  int z = open.top().second;
+  open.pop();
+  Assert(status[z] == Open);
+
+  GetNeighbors(z);
+  vector<int> opened;
+  for(size_t k=0;k<neighbors[z].size();k++) {
+    int x = neighbors[z][k];
+    if(status[x] != Unvisited) continue;
+    //connect x to its best open neighbor
+    GetNeighbors(x);
+    int ymin = -1;
+    Real cmin = Inf;
+    for(size_t m=0;m<neighbors[x].size();m++) {
+      int y = neighbors[x][m];
+      if(status[y] == Open && cost[y]+neighborDistances[x][m] < cmin) {
+        ymin = y;
+        cmin = cost[y]+neighborDistances[x][m];
+      }
+    }
+    if(ymin < 0) continue;
+    //prune if x can't be on a better path than the current one
+    if(cmin + space->Distance(roadmap.nodes[x],roadmap.nodes[goal]) >= bestCost) continue;
+    pair<int,int> key(Min(ymin,x),Max(ymin,x));
+    if(failedEdges.count(key) != 0) continue;
+    Timer timer;
+    SmartPointer<EdgePlanner> e = space->LocalPlanner(roadmap.nodes[ymin],roadmap.nodes[x]);
+    numEdgeChecks++;
+    bool feasible = e->IsVisible();
+    tConnect += timer.ElapsedTime();
+    if(!feasible) {
+      failedEdges.insert(key);
+      continue;
+    }
+    cost[x] = cmin;
+    parent[x] = ymin;
+    ConnectEdge(ymin,x,e);
+    opened.push_back(x);
+  }
+  status[z] = Closed;
+  for(size_t i=0;i<opened.size();i++) {
+    status[opened[i]] = Open;
+    open.push(pair<Real,int>(cost[opened[i]],opened[i]));
+  }
+  if(status[goal] == Open) {
+    //the goal's cost won't change in this batch, so it's done
+    if(cost[goal] < bestCost) {
+      bestCost = cost[goal];
+      GetTreePath(*this,parent,goal,bestPath);
+    }
+    while(!open.empty()) open.pop();
+  }
+}
+
+bool FMTStarPlanner::GetPath(MilestonePath& path)
+{
+  if(IsInf(bestCost)) return false;
+  path = bestPath;
+  return true;
+}
+
+bool FMTStarPlanner::LoadRoadmap(const char* fn,const vector<string>& changedConstraints)
+{
+  fprintf(stderr,"FMTStarPlanner::LoadRoadmap: roadmaps can't be loaded into FMT*\n");
+  return false;
+}
+
+
+
+BITStarPlanner::BITStarPlanner(CSpace* space)
+  :RoadmapPlanner(space),batchSize(100),rewireFactor(1.1),connectionThreshold(Inf),informed(true),start(-1),goal(-1),sampler(space),numBatches(0),radius(0),prunedCost(Inf)
+{
+  numPlanSteps = 0;
+  numConfigChecks = 0;
+  numEdgeChecks = 0;
+  numRewires = 0;
+  tCheck=tKnn=tConnect=0;
+}
+
+void BITStarPlanner::Cleanup()
+{
+  RoadmapPlanner::Cleanup();
+  cost.clear();
+  gHat.clear();
+  hHat.clear();
+  parent.clear();
+  children.clear();
+  oldVertex.clear();
+  inVertexQueue.clear();
+  while(!vertexQueue.empty()) vertexQueue.pop();
+  while(!edgeQueue.empty()) edgeQueue.pop();
+  failedEdges.clear();
+}
+
+void BITStarPlanner::Init(const Config& qstart,const Config& qgoal)
+{
+  Cleanup();
+  sampler.Init(qstart,qgoal);
+  start = AddMilestone(qstart);
+  goal = AddMilestone(qgoal);
+  Assert(start == 0 && goal == 1);
+  cost.resize(2);
+  cost[start] = 0;
+  cost[goal] = Inf;
+  gHat.resize(2);
+  hHat.resize(2);
+  gHat[start] = hHat[goal] = 0;
+  gHat[goal] = hHat[start] = sampler.cmin;
+  parent.resize(2,-1);
+  children.resize(2);
+  oldVertex.resize(2,0);
+  inVertexQueue.resize(2,0);
+  numBatches = 0;
+  prunedCost = Inf;
+  numPlanSteps = 0;
+  numConfigChecks = 0;
+  numEdgeChecks = 0;
+  numRewires = 0;
+  tCheck=tKnn=tConnect=0;
+}
+
+void BITStarPlanner::Prune(Real c)
+{
+  int N = (int)roadmap.nodes.size();
+  vector<char> keep(N,0),reached(N,0);
+  for(int i=0;i<N;i++) {
+    Real f = gHat[i]+hHat[i];
+    keep[i] = (IsInf(cost[i]) ? f < c : f <= c);
+  }
+  keep[start] = keep[goal] = 1;
+  //vertices that are cut off from the start by pruning become samples again
+  vector<int> stack(1,start);
+  reached[start] = 1;
+  while(!stack.empty()) {
+    int v = stack.back();
+    stack.pop_back();
+    for(size_t k=0;k<children[v].size();k++) {
+      int w = children[v][k];
+      if(keep[w]) {
+        reached[w] = 1;
+        stack.push_back(w);
+      }
+    }
+  }
+  vector<int> index(N,-1);
+  int M = 0;
+  for(int i=0;i<N;i++)
+    if(keep[i]) index[i] = M++;
+  Assert(index[start] == start && index[goal] == goal);
+
+  vector<Config> nodes(M);
+  vector<Real> newCost(M),newGHat(M),newHHat(M);
+  vector<int> newParent(M,-1);
+  vector<SmartPointer<EdgePlanner> > edges(M);
+  for(int i=0;i<N;i++) {
+    if(!keep[i]) continue;
+    int j = index[i];
+    nodes[j] = roadmap.nodes[i];
+    newGHat[j] = gHat[i];
+    newHHat[j] = hHat[i];
+    if(reached[i]) {
+      newCost[j] = cost[i];
+      if(parent[i] >= 0) {
+        newParent[j] = index[parent[i]];
+        edges[j] = *roadmap.FindEdge(parent[i],i);
+      }
+    }
+    else
+      newCost[j] = Inf;
+  }
+  set<pair<int,int> > newFailedEdges;
+  for(set<pair<int,int> >::const_iterator i=failedEdges.begin();i!=failedEdges.end();i++)
+    if(keep[i->first] && keep[i->second])
+      newFailedEdges.insert(pair<int,int>(index[i->first],index[i->second]));
+
+  RoadmapPlanner::Cleanup();
+  for(int i=0;i<M;i++) {
+    roadmap.AddNode(nodes[i]);
+    ccs.AddNode();
+  }
+  children.resize(0);
+  children.resize(M);
+  for(int i=0;i<M;i++) {
+    if(newParent[i] >= 0) {
+      roadmap.AddEdge(newParent[i],i,edges[i]);
+      children[newParent[i]].push_back(i);
+    }
+  }
+  swap(cost,newCost);
+  swap(gHat,newGHat);
+  swap(hHat,newHHat);
+  swap(parent,newParent);
+  swap(failedEdges,newFailedEdges);
+  oldVertex.resize(M);
+  inVertexQueue.resize(M);
+}
+
+void BITStarPlanner::NewBatch()
+{
+  if(cost[goal] < prunedCost) {
+    Prune(cost[goal]);
+    prunedCost = cost[goal];
+  }
+  numBatches++;
+  Real cbest = (informed ? cost[goal] : Inf);
+  Timer timer;
+  Config x;
+  for(int k=0;k<batchSize;k++) {
+    if(!sampler.Sample(cbest,x)) continue;
+    numConfigChecks++;
+    if(!space->IsFeasible(x)) continue;
+    roadmap.AddNode(x);
+    ccs.AddNode();
+    cost.push_back(Inf);
+    gHat.push_back(space->Distance(roadmap.nodes[start],x));
+    hHat.push_back(space->Distance(x,roadmap.nodes[goal]));
+    parent.push_back(-1);
+    children.resize(children.size()+1);
+  }
+  tCheck += timer.ElapsedTime();
+  timer.Reset();
+  pointLocator->OnBuild();
+  tKnn += timer.ElapsedTime();
+
+  int N = (int)roadmap.nodes.size();
+  radius = Min(sampler.ConnectionRadius(cbest,N,rewireFactor),connectionThreshold);
+  while(!edgeQueue.empty()) edgeQueue.pop();
+  while(!vertexQueue.empty()) vertexQueue.pop();
+  oldVertex.resize(N);
+  inVertexQueue.resize(N);
+  for(int i=0;i<N;i++) {
+    oldVertex[i] = inVertexQueue[i] = !IsInf(cost[i]);
+    if(!IsInf(cost[i]))
+      vertexQueue.push(VertexEntry(cost[i]+hHat[i],i));
+  }
+}
+
+Real BITStarPlanner::BestVertexKey()
+{
+  while(!vertexQueue.empty()) {
+    int v = vertexQueue.top().second;
+    //skip entries that were expanded or superseded by a cost decrease
+    if(inVertexQueue[v] && vertexQueue.top().first <= cost[v]+hHat[v]) 
+      return vertexQueue.top().first;
+    vertexQueue.pop();
+  }
+  return Inf;
+}
+
+Real BITStarPlanner::BestEdgeKey()
+{
+  if(edgeQueue.empty()) return Inf;
+  return edgeQueue.top().key;
+}
+
+void BITStarPlanner::ExpandVertex(int v)
+{
+  inVertexQueue[v] = 0;
+  Timer timer;
+  vector<int> nn;
+  vector<Real> distances;
+  CloseNeighbors(*this,v,radius,nn,distances);
+  tKnn += timer.ElapsedTime();
+  Real cgoal = cost[goal];
+  EdgeEntry e;
+  e.v = v;
+  for(size_t k=0;k<nn.size();k++) {
+    int x = nn[k];
+    if(x == start) continue;
+    if(gHat[v]+distances[k]+hHat[x] >= cgoal) continue;
+    if(IsInf(cost[x])) {
+      //edge to a sample
+      e.key = cost[v]+distances[k]+hHat[x];
+      e.x = x;
+      edgeQueue.push(e);
+    }
+    else if(!oldVertex[v]) {
+      //rewiring edge from a new vertex
+      if(parent[x] == v || parent[v] == x) continue;
+      if(cost[v]+distances[k] >= cost[x]) continue;
+      e.key = cost[v]+distances[k]+hHat[x];
+      e.x = x;
+      edgeQueue.push(e);
+    }
+  }
+}
+
+void BITStarPlanner::UpdateCosts(int v)
+{
+  vector<int> stack(1,v);
+  while(!stack.empty()) {
+    int w = stack.back();
+    stack.pop_back();
+    for(size_t k=0;k<children[w].size();k++) {
+      int c = children[w][k];
+      cost[c] = cost[w] + space->Distance(roadmap.nodes[w],roadmap.nodes[c]);
+      if(inVertexQueue[c])
+        vertexQueue.push(VertexEntry(cost[c]+hHat[c],c));
+      stack.push_back(c);
+    }
+  }
+}
+
+void BITStarPlanner::PlanMore()
+{
+  if(start < 0 || goal < 0) {
+    fprintf(stderr,"BITStarPlanner::PlanMore(): Init() must be called before planning\n");
+    return;
+  }
+  numPlanSteps++;
+  if(edgeQueue.empty() && vertexQueue.empty()) {
+    NewBatch();
+    return;
+  }
+  while(true) {
+    Real kv = BestVertexKey();
+    if(IsInf(kv) || kv > BestEdgeKey()) break;
+    int v = vertexQueue.top().second;
+    vertexQueue.pop();
+    ExpandVertex(v);
+  }
+  if(edgeQueue.empty()) {
+    while(!vertexQueue.empty()) vertexQueue.pop();
+    return;
+  }
+  EdgeEntry best = edgeQueue.top();
+  edgeQueue.pop();
+  int v = best.v, x = best.x;
+  Real c = space->Distance(roadmap.nodes[v],roadmap.nodes[x]);
+  if(cost[v]+c+hHat[x] >= cost[goal]) {
+    //no remaining edge can improve the solution, the batch is done
+    while(!edgeQueue.empty()) edgeQueue.pop();
+    while(!vertexQueue.empty()) vertexQueue.pop();
+    return;
+  }
+  if(cost[v]+c >= cost[x]) return;
+  pair<int,int> key(Min(v,x),Max(v,x));
+  if(failedEdges.count(key) != 0) return;
+  Timer timer;
+  SmartPointer<EdgePlanner> e = space->LocalPlanner(roadmap.nodes[v],roadmap.nodes[x]);
+  numEdgeChecks++;
+  bool feasible = e->IsVisible();
+  tConnect += timer.ElapsedTime();
+  if(!feasible) {
+    failedEdges.insert(key);
+    return;
+  }
+  if(!IsInf(cost[x])) {
+    //rewire
+    int p = parent[x];
+    vector<int>::iterator i = find(children[p].begin(),children[p].end(),x);
+    Assert(i != children[p].end());
+    children[p].erase(i);
+    roadmap.DeleteEdge(p,x);
+    numRewires++;
+  }
+  else
+    inVertexQueue[x] = 1;
+  parent[x] = v;
+  children[v].push_back(x);
+  roadmap.AddEdge(v,x,e);
+  cost[x] = cost[v]+c;
+  vertexQueue.push(VertexEntry(cost[x]+hHat[x],x));
+  UpdateCosts(x);
+}
+
+bool BITStarPlanner::GetPath(MilestonePath& path)
+{
+  if(!HasPath()) return false;
+  GetTreePath(*this,parent,goal,path);
+  return true;
+}
+
+bool BITStarPlanner::LoadRoadmap(const char* fn,const vector<string>& changedConstraints)
+{
+  fprintf(stderr,"BITStarPlanner::LoadRoadmap: roadmaps can't be loaded into BIT*\n");
+  return false;
+}
@@ -3,6 +3,8 @@
 
 #include "MotionPlanner.h"
 #include <KrisLibrary/graph/ShortestPaths.h>
+#include <queue>
+#include <set>
 
 class PRMStarPlanner : public RoadmapPlanner
 {
@@ -32,6 +34,14 @@ class PRMStarPlanner : public RoadmapPlanner
   virtual void ConnectEdge(int i,int j,const SmartPointer<EdgePlanner>& e);
   ///Helper: add an unchecked edge, and update data structures
   void ConnectEdgeLazy(int i,int j,const SmartPointer<EdgePlanner>& e);
+  ///Saves the roadmap, marking the edges that haven't been checked yet in
+  ///lazy mode
+  virtual bool SaveRoadmap(const char* fn);
+  ///Appends a roadmap saved by SaveRoadmap and connects the start and goal
+  ///to it.  Init() must be called first.  In lazy mode, unchecked edges are
+  ///kept and edges invalidated by changed constraints are marked unchecked;
+  ///otherwise they are rechecked against the changed constraints.
+  virtual bool LoadRoadmap(const char* fn,const std::vector<std::string>& changedConstraints=std::vector<std::string>());
 
   //configuration variables
   ///Set lazy to true if you wish to do lazy planning (default false)
@@ -70,5 +80,200 @@ class PRMStarPlanner : public RoadmapPlanner
   int numEdgePrechecks;
 };
 
+/** @brief Samples the informed subset of a CSpace for a point-to-point
+ * problem, i.e., the configurations x with d(start,x)+d(x,goal) < cbest,
+ * which contains every path that improves upon a solution of cost cbest.
+ *
+ * If the space is (weighted) euclidean and its properties give its bounds,
+ * the informed set is a prolate hyperspheroid with foci at start and goal,
+ * which is sampled directly and then rejected against the bounds.
+ * Otherwise, or when the hyperspheroid is larger than the bounds,
+ * CSpace::Sample is used and samples outside of the set are rejected.
+ */
+class InformedSampler
+{
+ public:
+  InformedSampler(CSpace* space);
+  ///Sets up the start and goal, and reads the space's properties
+  void Init(const Config& start,const Config& goal);
+  ///Returns the lower bound d(start,x)+d(x,goal) on the cost of any
+  ///solution through x
+  Real Heuristic(const Config& x) const;
+  ///Returns the measure of the informed set for the cost bound cbest
+  ///(the volume of the space if cbest is infinite)
+  Real Measure(Real cbest) const;
+  ///Samples x from the informed set for the cost bound cbest.  Returns
+  ///false if no sample was found after maxRejections tries.
+  bool Sample(Real cbest,Config& x);
+  ///Returns the connection radius rewireFactor*gamma*(log(n)/n)^(1/d) for
+  ///n samples in the informed set, where gamma is the lower bound of
+  ///Karaman and Frazzoli for the measure of the set.
+  Real ConnectionRadius(Real cbest,int n,Real rewireFactor) const;
+
+  CSpace* space;
+  Config start,goal;
+  ///The distance from start to goal, i.e., the minimum possible cost
+  Real cmin;
+  ///Maximum number of rejected samples before Sample() gives up (default 100)
+  int maxRejections;
+
+  //set by Init from the space's properties
+  int dimension;
+  bool euclidean;
+  Real volume;
+  Vector bmin,bmax,weights;
+  //hyperspheroid center and the Householder vector that reflects the first
+  //axis onto the start-goal axis, in coordinates scaled by sqrt(weights)
+  Vector center,householder;
+};
+
+/** @brief The Fast Marching Tree (FMT*) algorithm of Janson et al (2015),
+ * made anytime by running it over batches of increasing size.
+ *
+ * Each batch samples a fixed set of configurations and then grows a tree
+ * by marching outward from the start in order of cost-to-come.  Each
+ * newly reached sample is connected only to its best open neighbor, so
+ * only one edge is collision checked per sample.  A batch ends when the goal
+ * is reached or no open nodes remain, and the next batch doubles the number
+ * of samples.  Once a solution is found, the samples outside of the informed
+ * set are discarded and new samples are drawn from the informed set.
+ * Edges found infeasible are remembered across batches, so no edge between
+ * kept samples is collision checked twice.
+ */
+class FMTStarPlanner : public RoadmapPlanner
+{
+ public:
+  FMTStarPlanner(CSpace* space);
+  ///Initialize with a start and goal configuration
+  void Init(const Config& start,const Config& goal);
+  ///Erases all internal data structures
+  virtual void Cleanup();
+  ///Perform one planning step: expands one open node, or starts a new batch
+  void PlanMore();
+  ///Helper: returns true if a solution has been found
+  bool HasPath() const { return !IsInf(bestCost); }
+  ///Helper: get the best path from start to goal found so far
+  bool GetPath(MilestonePath& path);
+  ///Not supported, since a new tree is built for each batch
+  virtual bool LoadRoadmap(const char* fn,const std::vector<std::string>& changedConstraints=std::vector<std::string>());
+
+  //configuration variables
+  ///The number of samples in the first batch (default 100)
+  int batchSize;
+  ///The multiplier of the connection radius (default 1.1)
+  Real rewireFactor;
+  ///Set this value to limit the maximum distance of attempted connections
+  Real connectionThreshold;
+  ///Set to false to sample the whole space rather than the informed set
+  bool informed;
+
+  int start,goal;
+  InformedSampler sampler;
+  ///The best solution found so far, and its cost
+  MilestonePath bestPath;
+  Real bestCost;
+
+  //state of the current batch
+  enum { Unvisited, Open, Closed };
+  int numBatches;
+  Real radius;
+  vector<char> status;
+  vector<Real> cost;
+  vector<int> parent;
+  vector<vector<int> > neighbors;
+  vector<vector<Real> > neighborDistances;
+  vector<char> neighborsComputed;
+  priority_queue<pair<Real,int>,vector<pair<Real,int> >,greater<pair<Real,int> > > open;
+  set<pair<int,int> > failedEdges;
+
+  //statistics
+  int numPlanSteps;
+  Real tCheck, tKnn, tConnect;
+  int numConfigChecks;
+  int numEdgeChecks;
+
+ private:
+  void NewBatch();
+  void GetNeighbors(int i);
+};
+
+/** @brief The Batch Informed Trees (BIT*) algorithm of Gammell et al (2015).
+ *
+ * Samples are added in batches of batchSize, and each batch is searched in
+ * order of the heuristic f = g + c + h of the candidate edges, where g is
+ * the cost-to-come in the tree and c and h are the CSpace distance
+ * (i.e., edges are only collision checked if they could improve the
+ * solution).  When a new solution is found, the tree and samples
+ * outside of the informed set are pruned, and new batches are sampled
+ * from the informed set.  Existing vertices are rewired as better
+ * connections are found.
+ */
+class BITStarPlanner : public RoadmapPlanner
+{
+ public:
+  BITStarPlanner(CSpace* space);
+  ///Initialize with a start and goal configuration
+  void Init(const Config& start,const Config& goal);
+  ///Erases all internal data structures
+  virtual void Cleanup();
+  ///Perform one planning step: processes the best edge in the queue, or
+  ///starts a new batch
+  void PlanMore();
+  ///Helper: returns true if a solution has been found
+  bool HasPath() const { return goal >= 0 && !IsInf(cost[goal]); }
+  ///Helper: get the best path from start to goal found so far
+  bool GetPath(MilestonePath& path);
+  ///Not supported, since a new tree is built for each batch
+  virtual bool LoadRoadmap(const char* fn,const std::vector<std::string>& changedConstraints=std::vector<std::string>());
+
+  //configuration variables
+  ///The number of samples per batch (default 100)
+  int batchSize;
+  ///The multiplier of the connection radius (default 1.1)
+  Real rewireFactor;
+  ///Set this value to limit the maximum distance of attempted connections
+  Real connectionThreshold;
+  ///Set to false to sample the whole space rather than the informed set
+  bool informed;
+
+  int start,goal;
+  InformedSampler sampler;
+
+  //search state: cost-to-come (Inf for samples not in the tree), the
+  //heuristic cost-to-come and cost-to-go, parent and children in the tree,
+  //and whether the vertex existed before this batch
+  typedef pair<Real,int> VertexEntry;
+  struct EdgeEntry
+  {
+    bool operator < (const EdgeEntry& e) const { return key > e.key; }
+    Real key;
+    int v,x;
+  };
+  int numBatches;
+  Real radius;
+  Real prunedCost;
+  vector<Real> cost,gHat,hHat;
+  vector<int> parent;
+  vector<vector<int> > children;
+  vector<char> oldVertex,inVertexQueue;
+  priority_queue<VertexEntry,vector<VertexEntry>,greater<VertexEntry> > vertexQueue;
+  priority_queue<EdgeEntry> edgeQueue;
+  set<pair<int,int> > failedEdges;
+
+  //statistics
+  int numPlanSteps;
+  Real tCheck, tKnn, tConnect;
+  int numConfigChecks;
+  int numEdgeChecks;
+  int numRewires;
+
+ private:
+  void NewBatch();
+  void Prune(Real c);
+  void ExpandVertex(int v);
+  void UpdateCosts(int v);
+  Real BestVertexKey();
+  Real BestEdgeKey();
+};
 
 #endif
@@ -2,6 +2,8 @@
 #include <math/random.h>
 #include <Timer.h>
 #include <errors.h>
+#include <utils/threadutils.h>
+#include <algorithm>
 
 MilestonePath::MilestonePath()
 {}
@@ -133,6 +135,198 @@ int MilestonePath::Reduce(int numIters)
   return numsplices;
 }
 
+ShortcutStats::ShortcutStats()
+  :numRounds(0),numCandidates(0),numChecked(0),numCancelled(0),numShortcuts(0),
+   initialLength(0),finalLength(0),time(0)
+{}
+
+Real ShortcutStats::CostReductionRate() const
+{
+  if(time <= 0) return 0;
+  return (initialLength-finalLength)/time;
+}
+
+struct ShortcutCandidate
+{
+  enum { Pending, Feasible, Infeasible, Cancelled };
+
+  inline bool operator < (const ShortcutCandidate& c) const { return gain > c.gain; }
+  inline bool Overlaps(const ShortcutCandidate& c) const { return i1 <= c.i2 && c.i1 <= i2; }
+
+  //replaces edges i1...i2 with e[0],e[1],e[2]
+  int i1,i2;
+  Real gain;
+  SmartPointer<EdgePlanner> e[3];
+  int status;
+};
+
+struct ShortcutRound
+{
+  //returns true if a better candidate overlapping candidate k is feasible
+  bool IsDominated(int k) {
+    ScopedLock lock(mutex);
+    for(size_t i=0;i<feasible.size();i++)
+      if(feasible[i] < k && candidates[feasible[i]].Overlaps(candidates[k])) return true;
+    return false;
+  }
+  void SetStatus(int k,int status) {
+    ScopedLock lock(mutex);
+    candidates[k].status = status;
+    if(status == ShortcutCandidate::Feasible) feasible.push_back(k);
+  }
+  int Next() {
+    ScopedLock lock(mutex);
+    return next++;
+  }
+
+  vector<ShortcutCandidate> candidates;
+  CSpace* space;
+  vector<int> feasible;
+  int next;
+  Mutex mutex;
+};
+
+static void CheckShortcutCandidate(ShortcutRound& round,int k)
+{
+  ShortcutCandidate& c = round.candidates[k];
+  //the new milestones lie on checked edges, but edge checkers only test
+  //them to within a resolution
+  if(!round.space->IsFeasible(c.e[1]->Start()) || !round.space->IsFeasible(c.e[1]->End())) {
+    round.SetStatus(k,ShortcutCandidate::Infeasible);
+    return;
+  }
+  //check the middle segment first, it's the most likely to fail
+  const static int order[3] = {1,0,2};
+  for(int i=0;i<3;i++) {
+    if(round.IsDominated(k)) {
+      round.SetStatus(k,ShortcutCandidate::Cancelled);
+      return;
+    }
+    EdgePlanner* e = c.e[order[i]];
+    if(e->IsIncremental()) {
+      while(!e->Done() && !e->Failed()) {
+        e->Plan();
+        if(round.IsDominated(k)) {
+          round.SetStatus(k,ShortcutCandidate::Cancelled);
+          return;
+        }
+      }
+      if(e->Failed()) {
+        round.SetStatus(k,ShortcutCandidate::Infeasible);
+        return;
+      }
+    }
+    else if(!e->IsVisible()) {
+      round.SetStatus(k,ShortcutCandidate::Infeasible);
+      return;
+    }
+  }
+  round.SetStatus(k,ShortcutCandidate::Feasible);
+}
+
+static void* ShortcutThread(void* data)
+{
+  ShortcutRound* round = reinterpret_cast<ShortcutRound*>(data);
+  while(true) {
+    int k = round->Next();
+    if(k >= (int)round->candidates.size()) break;
+    CheckShortcutCandidate(*round,k);
+  }
+  return NULL;
+}
+
+int MilestonePath::ParallelShortcut(int numRounds,int numCandidates,int numThreads,Real timeLimit,ShortcutStats* stats)
+{
+  if(edges.size() < 2) return 0;
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  if(numCandidates <= 0) numCandidates = 4*numThreads;
+  CSpace* space=Space();
+  Timer timer;
+  if(stats && stats->numRounds == 0) stats->initialLength = Length();
+  int numsplices=0;
+  Config x1,x2;
+  vector<Real> cumLength;
+  for(int rounds=0;rounds<numRounds;rounds++) {
+    if(timer.ElapsedTime() >= timeLimit) break;
+    if(edges.size() < 2) break;
+    //cumLength[i] is the length of edges 0...i-1
+    cumLength.resize(edges.size()+1);
+    cumLength[0] = 0;
+    for(size_t i=0;i<edges.size();i++)
+      cumLength[i+1] = cumLength[i] + edges[i]->Length();
+
+    //propose candidates, keeping those that shorten the path
+    ShortcutRound round;
+    round.space = space;
+    round.next = 0;
+    round.candidates.reserve(numCandidates);
+    for(int iters=0;iters<numCandidates;iters++) {
+      ShortcutCandidate c;
+      c.i1 = rand()%edges.size();
+      c.i2 = rand()%edges.size();
+      if(c.i2 < c.i1) swap(c.i1,c.i2);
+      else if(c.i1 == c.i2) continue;
+      edges[c.i1]->Eval(Rand(),x1);
+      edges[c.i2]->Eval(Rand(),x2);
+      c.e[0] = space->LocalPlanner(edges[c.i1]->Start(),x1);
+      c.e[1] = space->LocalPlanner(x1,x2);
+      c.e[2] = space->LocalPlanner(x2,edges[c.i2]->End());
+      c.gain = cumLength[c.i2+1]-cumLength[c.i1] - (c.e[0]->Length()+c.e[1]->Length()+c.e[2]->Length());
+      c.status = ShortcutCandidate::Pending;
+      if(c.gain > 0) round.candidates.push_back(c);
+    }
+    sort(round.candidates.begin(),round.candidates.end());
+
+    //check them
+    int nt = Min(numThreads,(int)round.candidates.size());
+    if(nt <= 1)
+      ShortcutThread(&round);
+    else {
+      vector<Thread> threads(nt);
+      for(int t=0;t<nt;t++)
+        threads[t] = ThreadStart(ShortcutThread,&round);
+      for(int t=0;t<nt;t++)
+        ThreadJoin(threads[t]);
+    }
+
+    //pick the best non-overlapping feasible candidates, then splice them
+    //in from the end of the path so the earlier indices stay valid
+    vector<int> accepted;
+    for(size_t k=0;k<round.candidates.size();k++) {
+      const ShortcutCandidate& c = round.candidates[k];
+      if(stats) {
+        if(c.status == ShortcutCandidate::Cancelled) stats->numCancelled++;
+        else stats->numChecked++;
+      }
+      if(c.status != ShortcutCandidate::Feasible) continue;
+      bool overlap = false;
+      for(size_t i=0;i<accepted.size();i++)
+        if(round.candidates[accepted[i]].Overlaps(c)) { overlap = true; break; }
+      if(!overlap) accepted.push_back((int)k);
+    }
+    vector<pair<int,int> > order(accepted.size());
+    for(size_t i=0;i<accepted.size();i++)
+      order[i] = pair<int,int>(-round.candidates[accepted[i]].i1,accepted[i]);
+    sort(order.begin(),order.end());
+    for(size_t i=0;i<order.size();i++) {
+      const ShortcutCandidate& c = round.candidates[order[i].second];
+      edges.erase(edges.begin()+c.i1,edges.begin()+c.i2+1);
+      edges.insert(edges.begin()+c.i1,c.e,c.e+3);
+    }
+    numsplices += (int)accepted.size();
+    if(stats) {
+      stats->numRounds++;
+      stats->numCandidates += (int)round.candidates.size();
+    }
+  }
+  if(stats) {
+    stats->numShortcuts += numsplices;
+    stats->finalLength = Length();
+    stats->time += timer.ElapsedTime();
+  }
+  return numsplices;
+}
+
 void MilestonePath::Discretize(Real h)
 {
   for(size_t i=0;i<edges.size();i++) {
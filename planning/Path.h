@@ -6,6 +6,23 @@
 #include <list>
 using namespace std;
 
+/** @ingroup MotionPlanning
+ * @brief Statistics reported by MilestonePath::ParallelShortcut.
+ */
+struct ShortcutStats
+{
+  ShortcutStats();
+  ///Cost reduction per second of shortcutting
+  Real CostReductionRate() const;
+
+  int numRounds;
+  ///Number of candidates that would shorten the path, of those the number
+  ///checked to completion and cancelled, and the number committed
+  int numCandidates,numChecked,numCancelled,numShortcuts;
+  Real initialLength,finalLength;
+  Real time;
+};
+
 /** @ingroup MotionPlanning
  * @brief A sequence of locally planned paths between milestones
  *
@@ -51,6 +68,26 @@ public:
   /// Tries to shorten the path by connecting random points
   /// with a shortcut, for numIters iterations.  Returns # of shortcuts
   int Reduce(int numIters);
+  /** @brief Shortcuts the path in rounds, checking candidate shortcuts
+   * concurrently.  Returns # of shortcuts.
+   *
+   * In each round, numCandidates random shortcuts are proposed as in
+   * Reduce, and those that would shorten the path are checked by numThreads
+   * threads in order of decreasing length reduction.  The check of a
+   * candidate is cancelled as soon as a better candidate that overlaps it
+   * has been found feasible (this is done between steps of incremental edge
+   * planners).  At the end of the round the feasible, non-overlapping
+   * candidates are spliced in.
+   *
+   * If numCandidates <= 0, 4*numThreads candidates are proposed per round.
+   * If numThreads <= 0, the number of hardware threads is used.  Stops
+   * early if timeLimit seconds have elapsed.  If stats is non-NULL, the
+   * statistics of the run are added to it.
+   *
+   * With numThreads > 1, the feasibility tests of the path's CSpace must be
+   * safe to call from multiple threads.
+   */
+  int ParallelShortcut(int numRounds,int numCandidates=0,int numThreads=0,Real timeLimit=Inf,ShortcutStats* stats=NULL);
   /// Replaces the section of the path between milestones
   /// start and goal with a new path.  If the index is negative,
   /// erases the corresponding start/goal milestones too.
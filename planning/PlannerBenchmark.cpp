@@ -0,0 +1,307 @@
+#include "PlannerBenchmark.h"
+#include "Geometric2DCSpace.h"
+#include "Grid2DCSpace.h"
+#include "RigidRobot2DCSpace.h"
+#include "MultiRobot2DCSpace.h"
+#include <math/random.h>
+#include <utils/AnyCollection.h>
+#include <Timer.h>
+#include <sstream>
+#include <algorithm>
+using namespace std;
+
+static const char* kBenchmarkProblemNames[] = {
+  "geometric2d_clutter",
+  "geometric2d_narrow",
+  "grid2d_maze",
+  "rigid2d_rotate",
+  "multirobot2d_swap",
+  NULL
+};
+
+inline Config Config2(Real x,Real y)
+{
+  Config q(2);
+  q(0) = x; q(1) = y;
+  return q;
+}
+
+inline Config Config3(Real x,Real y,Real theta)
+{
+  Config q(3);
+  q(0) = x; q(1) = y; q(2) = theta;
+  return q;
+}
+
+inline AABB2D Box(Real xmin,Real ymin,Real xmax,Real ymax)
+{
+  AABB2D bb;
+  bb.bmin.set(xmin,ymin);
+  bb.bmax.set(xmax,ymax);
+  return bb;
+}
+
+inline Circle2D Disk(Real x,Real y,Real r)
+{
+  Circle2D c;
+  c.center.set(x,y);
+  c.radius = r;
+  return c;
+}
+
+//a wall at x in [0.48,0.52] with a gap of the given width centered at y=0.5
+inline void GetWall(Real gap,AABB2D& lower,AABB2D& upper)
+{
+  lower = Box(0.48,0,0.52,0.5-0.5*gap);
+  upper = Box(0.48,0.5+0.5*gap,0.52,1);
+}
+
+void GetBenchmarkProblemNames(vector<string>& names)
+{
+  names.resize(0);
+  for(int i=0;kBenchmarkProblemNames[i]!=NULL;i++)
+    names.push_back(kBenchmarkProblemNames[i]);
+}
+
+bool MakeBenchmarkProblem(const string& name,BenchmarkProblem& problem)
+{
+  problem.name = name;
+  if(name == "geometric2d_clutter") {
+    Geometric2DCSpace* space = new Geometric2DCSpace;
+    space->Add(Box(0.15,0.0,0.2,0.6));
+    space->Add(Box(0.35,0.4,0.4,1.0));
+    space->Add(Box(0.55,0.0,0.6,0.6));
+    space->Add(Disk(0.8,0.7,0.12));
+    space->Add(Disk(0.27,0.8,0.06));
+    space->Add(Triangle2D(Vector2(0.65,0.9),Vector2(0.75,1.0),Vector2(0.9,0.85)));
+    space->Add(Triangle2D(Vector2(0.7,0.1),Vector2(0.95,0.3),Vector2(0.75,0.35)));
+    space->InitConstraints();
+    problem.space = space;
+    problem.qstart = Config2(0.05,0.05);
+    problem.qgoal = Config2(0.95,0.95);
+  }
+  else if(name == "geometric2d_narrow") {
+    Geometric2DCSpace* space = new Geometric2DCSpace;
+    AABB2D lower,upper;
+    GetWall(0.02,lower,upper);
+    space->Add(lower);
+    space->Add(upper);
+    space->InitConstraints();
+    problem.space = space;
+    problem.qstart = Config2(0.1,0.2);
+    problem.qgoal = Config2(0.9,0.8);
+  }
+  else if(name == "grid2d_maze") {
+    Grid2DCSpace* space = new Grid2DCSpace(100,100);
+    space->Add(Box(0.2,0.0,0.25,0.8));
+    space->Add(Box(0.45,0.2,0.5,1.0));
+    space->Add(Box(0.7,0.0,0.75,0.8));
+    space->Add(Box(0.25,0.35,0.4,0.4));
+    space->Add(Box(0.55,0.6,0.7,0.65));
+    problem.space = space;
+    problem.qstart = Config2(0.1,0.1);
+    problem.qgoal = Config2(0.9,0.1);
+  }
+  else if(name == "rigid2d_rotate") {
+    RigidRobot2DCSpace* space = new RigidRobot2DCSpace;
+    //a 0.2 x 0.02 rod, which must be turned to horizontal to pass the gap
+    space->robot.Add(Box(-0.1,-0.01,0.1,0.01));
+    AABB2D lower,upper;
+    GetWall(0.1,lower,upper);
+    space->obstacles.Add(lower);
+    space->obstacles.Add(upper);
+    space->InitConstraints();
+    problem.space = space;
+    problem.qstart = Config3(0.2,0.5,Pi*0.5);
+    problem.qgoal = Config3(0.8,0.5,Pi*0.5);
+  }
+  else if(name == "multirobot2d_swap") {
+    MultiRobot2DCSpace* space = new MultiRobot2DCSpace;
+    space->allowRotation = false;
+    space->robots.resize(2);
+    space->robots[0].Add(Disk(0,0,0.05));
+    space->robots[1].Add(Disk(0,0,0.05));
+    space->obstacles.Add(Box(0.4,0.3,0.6,0.7));
+    problem.space = space;
+    problem.qstart.resize(4);
+    problem.qstart(0) = 0.2; problem.qstart(1) = 0.5;
+    problem.qstart(2) = 0.8; problem.qstart(3) = 0.5;
+    problem.qgoal.resize(4);
+    problem.qgoal(0) = 0.8; problem.qgoal(1) = 0.5;
+    problem.qgoal(2) = 0.2; problem.qgoal(3) = 0.5;
+  }
+  else {
+    problem.space = NULL;
+    return false;
+  }
+  return true;
+}
+
+BenchmarkRun::BenchmarkRun()
+  :seed(0),solved(false),setupTime(0),firstSolutionTime(Inf),firstSolutionCost(Inf),finalCost(Inf),time(0),numIters(0)
+{}
+
+void RunBenchmark(BenchmarkProblem& problem,MotionPlannerFactory& factory,const HaltingCondition& cond,int seed,BenchmarkRun& run,Real curveResolution)
+{
+  run = BenchmarkRun();
+  run.seed = seed;
+  Srand(seed);
+  Timer timer;
+  MotionPlannerInterface* planner = factory.Create(problem.space,problem.qstart,problem.qgoal);
+  run.setupTime = timer.ElapsedTime();
+  if(!planner) {
+    fprintf(stderr,"RunBenchmark: could not create planner %s\n",factory.type.c_str());
+    run.terminationReason = "error";
+    return;
+  }
+
+  MilestonePath path;
+  Real lastSampleTime = 0;
+  Real lastCheckTime = 0, lastCheckValue = 0;
+  run.terminationReason = "maxIters";
+  timer.Reset();
+  while(run.numIters < cond.maxIters) {
+    Real t = timer.ElapsedTime();
+    if(t > cond.timeLimit) {
+      run.terminationReason = "timeLimit";
+      break;
+    }
+    //check for cost improvements
+    if(run.solved && t > lastCheckTime + cond.costImprovementPeriod) {
+      if(run.finalCost < cond.costThreshold) {
+        run.terminationReason = "costThreshold";
+        break;
+      }
+      if(lastCheckValue - run.finalCost < cond.costImprovementThreshold) {
+        run.terminationReason = "costImprovementThreshold";
+        break;
+      }
+      lastCheckTime = t;
+      lastCheckValue = run.finalCost;
+    }
+    planner->PlanMore();
+    run.numIters++;
+    t = timer.ElapsedTime();
+    if(!run.solved) {
+      if(planner->IsSolved()) {
+        planner->GetSolution(path);
+        run.solved = true;
+        run.firstSolutionTime = t;
+        run.firstSolutionCost = run.finalCost = path.Length();
+        run.costCurve.push_back(pair<Real,Real>(t,run.finalCost));
+        lastSampleTime = lastCheckTime = t;
+        lastCheckValue = run.finalCost;
+        if(cond.foundSolution) {
+          run.terminationReason = "foundSolution";
+          break;
+        }
+      }
+    }
+    else if(t >= lastSampleTime + curveResolution) {
+      planner->GetSolution(path);
+      Real cost = path.Length();
+      if(cost < run.finalCost) {
+        run.finalCost = cost;
+        run.costCurve.push_back(pair<Real,Real>(t,cost));
+      }
+      lastSampleTime = t;
+    }
+  }
+  run.time = timer.ElapsedTime();
+  if(run.solved && run.terminationReason != "foundSolution") {
+    planner->GetSolution(path);
+    Real cost = path.Length();
+    if(cost < run.finalCost) {
+      run.finalCost = cost;
+      run.costCurve.push_back(pair<Real,Real>(run.time,cost));
+    }
+  }
+  planner->GetStats(run.stats);
+  delete planner;
+}
+
+void RunBenchmark(BenchmarkProblem& problem,MotionPlannerFactory& factory,const HaltingCondition& cond,int numSeeds,vector<BenchmarkRun>& runs,Real curveResolution,int firstSeed)
+{
+  runs.resize(numSeeds);
+  for(int i=0;i<numSeeds;i++)
+    RunBenchmark(problem,factory,cond,firstSeed+i,runs[i],curveResolution);
+}
+
+//infinite values are written as null, since JSON can't represent them
+inline void SetFinite(AnyCollection& item,Real value)
+{
+  if(IsFinite(value)) item = double(value);
+}
+
+//stats that parse as numbers are written as numbers
+static void StatsToCollection(const PropertyMap& stats,AnyCollection& items)
+{
+  items.clear();
+  for(PropertyMap::const_iterator i=stats.begin();i!=stats.end();i++) {
+    stringstream ss(i->second);
+    double value;
+    ss >> value;
+    if(ss && ss.eof()) items[i->first.c_str()] = value;
+    else items[i->first.c_str()] = i->second;
+  }
+}
+
+void SaveBenchmarkJSON(ostream& out,const BenchmarkProblem& problem,const MotionPlannerFactory& factory,const HaltingCondition& cond,const vector<BenchmarkRun>& runs)
+{
+  AnyCollection report;
+  if(!report["planner"].read(factory.SaveJSON().c_str()))
+    report["planner"]["type"] = factory.type;
+  AnyCollection& halt = report["haltingCondition"];
+  halt["foundSolution"] = cond.foundSolution;
+  halt["maxIters"] = cond.maxIters;
+  SetFinite(halt["timeLimit"],cond.timeLimit);
+  SetFinite(halt["costThreshold"],cond.costThreshold);
+  SetFinite(halt["costImprovementPeriod"],cond.costImprovementPeriod);
+  SetFinite(halt["costImprovementThreshold"],cond.costImprovementThreshold);
+  report["problem"] = problem.name;
+
+  AnyCollection& items = report["runs"];
+  items.resize(runs.size());
+  vector<Real> solveTimes;
+  Real sumSolveTime = 0, sumCost = 0;
+  for(size_t i=0;i<runs.size();i++) {
+    const BenchmarkRun& run = runs[i];
+    AnyCollection& item = items[(int)i];
+    item["seed"] = run.seed;
+    item["solved"] = run.solved;
+    item["setupTime"] = double(run.setupTime);
+    SetFinite(item["firstSolutionTime"],run.firstSolutionTime);
+    SetFinite(item["firstSolutionCost"],run.firstSolutionCost);
+    SetFinite(item["finalCost"],run.finalCost);
+    item["time"] = double(run.time);
+    item["numIters"] = run.numIters;
+    item["terminationReason"] = run.terminationReason;
+    AnyCollection& curve = item["costCurve"];
+    curve.resize(run.costCurve.size());
+    for(size_t j=0;j<run.costCurve.size();j++) {
+      curve[(int)j].resize(2);
+      curve[(int)j][0] = double(run.costCurve[j].first);
+      curve[(int)j][1] = double(run.costCurve[j].second);
+    }
+    StatsToCollection(run.stats,item["stats"]);
+    if(run.solved) {
+      solveTimes.push_back(run.firstSolutionTime);
+      sumSolveTime += run.firstSolutionTime;
+      sumCost += run.finalCost;
+    }
+  }
+
+  AnyCollection& summary = report["summary"];
+  summary["numRuns"] = (int)runs.size();
+  summary["numSolved"] = (int)solveTimes.size();
+  if(!solveTimes.empty()) {
+    sort(solveTimes.begin(),solveTimes.end());
+    size_t n = solveTimes.size();
+    Real median = (n%2==1 ? solveTimes[n/2] : 0.5*(solveTimes[n/2-1]+solveTimes[n/2]));
+    summary["meanFirstSolutionTime"] = double(sumSolveTime/n);
+    summary["medianFirstSolutionTime"] = double(median);
+    summary["meanFinalCost"] = double(sumCost/n);
+  }
+  report.write(out);
+  out<<endl;
+}
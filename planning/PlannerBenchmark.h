@@ -0,0 +1,90 @@
+#ifndef PLANNER_BENCHMARK_H
+#define PLANNER_BENCHMARK_H
+
+#include "AnyMotionPlanner.h"
+#include <KrisLibrary/utils/PropertyMap.h>
+#include <KrisLibrary/utils/SmartPointer.h>
+#include <iostream>
+#include <vector>
+#include <string>
+
+/** @ingroup MotionPlanning
+ * @brief A reproducible benchmark problem: a space with a start and goal.
+ *
+ * The canonical problems are built with fixed geometry by
+ * MakeBenchmarkProblem, so a run only depends on the planner settings and
+ * the random seed.
+ */
+struct BenchmarkProblem
+{
+  std::string name;
+  SmartPointer<CSpace> space;
+  Config qstart,qgoal;
+};
+
+///Returns the names of the canonical benchmark problems
+void GetBenchmarkProblemNames(std::vector<std::string>& names);
+
+/** @brief Builds one of the canonical benchmark problems, returning false if
+ * the name is not recognized.
+ *
+ * - "geometric2d_clutter": a point among boxes, disks, and triangles
+ *   (Geometric2DCSpace)
+ * - "geometric2d_narrow": a point passing through a narrow gap in a wall
+ *   (Geometric2DCSpace)
+ * - "grid2d_maze": a point in a rasterized maze (Grid2DCSpace)
+ * - "rigid2d_rotate": a rod that must rotate to fit through a gap in a wall
+ *   (RigidRobot2DCSpace)
+ * - "multirobot2d_swap": two translating disks that swap sides around a
+ *   central obstacle (MultiRobot2DCSpace)
+ */
+bool MakeBenchmarkProblem(const std::string& name,BenchmarkProblem& problem);
+
+/** @brief The result of running a planner once on a benchmark problem.
+ *
+ * Times are in seconds from the start of planning, after the planner is
+ * created.  The cost curve holds (time,cost) pairs, recorded whenever the
+ * solution cost improves.  stats holds the planner's GetStats counters
+ * (e.g., numEdgeChecks, knnTime, configCheckTime).  Setting instrument in
+ * the MotionPlannerFactory adds the same feasibility, edge, distance, and
+ * point location counters for every planner.
+ */
+struct BenchmarkRun
+{
+  BenchmarkRun();
+
+  int seed;
+  bool solved;
+  Real setupTime;
+  Real firstSolutionTime,firstSolutionCost;
+  Real finalCost;
+  Real time;
+  int numIters;
+  std::string terminationReason;
+  std::vector<std::pair<Real,Real> > costCurve;
+  PropertyMap stats;
+};
+
+/** @brief Runs a planner on a benchmark problem with the given random seed
+ * until the halting condition is met.
+ *
+ * The solution cost is sampled at most every curveResolution seconds (and
+ * always when the first solution is found and at termination), since
+ * extracting a solution can be expensive for some planners.
+ */
+void RunBenchmark(BenchmarkProblem& problem,MotionPlannerFactory& factory,const HaltingCondition& cond,int seed,BenchmarkRun& run,Real curveResolution=0.01);
+
+///Runs the planner with seeds firstSeed,...,firstSeed+numSeeds-1
+void RunBenchmark(BenchmarkProblem& problem,MotionPlannerFactory& factory,const HaltingCondition& cond,int numSeeds,std::vector<BenchmarkRun>& runs,Real curveResolution=0.01,int firstSeed=1);
+
+/** @brief Writes a JSON report of a set of runs.
+ *
+ * The report is an object with the planner settings ("planner"), the
+ * halting condition ("haltingCondition"), the problem name ("problem"), one
+ * entry per run ("runs"), and a summary over the runs ("summary": number
+ * solved, mean / median time to first solution, and mean final cost).
+ * Unsolved runs have null solution times and costs.
+ */
+void SaveBenchmarkJSON(std::ostream& out,const BenchmarkProblem& problem,const MotionPlannerFactory& factory,const HaltingCondition& cond,const std::vector<BenchmarkRun>& runs);
+
+#endif
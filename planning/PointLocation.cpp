@@ -271,7 +271,7 @@ void KDTreePointLocation::OnBuild()
     pts[i].pt.setRef(points[i]);
     pts[i].id = (int)i;
   }
-  tree = new Geometry::KDTree(pts, k, 100);
+  tree = new Geometry::KDTree(pts, k, 0, 100);
 }
 
 void KDTreePointLocation::OnAppend()
@@ -292,8 +292,8 @@ bool KDTreePointLocation::OnClear()
 
 bool KDTreePointLocation::NN(const Vector& p,int& nn,Real& distance)
 { 
-  nn = tree->ClosestPoint(p,2,weights,distance);
-  return true;
+  nn = tree->ClosestPoint(p,norm,weights,distance);
+  return nn >= 0;
 }
 
 bool KDTreePointLocation::KNN(const Vector& p,int k,std::vector<int>& nn,std::vector<Real>& distances) 
@@ -319,6 +319,11 @@ bool KDTreePointLocation::KNN(const Vector& p,int k,std::vector<int>& nn,std::ve
   return true;
 }
 
+bool KDTreePointLocation::Remove(int id)
+{
+  return tree->Remove(points[id],id);
+}
+
 bool KDTreePointLocation::Close(const Vector& p,Real r,std::vector<int>& nn,std::vector<Real>& distances) 
 { 
   tree->ClosePoints(p,r,norm,weights,distances,nn);
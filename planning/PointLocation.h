@@ -125,6 +125,9 @@ class KDTreePointLocation : public PointLocationBase
   virtual bool NN(const Vector& p,int& nn,Real& distance);
   virtual bool KNN(const Vector& p,int k,std::vector<int>& nn,std::vector<Real>& distances);
   virtual bool Close(const Vector& p,Real r,std::vector<int>& nn,std::vector<Real>& distances);
+  ///Removes point id from the tree without renumbering the other points.
+  ///points[id] must not be changed until it is removed.
+  bool Remove(int id);
 
   Real norm;
   Vector weights;
@@ -73,7 +73,7 @@ void SO2CSpace::SampleNeighborhood(const Config& c,Real r,Config& x)
 void SO2CSpace::Interpolate(const Config& a,const Config& b,Real u,Config& out)
 {
   out.resize(1);
-  out(2)=AngleInterp(a(0),b(0),u);
+  out(0)=AngleInterp(a(0),b(0),u);
 }
 
 Real SO2CSpace::Distance(const Config& a,const Config& b)
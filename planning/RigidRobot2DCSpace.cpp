@@ -18,6 +18,7 @@ RigidRobot2DCSpace::RigidRobot2DCSpace()
 void RigidRobot2DCSpace::InitConstraints()
 {
   SetDomain(domain.bmin,domain.bmax);
+  FlattenConstraints();
   for(int i=0;i<obstacles.NumObstacles();i++) {
     char buf[64];
     sprintf(buf,"%s[%d]",obstacles.ObstacleTypeName(i),obstacles.ObstacleIndex(i));
@@ -16,6 +16,8 @@ public:
   void DrawRobotGL(const Config& q) const;
   void DrawGL(const Config& q) const;
 
+  virtual bool IsFeasible(const Config& x) { return CSpace::IsFeasible(x); }
+  virtual EdgePlanner* LocalPlanner(const Config& a,const Config& b) { return PathChecker(a,b); }
   virtual EdgePlanner* PathChecker(const Config& a,const Config& b);
   virtual EdgePlanner* PathChecker(const Config& a,const Config& b,int obstacle);
   virtual void Properties(PropertyMap&);
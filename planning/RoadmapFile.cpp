@@ -0,0 +1,228 @@
+#include "RoadmapFile.h"
+#include "EdgePlanner.h"
+#include <utils/SmartPointer.h>
+#include <errors.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+using namespace std;
+
+static const char* kRoadmapFileMagic = "KLRM";
+static const int kRoadmapFileVersion = 2;
+//written in native byte order, so it reads back differently on a machine of
+//the other byte order
+static const unsigned int kRoadmapFileByteOrder = 0x01020304;
+static const unsigned int kRoadmapFileSwappedByteOrder = 0x04030201;
+
+//rounds the offset up to the alignment of the arrays
+inline size_t AlignOffset(size_t n) { return (n+7)&~size_t(7); }
+
+RoadmapFile::RoadmapFile()
+  :dimension(0),numMilestones(0),numEdges(0),milestones(NULL),edges(NULL),edgeStatus(NULL)
+{}
+
+void RoadmapFile::Close()
+{
+  view.Close();
+  dimension = numMilestones = numEdges = 0;
+  constraintNames.clear();
+  milestones = NULL;
+  edges = NULL;
+  edgeStatus = NULL;
+}
+
+bool RoadmapFile::Open(const char* fn)
+{
+  Close();
+  if(!view.Open(fn)) {
+    fprintf(stderr,"RoadmapFile::Open: could not open file %s\n",fn);
+    return false;
+  }
+  const char* data = view.data;
+  size_t size = view.size;
+  unsigned int byteOrder;
+  int header[5];
+  if(size < 4+sizeof(byteOrder)+sizeof(header) || memcmp(data,kRoadmapFileMagic,4) != 0) {
+    fprintf(stderr,"RoadmapFile::Open: %s is not a roadmap file\n",fn);
+    Close();
+    return false;
+  }
+  memcpy(&byteOrder,data+4,sizeof(byteOrder));
+  if(byteOrder != kRoadmapFileByteOrder) {
+    if(byteOrder == kRoadmapFileSwappedByteOrder)
+      fprintf(stderr,"RoadmapFile::Open: %s was written on a machine with a different byte order\n",fn);
+    else
+      fprintf(stderr,"RoadmapFile::Open: %s has an unsupported version or byte order\n",fn);
+    Close();
+    return false;
+  }
+  memcpy(header,data+4+sizeof(byteOrder),sizeof(header));
+  if(header[0] != kRoadmapFileVersion) {
+    fprintf(stderr,"RoadmapFile::Open: %s has unsupported version %d\n",fn,header[0]);
+    Close();
+    return false;
+  }
+  dimension = header[1];
+  numMilestones = header[2];
+  numEdges = header[3];
+  int numConstraints = header[4];
+  if(dimension < 0 || numMilestones < 0 || numEdges < 0 || numConstraints < 0) {
+    fprintf(stderr,"RoadmapFile::Open: %s has a corrupt header\n",fn);
+    Close();
+    return false;
+  }
+  size_t offset = 4+sizeof(byteOrder)+sizeof(header);
+  constraintNames.resize(numConstraints);
+  for(int i=0;i<numConstraints;i++) {
+    int len;
+    if(offset+sizeof(int) > size) break;
+    memcpy(&len,data+offset,sizeof(int));
+    offset += sizeof(int);
+    if(len < 0 || offset+len > size) { offset = size+1; break; }
+    constraintNames[i].assign(data+offset,len);
+    offset += len;
+  }
+  offset = AlignOffset(offset);
+  size_t milestoneBytes = sizeof(double)*size_t(numMilestones)*size_t(dimension);
+  size_t edgeBytes = sizeof(int)*2*size_t(numEdges);
+  if(offset > size || size-offset < milestoneBytes+edgeBytes+size_t(numEdges)) {
+    fprintf(stderr,"RoadmapFile::Open: %s is truncated\n",fn);
+    Close();
+    return false;
+  }
+  milestones = reinterpret_cast<const double*>(data+offset);
+  edges = reinterpret_cast<const int*>(data+offset+milestoneBytes);
+  edgeStatus = reinterpret_cast<const unsigned char*>(data+offset+milestoneBytes+edgeBytes);
+  for(int i=0;i<numEdges*2;i++) {
+    if(edges[i] < 0 || edges[i] >= numMilestones) {
+      fprintf(stderr,"RoadmapFile::Open: %s has an invalid edge %d\n",fn,i/2);
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RoadmapFile::Save(const char* fn,const vector<Config>& milestones,const vector<pair<int,int> >& edges,const vector<unsigned char>& edgeStatus,const vector<string>& constraintNames)
+{
+  Assert(edges.size() == edgeStatus.size());
+  int dimension = (milestones.empty() ? 0 : milestones[0].n);
+  for(size_t i=0;i<milestones.size();i++) {
+    if(milestones[i].n != dimension) {
+      fprintf(stderr,"RoadmapFile::Save: milestone %d has dimension %d, expected %d\n",(int)i,milestones[i].n,dimension);
+      return false;
+    }
+  }
+  FILE* f = fopen(fn,"wb");
+  if(!f) {
+    fprintf(stderr,"RoadmapFile::Save: could not open %s for writing\n",fn);
+    return false;
+  }
+  int header[5] = { kRoadmapFileVersion, dimension, (int)milestones.size(), (int)edges.size(), (int)constraintNames.size() };
+  size_t offset = 0;
+  bool ok = true;
+  ok = ok && fwrite(kRoadmapFileMagic,1,4,f) == 4;
+  ok = ok && fwrite(&kRoadmapFileByteOrder,sizeof(kRoadmapFileByteOrder),1,f) == 1;
+  ok = ok && fwrite(header,sizeof(header),1,f) == 1;
+  offset += 4+sizeof(kRoadmapFileByteOrder)+sizeof(header);
+  for(size_t i=0;i<constraintNames.size();i++) {
+    int len = (int)constraintNames[i].length();
+    ok = ok && fwrite(&len,sizeof(int),1,f) == 1;
+    if(len > 0) ok = ok && fwrite(constraintNames[i].c_str(),1,len,f) == size_t(len);
+    offset += sizeof(int)+len;
+  }
+  char padding[8] = {0,0,0,0,0,0,0,0};
+  size_t npad = AlignOffset(offset)-offset;
+  if(npad > 0) ok = ok && fwrite(padding,1,npad,f) == npad;
+  vector<double> buffer(dimension);
+  for(size_t i=0;i<milestones.size() && ok;i++) {
+    for(int j=0;j<dimension;j++) buffer[j] = milestones[i][j];
+    if(dimension > 0) ok = fwrite(&buffer[0],sizeof(double),dimension,f) == size_t(dimension);
+  }
+  for(size_t i=0;i<edges.size() && ok;i++) {
+    int e[2] = { edges[i].first, edges[i].second };
+    ok = fwrite(e,sizeof(int),2,f) == 2;
+  }
+  if(!edgeStatus.empty())
+    ok = ok && fwrite(&edgeStatus[0],1,edgeStatus.size(),f) == edgeStatus.size();
+  if(fclose(f) != 0) ok = false;
+  if(!ok) fprintf(stderr,"RoadmapFile::Save: error writing to %s\n",fn);
+  return ok;
+}
+
+void RoadmapFile::GetMilestone(int i,Config& q) const
+{
+  q.resize(dimension);
+  const double* x = milestones+size_t(i)*size_t(dimension);
+  for(int j=0;j<dimension;j++) q[j] = x[j];
+}
+
+void RoadmapFile::Validate(CSpace* space,const vector<string>& changedConstraints,bool recheck,vector<bool>& milestoneValid,vector<unsigned char>& status) const
+{
+  vector<int> newConstraints;
+  bool removed = false;
+  bool wholeSpace = (space->NumConstraints()==0 && !changedConstraints.empty());
+  for(int i=0;i<space->NumConstraints();i++) {
+    string name = space->ConstraintName(i);
+    if(find(constraintNames.begin(),constraintNames.end(),name) == constraintNames.end() ||
+       find(changedConstraints.begin(),changedConstraints.end(),name) != changedConstraints.end())
+      newConstraints.push_back(i);
+  }
+  for(size_t i=0;i<constraintNames.size();i++) {
+    bool found = false;
+    for(int j=0;j<space->NumConstraints();j++)
+      if(space->ConstraintName(j) == constraintNames[i]) { found = true; break; }
+    if(!found || find(changedConstraints.begin(),changedConstraints.end(),constraintNames[i]) != changedConstraints.end())
+      removed = true;
+  }
+  if(wholeSpace) removed = true;
+  bool added = (wholeSpace || !newConstraints.empty());
+
+  milestoneValid.resize(0);
+  milestoneValid.resize(numMilestones,true);
+  if(added) {
+    Config q;
+    for(int i=0;i<numMilestones;i++) {
+      GetMilestone(i,q);
+      if(wholeSpace)
+        milestoneValid[i] = space->IsFeasible(q);
+      else {
+        for(size_t k=0;k<newConstraints.size();k++)
+          if(!space->IsFeasible(q,newConstraints[k])) {
+            milestoneValid[i] = false;
+            break;
+          }
+      }
+    }
+  }
+
+  status.resize(numEdges);
+  Config a,b;
+  for(int i=0;i<numEdges;i++) {
+    status[i] = edgeStatus[i];
+    if(!milestoneValid[EdgeStart(i)] || !milestoneValid[EdgeEnd(i)]) continue;
+    if(status[i] == Feasible && added) {
+      if(!recheck) {
+        status[i] = Unchecked;
+        continue;
+      }
+      GetMilestone(EdgeStart(i),a);
+      GetMilestone(EdgeEnd(i),b);
+      if(wholeSpace) {
+        SmartPointer<EdgePlanner> e = space->PathChecker(a,b);
+        if(!e->IsVisible()) status[i] = Infeasible;
+      }
+      else {
+        for(size_t k=0;k<newConstraints.size();k++) {
+          SmartPointer<EdgePlanner> e = space->PathChecker(a,b,newConstraints[k]);
+          if(!e->IsVisible()) {
+            status[i] = Infeasible;
+            break;
+          }
+        }
+      }
+    }
+    else if(status[i] == Infeasible && removed)
+      status[i] = Unchecked;
+  }
+}
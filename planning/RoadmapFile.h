@@ -0,0 +1,67 @@
+#ifndef ROADMAP_FILE_H
+#define ROADMAP_FILE_H
+
+#include "CSpace.h"
+#include <KrisLibrary/utils/fileutils.h>
+#include <vector>
+#include <string>
+
+/** @ingroup MotionPlanning
+ * @brief A compact binary file format for roadmaps, used to save a
+ * planner's roadmap and warm-start a planner in a later run.
+ *
+ * The file stores the milestones, the edges, and the status of each edge
+ * (unchecked, feasible, or infeasible) along with the names of the CSpace
+ * constraints that the status was determined with.  Open() memory-maps the
+ * file and the arrays are read in place, so loading costs little more than
+ * copying the milestones into the planner.  Files written on a machine of
+ * the other byte order, or by an older version, are rejected by Open().
+ *
+ * Layout, in native byte order, with the arrays aligned to 8 bytes:
+ * - "KLRM", the uint32 byte order mark 0x01020304, and the int32s version
+ *   (2), dimension, numMilestones, numEdges, numConstraints
+ * - for each constraint, an int32 length followed by its name
+ * - padding up to a multiple of 8 bytes
+ * - double milestones[numMilestones*dimension]
+ * - int32 edges[numEdges*2]
+ * - uint8 edgeStatus[numEdges]
+ */
+class RoadmapFile
+{
+ public:
+  enum { Unchecked=0, Feasible=1, Infeasible=2 };
+
+  RoadmapFile();
+  ///Memory-maps the file and reads its header.  Returns false on failure.
+  bool Open(const char* fn);
+  void Close();
+  ///Writes a roadmap to a file.  Returns false on failure.
+  static bool Save(const char* fn,const std::vector<Config>& milestones,const std::vector<std::pair<int,int> >& edges,const std::vector<unsigned char>& edgeStatus,const std::vector<std::string>& constraintNames);
+  void GetMilestone(int i,Config& q) const;
+  inline int EdgeStart(int e) const { return edges[e*2]; }
+  inline int EdgeEnd(int e) const { return edges[e*2+1]; }
+
+  /** @brief Revalidates the roadmap against the current constraints of
+   * space.
+   *
+   * The constraints of space that are not in the file, or that are named in
+   * changedConstraints, are new.  If space has no constraints, a nonempty
+   * changedConstraints means that the whole space has changed.
+   *
+   * Milestones that violate a new constraint are marked invalid, and the
+   * planner should drop them along with their edges.  If there are new
+   * constraints, feasible edges are rechecked against them if recheck is
+   * true, and otherwise they are marked unchecked.  If a stored constraint
+   * was removed or changed, infeasible edges are marked unchecked.
+   */
+  void Validate(CSpace* space,const std::vector<std::string>& changedConstraints,bool recheck,std::vector<bool>& milestoneValid,std::vector<unsigned char>& status) const;
+
+  int dimension,numMilestones,numEdges;
+  std::vector<std::string> constraintNames;
+  const double* milestones;
+  const int* edges;
+  const unsigned char* edgeStatus;
+  FileUtils::FileView view;
+};
+
+#endif
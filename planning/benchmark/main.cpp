@@ -0,0 +1,126 @@
+#include <KrisLibrary/planning/PlannerBenchmark.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fstream>
+using namespace std;
+
+void PrintUsage(const char* program)
+{
+  printf("Usage: %s [options]\n",program);
+  printf("Runs a motion planner on the canonical benchmark problems and writes a JSON report.\n");
+  printf("Options:\n");
+  printf("  -planner type|json: the planner type, or MotionPlannerFactory settings as a JSON string (default rrt)\n");
+  printf("  -problem name: the problem to run, or \"all\" (default all)\n");
+  printf("  -seeds n: number of seeds per problem (default 10)\n");
+  printf("  -firstseed n: the first seed (default 1)\n");
+  printf("  -halt json: the HaltingCondition, as a JSON string (default {foundSolution:0,timeLimit:1})\n");
+  printf("  -resolution t: the minimum time between samples of the cost curve (default 0.01)\n");
+  printf("  -o file: the output file (default stdout)\n");
+  printf("  -list: lists the problem names\n");
+}
+
+int main(int argc,const char** argv)
+{
+  MotionPlannerFactory factory;
+  factory.type = "rrt";
+  HaltingCondition cond;
+  cond.foundSolution = false;
+  cond.maxIters = INT_MAX;
+  cond.timeLimit = 1;
+  string problemName = "all";
+  int numSeeds = 10, firstSeed = 1;
+  Real resolution = 0.01;
+  const char* outputFile = NULL;
+  vector<string> problemNames;
+  GetBenchmarkProblemNames(problemNames);
+
+  for(int i=1;i<argc;i++) {
+    if(0==strcmp(argv[i],"-list")) {
+      for(size_t j=0;j<problemNames.size();j++)
+        printf("%s\n",problemNames[j].c_str());
+      return 0;
+    }
+    else if(0==strcmp(argv[i],"-h") || 0==strcmp(argv[i],"-help")) {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+    else if(i+1 >= argc) {
+      fprintf(stderr,"Invalid or incomplete option %s\n",argv[i]);
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    else if(0==strcmp(argv[i],"-planner")) {
+      if(argv[i+1][0] == '{') {
+        if(!factory.LoadJSON(argv[i+1])) {
+          fprintf(stderr,"Error parsing planner settings %s\n",argv[i+1]);
+          return 1;
+        }
+      }
+      else factory.type = argv[i+1];
+      i++;
+    }
+    else if(0==strcmp(argv[i],"-problem")) {
+      problemName = argv[i+1];
+      i++;
+    }
+    else if(0==strcmp(argv[i],"-seeds")) {
+      numSeeds = atoi(argv[i+1]);
+      i++;
+    }
+    else if(0==strcmp(argv[i],"-firstseed")) {
+      firstSeed = atoi(argv[i+1]);
+      i++;
+    }
+    else if(0==strcmp(argv[i],"-halt")) {
+      if(!cond.LoadJSON(argv[i+1])) {
+        fprintf(stderr,"Error parsing halting condition %s\n",argv[i+1]);
+        return 1;
+      }
+      i++;
+    }
+    else if(0==strcmp(argv[i],"-resolution")) {
+      resolution = atof(argv[i+1]);
+      i++;
+    }
+    else if(0==strcmp(argv[i],"-o")) {
+      outputFile = argv[i+1];
+      i++;
+    }
+    else {
+      fprintf(stderr,"Invalid option %s\n",argv[i]);
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if(problemName != "all") {
+    problemNames.resize(1);
+    problemNames[0] = problemName;
+  }
+  ofstream fout;
+  if(outputFile) {
+    fout.open(outputFile);
+    if(!fout) {
+      fprintf(stderr,"Could not open %s for writing\n",outputFile);
+      return 1;
+    }
+  }
+  ostream& out = (outputFile ? fout : cout);
+  if(problemNames.size() > 1) out<<"["<<endl;
+  for(size_t i=0;i<problemNames.size();i++) {
+    BenchmarkProblem problem;
+    if(!MakeBenchmarkProblem(problemNames[i],problem)) {
+      fprintf(stderr,"Unknown problem %s, use -list to list the problems\n",problemNames[i].c_str());
+      return 1;
+    }
+    fprintf(stderr,"Running %s on %s with %d seeds...\n",factory.type.c_str(),problem.name.c_str(),numSeeds);
+    vector<BenchmarkRun> runs;
+    RunBenchmark(problem,factory,cond,numSeeds,runs,resolution,firstSeed);
+    SaveBenchmarkJSON(out,problem,factory,cond,runs);
+    if(i+1 < problemNames.size()) out<<","<<endl;
+  }
+  if(problemNames.size() > 1) out<<"]"<<endl;
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include "GaussianHMM.h"
-#include "OnlineMoments.h"
+#include "HMMInference.h"
 #include <math/indexing.h>
+#include <utils/threadutils.h>
 #include <fstream>
 using namespace Math;
 using namespace std;
@@ -80,28 +81,133 @@ void GaussianHMM::SetUniformExitProbabilities(Real pExit)
   }
 }
 
-bool GaussianHMM::TrainEM(const vector<vector<Vector> >& examples,Real& tol,int maxIters,int verbose)
+//Fills in the cached log-densities of the gaussians
+static void GetLogDensities(const vector<Gaussian<Real> >& gaussians,vector<GaussianLogDensity>& densities)
 {
-  vector<Real> flatWeights;
-  vector<Vector> flatExamples;
-  for(size_t i=0;i<examples.size();i++)
-    flatExamples.insert(flatExamples.end(),examples[i].begin(),examples[i].end());
-  flatWeights.resize(flatExamples.size());
+  densities.resize(gaussians.size());
+  for(size_t i=0;i<gaussians.size();i++)
+    densities[i].Set(gaussians[i]);
+}
 
-  //weights of each example belonging to each class 
-  vector<Vector> w;
+//Computes the log emission probabilities of a sequence.  Row 0 is for the
+//initial state x0, which emits nothing, and row t+1 is for observation t.
+static void GetLogEmissions(const vector<GaussianLogDensity>& densities,const vector<Vector>& observations,Matrix& logE)
+{
+  int k = (int)densities.size();
+  int d = (densities.empty() ? 0 : densities[0].d);
+  logE.resize((int)observations.size()+1,k);
+  vector<Real> work(Max(d,1));
+  for(int j=0;j<k;j++) logE(0,j) = 0;
+  for(size_t t=0;t<observations.size();t++)
+    for(int j=0;j<k;j++)
+      logE(t+1,j) = densities[j].Evaluate(observations[t],&work[0]);
+}
+
+//E step over the sequences start,start+step,..., accumulating the
+//statistics needed by the M step
+struct GaussianHMMEStepTask
+{
+  const GaussianHMM* hmm;
+  const vector<GaussianLogDensity>* densities;
+  const vector<vector<Vector> >* examples;
+  int start,step;
+  Real logLikelihood;
   Vector p0accum;
   Matrix taccum;
-  vector<OnlineMoments> momentaccum(discretePrior.n);
+  //responsibility-weighted sums of 1, x-mu, and the lower triangle of
+  //(x-mu)(x-mu)^t for each state, centered on the current means
+  vector<Real> sw;
+  vector<Vector> s1;
+  vector<Matrix> s2;
+};
+
+static void GaussianHMMEStep(GaussianHMMEStepTask& task)
+{
+  const GaussianHMM& hmm = *task.hmm;
+  const vector<vector<Vector> >& examples = *task.examples;
+  int k = hmm.discretePrior.n;
+  int d = hmm.NumDims();
+  task.logLikelihood = 0;
+  task.p0accum.resize(k,0.0);
+  task.taccum.resize(k,k,0.0);
+  task.sw.assign(k,0.0);
+  task.s1.resize(k);
+  task.s2.resize(k);
+  for(int j=0;j<k;j++) {
+    task.s1[j].resize(d,0.0);
+    task.s2[j].resize(d,d,0.0);
+  }
+  Matrix logE;
+  vector<Vector> w;
+  Vector dx(d);
+  for(size_t i=task.start;i<examples.size();i+=task.step) {
+    GetLogEmissions(*task.densities,examples[i],logE);
+    task.logLikelihood += HMMForwardBackward(hmm.discretePrior,hmm.transitionMatrix,logE,w,&task.taccum);
+    task.p0accum += w[0];
+    for(size_t t=1;t<w.size();t++) {
+      const Vector& x = examples[i][t-1];
+      for(int j=0;j<k;j++) {
+	Real wj = w[t](j);
+	if(wj == 0) continue;
+	dx.sub(x,hmm.emissionModels[j].mu);
+	task.sw[j] += wj;
+	task.s1[j].madd(dx,wj);
+	Matrix& s2 = task.s2[j];
+	for(int p=0;p<d;p++) {
+	  Real wp = wj*dx(p);
+	  for(int q=0;q<=p;q++)
+	    s2(p,q) += wp*dx(q);
+	}
+      }
+    }
+  }
+}
+
+static void* GaussianHMMEStepThread(void* data)
+{
+  GaussianHMMEStep(*(GaussianHMMEStepTask*)data);
+  return NULL;
+}
+
+bool GaussianHMM::TrainEM(const vector<vector<Vector> >& examples,Real& tol,int maxIters,int verbose,int numThreads)
+{
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  numThreads = Max(1,Min(numThreads,(int)examples.size()));
+  vector<GaussianHMMEStepTask> tasks(numThreads);
+  vector<GaussianLogDensity> densities;
+  int d = NumDims();
+  Vector dm(d);
+  Matrix cov(d,d);
   Real lltotal_old = -Inf;
   for(int iters=0;iters<maxIters;iters++) {
+    //E step, split over sequences.  This also gives the log likelihood of
+    //the data under the current model.
+    GetLogDensities(emissionModels,densities);
+    for(int t=0;t<numThreads;t++) {
+      tasks[t].hmm = this;
+      tasks[t].densities = &densities;
+      tasks[t].examples = &examples;
+      tasks[t].start = t;
+      tasks[t].step = numThreads;
+    }
+    if(numThreads == 1)
+      GaussianHMMEStep(tasks[0]);
+    else {
+      vector<Thread> threads(numThreads);
+      for(int t=0;t<numThreads;t++)
+	threads[t] = ThreadStart(GaussianHMMEStepThread,&tasks[t]);
+      for(int t=0;t<numThreads;t++)
+	ThreadJoin(threads[t]);
+    }
     Real lltotal=0.0;
-    for(size_t i=0;i<examples.size();i++)
-      lltotal += LogLikelihood(examples[i]);
+    for(int t=0;t<numThreads;t++)
+      lltotal += tasks[t].logLikelihood;
     printf("Log likelihood of data: %g\n",lltotal);
     if(Abs(lltotal-lltotal_old) < tol) {
+      tol = lltotal;
       return true;
     }
+    lltotal_old = lltotal;
     if((iters+1) % 10 == 0) {
       printf("Saving progress to temp.ghmm\n");
       ofstream out("temp.ghmm");
@@ -110,36 +216,20 @@ bool GaussianHMM::TrainEM(const vector<vector<Vector> >& examples,Real& tol,int
     }
 
     printf("Performing EM iteration %d...\n",iters);
-
-    //interleaved E/M steps to reduce memory consumption
-    p0accum.resize(discretePrior.n);
-    p0accum.setZero();
-    taccum.resize(discretePrior.n,discretePrior.n);
-    taccum.setZero();
-    for(int k=0;k<discretePrior.n;k++) {
-      momentaccum[k].Clear();
-    }
-    for(size_t i=0;i<examples.size();i++) {
-      //E step
-      w.resize(examples[i].size());
-      Posterior(examples[i],w,taccum);
-
-      //M accumulations...
-      //M discrete prior
-      p0accum += w[0];
-      //M transition is already taken care of in taccum
-      //M moments
-      for(size_t j=1;j<w.size();j++) {
-	for(int k=0;k<discretePrior.n;k++) {
-	  momentaccum[k].AddPoint(examples[i][j-1],w[j](k));
-	}
+    for(int t=1;t<numThreads;t++) {
+      tasks[0].p0accum += tasks[t].p0accum;
+      tasks[0].taccum += tasks[t].taccum;
+      for(int i=0;i<discretePrior.n;i++) {
+	tasks[0].sw[i] += tasks[t].sw[i];
+	tasks[0].s1[i] += tasks[t].s1[i];
+	tasks[0].s2[i] += tasks[t].s2[i];
       }
     }
-    discretePrior = p0accum;
+    discretePrior = tasks[0].p0accum;
     NormalizeProbability(discretePrior);
     //cout<<"Priors: "<<discretePrior<<endl;
     //now maximize transition matrix
-    transitionMatrix = taccum;
+    transitionMatrix = tasks[0].taccum;
     //cout<<"Counts: "<<transitionMatrix<<endl;
     for(int i=0;i<transitionMatrix.m;i++) {
       Vector temp;
@@ -148,30 +238,36 @@ bool GaussianHMM::TrainEM(const vector<vector<Vector> >& examples,Real& tol,int
     }
     //now maximize emission probabilities
     for(size_t i=0;i<emissionModels.size();i++) {
-      if(momentaccum[i].sumWeight == 0.0 ) {
+      Real sw = tasks[0].sw[i];
+      if(sw == 0.0 ) {
 	emissionModels[i].mu.setZero();
 	emissionModels[i].L.setIdentity();
 	emissionModels[i].L *= covarianceRegularizationFactor;
       }
       else {
+	dm.div(tasks[0].s1[i],sw);
+	const Matrix& s2 = tasks[0].s2[i];
+	for(int p=0;p<d;p++)
+	  for(int q=0;q<=p;q++)
+	    cov(p,q) = cov(q,p) = s2(p,q)/sw - dm(p)*dm(q);
 	//add a small amount to the diagonal
-	for(int k=0;k<examples[0][0].n;k++) 
-	  momentaccum[i].cov(k,k) += Sqr(covarianceRegularizationFactor);
-	emissionModels[i].mu = momentaccum[i].mean;
-	bool res=emissionModels[i].setCovariance(momentaccum[i].cov,verbose);
+	for(int k=0;k<d;k++) 
+	  cov(k,k) += Sqr(covarianceRegularizationFactor);
+	emissionModels[i].mu += dm;
+	bool res=emissionModels[i].setCovariance(cov,verbose);
 	if(!res) {
-	  printf("Error setting gaussian %d\n",i);
+	  printf("Error setting gaussian %d\n",(int)i);
 	  return false;
 	}
 	int nzero = 0;
-	for(int k=0;k<examples[0][0].n;k++) {
+	for(int k=0;k<d;k++) {
 	  if(emissionModels[i].L(k,k) <= covarianceRegularizationFactor) {
 	    nzero++;
 	    emissionModels[i].L(k,k) = covarianceRegularizationFactor;
 	  }
 	}
 	if(nzero > 0) {
-	  printf("Gaussian %d became degenerate on %d axes\n",i,nzero);
+	  printf("Gaussian %d became degenerate on %d axes\n",(int)i,nzero);
 	}
       }
     }
@@ -205,15 +301,11 @@ Real GaussianHMM::LogLikelihood(const vector<int>& dstates,const vector<Vector>&
 
 Real GaussianHMM::LogLikelihood(const vector<Vector>& observations) const
 {
-  Real ll=0.0;
-  Vector p = discretePrior,temp;
-  for(size_t i=0;i<observations.size();i++) {
-    Predict(p,temp);
-    Real pi = Probability(temp,observations[i]);
-    ll += Log(pi);
-    p = temp;
-  }
-  return ll;
+  vector<GaussianLogDensity> densities;
+  GetLogDensities(emissionModels,densities);
+  Matrix logE;
+  GetLogEmissions(densities,observations,logE);
+  return HMMLogLikelihood(discretePrior,transitionMatrix,logE);
 }
 
 
@@ -263,132 +355,29 @@ void GaussianHMM::Filter(const Vector& p0,const Vector& obs,Vector& pnext) const
 
 void GaussianHMM::MAP(const vector<Vector>& observations,vector<int>& dstates) const
 {
-  dstates.resize(observations.size()+1);
-  vector<Vector> maxp(observations.size()+1);
-  vector<vector<int> > pred(observations.size()+1);
-  for(size_t i=0;i<observations.size();i++) {
-    maxp[i].resize(discretePrior.size());
-    pred[i].resize(discretePrior.size(),-1);
-  }
-  maxp[0] = discretePrior;
-
-  for(size_t i=0;i<observations.size();i++) {
-    for(int k=0;k<discretePrior.size();k++) {
-      Real best = -Inf;
-      int bestInd = 0;
-      for(int j=0;j<discretePrior.size();j++)
-	if(maxp[i][j]*transitionMatrix(k,j) > best) {
-	  best = maxp[i][j]*transitionMatrix(k,j);
-	  bestInd = j;
-	}
-      pred[i+1][k]=bestInd;
-      maxp[i+1][k]=best*emissionModels[k].probability(observations[i]);
-    }
-    //normalize maxp for better numerical performance
-    NormalizeProbability(maxp[i+1]);
-  }
-  //do backwards pass
-  maxp.back().maxElement(&dstates.back());
-  for(int i=(int)maxp.size()-1;i>0;i--) 
-    dstates[i-1] = pred[i][dstates[i]];
+  vector<GaussianLogDensity> densities;
+  GetLogDensities(emissionModels,densities);
+  Matrix logE;
+  GetLogEmissions(densities,observations,logE);
+  HMMViterbi(discretePrior,transitionMatrix,logE,dstates);
 }
 
 void GaussianHMM::Posterior(const vector<Vector>& observations,vector<Vector>& pstate) const
 {
-  vector<Vector> pforward(observations.size()+1),pbackward(observations.size()+1);
-  Matrix obsMat(observations.size(),discretePrior.n);
-  for(size_t i=0;i<observations.size();i++)
-    for(int j=0;j<discretePrior.n;j++)
-      obsMat(i,j) = emissionModels[j].probability(observations[i]);
-  //forward pass
-  pforward[0] = discretePrior;
-  for(size_t i=0;i<observations.size();i++) {
-    //Filter(pforward[i],observations[i],pforward[i+1]);
-    transitionMatrix.mul(pforward[i],pforward[i+1]);
-    for(size_t j=0;j<emissionModels.size();j++) 
-      pforward[i+1](j) *= obsMat(i,j);
-    Real sumw=NormalizeProbability(pforward[i+1]);
-    assert(sumw != 0.0);
-  }
-  //backward pass
-  pbackward.back().resize(discretePrior.size(),1.0);
-  for(int i=(int)observations.size()-1;i>=0;i--) {
-    //probability of o[i+1],...,o[T] given X[i] = k 
-    //=Sum_j P(X[i+1]=j|X[i]=k)*P(o[i+1]|X[i+1]=j)*P(o[i+2],...,o[T]|X[i+1]=j)
-    Vector pobs(discretePrior.size());
-    for(int j=0;j<pobs.n;j++)
-      pobs[j] = pbackward[i+1][j]*obsMat(i,j);
-    transitionMatrix.mulTranspose(pobs,pbackward[i]);
-    NormalizeProbability(pbackward[i]);
-    //for(size_t k=0;j<discretePrior.size();k++) 
-    //  for(size_t j=0;j<discretePrior.size();j++) 
-    //    pbackward[i][k] += pobs[j]*transitionMatrix(j,k);
-  }
-  //combine via elementwise product and normalize
-  pstate.resize(observations.size()+1);
-  for(size_t i=0;i<=observations.size();i++) {
-    pstate[i].resize(discretePrior.size()); 
-    for(int k=0;k<pstate[i].n;k++)
-      pstate[i][k] = pforward[i][k]*pbackward[i][k];
-    NormalizeProbability(pstate[i]);
-  }
+  vector<GaussianLogDensity> densities;
+  GetLogDensities(emissionModels,densities);
+  Matrix logE;
+  GetLogEmissions(densities,observations,logE);
+  HMMForwardBackward(discretePrior,transitionMatrix,logE,pstate);
 }
 
 void GaussianHMM::Posterior(const vector<Vector>& observations,vector<Vector>& pstate,Matrix& tstate) const
 {
-  vector<Vector> pforward(observations.size()+1),pbackward(observations.size()+1);
-  Matrix obsMat(observations.size(),discretePrior.n);
-  for(size_t i=0;i<observations.size();i++)
-    for(int j=0;j<discretePrior.n;j++)
-      obsMat(i,j) = emissionModels[j].probability(observations[i]);
-  //forward pass
-  pforward[0] = discretePrior;
-  for(size_t i=0;i<observations.size();i++) {
-    //Filter(pforward[i],observations[i],pforward[i+1]);
-    transitionMatrix.mul(pforward[i],pforward[i+1]);
-    for(size_t j=0;j<emissionModels.size();j++) 
-      pforward[i+1](j) *= obsMat(i,j);
-    Real sumw=NormalizeProbability(pforward[i+1]);
-    assert(sumw != 0.0);
-  }
-  //backward pass
-  pbackward.back().resize(discretePrior.size(),1.0);
-  for(int i=(int)observations.size()-1;i>=0;i--) {
-    //probability of o[i+1],...,o[T] given X[i] = k 
-    //=Sum_j P(X[i+1]=j|X[i]=k)*P(o[i+1]|X[i+1]=j)*P(o[i+2],...,o[T]|X[i+1]=j)
-    Vector pobs(discretePrior.size());
-    for(int j=0;j<pobs.n;j++)
-      pobs[j] = pbackward[i+1][j]*obsMat(i,j);
-    transitionMatrix.mulTranspose(pobs,pbackward[i]);
-    NormalizeProbability(pbackward[i]);
-    //for(size_t k=0;j<discretePrior.size();k++) 
-    //  for(size_t j=0;j<discretePrior.size();j++) 
-    //    pbackward[i][k] += pobs[j]*transitionMatrix(j,k);
-  }
-  //combine via elementwise product and normalize
-  pstate.resize(observations.size()+1);
-  for(size_t i=0;i<=observations.size();i++) {
-    pstate[i].resize(discretePrior.size()); 
-    for(int k=0;k<pstate[i].n;k++)
-      pstate[i][k] = pforward[i][k]*pbackward[i][k];
-    NormalizeProbability(pstate[i]);
-  }
-
-  //compute transition models
-  Matrix temp(discretePrior.n,discretePrior.n);
-  if(tstate.isEmpty()) tstate.resize(discretePrior.n,discretePrior.n,0.0);
-  for(size_t i=0;i<observations.size();i++) {
-    Real sum=0.0;
-    for(int k=0;k<discretePrior.n;k++) {
-      Real pobs=pbackward[i+1][k]*obsMat(i,k);
-      for(int j=0;j<discretePrior.n;j++) {
-	temp(k,j) = pforward[i][j]*transitionMatrix(k,j)*pobs;
-	sum += temp(k,j);
-      }
-    }
-    temp *= 1.0/sum;
-    tstate += temp;
-  }
+  vector<GaussianLogDensity> densities;
+  GetLogDensities(emissionModels,densities);
+  Matrix logE;
+  GetLogEmissions(densities,observations,logE);
+  HMMForwardBackward(discretePrior,transitionMatrix,logE,pstate,&tstate);
 }
 
 
@@ -37,8 +37,11 @@ public:
    * gaussians, given the training data, a tolerance, # of max iterations.
    * Returns true if tolerance was reached, returns log-likelihood
    * of data in tol.
+   *
+   * The E step processes the sequences in parallel over numThreads
+   * threads (or all hardware threads, if numThreads <= 0).
    */
-  bool TrainEM(const std::vector<std::vector<Vector> >& examples,Real& tol,int maxIters,int verbose=0);
+  bool TrainEM(const std::vector<std::vector<Vector> >& examples,Real& tol,int maxIters,int verbose=0,int numThreads=0);
   bool TrainDiagonalEM(const std::vector<std::vector<Vector> >& examples,Real& tol,int maxIters,int verbose=0);
 
   /// Computes the log likelihood of the time series
@@ -58,10 +61,12 @@ public:
   /// Given distribution over discrete states, compute distribution over
   /// observation
   void ObservationDistribution(const Vector& p0,GaussianMixtureModel& model) const;
-  /// Computes the MAP assignment using the Viterbi algorithm
+  /// Computes the MAP assignment using the Viterbi algorithm in log space
   void MAP(const std::vector<Vector>& observations,std::vector<int>& dstates) const;
   /// Computes the posterior probabilities of each discrete state using the
-  /// forward-backward algorithm
+  /// forward-backward algorithm.  The emission log-probabilities of the
+  /// whole sequence are computed first, and the passes are scaled to
+  /// avoid underflow (see HMMInference.h)
   void Posterior(const std::vector<Vector>& observations,std::vector<Vector>& pstate) const;
   /// Computes the posterior probabilities of each discrete state and
   /// accumulates state-to-state transition pairs using the forward-backward
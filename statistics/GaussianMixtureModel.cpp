@@ -5,6 +5,7 @@
 #include <math/SVDecomposition.h>
 #include <math/sample.h>
 #include <math/indexing.h>
+#include <utils/threadutils.h>
 #include <iostream>
 #include <fstream>
 using namespace std;
@@ -765,6 +766,337 @@ bool GaussianMixtureModel::TrainDiagonalEM(const std::vector<Vector>& examples,R
   return false;
 }
 
+//Number of examples whose log-densities are computed together by the
+//matrix EM pass
+const static int kEMBlockSize = 64;
+//Same tolerance as LBackSubstitute, for components with a zero diagonal
+const static Real kEMZeroTolerance = 1e-4;
+
+//Per-component quantities, computed once per EM iteration
+struct EMComponent
+{
+  bool active;
+  //log(phi) - log of the normalization factor
+  Real logScale;
+  vector<Real> mu;
+  //row-major copy of the cholesky factor, and its inverse diagonal (0 where
+  //the diagonal is 0)
+  vector<Real> L,invDiag;
+};
+
+//One thread's share of an EM pass over the rows [start,end) of the data
+struct EMTask
+{
+  const Matrix* data;
+  const vector<EMComponent>* components;
+  int start,end;
+  bool diagonal;
+  bool accumulate;
+  Real logLikelihood;
+  int numOutliers;
+  //responsibility-weighted sums of 1, x-mu, and (x-mu)(x-mu)^t for each
+  //component, centered on the component's current mean.  The lower
+  //triangle of (x-mu)(x-mu)^t is stored, or only its diagonal for diagonal
+  //EM.
+  vector<Real> sw,s1,s2;
+};
+
+static void SetupEMComponents(const GaussianMixtureModel& gmm,vector<EMComponent>& comps)
+{
+  int d=gmm.NumDims();
+  comps.resize(gmm.gaussians.size());
+  for(size_t j=0;j<comps.size();j++) {
+    const Gaussian<Real>& g=gmm.gaussians[j];
+    EMComponent& c=comps[j];
+    c.active = (gmm.phi[j] > 0);
+    c.mu.resize(d);
+    c.L.resize(d*d);
+    c.invDiag.resize(d);
+    int dnonzero = d;
+    Real logdet = 0;
+    for(int p=0;p<d;p++) {
+      c.mu[p] = g.mu(p);
+      for(int q=0;q<d;q++)
+	c.L[p*d+q] = (q <= p ? g.L(p,q) : Zero);
+      if(g.L(p,p) == 0.0) {
+	dnonzero--;
+	c.invDiag[p] = 0;
+      }
+      else {
+	logdet += Log(g.L(p,p));
+	c.invDiag[p] = 1.0/g.L(p,p);
+      }
+    }
+    if(c.active)
+      c.logScale = Log(gmm.phi[j]) - 0.5*Real(dnonzero)*Log(2.0*Pi) - logdet;
+    else
+      c.logScale = -Inf;
+  }
+}
+
+static void EMPass(EMTask& task)
+{
+  const Matrix& data = *task.data;
+  const vector<EMComponent>& comps = *task.components;
+  const int B = kEMBlockSize;
+  int d = data.n;
+  int k = (int)comps.size();
+  int s2size = (task.diagonal ? d : d*d);
+  task.logLikelihood = 0;
+  task.numOutliers = 0;
+  if(task.accumulate) {
+    task.sw.assign(k,0);
+    task.s1.assign(k*d,0);
+    task.s2.assign(k*s2size,0);
+  }
+  //x and y store the block with dimensions as rows, so the inner loops run
+  //over contiguous examples
+  vector<Real> x(d*B),y(d*B),lp(k*B),sq(B),dx(d);
+  vector<bool> zeroProbability(B);
+  for(int b0=task.start;b0<task.end;b0+=B) {
+    int nb = Min(B,task.end-b0);
+    for(int p=0;p<nb;p++)
+      for(int r=0;r<d;r++)
+	x[r*B+p] = data(b0+p,r);
+
+    //log-densities: solve L y = x-mu for the whole block
+    for(int j=0;j<k;j++) {
+      const EMComponent& c = comps[j];
+      Real* lpj = &lp[j*B];
+      if(!c.active) {
+	for(int p=0;p<nb;p++) lpj[p] = -Inf;
+	continue;
+      }
+      for(int p=0;p<nb;p++) {
+	sq[p] = 0;
+	zeroProbability[p] = false;
+      }
+      for(int r=0;r<d;r++) {
+	Real* yr = &y[r*B];
+	const Real* xr = &x[r*B];
+	Real mur = c.mu[r];
+	for(int p=0;p<nb;p++) yr[p] = xr[p]-mur;
+	if(!task.diagonal) {
+	  for(int q=0;q<r;q++) {
+	    Real Lrq = c.L[r*d+q];
+	    if(Lrq == 0) continue;
+	    const Real* yq = &y[q*B];
+	    for(int p=0;p<nb;p++) yr[p] -= Lrq*yq[p];
+	  }
+	}
+	Real inv = c.invDiag[r];
+	if(inv != 0) {
+	  for(int p=0;p<nb;p++) {
+	    yr[p] *= inv;
+	    sq[p] += yr[p]*yr[p];
+	  }
+	}
+	else {
+	  //degenerate axis: x must lie in the subspace
+	  for(int p=0;p<nb;p++) {
+	    if(!FuzzyZero(yr[p],kEMZeroTolerance)) zeroProbability[p] = true;
+	    yr[p] = 0;
+	  }
+	}
+      }
+      for(int p=0;p<nb;p++)
+	lpj[p] = (zeroProbability[p] ? -Inf : c.logScale - Half*sq[p]);
+    }
+
+    //responsibilities, normalized with log-sum-exp
+    for(int p=0;p<nb;p++) {
+      Real lmax = -Inf;
+      for(int j=0;j<k;j++) lmax = Max(lmax,lp[j*B+p]);
+      if(!IsFinite(lmax)) {
+	task.numOutliers++;
+	task.logLikelihood += Log(p_outlier);
+	for(int j=0;j<k;j++) lp[j*B+p] = 0;
+	continue;
+      }
+      Real sum = 0;
+      for(int j=0;j<k;j++) {
+	Real e = Exp(lp[j*B+p]-lmax);
+	lp[j*B+p] = e;
+	sum += e;
+      }
+      task.logLikelihood += lmax + Log(sum);
+      Real scale = 1.0/sum;
+      for(int j=0;j<k;j++) lp[j*B+p] *= scale;
+    }
+    if(!task.accumulate) continue;
+
+    //sufficient statistics
+    for(int j=0;j<k;j++) {
+      const EMComponent& c = comps[j];
+      if(!c.active) continue;
+      Real* s1j = &task.s1[j*d];
+      Real* s2j = &task.s2[j*s2size];
+      for(int p=0;p<nb;p++) {
+	Real wp = lp[j*B+p];
+	if(wp == 0) continue;
+	task.sw[j] += wp;
+	for(int r=0;r<d;r++) {
+	  dx[r] = x[r*B+p]-c.mu[r];
+	  s1j[r] += wp*dx[r];
+	}
+	if(task.diagonal) {
+	  for(int r=0;r<d;r++)
+	    s2j[r] += wp*dx[r]*dx[r];
+	}
+	else {
+	  for(int r=0;r<d;r++) {
+	    Real wr = wp*dx[r];
+	    Real* s2r = &s2j[r*d];
+	    for(int q=0;q<=r;q++)
+	      s2r[q] += wr*dx[q];
+	  }
+	}
+      }
+    }
+  }
+}
+
+static void* EMPassThread(void* data)
+{
+  EMPass(*(EMTask*)data);
+  return NULL;
+}
+
+//Runs one pass over the data, returning the log likelihood.  If accumulate
+//is true, the tasks hold the sufficient statistics on output.
+static Real RunEMPass(const GaussianMixtureModel& gmm,const Matrix& data,bool diagonal,bool accumulate,int numThreads,vector<EMTask>& tasks,int& numOutliers)
+{
+  vector<EMComponent> comps;
+  SetupEMComponents(gmm,comps);
+  int m = data.m;
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  numThreads = Max(1,Min(numThreads,(m+kEMBlockSize-1)/kEMBlockSize));
+  tasks.resize(numThreads);
+  for(int t=0;t<numThreads;t++) {
+    tasks[t].data = &data;
+    tasks[t].components = &comps;
+    tasks[t].start = int((long long)m*t/numThreads);
+    tasks[t].end = int((long long)m*(t+1)/numThreads);
+    tasks[t].diagonal = diagonal;
+    tasks[t].accumulate = accumulate;
+  }
+  if(numThreads == 1)
+    EMPass(tasks[0]);
+  else {
+    vector<Thread> threads(numThreads);
+    for(int t=0;t<numThreads;t++)
+      threads[t] = ThreadStart(EMPassThread,&tasks[t]);
+    for(int t=0;t<numThreads;t++)
+      ThreadJoin(threads[t]);
+  }
+  Real ll = 0;
+  numOutliers = 0;
+  for(int t=0;t<numThreads;t++) {
+    ll += tasks[t].logLikelihood;
+    numOutliers += tasks[t].numOutliers;
+  }
+  return ll;
+}
+
+//M step from the sufficient statistics accumulated by the tasks
+static void EMMaximize(GaussianMixtureModel& gmm,const vector<EMTask>& tasks,int m,bool diagonal,int verbose)
+{
+  int k = (int)gmm.gaussians.size();
+  int d = gmm.NumDims();
+  int s2size = (diagonal ? d : d*d);
+  vector<Real> s1(d),s2(s2size);
+  Vector dm(d);
+  Matrix cov(d,d);
+  for(int j=0;j<k;j++) {
+    if(gmm.phi[j] == 0.0) continue;
+    Real sw = 0;
+    fill(s1.begin(),s1.end(),0);
+    fill(s2.begin(),s2.end(),0);
+    for(size_t t=0;t<tasks.size();t++) {
+      sw += tasks[t].sw[j];
+      for(int r=0;r<d;r++) s1[r] += tasks[t].s1[j*d+r];
+      for(int r=0;r<s2size;r++) s2[r] += tasks[t].s2[j*s2size+r];
+    }
+    if(!(sw > 0)) {
+      if(verbose >= 1) printf("Associations to Gaussian %d dropped to zero\n",j);
+      gmm.phi[j] = 0.0;
+      continue;
+    }
+    Gaussian<Real>& g = gmm.gaussians[j];
+    gmm.phi[j] = sw/m;
+    for(int r=0;r<d;r++) dm(r) = s1[r]/sw;
+    g.mu += dm;
+    if(diagonal) {
+      g.L.resize(d,d,Zero);
+      g.L.setZero();
+      for(int r=0;r<d;r++)
+	g.L(r,r) = Sqrt(Max(s2[r]/sw-dm(r)*dm(r),Zero));
+    }
+    else {
+      for(int r=0;r<d;r++)
+	for(int q=0;q<=r;q++)
+	  cov(r,q) = cov(q,r) = s2[r*d+q]/sw-dm(r)*dm(q);
+      if(!g.setCovariance(cov,verbose) && verbose >= 1)
+	printf("Error setting maximum likelihood for gaussian %d\n",j);
+    }
+    bool finite = true;
+    for(int r=0;r<d;r++) {
+      if(g.L(r,r) <= covarianceRegularizationFactor)
+	g.L(r,r) = covarianceRegularizationFactor;
+      for(int q=0;q<=r;q++)
+	if(!IsFinite(g.L(r,q))) finite = false;
+    }
+    if(!finite) {
+      if(verbose >= 1) printf("Gaussian %d became non-finite\n",j);
+      gmm.phi[j] = 0.0;
+    }
+  }
+  Normalize(gmm.phi);
+}
+
+static bool TrainEMMatrix(GaussianMixtureModel& gmm,const Matrix& examples,bool diagonal,Real& tol,int maxIters,int verbose,int numThreads)
+{
+  int m=examples.m;
+  int n=(int)gmm.gaussians.size();
+  if(verbose >= 1) printf("Training %sGMM with %d examples, %d gaussians\n",(diagonal?"diagonal ":""),m,n);
+  assert(m > 0);
+  assert(n > 0);
+  assert(examples.n == gmm.NumDims());
+  vector<EMTask> tasks;
+  Real likelihood = 0;
+  for(int s=0;s<maxIters;s++) {
+    Real oldlikelihood = likelihood;
+    int numOutliers;
+    likelihood = RunEMPass(gmm,examples,diagonal,true,numThreads,tasks,numOutliers);
+    if(verbose >= 1) printf("Iteration %d: likelihood %g\n",s,likelihood);
+    if(numOutliers > 0 && verbose >= 1)
+      printf("Warning, %d/%d examples have zero probability\n",numOutliers,m);
+    if(s > 0 && Abs(likelihood - oldlikelihood) < tol) {
+      tol = likelihood;
+      return true;
+    }
+    EMMaximize(gmm,tasks,m,diagonal,verbose);
+  }
+  return false;
+}
+
+bool GaussianMixtureModel::TrainEM(const Matrix& examples,Real& tol,int maxIters,int verbose,int numThreads)
+{
+  return TrainEMMatrix(*this,examples,false,tol,maxIters,verbose,numThreads);
+}
+
+bool GaussianMixtureModel::TrainDiagonalEM(const Matrix& examples,Real& tol,int maxIters,int verbose,int numThreads)
+{
+  return TrainEMMatrix(*this,examples,true,tol,maxIters,verbose,numThreads);
+}
+
+Real GaussianMixtureModel::LogLikelihood(const Matrix& data,int numThreads)
+{
+  vector<EMTask> tasks;
+  int numOutliers;
+  return RunEMPass(*this,data,false,false,numThreads,tasks,numOutliers);
+}
+
 
 int GaussianMixtureModel::PickGaussian() const
 {
@@ -33,8 +33,27 @@ public:
   bool TrainEM(const std::vector<Vector>& examples,Real& tol,int maxIters,int verbose=0);
   bool TrainDiagonalEM(const std::vector<Vector>& examples,Real& tol,int maxIters,int verbose=0);
 
+  /** @brief Same as above, but for a data matrix with one example per row,
+   * and suited to very large data sets.
+   *
+   * Each iteration makes one pass over the data, split over numThreads
+   * threads (or all hardware threads, if numThreads <= 0).  Rather than
+   * storing the responsibilities of all examples, each thread computes them
+   * for blocks of examples and accumulates the weighted sums needed by the
+   * M step.  The log-densities of a block are computed with one triangular
+   * solve per component on the whole block, using the cholesky factors, and
+   * the responsibilities are normalized with the log-sum-exp trick.
+   *
+   * Components whose weight drops to zero get phi=0 and are left out of
+   * subsequent iterations.
+   */
+  bool TrainEM(const Matrix& examples,Real& tol,int maxIters,int verbose=0,int numThreads=0);
+  bool TrainDiagonalEM(const Matrix& examples,Real& tol,int maxIters,int verbose=0,int numThreads=0);
+
   /// Computes the log likelihood of the data
   Real LogLikelihood(const std::vector<Vector>& data);
+  /// Computes the log likelihood of a data matrix with one example per row
+  Real LogLikelihood(const Matrix& data,int numThreads=0);
 
   int PickGaussian() const;
   Real Probability(const Vector& x) const;
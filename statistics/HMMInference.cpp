@@ -0,0 +1,239 @@
+#include "HMMInference.h"
+using namespace std;
+
+namespace Statistics {
+
+//Same tolerance as LBackSubstitute
+const static Real kZeroDiagonalTolerance = 1e-4;
+
+void GaussianLogDensity::Set(const Gaussian<Real>& g)
+{
+  d = g.mu.n;
+  mu.resize(d);
+  L.resize(d*d);
+  invDiag.resize(d);
+  int dnonzero = d;
+  Real logdet = 0;
+  for(int i=0;i<d;i++) {
+    mu[i] = g.mu(i);
+    for(int j=0;j<d;j++)
+      L[i*d+j] = (j <= i ? g.L(i,j) : Zero);
+    if(g.L(i,i) == 0.0) {
+      dnonzero--;
+      invDiag[i] = 0;
+    }
+    else {
+      logdet += Log(g.L(i,i));
+      invDiag[i] = 1.0/g.L(i,i);
+    }
+  }
+  logScale = -0.5*Real(dnonzero)*Log(2.0*Pi) - logdet;
+}
+
+Real GaussianLogDensity::Evaluate(const Vector& x,Real* work) const
+{
+  Assert(x.n == d);
+  for(int i=0;i<d;i++) work[i] = x(i)-mu[i];
+  return EvaluateOffset(work);
+}
+
+Real GaussianLogDensity::EvaluateOffset(Real* y) const
+{
+  //solve L y' = y in place
+  Real sq = 0;
+  for(int i=0;i<d;i++) {
+    const Real* Li = &L[i*d];
+    Real sum = y[i];
+    for(int j=0;j<i;j++)
+      sum -= Li[j]*y[j];
+    if(invDiag[i] == 0) {
+      if(!FuzzyZero(sum,kZeroDiagonalTolerance)) return -Inf;
+      y[i] = 0;
+    }
+    else {
+      y[i] = sum*invDiag[i];
+      sq += y[i]*y[i];
+    }
+  }
+  return logScale - Half*sq;
+}
+
+//Copies the transition matrix into a contiguous row-major array
+static void GetTransitions(const Matrix& transitionMatrix,vector<Real>& T)
+{
+  int k = transitionMatrix.m;
+  T.resize(k*k);
+  for(int i=0;i<k;i++)
+    for(int j=0;j<k;j++)
+      T[i*k+j] = transitionMatrix(i,j);
+}
+
+//Forward pass.  On output, row t of e holds the emission probabilities
+//scaled by the largest one, and row t of f holds the normalized forward
+//distribution.  If no state can emit o[t], row t of e is set to all ones,
+//i.e., the observation is ignored.
+static Real ScaledForward(const Vector& p0,const vector<Real>& T,const Matrix& logEmissions,vector<Real>& e,vector<Real>& f)
+{
+  int n = logEmissions.m;
+  int k = logEmissions.n;
+  e.resize(n*k);
+  f.resize(n*k);
+  Real ll = 0;
+  for(int t=0;t<n;t++) {
+    Real* et = &e[t*k];
+    Real* ft = &f[t*k];
+    Real emax = -Inf;
+    for(int j=0;j<k;j++) emax = Max(emax,logEmissions(t,j));
+    if(IsFinite(emax))
+      for(int j=0;j<k;j++) et[j] = Exp(logEmissions(t,j)-emax);
+    if(t == 0)
+      for(int j=0;j<k;j++) ft[j] = p0(j);
+    else {
+      const Real* fprev = &f[(t-1)*k];
+      for(int i=0;i<k;i++) {
+        const Real* Ti = &T[i*k];
+        Real sum = 0;
+        for(int j=0;j<k;j++) sum += Ti[j]*fprev[j];
+        ft[i] = sum;
+      }
+    }
+    Real c = 0;
+    if(IsFinite(emax)) {
+      for(int j=0;j<k;j++) c += ft[j]*et[j];
+    }
+    if(c > 0) {
+      ll += Log(c) + emax;
+      Real scale = 1.0/c;
+      for(int j=0;j<k;j++) ft[j] *= et[j]*scale;
+    }
+    else {
+      ll = -Inf;
+      for(int j=0;j<k;j++) et[j] = 1;
+      Real sum = 0;
+      for(int j=0;j<k;j++) sum += ft[j];
+      if(sum > 0)
+        for(int j=0;j<k;j++) ft[j] /= sum;
+    }
+  }
+  return ll;
+}
+
+Real HMMLogLikelihood(const Vector& p0,const Matrix& transitionMatrix,const Matrix& logEmissions)
+{
+  Assert(p0.n == logEmissions.n);
+  vector<Real> T,e,f;
+  GetTransitions(transitionMatrix,T);
+  return ScaledForward(p0,T,logEmissions,e,f);
+}
+
+Real HMMForwardBackward(const Vector& p0,const Matrix& transitionMatrix,const Matrix& logEmissions,vector<Vector>& pstate,Matrix* tstate)
+{
+  Assert(p0.n == logEmissions.n);
+  int n = logEmissions.m;
+  int k = logEmissions.n;
+  pstate.resize(n);
+  if(n == 0) return 0;
+  vector<Real> T,e,f;
+  GetTransitions(transitionMatrix,T);
+  Real ll = ScaledForward(p0,T,logEmissions,e,f);
+
+  //backward pass: b[t](j) is proportional to P(o[t+1],...,o[n-1]|x[t]=j)
+  vector<Real> b(n*k),g(k);
+  for(int j=0;j<k;j++) b[(n-1)*k+j] = 1;
+  for(int t=n-1;t>0;t--) {
+    const Real* bt = &b[t*k];
+    const Real* et = &e[t*k];
+    Real* bprev = &b[(t-1)*k];
+    for(int i=0;i<k;i++) g[i] = bt[i]*et[i];
+    for(int j=0;j<k;j++) bprev[j] = 0;
+    for(int i=0;i<k;i++) {
+      if(g[i] == 0) continue;
+      const Real* Ti = &T[i*k];
+      for(int j=0;j<k;j++) bprev[j] += Ti[j]*g[i];
+    }
+    Real sum = 0;
+    for(int j=0;j<k;j++) sum += bprev[j];
+    if(sum > 0) {
+      Real scale = 1.0/sum;
+      for(int j=0;j<k;j++) bprev[j] *= scale;
+    }
+  }
+
+  //combine via elementwise product and normalize
+  for(int t=0;t<n;t++) {
+    pstate[t].resize(k);
+    Real sum = 0;
+    for(int j=0;j<k;j++) {
+      pstate[t](j) = f[t*k+j]*b[t*k+j];
+      sum += pstate[t](j);
+    }
+    if(sum > 0) pstate[t] *= 1.0/sum;
+  }
+
+  if(tstate) {
+    if(tstate->isEmpty()) tstate->resize(k,k,0.0);
+    Assert(tstate->m == k && tstate->n == k);
+    vector<Real> xi(k*k);
+    for(int t=1;t<n;t++) {
+      const Real* fprev = &f[(t-1)*k];
+      Real sum = 0;
+      for(int i=0;i<k;i++) {
+        Real gi = b[t*k+i]*e[t*k+i];
+        const Real* Ti = &T[i*k];
+        Real* xii = &xi[i*k];
+        for(int j=0;j<k;j++) {
+          xii[j] = fprev[j]*Ti[j]*gi;
+          sum += xii[j];
+        }
+      }
+      if(!(sum > 0)) continue;
+      Real scale = 1.0/sum;
+      for(int i=0;i<k;i++)
+        for(int j=0;j<k;j++)
+          (*tstate)(i,j) += xi[i*k+j]*scale;
+    }
+  }
+  return ll;
+}
+
+void HMMViterbi(const Vector& p0,const Matrix& transitionMatrix,const Matrix& logEmissions,vector<int>& states)
+{
+  Assert(p0.n == logEmissions.n);
+  int n = logEmissions.m;
+  int k = logEmissions.n;
+  states.resize(n);
+  if(n == 0) return;
+  vector<Real> logT;
+  GetTransitions(transitionMatrix,logT);
+  for(size_t i=0;i<logT.size();i++) logT[i] = Log(logT[i]);
+  vector<Real> delta(k),deltaNext(k);
+  vector<int> pred(n*k,-1);
+  for(int j=0;j<k;j++) delta[j] = Log(p0(j)) + logEmissions(0,j);
+  for(int t=1;t<n;t++) {
+    for(int i=0;i<k;i++) {
+      const Real* logTi = &logT[i*k];
+      Real best = -Inf;
+      int bestInd = 0;
+      for(int j=0;j<k;j++)
+        if(delta[j]+logTi[j] > best) {
+          best = delta[j]+logTi[j];
+          bestInd = j;
+        }
+      pred[t*k+i] = bestInd;
+      deltaNext[i] = best + logEmissions(t,i);
+    }
+    swap(delta,deltaNext);
+  }
+  //do backwards pass
+  Real best = -Inf;
+  states[n-1] = 0;
+  for(int j=0;j<k;j++)
+    if(delta[j] > best) {
+      best = delta[j];
+      states[n-1] = j;
+    }
+  for(int t=n-1;t>0;t--)
+    states[t-1] = pred[t*k+states[t]];
+}
+
+} //namespace Statistics
@@ -0,0 +1,58 @@
+#ifndef STATISTICS_HMM_INFERENCE_H
+#define STATISTICS_HMM_INFERENCE_H
+
+#include <KrisLibrary/math/gaussian.h>
+#include <KrisLibrary/math/vector.h>
+#include <KrisLibrary/math/matrix.h>
+#include <vector>
+
+/** @file statistics/HMMInference.h
+ * @ingroup Statistics
+ * @brief Inference routines shared by GaussianHMM and LinearProcessHMM.
+ *
+ * A sequence of n time steps is described by the distribution p0 of the
+ * first discrete state, the transition matrix T with
+ * T(i,j) = P(x[t+1]=i | x[t]=j), and an n x k matrix logE of log emission
+ * probabilities with logE(t,j) = log P(o[t] | x[t]=j).  All emissions are
+ * computed up front, so the recursions only involve k x k products.
+ */
+
+namespace Statistics {
+  using namespace Math;
+
+/** @ingroup Statistics
+ * @brief Evaluates the log-density of a fixed Gaussian at many points.
+ *
+ * Stores the normalization constant and a contiguous copy of the cholesky
+ * factor, so no temporaries are allocated per evaluation.  Gives the same
+ * values as Gaussian::logProbability, including for zero diagonal entries.
+ * Evaluate is const and may be called from several threads.
+ */
+struct GaussianLogDensity
+{
+  void Set(const Gaussian<Real>& g);
+  ///Returns log N(x;mu,Sigma).  work must have room for d values.
+  Real Evaluate(const Vector& x,Real* work) const;
+  ///Returns log N(mu+dx;mu,Sigma).  dx is overwritten.
+  Real EvaluateOffset(Real* dx) const;
+
+  int d;
+  Real logScale;
+  std::vector<Real> mu,L,invDiag;
+};
+
+///Scaled forward-backward algorithm.  Sets pstate[t] to the posterior
+///distribution of x[t] and, if tstate is non-NULL, adds the expected
+///number of transitions from j to i to tstate(i,j).  Returns the log
+///likelihood of the observations.
+Real HMMForwardBackward(const Vector& p0,const Matrix& transitionMatrix,const Matrix& logEmissions,std::vector<Vector>& pstate,Matrix* tstate=NULL);
+
+///Returns the log likelihood of the observations using the forward pass
+Real HMMLogLikelihood(const Vector& p0,const Matrix& transitionMatrix,const Matrix& logEmissions);
+
+///Viterbi algorithm in log space: returns the most likely state sequence
+void HMMViterbi(const Vector& p0,const Matrix& transitionMatrix,const Matrix& logEmissions,std::vector<int>& states);
+
+} //namespace Statistics
+
+#endif
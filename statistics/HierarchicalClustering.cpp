@@ -1,117 +1,324 @@
 #include "HierarchicalClustering.h"
-#include <set>
+#include <utils/unionfind.h>
+#include <utils/threadutils.h>
+#include <algorithm>
 
 using namespace Statistics;
 using namespace std;
 
-void HierarchicalClustering::Build(const vector<Vector>& data,int K,Type type)
+//maximum number of distances buffered by SLINK at once
+const static size_t kSLINKBufferSize = 1<<22;
+
+//offset of row i in a packed lower-triangular matrix without diagonal
+inline size_t TriangleOffset(int i) { return size_t(i)*size_t(i-1)/2; }
+
+//Computes the rows start,start+step,... < end of the lower triangle of the
+//distance matrix.  Row i holds the distances from i to 0..i-1 and is stored
+//at rows + TriangleOffset(i) - rowsOffset.
+struct DistanceRowTask
 {
-	// fill distances matrix C, then I and P
-	int N = (int)data.size();
-	int i, j;
-	A.clear();
-	A.resize(N);
-	// multiset for storing sorted distances: insert/delete operation - O(log N)
-	std::vector<std::multiset<distances, Cmp> > P(N);
-	// 2d vector for storing distances matrix
-	std::vector<std::vector<distances> > C(N);
-	// vector for storing flags for marking currently active clusters
-	std::vector<int> II(N);
-
-	// complexity is: O(N*N*log(N))
-	for(i=0; i<N; ++i)
-	{
-		std::vector<distances> V_temp;
-		distances D_temp;
-		V_temp.clear();
-		std::multiset<distances, Cmp> Q_temp;
-		Q_temp.clear();
-		V_temp.resize(N);
-		for(j=0; j<N; ++j)
-		{
-		  D_temp.dist = data[i].distance(data[j]);
-		  D_temp.index = j;
-		  V_temp[j]=D_temp;
-		  if(j!=i)  {
-		    Q_temp.insert(D_temp);
-		  }
+	const vector<Vector>* data;
+	const Matrix* dist;
+	bool squared;
+	int start,end,step;
+	Real* rows;
+	size_t rowsOffset;
+};
+
+static void ComputeDistanceRows(DistanceRowTask& task)
+{
+	for(int i=task.start;i<task.end;i+=task.step) {
+		Real* row = task.rows + (TriangleOffset(i)-task.rowsOffset);
+		if(task.data) {
+			const vector<Vector>& data = *task.data;
+			if(task.squared)
+				for(int j=0;j<i;j++) row[j] = data[i].distanceSquared(data[j]);
+			else
+				for(int j=0;j<i;j++) row[j] = data[i].distance(data[j]);
+		}
+		else {
+			const Matrix& dist = *task.dist;
+			if(task.squared)
+				for(int j=0;j<i;j++) row[j] = Sqr(dist(i,j));
+			else
+				for(int j=0;j<i;j++) row[j] = dist(i,j);
 		}
-		C[i]=V_temp;
-		II[i]=1;
-		P[i]=Q_temp;
+	}
+}
 
-		A[i].resize(1);
-		A[i][0] = i;
+static void* ComputeDistanceRowsThread(void* data)
+{
+	ComputeDistanceRows(*(DistanceRowTask*)data);
+	return NULL;
+}
+
+//Fills rows [start,end) of the lower triangle, as described above
+static void RunDistanceRows(const vector<Vector>* data,const Matrix* dist,bool squared,int start,int end,Real* rows,size_t rowsOffset,int numThreads)
+{
+	if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+	numThreads = Max(1,Min(numThreads,end-start));
+	vector<DistanceRowTask> tasks(numThreads);
+	for(int t=0;t<numThreads;t++) {
+		tasks[t].data = data;
+		tasks[t].dist = dist;
+		tasks[t].squared = squared;
+		//interleave the rows, since their lengths grow with i
+		tasks[t].start = start+t;
+		tasks[t].end = end;
+		tasks[t].step = numThreads;
+		tasks[t].rows = rows;
+		tasks[t].rowsOffset = rowsOffset;
 	}
+	if(numThreads == 1)
+		ComputeDistanceRows(tasks[0]);
+	else {
+		vector<Thread> threads(numThreads);
+		for(int t=0;t<numThreads;t++)
+			threads[t] = ThreadStart(ComputeDistanceRowsThread,&tasks[t]);
+		for(int t=0;t<numThreads;t++)
+			ThreadJoin(threads[t]);
+	}
+}
 
-	// next: build clusters until K clusters left
-	// complexity is: O(N*N*log(N))
-	for(int n=0; n<N-K; ++n)
-	{
-		double min_dist = Inf;
-		int min_index = 0;
-		for(int k=0; k<N-1; ++k)
-		{
-			if(II[k]==1)
-			{
-				if(P[k].begin()->dist<min_dist)
-				{
-					min_dist = P[k].begin()->dist;
-					min_index = P[k].begin()->index;
+//A merge of the clusters containing items a and b at the given height
+struct ClusterMerge
+{
+	int a,b;
+	Real height;
+};
+
+struct ClusterMergeHeightCmp
+{
+	bool operator()(const ClusterMerge& m1,const ClusterMerge& m2) const
+	{ return m1.height < m2.height; }
+};
+
+//Computes the pointer representation (pi,lambda) of the single linkage
+//dendrogram: item i is merged with the cluster of pi[i] > i at height
+//lambda[i] (Sibson 1973)
+static void SLINK(const vector<Vector>* data,const Matrix* dist,int N,int numThreads,vector<int>& pi,vector<Real>& lambda)
+{
+	pi.resize(N);
+	lambda.resize(N);
+	vector<Real> M(N);
+	vector<Real> rows;
+	int i=0;
+	while(i < N) {
+		//compute the next batch of rows in parallel
+		int iend = i+1;
+		while(iend < N && TriangleOffset(iend+1)-TriangleOffset(i) <= kSLINKBufferSize) iend++;
+		size_t rowsOffset = TriangleOffset(i);
+		rows.resize(TriangleOffset(iend)-rowsOffset+1);
+		RunDistanceRows(data,dist,false,i,iend,&rows[0],rowsOffset,numThreads);
+		for(;i<iend;i++) {
+			const Real* row = &rows[TriangleOffset(i)-rowsOffset];
+			pi[i] = i;
+			lambda[i] = Inf;
+			for(int j=0;j<i;j++) M[j] = row[j];
+			for(int j=0;j<i;j++) {
+				if(lambda[j] >= M[j]) {
+					M[pi[j]] = Min(M[pi[j]],lambda[j]);
+					lambda[j] = M[j];
+					pi[j] = i;
 				}
+				else
+					M[pi[j]] = Min(M[pi[j]],M[j]);
 			}
+			for(int j=0;j<i;j++)
+				if(lambda[j] >= lambda[pi[j]]) pi[j] = i;
 		}
-		// we have minimum distance
-		// k1, k2 - indexes of most nearest clusters
-		int k1 = min_index;
-		int k2 = P[k1].begin()->index;
-		
-		int N_k1 = A[k1].size();
-		int N_k2 = A[k2].size();
-		
-		P[k1].clear();
-		// add cluster k2 to A[k1]
-		for(size_t l=0;l<A[k2].size();++l)
-		{
-			A[k1].push_back(A[k2][l]);
-		}
-		
-		// clear the second cluster
-		II[k2] = 0;
-		// O(N*log(N))
-		for(int m=0; m<N; ++m)
-		{
-			// O(log(N)): insert, erase operations
-			if((II[m]!=0)&&(m!=k1))
-			{
-				P[m].erase(C[m][k1]);
-				P[m].erase(C[m][k2]);
-				if(type == SingleLinkage)
-				{
-					C[m][k1].dist = C[m][k1].dist<C[m][k2].dist ? C[m][k1].dist : C[m][k2].dist;
-					C[k1][m].dist = C[m][k1].dist;
-				}
-				else if(type == CompleteLinkage)
-				{
-					C[m][k1].dist = C[m][k1].dist>C[m][k2].dist ? C[m][k1].dist : C[m][k2].dist;
-					C[k1][m].dist = C[m][k1].dist;
-				}
-				else if(type == AverageLinkage)
+	}
+}
+
+//Lance-Williams updates of a packed lower-triangular distance matrix.  For
+//Ward linkage the matrix stores squared distances.
+class MatrixLinkage
+{
+public:
+	MatrixLinkage(HierarchicalClustering::Type _type,vector<Real>& _d,vector<int>& _sizes)
+		:type(_type),d(_d),sizes(_sizes) {}
+	inline Real& D(int a,int b) { return (a > b ? d[TriangleOffset(a)+b] : d[TriangleOffset(b)+a]); }
+	inline Real Distance(int a,int b) { return D(a,b); }
+	inline Real Height(Real dab) const { return (type == HierarchicalClustering::WardLinkage ? Sqrt(dab) : dab); }
+	//merges b into a
+	void Merge(int a,int b,const vector<int>& active)
+	{
+		Real na=sizes[a],nb=sizes[b];
+		Real dab = D(a,b);
+		for(size_t k=0;k<active.size();k++) {
+			int c=active[k];
+			if(c == a || c == b) continue;
+			Real& dac = D(a,c);
+			Real dbc = D(b,c);
+			switch(type) {
+			case HierarchicalClustering::CompleteLinkage:
+				dac = Max(dac,dbc);
+				break;
+			case HierarchicalClustering::AverageLinkage:
+				dac = (na*dac + nb*dbc)/(na+nb);
+				break;
+			case HierarchicalClustering::WardLinkage:
 				{
-					int N_m = A[m].size();
-					C[m][k1].dist = (N_k1*C[m][k1].dist + N_k2*C[m][k2].dist)/N_m;
+					Real nc=sizes[c];
+					dac = ((na+nc)*dac + (nb+nc)*dbc - nc*dab)/(na+nb+nc);
 				}
-				P[m].insert(C[m][k1]);					
-				P[k1].insert(C[k1][m]);
+				break;
+			default:
+				dac = Min(dac,dbc);
+				break;
+			}
+		}
+		sizes[a] += sizes[b];
+	}
+
+	HierarchicalClustering::Type type;
+	vector<Real>& d;
+	vector<int>& sizes;
+};
+
+//Ward linkage computed from the cluster centroids and sizes.  Distance
+//returns the increase in the sum of squared errors caused by a merge.
+class WardCentroidLinkage
+{
+public:
+	WardCentroidLinkage(const vector<Vector>& data,vector<int>& _sizes)
+		:centroids(data),sizes(_sizes) {}
+	inline Real Distance(int a,int b) {
+		Real na=sizes[a],nb=sizes[b];
+		return na*nb/(na+nb)*centroids[a].distanceSquared(centroids[b]);
+	}
+	inline Real Height(Real dab) const { return Sqrt(Two*dab); }
+	//merges b into a
+	void Merge(int a,int b,const vector<int>& active)
+	{
+		Real na=sizes[a],nb=sizes[b];
+		centroids[a].inplaceMul(na/(na+nb));
+		centroids[a].madd(centroids[b],nb/(na+nb));
+		centroids[b].clear();
+		sizes[a] += sizes[b];
+	}
+
+	vector<Vector> centroids;
+	vector<int>& sizes;
+};
+
+//Nearest-neighbor chain algorithm for a reducible linkage.  Returns the
+//N-1 merges in the order they were found, which for a reducible linkage
+//give the same dendrogram as greedy agglomeration once sorted by height.
+template <class Linkage>
+void NNChain(Linkage& linkage,int N,vector<ClusterMerge>& merges)
+{
+	vector<int> active(N),activeIndex(N);
+	for(int i=0;i<N;i++) active[i]=activeIndex[i]=i;
+	vector<int> chain;
+	merges.resize(0);
+	merges.reserve(N-1);
+	while(active.size() > 1) {
+		if(chain.empty()) chain.push_back(active[0]);
+		int a = chain.back();
+		int prev = (chain.size() >= 2 ? chain[chain.size()-2] : -1);
+		//find the nearest neighbor of a, preferring the previous element of
+		//the chain on ties so that the chain terminates
+		int c = prev;
+		Real dmin = (prev >= 0 ? linkage.Distance(a,prev) : Inf);
+		for(size_t k=0;k<active.size();k++) {
+			int b=active[k];
+			if(b == a || b == prev) continue;
+			Real dab = linkage.Distance(a,b);
+			if(dab < dmin || c < 0) {
+				dmin = dab;
+				c = b;
 			}
 		}
+		if(c != prev) {
+			chain.push_back(c);
+			continue;
+		}
+		//a and prev are reciprocal nearest neighbors: merge them
+		chain.resize(chain.size()-2);
+		int keep = Min(a,prev), drop = Max(a,prev);
+		ClusterMerge m;
+		m.a = keep;
+		m.b = drop;
+		m.height = linkage.Height(dmin);
+		merges.push_back(m);
+		linkage.Merge(keep,drop,active);
+		int k = activeIndex[drop];
+		active[k] = active.back();
+		activeIndex[active[k]] = k;
+		active.resize(active.size()-1);
 	}
-	vector<vector<int> > Atemp;
-	Atemp.reserve(K);
-	for(i=0;i<N;i++) {
-	  if(II[i])
-	    Atemp.push_back(A[i]);
+}
+
+//Applies the N-K lowest merges and stores the resulting clusters in A
+static void CutDendrogram(int N,int K,vector<ClusterMerge>& merges,vector<vector<int> >& A)
+{
+	//stable, so that on ties a merge stays after the merges it depends on
+	stable_sort(merges.begin(),merges.end(),ClusterMergeHeightCmp());
+	UnionFind sets(N);
+	for(int n=0;n<N-K && n<(int)merges.size();n++)
+		sets.Union(merges[n].a,merges[n].b);
+	vector<int> clusterIndex(N,-1);
+	A.resize(0);
+	A.reserve(K);
+	for(int i=0;i<N;i++) {
+		int root = sets.FindSet(i);
+		if(clusterIndex[root] < 0) {
+			clusterIndex[root] = (int)A.size();
+			A.resize(A.size()+1);
+		}
+		A[clusterIndex[root]].push_back(i);
 	}
-	assert((int)Atemp.size()==K);
-	swap(A,Atemp);
+}
+
+static void BuildClustering(const vector<Vector>* data,const Matrix* dist,int N,int K,HierarchicalClustering::Type type,int numThreads,size_t maxMatrixEntries,vector<vector<int> >& A)
+{
+	Assert(K >= 1);
+	if(K > N) K = N;
+	vector<ClusterMerge> merges;
+	if(N > 1) {
+		if(type == HierarchicalClustering::SingleLinkage) {
+			vector<int> pi;
+			vector<Real> lambda;
+			SLINK(data,dist,N,numThreads,pi,lambda);
+			merges.resize(N-1);
+			for(int i=0;i<N-1;i++) {
+				merges[i].a = i;
+				merges[i].b = pi[i];
+				merges[i].height = lambda[i];
+			}
+		}
+		else {
+			vector<int> sizes(N,1);
+			if(type == HierarchicalClustering::WardLinkage && data) {
+				WardCentroidLinkage linkage(*data,sizes);
+				NNChain(linkage,N,merges);
+			}
+			else {
+				if(TriangleOffset(N) > maxMatrixEntries)
+					FatalError("HierarchicalClustering: this linkage on %d items needs a %g GB distance matrix, over the limit of maxMatrixEntries=%g entries.  Use single or Ward linkage on vector data, or raise maxMatrixEntries",N,double(TriangleOffset(N))*sizeof(Real)/1e9,double(maxMatrixEntries));
+				vector<Real> d(TriangleOffset(N));
+				RunDistanceRows(data,dist,(type == HierarchicalClustering::WardLinkage),1,N,&d[0],0,numThreads);
+				MatrixLinkage linkage(type,d,sizes);
+				NNChain(linkage,N,merges);
+			}
+		}
+	}
+	CutDendrogram(N,K,merges,A);
+	Assert((int)A.size()==K);
+}
+
+HierarchicalClustering::HierarchicalClustering()
+	:numThreads(0),maxMatrixEntries(size_t(1)<<30)
+{}
+
+void HierarchicalClustering::Build(const vector<Vector>& data,int K,Type type)
+{
+	BuildClustering(&data,NULL,(int)data.size(),K,type,numThreads,maxMatrixEntries,A);
+}
+
+void HierarchicalClustering::Build(const Matrix& dist,int K,Type type)
+{
+	Assert(dist.m == dist.n);
+	BuildClustering(NULL,&dist,dist.m,K,type,numThreads,maxMatrixEntries,A);
 }
@@ -5,9 +5,32 @@
 
 namespace Statistics {
 
+/** @ingroup Statistics
+ * @brief Agglomerative clustering of a data set into K clusters.
+ *
+ * Single linkage uses the SLINK algorithm, which only stores O(N) values
+ * and computes the distances one row at a time.  The other linkages use
+ * the nearest-neighbor chain algorithm.  Ward linkage on a vector data set
+ * works directly on the cluster centroids and also needs O(N) memory,
+ * while complete and average linkage, and all linkages on a distance
+ * matrix, update a packed lower-triangular copy of the N(N-1)/2 distances.
+ * That copy is limited to maxMatrixEntries values (by default 2^30, i.e.,
+ * 8 GB, or about 46,000 items), and Build exits with an error if it would
+ * be larger.  All methods take O(N^2) time, and the distance computations
+ * are split over numThreads threads (or all hardware threads, if
+ * numThreads <= 0).
+ *
+ * Note: the cluster order in A differs from older versions of this class,
+ * which listed clusters in the order of the internal slot that survived
+ * each merge and kept the items of a cluster in merge order.  Clusters are
+ * now ordered by their smallest item and their items are sorted.  Code that
+ * relied on the old cluster indices must match clusters by their contents.
+ */
 class HierarchicalClustering
 {
  public:
+	HierarchicalClustering();
+
 	struct distances
 	{
 		Real dist;
@@ -27,20 +50,30 @@ class HierarchicalClustering
 		}
 	};
 
-	enum Type { SingleLinkage, CompleteLinkage, AverageLinkage };
+	///Ward linkage merges the pair of clusters that least increases the
+	///total within-cluster variance
+	enum Type { SingleLinkage, CompleteLinkage, AverageLinkage, WardLinkage };
 
 	///Builds the clustering using standard Euclidean distance
 	void Build(const std::vector<Vector>& data,int K,Type type = SingleLinkage);
 
-	///Builds the clustering for a custom distance matrix
+	///Builds the clustering for a custom symmetric distance matrix
 	void Build(const Matrix& dist,int K,Type type = SingleLinkage);
 
 	///Returns the indices of the data elements in the i'th cluster
 	const std::vector<int>& Cluster(int i) const { return A[i]; }
 
-	// 2d vector for storing lists of items in clusters
+	// 2d vector for storing lists of items in clusters.  Clusters are
+	// ordered by their smallest item, and items are sorted.
 	std::vector<std::vector<int> > A;
 
+	// number of threads used for distance computations (default 0)
+	int numThreads;
+
+	// maximum number of entries of the packed distance matrix used by
+	// complete and average linkage and by matrix input (default 2^30)
+	size_t maxMatrixEntries;
+
 };
 
 
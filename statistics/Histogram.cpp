@@ -2,11 +2,100 @@
 #include "Histogram2D.h"
 #include "Histogram3D.h"
 #include <math3d/primitives.h>
+#include <utils/threadutils.h>
 #include <algorithm>
 using namespace Statistics;
 using namespace Math3D;
 using namespace std;
 
+//fewer samples than this per thread aren't worth starting a thread
+const static size_t kMinSamplesPerThread = 10000;
+
+void HistogramAxis::Set(const vector<Real>& _divs)
+{
+  divs = (_divs.empty() ? NULL : &_divs[0]);
+  numDivs = (int)_divs.size();
+  uniform = false;
+  if(numDivs < 2) return;
+  x0 = _divs.front();
+  Real h = (_divs.back()-x0)/(numDivs-1);
+  if(!(h > 0)) return;
+  //GetBucket corrects its guess using the divisions, so this only needs to
+  //be roughly uniform
+  for(int i=1;i<numDivs;i++)
+    if(Abs(_divs[i]-(x0+i*h)) > 1e-3*h) return;
+  uniform = true;
+  hinv = 1.0/h;
+}
+
+int HistogramAxis::GetBucket(Real val) const
+{
+  if(numDivs == 0 || val < divs[0]) return 0;
+  if(val >= divs[numDivs-1]) return numDivs;
+  if(!uniform)
+    return (int)(upper_bound(divs,divs+numDivs,val)-divs);
+  int i = (int)((val-x0)*hinv)+1;
+  if(i < 1) i = 1;
+  if(i > numDivs-1) i = numDivs-1;
+  while(val < divs[i-1]) i--;
+  while(val >= divs[i]) i++;
+  return i;
+}
+
+//Bins data[start,end), or if source is non-NULL, blocks of samples read
+//from the source, into counts
+struct HistogramTask
+{
+  const HistogramAxis* axis;
+  const vector<Real>* data;
+  size_t start,end;
+  HistogramSource* source;
+  Mutex* sourceLock;
+  int blockSize;
+  vector<Real> counts;
+};
+
+static void* HistogramThread(void* data)
+{
+  HistogramTask& task = *(HistogramTask*)data;
+  if(task.source) {
+    vector<Real> block;
+    while(true) {
+      int n;
+      {
+        ScopedLock lock(*task.sourceLock);
+        n = task.source->Read(task.blockSize,block);
+      }
+      if(n <= 0) break;
+      for(int i=0;i<n;i++)
+        task.counts[task.axis->GetBucket(block[i])] += 1;
+    }
+  }
+  else {
+    const vector<Real>& data = *task.data;
+    for(size_t i=task.start;i<task.end;i++)
+      task.counts[task.axis->GetBucket(data[i])] += 1;
+  }
+  return NULL;
+}
+
+//Runs the tasks and adds their counts to buckets
+static void RunHistogramTasks(vector<HistogramTask>& tasks,vector<Real>& buckets)
+{
+  if(tasks.size() == 1)
+    HistogramThread(&tasks[0]);
+  else {
+    vector<Thread> threads(tasks.size());
+    for(size_t t=0;t<tasks.size();t++)
+      threads[t] = ThreadStart(HistogramThread,&tasks[t]);
+    for(size_t t=0;t<tasks.size();t++)
+      ThreadJoin(threads[t]);
+  }
+  for(size_t t=0;t<tasks.size();t++)
+    for(size_t i=0;i<buckets.size();i++)
+      buckets[i] += tasks[t].counts[i];
+}
+
 Histogram::Histogram()
 {
   Clear();
@@ -58,14 +147,50 @@ void Histogram::Fill(Real val)
   fill(buckets.begin(),buckets.end(),val);
 }
 
-void Histogram::Calculate(const vector<Real>& data)
+void Histogram::Calculate(const vector<Real>& data,int numThreads)
 {
   assert(divs.size()+1 == buckets.size());
   fill(buckets.begin(),buckets.end(),0);
-  for(size_t i=0;i<data.size();i++) {
-    int b = GetBucket(data[i]);
-    buckets[b]++;
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  numThreads = (int)Max(size_t(1),Min(size_t(numThreads),data.size()/kMinSamplesPerThread));
+  HistogramAxis axis;
+  axis.Set(divs);
+  vector<HistogramTask> tasks(numThreads);
+  for(int t=0;t<numThreads;t++) {
+    tasks[t].axis = &axis;
+    tasks[t].data = &data;
+    tasks[t].start = data.size()*t/numThreads;
+    tasks[t].end = data.size()*(t+1)/numThreads;
+    tasks[t].source = NULL;
+    tasks[t].counts.resize(buckets.size(),0);
+  }
+  RunHistogramTasks(tasks,buckets);
+}
+
+void Histogram::Accumulate(HistogramSource& source,int numThreads,int blockSize)
+{
+  assert(divs.size()+1 == buckets.size());
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  HistogramAxis axis;
+  axis.Set(divs);
+  Mutex sourceLock;
+  vector<HistogramTask> tasks(numThreads);
+  for(int t=0;t<numThreads;t++) {
+    tasks[t].axis = &axis;
+    tasks[t].data = NULL;
+    tasks[t].source = &source;
+    tasks[t].sourceLock = &sourceLock;
+    tasks[t].blockSize = blockSize;
+    tasks[t].counts.resize(buckets.size(),0);
   }
+  RunHistogramTasks(tasks,buckets);
+}
+
+void Histogram::Merge(const Histogram& h)
+{
+  assert(h.divs == divs);
+  for(size_t i=0;i<buckets.size();i++)
+    buckets[i] += h.buckets[i];
 }
 
 void Histogram::GetRange(int bucket,Real& min,Real& max) const
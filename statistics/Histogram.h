@@ -5,6 +5,41 @@
 
 namespace Statistics {
 
+/** @ingroup Statistics
+ * @brief A stream of samples for Histogram::Accumulate and
+ * HistogramND::Accumulate.
+ *
+ * Read is called from the worker threads one at a time, so it needs no
+ * locking of its own.
+ */
+class HistogramSource
+{
+public:
+  virtual ~HistogramSource() {}
+  ///Stores up to maxSamples samples in x, one after the other, with one
+  ///value per dimension of the histogram.  Returns the number of samples
+  ///stored, or 0 at the end of the stream.
+  virtual int Read(int maxSamples,std::vector<Real>& x)=0;
+};
+
+/** @ingroup Statistics
+ * @brief Finds buckets on one axis of a histogram.  Uniformly spaced
+ * divisions are looked up in O(1) time, and others by bisection.
+ */
+struct HistogramAxis
+{
+  ///divs must not change while the axis is used
+  void Set(const std::vector<Real>& divs);
+  ///Returns 0 below divs.front(), divs.size() at or above divs.back(),
+  ///and otherwise the i such that divs[i-1] <= val < divs[i]
+  int GetBucket(Real val) const;
+
+  const Real* divs;
+  int numDivs;
+  bool uniform;
+  Real x0,hinv;
+};
+
 /** @ingroup Statistics
  * @brief 1-D histogram class
  */
@@ -22,8 +57,14 @@ class Histogram
   void ResizeToFit(const std::vector<Real>& data,size_t n);
   /// Fills all buckets with the given value
   void Fill(Real val=0);
-  /// Calculates the histogram of the data
-  void Calculate(const std::vector<Real>& data);
+  /// Calculates the histogram of the data using numThreads threads (0 uses
+  /// the number of hardware threads)
+  void Calculate(const std::vector<Real>& data,int numThreads=0);
+  /// Adds all samples of the stream, binning blocks of blockSize samples
+  /// on numThreads threads.  Unlike Calculate, keeps the existing counts.
+  void Accumulate(HistogramSource& source,int numThreads=0,int blockSize=4096);
+  /// Adds the counts of h, which must have the same divisions
+  void Merge(const Histogram& h);
 
   void GetRange(int bucket,Real& min,Real& max) const;
   int GetBucket(Real val) const;
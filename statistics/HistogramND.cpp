@@ -1,9 +1,12 @@
 #include "HistogramND.h"
 #include <errors.h>
+#include <utils/threadutils.h>
 #include <algorithm>
 using namespace Statistics;
 using namespace std;
 
+//fewer samples than this per thread aren't worth starting a thread
+const static size_t kMinSamplesPerThread = 10000;
 
 IndexHash::IndexHash(size_t _pow)
   :pow(_pow)
@@ -21,7 +24,138 @@ size_t IndexHash::operator () (const std::vector<int>& x) const
 }
 
 
+bool BinIndexPacker::Init(const vector<int>& imin,const vector<size_t>& numValues)
+{
+  Assert(imin.size() == numValues.size());
+  offset.resize(imin.size());
+  shift.resize(imin.size());
+  mask.resize(imin.size());
+  int totalBits = 0;
+  for(size_t d=0;d<imin.size();d++) {
+    int bits = 0;
+    while(bits < 64 && (Key(1) << bits) < Key(numValues[d])) bits++;
+    offset[d] = imin[d];
+    shift[d] = (bits == 0 ? 0 : totalBits);
+    mask[d] = (bits == 64 ? ~Key(0) : (Key(1) << bits)-1);
+    totalBits += bits;
+    if(totalBits > 64) return false;
+  }
+  return true;
+}
+
+bool BinIndexPacker::InitUnbounded(int n)
+{
+  if(n > 2) return false;
+  //32 bits hold any int index exactly
+  offset.resize(n);
+  shift.resize(n);
+  mask.resize(n);
+  for(int d=0;d<n;d++) {
+    offset[d] = -(1LL << 31);
+    shift[d] = d*32;
+    mask[d] = (Key(1) << 32)-1;
+  }
+  return true;
+}
+
+void BinIndexPacker::Unpack(Key key,vector<int>& index) const
+{
+  index.resize(shift.size());
+  for(size_t d=0;d<shift.size();d++)
+    index[d] = int((long long)((key >> shift[d]) & mask[d]) + offset[d]);
+}
+
+
+//Bins data[start,end), or if source is non-NULL, blocks of samples read
+//from the source, into counts
+struct HistogramNDTask
+{
+  const HistogramND* hist;
+  const vector<HistogramAxis>* axes;
+  const vector<Vector>* data;
+  size_t start,end;
+  HistogramSource* source;
+  Mutex* sourceLock;
+  int blockSize;
+  HistogramND::BucketHash counts;
+  HistogramND::IndexBucketHash indexCounts;
+};
+
+static inline void AddSample(HistogramNDTask& task,const vector<int>& index)
+{
+  if(task.hist->packed)
+    task.counts[task.hist->packer.Pack(index.empty() ? NULL : &index[0])] += 1;
+  else
+    task.indexCounts[index] += 1;
+}
+
+static void* HistogramNDThread(void* data)
+{
+  HistogramNDTask& task = *(HistogramNDTask*)data;
+  const vector<HistogramAxis>& axes = *task.axes;
+  int n = (int)axes.size();
+  vector<int> index(n);
+  if(task.source) {
+    vector<Real> block;
+    while(true) {
+      int m;
+      {
+        ScopedLock lock(*task.sourceLock);
+        m = task.source->Read(task.blockSize,block);
+      }
+      if(m <= 0) break;
+      Assert((int)block.size() >= m*n);
+      const Real* x = (block.empty() ? NULL : &block[0]);
+      for(int i=0;i<m;i++,x+=n) {
+        for(int d=0;d<n;d++) index[d] = axes[d].GetBucket(x[d]);
+        AddSample(task,index);
+      }
+    }
+  }
+  else {
+    const vector<Vector>& data = *task.data;
+    for(size_t i=task.start;i<task.end;i++) {
+      Assert(data[i].n == n);
+      for(int d=0;d<n;d++) index[d] = axes[d].GetBucket(data[i][d]);
+      AddSample(task,index);
+    }
+  }
+  return NULL;
+}
+
+//Adds the counts in src to dest, or just takes them if dest is empty
+template <class Hash>
+static void MergeCounts(Hash& dest,Hash& src)
+{
+  if(dest.empty())
+    dest.swap(src);
+  else {
+    for(typename Hash::const_iterator i=src.begin();i!=src.end();i++)
+      dest[i->first] += i->second;
+  }
+}
+
+//Runs the tasks and merges their counts into the histogram
+static void RunHistogramNDTasks(vector<HistogramNDTask>& tasks,HistogramND& hist)
+{
+  if(tasks.size() == 1)
+    HistogramNDThread(&tasks[0]);
+  else {
+    vector<Thread> threads(tasks.size());
+    for(size_t t=0;t<tasks.size();t++)
+      threads[t] = ThreadStart(HistogramNDThread,&tasks[t]);
+    for(size_t t=0;t<tasks.size();t++)
+      ThreadJoin(threads[t]);
+  }
+  for(size_t t=0;t<tasks.size();t++) {
+    MergeCounts(hist.buckets,tasks[t].counts);
+    MergeCounts(hist.indexBuckets,tasks[t].indexCounts);
+  }
+}
+
+
 HistogramND::HistogramND(int n)
+  :packed(true)
 {
   Resize(n);
 }
@@ -31,19 +165,18 @@ void HistogramND::Resize(int numDims)
   divs.resize(numDims);
   for(int i=0;i<numDims;i++) 
     divs[i].resize(0);
-  buckets.clear();
+  UpdatePacker();
 }
 
 void HistogramND::Clear()
 {
   divs.resize(0);
-  buckets.clear();
+  UpdatePacker();
 }
 
 void HistogramND::Resize(const Size& _dims,const Point& min,const Point& max)
 {
   Assert(_dims.size()==min.size() && _dims.size()==max.size());
-  buckets.clear();
   divs.resize(_dims.size());
   for(size_t d=0;d<divs.size();d++) {
     divs[d].resize(_dims[d]+1);
@@ -53,12 +186,12 @@ void HistogramND::Resize(const Size& _dims,const Point& min,const Point& max)
       x+=h;
     }
   }
+  UpdatePacker();
 }
 
 void HistogramND::Resize(const Index& _dims,const Point& min,const Point& max)
 {
   Assert(_dims.size()==min.size() && _dims.size()==max.size());
-  buckets.clear();
   divs.resize(_dims.size());
   for(size_t d=0;d<divs.size();d++) {
     divs[d].resize(_dims[d]+1);
@@ -68,6 +201,20 @@ void HistogramND::Resize(const Index& _dims,const Point& min,const Point& max)
       x+=h;
     }
   }
+  UpdatePacker();
+}
+
+void HistogramND::UpdatePacker()
+{
+  buckets.clear();
+  indexBuckets.clear();
+  //bucket indices on axis d range from 0 to divs[d].size()
+  vector<int> imin(divs.size(),0);
+  Size numValues(divs.size());
+  for(size_t d=0;d<divs.size();d++)
+    numValues[d] = divs[d].size()+1;
+  //too many buckets to pack, so key them by their full indices
+  packed = packer.Init(imin,numValues);
 }
 
 void HistogramND::ResizeToFit(const std::vector<Point>& data,const Size& dims)
@@ -82,29 +229,70 @@ void HistogramND::ResizeToFit(const std::vector<Point>& data,const Size& dims)
     for(size_t j=0;j<n;j++) {
       if(data[i][j] < bmin[j])
 	bmin[j]=data[i][j];
-    else if(data[i][j] > bmax[j])
+      else if(data[i][j] > bmax[j])
 	bmax[j]=data[i][j];
     }
   }
-  for(int k=0;k<3;k++)
+  for(size_t k=0;k<n;k++)
     if(bmin[k]==bmax[k]) bmax[k] += 1;
   Resize(dims,bmin,bmax);
 }
 
 void HistogramND::Fill(Real val)
 {
-  if(val==0) buckets.clear();
+  if(val==0) {
+    buckets.clear();
+    indexBuckets.clear();
+  }
   else {
     FatalError("TODO: Not done with filling multidimensional array with nonzero value");
   }
 }
 
-void HistogramND::Calculate(const std::vector<Point>& data)
+void HistogramND::Calculate(const std::vector<Point>& data,int numThreads)
 {
   Fill(0);
-  for(size_t i=0;i<data.size();i++) {
-    AddBucket(data[i],1);
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  numThreads = (int)Max(size_t(1),Min(size_t(numThreads),data.size()/kMinSamplesPerThread));
+  vector<HistogramAxis> axes(divs.size());
+  for(size_t d=0;d<divs.size();d++) axes[d].Set(divs[d]);
+  vector<HistogramNDTask> tasks(numThreads);
+  for(int t=0;t<numThreads;t++) {
+    tasks[t].hist = this;
+    tasks[t].axes = &axes;
+    tasks[t].data = &data;
+    tasks[t].start = data.size()*t/numThreads;
+    tasks[t].end = data.size()*(t+1)/numThreads;
+    tasks[t].source = NULL;
   }
+  RunHistogramNDTasks(tasks,*this);
+}
+
+void HistogramND::Accumulate(HistogramSource& source,int numThreads,int blockSize)
+{
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  vector<HistogramAxis> axes(divs.size());
+  for(size_t d=0;d<divs.size();d++) axes[d].Set(divs[d]);
+  Mutex sourceLock;
+  vector<HistogramNDTask> tasks(numThreads);
+  for(int t=0;t<numThreads;t++) {
+    tasks[t].hist = this;
+    tasks[t].axes = &axes;
+    tasks[t].data = NULL;
+    tasks[t].source = &source;
+    tasks[t].sourceLock = &sourceLock;
+    tasks[t].blockSize = blockSize;
+  }
+  RunHistogramNDTasks(tasks,*this);
+}
+
+void HistogramND::Merge(const HistogramND& h)
+{
+  Assert(h.divs == divs);
+  for(BucketHash::const_iterator i=h.buckets.begin();i!=h.buckets.end();i++)
+    buckets[i->first] += i->second;
+  for(IndexBucketHash::const_iterator i=h.indexBuckets.begin();i!=h.indexBuckets.end();i++)
+    indexBuckets[i->first] += i->second;
 }
 
 void HistogramND::GetRange(const Index& bucket,Point& min,Point& max) const
@@ -114,7 +302,7 @@ void HistogramND::GetRange(const Index& bucket,Point& min,Point& max) const
   max.resize(bucket.size());
   for(size_t i=0;i<divs.size();i++) {
     min[i]=(bucket[i] == 0? -Inf: divs[i][bucket[i]-1]);
-    max[i]=(bucket[i] == divs[i].size()+1? Inf : divs[i][bucket[i]]);
+    max[i]=(bucket[i] == (int)divs[i].size()? Inf : divs[i][bucket[i]]);
   }
 }
 
@@ -123,8 +311,8 @@ void HistogramND::GetBucket(const Point& val,Index& index) const
   Assert(val.size()==divs.size());
   index.resize(val.size());
   for(size_t i=0;i<val.size();i++) {
-    if(val[i] < divs[i].front()) index[i]=0;
-    else if(val[i] >= divs[i].back()) index[0]=divs[i].size()+1;
+    if(divs[i].empty() || val[i] < divs[i].front()) index[i]=0;
+    else if(val[i] >= divs[i].back()) index[i]=divs[i].size();
     else {
       vector<Real>::const_iterator it = std::upper_bound(divs[i].begin(),divs[i].end(),val[i]);
       index[i]=(it-divs[i].begin());
@@ -132,18 +320,29 @@ void HistogramND::GetBucket(const Point& val,Index& index) const
   }
 }
 
+HistogramND::Key HistogramND::IndexToKey(const Index& bucket) const
+{
+  Assert(bucket.size()==divs.size());
+  Assert(packed);
+  return packer.Pack(bucket.empty() ? NULL : &bucket[0]);
+}
+
 void HistogramND::AddBucket(const Point& val,Real num)
 {
   Index i;
   GetBucket(val,i);
-  BucketHash::iterator it=buckets.find(i);
-  if(it == buckets.end()) buckets[i] = num;
-  else it->second += num;
+  if(packed) buckets[IndexToKey(i)] += num;
+  else indexBuckets[i] += num;
 }
 
 Real HistogramND::GetBucketCount(const Index& bucket) const
 {
-  BucketHash::const_iterator i=buckets.find(bucket);
+  if(!packed) {
+    IndexBucketHash::const_iterator i=indexBuckets.find(bucket);
+    if(i == indexBuckets.end()) return 0.0;
+    return i->second;
+  }
+  BucketHash::const_iterator i=buckets.find(IndexToKey(bucket));
   if(i == buckets.end()) return 0.0;
   return i->second;
 }
@@ -153,5 +352,7 @@ Real HistogramND::NumObservations() const
   Real sum=0;
   for(BucketHash::const_iterator i=buckets.begin();i!=buckets.end();i++)
     sum += i->second;
+  for(IndexBucketHash::const_iterator i=indexBuckets.begin();i!=indexBuckets.end();i++)
+    sum += i->second;
   return sum;
 }
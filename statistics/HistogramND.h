@@ -2,6 +2,7 @@
 #define STATISTICS_HISTOGRAMND_H
 
 #include "statistics.h"
+#include "Histogram.h"
 #include <KrisLibrary/utils/stl_tr1.h>
 
 namespace Statistics {
@@ -13,10 +14,59 @@ struct IndexHash
   size_t pow;
 };
 
+/** @ingroup Statistics
+ * @brief Packs N-D integer bucket indices into 64-bit keys.
+ *
+ * Dimension d gets its own bit field, which stores index[d]-offset[d].
+ * Keys are cheap to hash and compare, and unlike a std::vector<int> index
+ * don't need to be allocated.
+ */
+struct BinIndexPacker
+{
+  typedef unsigned long long Key;
+
+  ///Sets up exact packing of indices with imin[d] <= index[d] <
+  ///imin[d]+numValues[d].  Returns false if they need more than 64 bits.
+  bool Init(const std::vector<int>& imin,const std::vector<size_t>& numValues);
+  ///Sets up exact packing of any int indices in n dimensions.  Returns
+  ///false if n > 2, since they need more than 64 bits.
+  bool InitUnbounded(int n);
+  inline Key Pack(const int* index) const {
+    Key key = 0;
+    for(size_t d=0;d<shift.size();d++)
+      key |= (Key((long long)index[d]-offset[d]) & mask[d]) << shift[d];
+    return key;
+  }
+  void Unpack(Key key,std::vector<int>& index) const;
+
+  std::vector<long long> offset;
+  std::vector<int> shift;
+  std::vector<Key> mask;
+};
+
+///Mixes the bits of a packed key, so that keys of neighboring buckets
+///spread over the hash table
+struct BinKeyHash
+{
+  inline size_t operator () (BinIndexPacker::Key key) const {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t)key;
+  }
+};
+
 /** @ingroup Statistics
  * @brief N-D histogram class
  *
- * Uses unordered_map so the histogram can be sparse and of manageable size even when N is large
+ * Uses unordered_map so the histogram can be sparse and of manageable size
+ * even when N is large.  When the number of buckets, including the ones
+ * below and above the divisions on each axis, is at most 2^64, buckets are
+ * keyed by their indices packed into 64 bits.  Otherwise they are keyed by
+ * their full indices in indexBuckets, which is slower.
+ *
+ * Calculate and Accumulate bin the samples on several threads, each into
+ * its own hash table, and then merge the tables.
  */
 class HistogramND
 {
@@ -24,6 +74,7 @@ class HistogramND
   typedef Vector Point;
   typedef std::vector<int> Index;
   typedef std::vector<size_t> Size;
+  typedef BinIndexPacker::Key Key;
 
   HistogramND(int numDims=0);
   /// resizes to the given number of dimensions, sets one big bucket
@@ -37,8 +88,14 @@ class HistogramND
   void ResizeToFit(const std::vector<Point>& data,const Size& dims);
   /// Fills all buckets with the given value
   void Fill(Real val=0);
-  /// Calculates the histogram of the data
-  void Calculate(const std::vector<Point>& data);
+  /// Calculates the histogram of the data using numThreads threads (0 uses
+  /// the number of hardware threads)
+  void Calculate(const std::vector<Point>& data,int numThreads=0);
+  /// Adds all samples of the stream, binning blocks of blockSize samples
+  /// on numThreads threads.  Unlike Calculate, keeps the existing counts.
+  void Accumulate(HistogramSource& source,int numThreads=0,int blockSize=4096);
+  /// Adds the counts of h, which must have the same divisions
+  void Merge(const HistogramND& h);
 
   /// Gets the range of the given bucket
   void GetRange(const Index& bucket,Point& min,Point& max) const;
@@ -46,10 +103,24 @@ class HistogramND
   void AddBucket(const Point& val,Real num=1);
   Real GetBucketCount(const Index& bucket) const;
   Real NumObservations() const;
+  /// Only valid if packed is true
+  Key IndexToKey(const Index& bucket) const;
+  void KeyToIndex(Key key,Index& bucket) const { packer.Unpack(key,bucket); }
+
+  ///Sets up the packer for the current divisions.  Call this after
+  ///changing divs directly; it clears the buckets.  If the indices don't
+  ///fit in 64 bits, sets packed to false.
+  void UpdatePacker();
 
+  ///The divisions on each axis
   std::vector<std::vector<Real> > divs;
-  typedef UNORDERED_MAP_TEMPLATE<Index,Real,IndexHash> BucketHash;
+  BinIndexPacker packer;
+  ///Whether the buckets are in buckets (true) or indexBuckets (false)
+  bool packed;
+  typedef UNORDERED_MAP_TEMPLATE<Key,Real,BinKeyHash> BucketHash;
   BucketHash buckets;
+  typedef UNORDERED_MAP_TEMPLATE<Index,Real,IndexHash> IndexBucketHash;
+  IndexBucketHash indexBuckets;
 };
 
 } //namespace Statistics
@@ -1,15 +1,63 @@
 #include "KMeans.h"
 #include <utils/permutation.h>
+#include <utils/threadutils.h>
+#include <math/random.h>
+#include <errors.h>
+#include <algorithm>
 using namespace Statistics;
 using namespace std;
 
+inline Real Distance2(const Real* a,const Real* b,int n)
+{
+  Real sum=0;
+  for(int i=0;i<n;i++) {
+    Real d=a[i]-b[i];
+    sum += d*d;
+  }
+  return sum;
+}
+
+inline Real CenterDistance(KMeans& km,const Vector& a,const Vector& b)
+{
+  if(km.euclidean) return a.distance(b);
+  return km.Distance(a,b);
+}
+
+inline Real CenterDistance2(KMeans& km,const Vector& a,const Vector& b)
+{
+  if(km.euclidean) return a.distanceSquared(b);
+  return Sqr(km.Distance(a,b));
+}
+
+//Samples an index with probability proportional to w[i], scaled by the
+//data weights if given.  Returns -1 if all of the weights are zero.
+static int SampleWeighted(const vector<Real>& w,const vector<Real>* weights)
+{
+  Real total=0;
+  for(size_t i=0;i<w.size();i++)
+    total += (weights ? w[i]*(*weights)[i] : w[i]);
+  if(!(total > 0)) return -1;
+  Real u = Rand()*total;
+  int last=-1;
+  for(size_t i=0;i<w.size();i++) {
+    Real wi = (weights ? w[i]*(*weights)[i] : w[i]);
+    if(wi <= 0) continue;
+    last = (int)i;
+    u -= wi;
+    if(u < 0) return last;
+  }
+  return last;
+}
+
 KMeans::KMeans(const vector<Vector>& _data)
-  :data(_data),weights(NULL),labels(_data.size(),-1)
+  :data(_data),weights(NULL),labels(_data.size(),-1),
+   euclidean(false),useBounds(true),numThreads(1),numDistanceComputations(0)
 {
 }
 
 KMeans::KMeans(const vector<Vector>& _data,int k)
-  :data(_data),weights(NULL),labels(_data.size(),-1),centers(k)
+  :data(_data),weights(NULL),labels(_data.size(),-1),centers(k),
+   euclidean(false),useBounds(true),numThreads(1),numDistanceComputations(0)
 {
 }
 
@@ -18,6 +66,8 @@ void KMeans::SetK(int k)
   centers.resize(k);
   for(size_t i=0;i<labels.size();i++)
     if(labels[i] >= k) labels[i] = -1;
+  boundCenters.clear();
+  miniBatchCounts.clear();
 }
 
 void KMeans::RandomInitialCenters()
@@ -35,11 +85,36 @@ void KMeans::RandomInitialCenters()
     for(size_t i=0;i<centers.size();i++)
       centers[i] = data[perm[i]];
   }
+  miniBatchCounts.clear();
+}
+
+void KMeans::KMeansPlusPlusInitialCenters()
+{
+  if(data.size() <= centers.size()) {
+    RandomInitialCenters();
+    return;
+  }
+  //mind2[i] is the squared distance from point i to the closest center
+  //drawn so far
+  vector<Real> mind2(data.size(),One);
+  for(size_t c=0;c<centers.size();c++) {
+    int i = SampleWeighted(mind2,weights);
+    //all points coincide with the existing centers
+    if(i < 0) i = RandInt(data.size());
+    centers[c] = data[i];
+    for(size_t j=0;j<data.size();j++) {
+      Real d2 = CenterDistance2(*this,data[j],centers[c]);
+      if(c == 0 || d2 < mind2[j]) mind2[j] = d2;
+    }
+  }
+  miniBatchCounts.clear();
 }
 
 void KMeans::ClearLabels()
 {
   fill(labels.begin(),labels.end(),-1);
+  packedData.clear();
+  boundCenters.clear();
 }
 
 void KMeans::Iterate(int& iters)
@@ -51,26 +126,174 @@ void KMeans::Iterate(int& iters)
   }
 }
 
-bool KMeans::CalcLabelsFromCenters()
+//Labels the points in [start,end)
+struct KMeansLabelTask
 {
-  assert(data.size()==labels.size());
-  if(data.empty()) return false;
-  for(size_t c=0;c<centers.size();c++)
-    assert(centers[c].n == data[0].n);
+  KMeans* km;
+  int start,end;
+  //the packed centers, if km->euclidean is true
+  const Real* centerData;
+  //half the distance from each center to the closest other center, if
+  //bounds are used
+  const Real* halfSeparation;
+  bool bounded;
+  bool changed;
+  size_t numDistances;
+};
 
-  bool changed=false;
-  for(size_t i=0;i<data.size();i++) {
+inline Real PointCenterDistance(KMeansLabelTask& task,int i,int c)
+{
+  task.numDistances++;
+  if(task.centerData) {
+    int d = task.km->centers[c].n;
+    return Sqrt(Distance2(&task.km->packedData[size_t(i)*d],task.centerData+size_t(c)*d,d));
+  }
+  return task.km->Distance(task.km->data[i],task.km->centers[c]);
+}
+
+static void LabelPoints(KMeansLabelTask& task)
+{
+  KMeans& km = *task.km;
+  int k = (int)km.centers.size();
+  for(int i=task.start;i<task.end;i++) {
+    int a = km.labels[i];
+    if(task.bounded && a >= 0 && a < k) {
+      //the label can't change if the point is closer to its center than
+      //to any other center
+      Real m = Max(task.halfSeparation[a],km.lowerBounds[i]);
+      if(km.upperBounds[i] <= m) continue;
+      km.upperBounds[i] = PointCenterDistance(task,i,a);
+      if(km.upperBounds[i] <= m) continue;
+    }
     int closest=-1;
-    Real closestDist=Inf;
-    for(size_t c=0;c<centers.size();c++) {
-      Real dist = Distance(data[i],centers[c]);
+    Real closestDist=Inf,secondDist=Inf;
+    for(int c=0;c<k;c++) {
+      Real dist = PointCenterDistance(task,i,c);
       if(dist < closestDist) {
+	secondDist = closestDist;
 	closestDist = dist;
-	closest = (int)c;
+	closest = c;
+      }
+      else if(dist < secondDist)
+	secondDist = dist;
+    }
+    if(closest != a) task.changed=true;
+    km.labels[i] = closest;
+    if(task.halfSeparation) {
+      km.upperBounds[i] = closestDist;
+      km.lowerBounds[i] = secondDist;
+    }
+  }
+}
+
+static void* LabelPointsThread(void* data)
+{
+  LabelPoints(*(KMeansLabelTask*)data);
+  return NULL;
+}
+
+bool KMeans::CalcLabelsFromCenters()
+{
+  assert(data.size()==labels.size());
+  if(data.empty()) return false;
+  int n = (int)data.size();
+  int k = (int)centers.size();
+  if(k == 0) {
+    bool changed=false;
+    for(int i=0;i<n;i++) {
+      if(labels[i] != -1) changed=true;
+      labels[i] = -1;
+    }
+    return changed;
+  }
+  int d = data[0].n;
+  for(int c=0;c<k;c++)
+    assert(centers[c].n == d);
+
+  vector<Real> centerData;
+  if(euclidean) {
+    if(packedData.size() != size_t(n)*d) {
+      packedData.resize(size_t(n)*d);
+      for(int i=0;i<n;i++) {
+	assert(data[i].n == d);
+	for(int j=0;j<d;j++)
+	  packedData[size_t(i)*d+j] = data[i](j);
       }
     }
-    if(closest != labels[i]) changed=true;
-    labels[i] = closest;
+    centerData.resize(size_t(k)*d);
+    for(int c=0;c<k;c++)
+      for(int j=0;j<d;j++)
+	centerData[size_t(c)*d+j] = centers[c](j);
+  }
+
+  vector<Real> halfSeparation;
+  bool bounded = false;
+  if(useBounds) {
+    bounded = (boundCenters.size()==centers.size() && upperBounds.size()==data.size());
+    if(bounded) {
+      //loosen the bounds by the distances the centers moved
+      vector<Real> shift(k);
+      Real maxShift=0,secondShift=0;
+      int maxShiftCenter=-1;
+      for(int c=0;c<k;c++) {
+	shift[c] = CenterDistance(*this,boundCenters[c],centers[c]);
+	if(shift[c] > maxShift) {
+	  secondShift = maxShift;
+	  maxShift = shift[c];
+	  maxShiftCenter = c;
+	}
+	else if(shift[c] > secondShift)
+	  secondShift = shift[c];
+      }
+      for(int i=0;i<n;i++) {
+	int a = labels[i];
+	if(a < 0 || a >= k) continue;
+	upperBounds[i] += shift[a];
+	lowerBounds[i] -= (a == maxShiftCenter ? secondShift : maxShift);
+      }
+    }
+    else {
+      upperBounds.resize(n);
+      lowerBounds.resize(n);
+    }
+    halfSeparation.resize(k,Inf);
+    for(int c=0;c<k;c++) {
+      for(int c2=c+1;c2<k;c2++) {
+	Real half = Half*CenterDistance(*this,centers[c],centers[c2]);
+	if(half < halfSeparation[c]) halfSeparation[c] = half;
+	if(half < halfSeparation[c2]) halfSeparation[c2] = half;
+      }
+    }
+    boundCenters = centers;
+  }
+
+  int nt = (numThreads <= 0 ? ThreadHardwareConcurrency() : numThreads);
+  if(nt > n) nt = n;
+  vector<KMeansLabelTask> tasks(nt);
+  for(int t=0;t<nt;t++) {
+    tasks[t].km = this;
+    tasks[t].start = int((long long)n*t/nt);
+    tasks[t].end = int((long long)n*(t+1)/nt);
+    tasks[t].centerData = (euclidean ? &centerData[0] : NULL);
+    tasks[t].halfSeparation = (useBounds ? &halfSeparation[0] : NULL);
+    tasks[t].bounded = bounded;
+    tasks[t].changed = false;
+    tasks[t].numDistances = 0;
+  }
+  if(nt == 1)
+    LabelPoints(tasks[0]);
+  else {
+    vector<Thread> threads(nt);
+    for(int t=0;t<nt;t++)
+      threads[t] = ThreadStart(LabelPointsThread,&tasks[t]);
+    for(int t=0;t<nt;t++)
+      ThreadJoin(threads[t]);
+  }
+
+  bool changed=false;
+  for(int t=0;t<nt;t++) {
+    if(tasks[t].changed) changed=true;
+    numDistanceComputations += tasks[t].numDistances;
   }
   return changed;
 }
@@ -105,18 +328,75 @@ void KMeans::CalcCentersFromLabels()
   for(size_t c=0;c<centers.size();c++) {
     if(num[c] == 0) //set a random datapoint
       centers[c] = data[rand()%data.size()];
-    else 
+    else
       centers[c] /= num[c];
   }
 }
 
+//Sculley's mini-batch update: the batch is labeled with the current
+//centers, then each center moves toward its points with a step of
+//w/(total weight assigned to the center so far)
+static void MiniBatchStep(KMeans& km,const vector<const Vector*>& batch,const vector<Real>* batchWeights)
+{
+  int k = (int)km.centers.size();
+  if(k == 0) return;
+  if((int)km.miniBatchCounts.size() != k)
+    km.miniBatchCounts.assign(k,0);
+  vector<int> batchLabels(batch.size());
+  for(size_t b=0;b<batch.size();b++) {
+    Real closestDist=Inf;
+    batchLabels[b] = 0;
+    for(int c=0;c<k;c++) {
+      Real dist = CenterDistance2(km,*batch[b],km.centers[c]);
+      if(dist < closestDist) {
+	closestDist = dist;
+	batchLabels[b] = c;
+      }
+    }
+  }
+  km.numDistanceComputations += batch.size()*k;
+  for(size_t b=0;b<batch.size();b++) {
+    Real w = (batchWeights ? (*batchWeights)[b] : One);
+    if(w <= 0) continue;
+    int c = batchLabels[b];
+    km.miniBatchCounts[c] += w;
+    Real eta = w/km.miniBatchCounts[c];
+    km.centers[c] *= (One-eta);
+    km.centers[c].madd(*batch[b],eta);
+  }
+}
+
+void KMeans::MiniBatchIterate(int batchSize,int iters)
+{
+  if(data.empty()) return;
+  vector<const Vector*> batch(batchSize);
+  vector<Real> batchWeights;
+  if(weights) batchWeights.resize(batchSize);
+  for(int iter=0;iter<iters;iter++) {
+    for(int b=0;b<batchSize;b++) {
+      int i = RandInt(data.size());
+      batch[b] = &data[i];
+      if(weights) batchWeights[b] = (*weights)[i];
+    }
+    MiniBatchStep(*this,batch,(weights ? &batchWeights : NULL));
+  }
+}
+
+void KMeans::MiniBatchUpdate(const vector<Vector>& batch,const vector<Real>* batchWeights)
+{
+  vector<const Vector*> ptrs(batch.size());
+  for(size_t i=0;i<batch.size();i++)
+    ptrs[i] = &batch[i];
+  MiniBatchStep(*this,ptrs,batchWeights);
+}
+
 Real KMeans::AverageDistance(int c)
 {
   assert(labels.size() == data.size());
   Real sum=0;
   Real num=0;
   for(size_t i=0;i<labels.size();i++) {
-    if((int)i == c) {
+    if(labels[i] == c) {
       sum += Distance(data[i],centers[c]);
       if(weights) num += (*weights)[i];
       else num += One;
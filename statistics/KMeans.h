@@ -10,7 +10,29 @@ namespace Statistics {
 /** @ingroup Statistics
  * @brief A simple clustering method to choose k clusters from a set of data.
  *
- * The cluster centers are 
+ * The cluster centers are initialized with RandomInitialCenters or
+ * KMeansPlusPlusInitialCenters, and then refined with Iterate, which
+ * alternates between labeling each point with its closest center and moving
+ * the centers to the means of their points.
+ *
+ * CalcLabelsFromCenters keeps, for each point, an upper bound on the
+ * distance to its center and a lower bound on the distance to all other
+ * centers (Hamerly's algorithm).  Points whose bounds show that their label
+ * can't change are skipped, so after the first few iterations most distance
+ * computations are avoided.  This requires Distance to be a metric; set
+ * useBounds to false if it is overridden with something that violates the
+ * triangle inequality.  Labeling is split over numThreads threads.
+ *
+ * If euclidean is set to true, the data is copied into one contiguous array
+ * the first time it is labeled, and the Euclidean distance is computed on it
+ * directly rather than through Distance.  It is off by default so that
+ * subclasses overriding Distance are respected; turn it on when Distance is
+ * left as is.  Call ClearLabels if the data changes afterward.
+ *
+ * For data sets that don't fit in memory, construct the object with an
+ * empty data set, set the centers (e.g., by running
+ * KMeansPlusPlusInitialCenters on a sample), and call MiniBatchUpdate on
+ * successive batches.
  */
 class KMeans
 {
@@ -20,8 +42,12 @@ class KMeans
   virtual ~KMeans() {}
   int GetK() const { return (int)centers.size(); }
   void SetK(int k);
-  ///Initialization 
+  ///Initialization
   void RandomInitialCenters();
+  ///Initialization by k-means++ seeding: each center is drawn from the data
+  ///with probability proportional to its (weighted) squared distance to the
+  ///closest center drawn so far.
+  void KMeansPlusPlusInitialCenters();
   void ClearLabels();
   ///Returns in maxIters the number of used iterations before convergence
   void Iterate(int& maxIters);
@@ -32,19 +58,45 @@ class KMeans
   ///Sets the centers from the data points in a center's group
   void CalcCentersFromLabels();
 
+  ///Mini-batch k-means: performs iters updates, each on batchSize points
+  ///drawn at random from the data.  The labels are not updated.
+  void MiniBatchIterate(int batchSize,int iters);
+  ///Moves the centers toward the points of the given batch, with per-center
+  ///learning rates that decay with the total weight assigned to each center
+  ///so far (stored in miniBatchCounts).
+  void MiniBatchUpdate(const std::vector<Vector>& batch,const std::vector<Real>* batchWeights=NULL);
+
   ///Returns the average distance of points for the given cluster
   Real AverageDistance(int c);
   ///Same as above, but for all clusters
   void AverageDistance(std::vector<Real>& dist);
 
-  ///Overrideable: distance metric
-  virtual Real Distance(const Vector& a,const Vector& b) 
+  ///Overrideable: distance metric.  Only used if euclidean is false, and must
+  ///be thread-safe if numThreads != 1.
+  virtual Real Distance(const Vector& a,const Vector& b)
   { return a.distance(b); }
 
   const std::vector<Vector>& data;
   const std::vector<Real>* weights;
   std::vector<int> labels;
   std::vector<Vector> centers;
+
+  ///Settings: use the built-in Euclidean distance (default false), use
+  ///distance bounds to skip computations (default true), and the number of
+  ///threads used for labeling, or <= 0 to use all hardware threads
+  ///(default 1).
+  bool euclidean;
+  bool useBounds;
+  int numThreads;
+  ///Statistic: total number of point-center distances computed
+  size_t numDistanceComputations;
+
+  //internal data: the packed data, the per-point bounds and the centers
+  //they refer to, and the mini-batch per-center weights
+  std::vector<Real> packedData;
+  std::vector<Real> upperBounds,lowerBounds;
+  std::vector<Vector> boundCenters;
+  std::vector<Real> miniBatchCounts;
 };
 
 }
@@ -1,7 +1,9 @@
 #include "LinearProcessHMM.h"
+#include "HMMInference.h"
 #include <math/sample.h>
 #include <math/indexing.h>
 #include <math/linalgebra.h>
+#include <utils/threadutils.h>
 #include <fstream>
 #include <iostream>
 using namespace Math;
@@ -176,7 +178,80 @@ void LinearProcessHMM::SetUniformExitProbabilities(Real pExit)
   }
 }
 
-bool LinearProcessHMM::TrainEM(const vector<vector<Vector> >& examples,Real& tol,int maxIters,int verbose)
+//Fills in the cached log-densities of the continuous priors and of the
+//linear process errors
+static void GetLogDensities(const LinearProcessHMM& hmm,vector<GaussianLogDensity>& priors,vector<GaussianLogDensity>& errors)
+{
+  priors.resize(hmm.continuousPriors.size());
+  for(size_t i=0;i<priors.size();i++)
+    priors[i].Set(hmm.continuousPriors[i]);
+  errors.resize(hmm.emissionModels.size());
+  for(size_t i=0;i<errors.size();i++)
+    errors[i].Set(hmm.emissionModels[i].error);
+}
+
+//Computes the log emission probabilities of a sequence: row 0 holds
+//log P(o[0]|x[0]) and row t holds log P(o[t]|x[t],o[t-1])
+static void GetLogEmissions(const LinearProcessHMM& hmm,const vector<GaussianLogDensity>& priors,const vector<GaussianLogDensity>& errors,const vector<Vector>& observations,Matrix& logE)
+{
+  int k = hmm.discretePrior.n;
+  int d = hmm.NumDims();
+  logE.resize((int)observations.size(),k);
+  if(observations.empty()) return;
+  vector<Real> r(Max(d,1));
+  for(int j=0;j<k;j++)
+    logE(0,j) = priors[j].Evaluate(observations[0],&r[0]);
+  for(size_t t=1;t<observations.size();t++) {
+    const Vector& x = observations[t-1];
+    const Vector& y = observations[t];
+    for(int j=0;j<k;j++) {
+      //r = y - A x - mu
+      const Matrix& A = hmm.emissionModels[j].A;
+      const vector<Real>& mu = errors[j].mu;
+      for(int p=0;p<d;p++) {
+	Real sum = y(p) - mu[p];
+	for(int q=0;q<d;q++)
+	  sum -= A(p,q)*x(q);
+	r[p] = sum;
+      }
+      logE(t,j) = errors[j].EvaluateOffset(&r[0]);
+    }
+  }
+}
+
+//E step over the sequences start,start+step,...
+struct LinearProcessHMMEStepTask
+{
+  const LinearProcessHMM* hmm;
+  const vector<GaussianLogDensity> *priors,*errors;
+  const vector<vector<Vector> >* examples;
+  vector<vector<Vector> >* w;
+  int start,step;
+  Real logLikelihood;
+  Matrix taccum;
+};
+
+static void LinearProcessHMMEStep(LinearProcessHMMEStepTask& task)
+{
+  const LinearProcessHMM& hmm = *task.hmm;
+  const vector<vector<Vector> >& examples = *task.examples;
+  int k = hmm.discretePrior.n;
+  task.logLikelihood = 0;
+  task.taccum.resize(k,k,0.0);
+  Matrix logE;
+  for(size_t i=task.start;i<examples.size();i+=task.step) {
+    GetLogEmissions(hmm,*task.priors,*task.errors,examples[i],logE);
+    task.logLikelihood += HMMForwardBackward(hmm.discretePrior,hmm.transitionMatrix,logE,(*task.w)[i],&task.taccum);
+  }
+}
+
+static void* LinearProcessHMMEStepThread(void* data)
+{
+  LinearProcessHMMEStep(*(LinearProcessHMMEStepTask*)data);
+  return NULL;
+}
+
+bool LinearProcessHMM::TrainEM(const vector<vector<Vector> >& examples,Real& tol,int maxIters,int verbose,int numThreads)
 {
   vector<Real> flatWeights,initWeights;
   vector<Vector> flatExamples,flatExamplesPrev,initExamples;
@@ -192,16 +267,49 @@ bool LinearProcessHMM::TrainEM(const vector<vector<Vector> >& examples,Real& tol
 
   //weights of each example belonging to each class 
   vector<vector<Vector> > w(examples.size());
+  if(numThreads <= 0) numThreads = ThreadHardwareConcurrency();
+  numThreads = Max(1,Min(numThreads,(int)examples.size()));
+  vector<LinearProcessHMMEStepTask> tasks(numThreads);
+  vector<GaussianLogDensity> priorDensities,errorDensities;
   Matrix taccum;
   Real lltotal_old = -Inf;
   for(int iters=0;iters<maxIters;iters++) {
+    printf("Performing E step iteration %d...\n",iters);
+
+    //E step, split over sequences.  This also gives the log likelihood of
+    //the data under the current model.
+    GetLogDensities(*this,priorDensities,errorDensities);
+    for(int t=0;t<numThreads;t++) {
+      tasks[t].hmm = this;
+      tasks[t].priors = &priorDensities;
+      tasks[t].errors = &errorDensities;
+      tasks[t].examples = &examples;
+      tasks[t].w = &w;
+      tasks[t].start = t;
+      tasks[t].step = numThreads;
+    }
+    if(numThreads == 1)
+      LinearProcessHMMEStep(tasks[0]);
+    else {
+      vector<Thread> threads(numThreads);
+      for(int t=0;t<numThreads;t++)
+	threads[t] = ThreadStart(LinearProcessHMMEStepThread,&tasks[t]);
+      for(int t=0;t<numThreads;t++)
+	ThreadJoin(threads[t]);
+    }
     Real lltotal=0.0;
-    for(size_t i=0;i<examples.size();i++)
-      lltotal += LogLikelihood(examples[i]);
+    taccum = tasks[0].taccum;
+    lltotal += tasks[0].logLikelihood;
+    for(int t=1;t<numThreads;t++) {
+      taccum += tasks[t].taccum;
+      lltotal += tasks[t].logLikelihood;
+    }
     printf("Log likelihood of data: %g\n",lltotal);
     if(Abs(lltotal-lltotal_old) < tol) {
+      tol = lltotal;
       return true;
     }
+    lltotal_old = lltotal;
     if((iters+1) % 10 == 0) {
       printf("Saving progress to temp.lphmm\n");
       ofstream out("temp.lphmm");
@@ -209,14 +317,6 @@ bool LinearProcessHMM::TrainEM(const vector<vector<Vector> >& examples,Real& tol
       out.close();
     }
 
-    printf("Performing E step iteration %d...\n",iters);
-
-    //E step
-    taccum.resize(discretePrior.n,discretePrior.n);
-    taccum.setZero();
-    for(size_t i=0;i<examples.size();i++) {
-      Posterior(examples[i],w[i],taccum);
-    }
     //M step
     printf("Performing M step...\n");
     //first maximize discrete prior
@@ -466,33 +566,11 @@ Real LinearProcessHMM::LogLikelihood(const vector<int>& dstates,const vector<Vec
 
 Real LinearProcessHMM::LogLikelihood(const vector<Vector>& observations) const
 {
-  Real ll=0.0;
-  Vector p = discretePrior,temp;
-  Real pobs0=0;
-  for(int i=0;i<discretePrior.n;i++) {
-    if(discretePrior[i] > 0) 
-      p(i) *= continuousPriors[i].probability(observations[0]);
-  }
-  pobs0 = NormalizeProbability(p);
-  if(pobs0 == 0) {
-    printf("Warning, probability of initial observation is 0\n");
-    cout<<"Discrete distribution "<<discretePrior<<endl;
-  }
-  ll += Log(pobs0);
-  for(size_t i=1;i<observations.size();i++) {
-    Predict(p,temp);
-    Real pi = Probability(temp,observations[i-1],observations[i]);
-    if(pi == 0) {
-      printf("Warning, probability of transition %d is 0\n",i);
-      cout<<"Discrete distribution "<<temp<<endl;
-      cout<<"Observations: "<<observations[i-1]<<" "<<observations[i]<<endl;
-      for(int j=0;j<discretePrior.n;j++)
-	cout<<"Logp["<<j<<"] = "<<emissionModels[j].LogProbability(observations[i-1],observations[i])<<endl;
-    }
-    ll += Log(pi);
-    Update(temp,observations[i-1],observations[i],p);
-  }
-  return ll;
+  vector<GaussianLogDensity> priors,errors;
+  GetLogDensities(*this,priors,errors);
+  Matrix logE;
+  GetLogEmissions(*this,priors,errors,observations,logE);
+  return HMMLogLikelihood(discretePrior,transitionMatrix,logE);
 }
 
 
@@ -544,152 +622,29 @@ void LinearProcessHMM::Filter(const Vector& p0,const Vector& prevObs,const Vecto
 
 void LinearProcessHMM::MAP(const vector<Vector>& observations,vector<int>& dstates) const
 {
-  dstates.resize(observations.size());
-  vector<Vector> maxp(observations.size()+1);
-  vector<vector<int> > pred(observations.size()+1);
-  for(size_t i=0;i<observations.size();i++) {
-    maxp[i].resize(discretePrior.size());
-    pred[i].resize(discretePrior.size(),-1);
-  }
-  //initialize
-  maxp[0] = discretePrior;
-  for(int j=0;j<discretePrior.n;j++)
-    maxp[0](j) *= continuousPriors[j].probability(observations[0]);
-  NormalizeProbability(maxp[0]);
-
-  //propagate
-  for(size_t i=1;i<observations.size();i++) {
-    for(int k=0;k<discretePrior.size();k++) {
-      Real best = -Inf;
-      int bestInd = 0;
-      for(int j=0;j<discretePrior.size();j++)
-	if(maxp[i-1][j]*transitionMatrix(k,j) > best) {
-	  best = maxp[i-1][j]*transitionMatrix(k,j);
-	  bestInd = j;
-	}
-      pred[i][k]=bestInd;
-      maxp[i][k]=best*emissionModels[k].Probability(observations[i-1],observations[i]);
-    }
-    //normalize maxp for better numerical performance
-    NormalizeProbability(maxp[i]);
-  }
-  //do backwards pass
-  maxp.back().maxElement(&dstates.back());
-  for(int i=(int)maxp.size()-1;i>0;i--) 
-    dstates[i-1] = pred[i][dstates[i]];
+  vector<GaussianLogDensity> priors,errors;
+  GetLogDensities(*this,priors,errors);
+  Matrix logE;
+  GetLogEmissions(*this,priors,errors,observations,logE);
+  HMMViterbi(discretePrior,transitionMatrix,logE,dstates);
 }
 
 void LinearProcessHMM::Posterior(const vector<Vector>& observations,vector<Vector>& pstate) const
 {
-  vector<Vector> pforward(observations.size()),pbackward(observations.size());
-  Matrix obsMat(observations.size(),discretePrior.n);
-  for(int j=0;j<discretePrior.n;j++)
-    obsMat(0,j) = continuousPriors[j].probability(0);
-  for(size_t i=1;i<observations.size();i++)
-    for(int j=0;j<discretePrior.n;j++)
-      obsMat(i,j) = emissionModels[j].Probability(observations[i-1],observations[i]);
-
-  //forward pass
-  pforward[0] = discretePrior;
-  for(size_t j=0;j<emissionModels.size();j++) 
-    pforward[0](j) *= obsMat(0,j);
-  Real sumw=NormalizeProbability(pforward[0]);
-  Assert(sumw != 0.0);
-  for(size_t i=1;i<observations.size();i++) {
-    transitionMatrix.mul(pforward[i-1],pforward[i]);
-    for(size_t j=0;j<emissionModels.size();j++) 
-      pforward[i](j) *= obsMat(i,j);
-    Real sumw=NormalizeProbability(pforward[i]);
-    Assert(sumw != 0.0);
-  }
-
-  //backward pass
-  pbackward.back().resize(discretePrior.size(),1.0);
-  for(int i=(int)observations.size()-1;i>0;i--) {
-    //probability of o[i+1],...,o[T] given X[i] = k 
-    //=Sum_j P(X[i+1]=j|X[i]=k)*P(o[i+1]|X[i+1]=j)*P(o[i+2],...,o[T]|X[i+1]=j)
-    Vector pobs(discretePrior.size());
-    for(int j=0;j<pobs.n;j++)
-      pobs[j] = pbackward[i][j]*obsMat(i,j);
-    transitionMatrix.mulTranspose(pobs,pbackward[i-1]);
-    NormalizeProbability(pbackward[i-1]);
-  }
-  //combine via elementwise product and normalize
-  pstate.resize(observations.size());
-  for(size_t i=0;i<observations.size();i++) {
-    pstate[i].resize(discretePrior.size()); 
-    for(int k=0;k<pstate[i].n;k++)
-      pstate[i](k) = pforward[i](k)*pbackward[i](k);
-    NormalizeProbability(pstate[i]);
-  }
+  vector<GaussianLogDensity> priors,errors;
+  GetLogDensities(*this,priors,errors);
+  Matrix logE;
+  GetLogEmissions(*this,priors,errors,observations,logE);
+  HMMForwardBackward(discretePrior,transitionMatrix,logE,pstate);
 }
 
 void LinearProcessHMM::Posterior(const vector<Vector>& observations,vector<Vector>& pstate,Matrix& tstate) const
 {
-  vector<Vector> pforward(observations.size()),pbackward(observations.size());
-  Matrix obsMat(observations.size(),discretePrior.n);
-  for(int j=0;j<discretePrior.n;j++) {
-    obsMat(0,j) = continuousPriors[j].logProbability(observations[0]);
-  }
-  for(size_t i=1;i<observations.size();i++)
-    for(int j=0;j<discretePrior.n;j++)
-      obsMat(i,j) = emissionModels[j].LogProbability(observations[i-1],observations[i]);
-
-  //forward pass
-  pforward[0].resize(discretePrior.n);
-  for(size_t j=0;j<emissionModels.size();j++) 
-    pforward[0](j) = Log(discretePrior(j)) + obsMat(0,j);
-  Real sumw=ExpNormalize(pforward[0]);
-  Assert(sumw != 0.0);
-  for(size_t i=1;i<observations.size();i++) {
-    transitionMatrix.mul(pforward[i-1],pforward[i]);
-    for(size_t j=0;j<emissionModels.size();j++) 
-      pforward[i](j) = Log(pforward[i](j)) + obsMat(i,j);
-    Real sumw=ExpNormalize(pforward[i]);
-    Assert(sumw != 0.0);
-  }
-  //backward pass
-  pbackward.back().resize(discretePrior.size(),1.0);
-  for(int i=(int)observations.size()-1;i>0;i--) {
-    //probability of o[i+1],...,o[T] given X[i] = k 
-    //=Sum_j Int_o[i] P(X[i+1]=j|X[i]=k)*P(o[i+1]|X[i+1]=j,o[i])*P(o[i+2],...,o[T]|X[i+1]=j)
-    Vector pobs(discretePrior.size());
-    for(int j=0;j<pobs.n;j++)
-      pobs[j] = Log(pbackward[i][j])+obsMat(i,j);
-    ExpNormalize(pobs);
-    transitionMatrix.mulTranspose(pobs,pbackward[i-1]);
-    NormalizeProbability(pbackward[i-1]);
-  }
-  //combine via elementwise product and normalize
-  pstate.resize(observations.size());
-  for(size_t i=0;i<observations.size();i++) {
-    pstate[i].resize(discretePrior.size()); 
-    for(int k=0;k<pstate[i].n;k++)
-      pstate[i][k] = pforward[i][k]*pbackward[i][k];
-    NormalizeProbability(pstate[i]);
-  }
-
-  //compute transition models
-  Matrix temp(discretePrior.n,discretePrior.n);
-  if(tstate.isEmpty()) tstate.resize(discretePrior.n,discretePrior.n,0.0);
-  for(size_t i=1;i<observations.size();i++) {
-    for(int k=0;k<discretePrior.n;k++) {
-      Real pobs=Log(pbackward[i][k])+obsMat(i,k);
-      for(int j=0;j<discretePrior.n;j++) {
-	temp(k,j) = Log(pforward[i-1][j])+Log(transitionMatrix(k,j))+pobs;
-      }
-    }
-    //exponential+normalize
-    Real vmax = temp.maxElement();
-    Real sum = 0.0;
-    for(int k=0;k<discretePrior.n;k++) 
-      for(int j=0;j<discretePrior.n;j++) {
-	temp(k,j) = Exp(temp(k,j)-vmax);
-	sum += temp(k,j);
-      }
-    temp *= 1.0/sum;
-    tstate += temp;
-  }
+  vector<GaussianLogDensity> priors,errors;
+  GetLogDensities(*this,priors,errors);
+  Matrix logE;
+  GetLogEmissions(*this,priors,errors,observations,logE);
+  HMMForwardBackward(discretePrior,transitionMatrix,logE,pstate,&tstate);
 }
 
 
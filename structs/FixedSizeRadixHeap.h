@@ -0,0 +1,208 @@
+#ifndef FIXED_SIZE_RADIX_HEAP_H
+#define FIXED_SIZE_RADIX_HEAP_H
+
+#include <vector>
+#include <iostream>
+#include <string.h>
+#include <KrisLibrary/errors.h>
+#include <KrisLibrary/utils/bits.h>
+
+/** @brief Maps a priority to a 64-bit radix key.  Larger priorities give
+ * smaller keys, so the element on top of FixedSizeRadixHeap has the
+ * smallest key.
+ */
+inline unsigned long long RadixHeapKey(double p)
+{
+  if(p == 0) p = 0; //map -0 to +0
+  unsigned long long u;
+  memcpy(&u,&p,sizeof(double));
+  //flip the order of negatives and put them below the positives
+  u = ((u >> 63) ? ~u : u | (1ULL << 63));
+  return ~u;
+}
+
+inline unsigned long long RadixHeapKey(float p) { return RadixHeapKey(double(p)); }
+inline unsigned long long RadixHeapKey(long long p) { return ~((unsigned long long)p ^ (1ULL << 63)); }
+inline unsigned long long RadixHeapKey(int p) { return RadixHeapKey((long long)p); }
+
+/** @brief A monotone radix heap with the same interface as FixedSizeHeap.
+ *
+ * Each element is indexed by an integer 0...N-1 and the element with the
+ * largest priority is on top.  The heap is monotone: after an element is
+ * popped, the priorities of pushed or adjusted elements must not exceed
+ * its priority.  This holds for Dijkstra's algorithm with nonnegative
+ * weights and for fast marching, which use the negated distance as the
+ * priority.  In exchange, a pop costs amortized O(log C) where C is the
+ * range of the keys, rather than O(log N), and it works on a few flat
+ * buckets rather than a tree.
+ *
+ * An element pushed with a priority above the last popped one is placed
+ * in the front bucket and popped next, so a slightly non-monotone
+ * sequence still works, but such elements come out in no particular
+ * order among themselves.  find() only indicates whether the element is
+ * in the heap, and there is no adjustByHeapIndex.
+ */
+template <class ptype>
+class FixedSizeRadixHeap
+{
+public:
+  FixedSizeRadixHeap(int maxValue)
+    :objectBucket(maxValue,-1),objectIndex(maxValue,0),numItems(0),last(0)
+  {
+  }
+
+  FixedSizeRadixHeap()
+    :numItems(0),last(0)
+  {
+  }
+
+  void init(int maxValue)
+  {
+    objectBucket.resize(maxValue);
+    objectIndex.resize(maxValue);
+    std::fill(objectBucket.begin(),objectBucket.end(),-1);
+    for(int i=0;i<kNumBuckets;i++) buckets[i].resize(0);
+    numItems=0;
+    last=0;
+  }
+
+  void increaseCapacity(int maxValue)
+  {
+    objectBucket.resize(maxValue,-1);
+    objectIndex.resize(maxValue,0);
+  }
+
+  inline int top() const { normalize(); return buckets[0].back().x; }
+
+  inline ptype topPriority() const { normalize(); return buckets[0].back().p; }
+
+  inline ptype priority(int x) const { return buckets[objectBucket[x]][objectIndex[x]].p; }
+
+  void pop()
+  {
+    Assert(!empty());
+    normalize();
+    objectBucket[buckets[0].back().x]=-1;
+    buckets[0].resize(buckets[0].size()-1);
+    numItems--;
+  }
+
+  void push(int x,const ptype& p)
+  {
+    Assert(objectBucket[x]<0);
+    item it;
+    it.x=x;
+    it.p=p;
+    it.key=RadixHeapKey(p);
+    if(it.key < last) it.key = last;
+    insert(it);
+    numItems++;
+  }
+
+  int find(const int x) const
+  {
+    Assert(x >= 0 && x < (int)objectBucket.size());
+    return (objectBucket[x] < 0 ? 0 : objectIndex[x]+1);
+  }
+
+  void adjust(const int x, const ptype& p)
+  {
+    if(find(x)) {
+      remove(x);
+      numItems--;
+    }
+    push(x,p);
+  }
+
+  inline void clear() { init((int)objectBucket.size()); }
+  inline bool empty() const { return numItems==0; }
+  inline int size() const { return numItems; }
+  inline int maxObjects() const { return (int)objectBucket.size(); }
+
+  bool isHeap() const
+  {
+    int n=0;
+    for(int b=0;b<kNumBuckets;b++) {
+      for(size_t i=0;i<buckets[b].size();i++) {
+        const item& it=buckets[b][i];
+        Assert(objectBucket[it.x] == b && objectIndex[it.x] == (int)i);
+        if(bucketIndex(it.key) != b) return false;
+        n++;
+      }
+    }
+    return n == numItems;
+  }
+
+  void print() const {
+    for(int b=0;b<kNumBuckets;b++) {
+      if(buckets[b].empty()) continue;
+      std::cout<<b<<": ";
+      for(size_t i=0;i<buckets[b].size();i++)
+        std::cout<<"("<<buckets[b][i].x<<","<<buckets[b][i].p<<")"<<" ";
+      std::cout<<std::endl;
+    }
+  }
+
+private:
+  enum { kNumBuckets = 65 };
+
+  struct item
+  {
+    int x;   //the object index
+    ptype p; //the priority key
+    unsigned long long key;  //the radix key, at least last
+  };
+
+  //bucket 0 holds the keys equal to last, and bucket b>0 holds the keys
+  //whose highest bit that differs from last is bit b-1
+  inline int bucketIndex(unsigned long long key) const { return GetGreatestBit64(key ^ last)+1; }
+
+  inline void insert(const item& it) const
+  {
+    int b = bucketIndex(it.key);
+    objectBucket[it.x] = b;
+    objectIndex[it.x] = (int)buckets[b].size();
+    buckets[b].push_back(it);
+  }
+
+  void remove(int x)
+  {
+    std::vector<item>& bucket = buckets[objectBucket[x]];
+    int i = objectIndex[x];
+    bucket[i] = bucket.back();
+    objectIndex[bucket[i].x] = i;
+    bucket.resize(bucket.size()-1);
+    objectBucket[x] = -1;
+  }
+
+  //If the front bucket is empty, moves last to the smallest key and
+  //redistributes the first nonempty bucket, whose elements all land in
+  //lower buckets
+  void normalize() const
+  {
+    Assert(numItems > 0);
+    if(!buckets[0].empty()) return;
+    int b=1;
+    while(buckets[b].empty()) b++;
+    std::vector<item>& bucket = buckets[b];
+    unsigned long long kmin = bucket[0].key;
+    for(size_t i=1;i<bucket.size();i++)
+      if(bucket[i].key < kmin) kmin = bucket[i].key;
+    last = kmin;
+    for(size_t i=0;i<bucket.size();i++)
+      insert(bucket[i]);
+    bucket.resize(0);
+  }
+
+  //the bucket and the index in the bucket of each object, or -1 if the
+  //object is not in the heap
+  mutable std::vector<int> objectBucket;
+  mutable std::vector<int> objectIndex;
+  mutable std::vector<item> buckets[kNumBuckets];
+  int numItems;
+  //the key of the last element on top
+  mutable unsigned long long last;
+};
+
+
+#endif
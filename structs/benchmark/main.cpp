@@ -0,0 +1,246 @@
+#include <KrisLibrary/math/math.h>
+#include <KrisLibrary/math/random.h>
+#include <KrisLibrary/math3d/primitives.h>
+#include <KrisLibrary/graph/CSRGraph.h>
+#include <KrisLibrary/structs/FixedSizeHeap.h>
+#include <KrisLibrary/structs/FixedSizeDaryHeap.h>
+#include <KrisLibrary/structs/FixedSizeRadixHeap.h>
+#include <KrisLibrary/Timer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <vector>
+using namespace Math;
+using namespace Math3D;
+using namespace std;
+
+/* Compares FixedSizeHeap with the 4-ary and radix heaps on the queue
+ * workloads of this library:
+ * - roadmap: Dijkstra's algorithm on a random geometric graph, as in
+ *   ShortestPathProblem on a PRM roadmap.
+ * - grid: Dijkstra's algorithm with integer costs on a 4-connected grid,
+ *   as in the mode graph searches of MCRPlanner.
+ * - fmm: fast marching on a 2D cost grid, with the same queue operations
+ *   as FMMSearch in planning/FMM.cpp.
+ */
+
+struct RoadmapEdge
+{
+  Real length;
+};
+
+inline Real EdgeLength(const RoadmapEdge& e,int s,int t) { return e.length; }
+
+typedef Graph::Graph<Vector2,RoadmapEdge> Roadmap;
+
+//Connects random points in the unit square that are closer than r
+void MakeRoadmap(int n,Real r,Roadmap& G)
+{
+  G.Cleanup();
+  G.Resize(n);
+  int m = (int)Ceil(1.0/r);
+  vector<vector<int> > cells(m*m);
+  for(int i=0;i<n;i++) {
+    G.nodes[i].set(Rand(),Rand());
+    int cx = Min((int)(G.nodes[i].x*m),m-1), cy = Min((int)(G.nodes[i].y*m),m-1);
+    cells[cx*m+cy].push_back(i);
+  }
+  RoadmapEdge e;
+  for(int cx=0;cx<m;cx++) {
+    for(int cy=0;cy<m;cy++) {
+      const vector<int>& c = cells[cx*m+cy];
+      for(int dx=0;dx<=1;dx++) {
+        for(int dy=-1;dy<=1;dy++) {
+          if(dx == 0 && dy < 0) continue;
+          if(cx+dx >= m || cy+dy < 0 || cy+dy >= m) continue;
+          const vector<int>& c2 = cells[(cx+dx)*m+cy+dy];
+          for(size_t i=0;i<c.size();i++) {
+            for(size_t j=(dx==0&&dy==0?i+1:0);j<c2.size();j++) {
+              e.length = G.nodes[c[i]].distance(G.nodes[c2[j]]);
+              if(e.length < r) G.AddEdge(c[i],c2[j],e);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <class Heap>
+void RoadmapDijkstra(const Graph::CSRGraph<Vector2,RoadmapEdge>& G,int s,vector<Real>& d)
+{
+  Heap H(G.NumNodes());
+  vector<int> p;
+  d.resize(G.NumNodes());
+  p.resize(G.NumNodes());
+  fill(d.begin(),d.end(),Inf);
+  d[s] = 0;
+  Graph::CSRSingleTargetVisitor visitor(-1,d,p);
+  Graph::CSRBestFirstSearch(G,EdgeLength,Graph::ZeroHeuristic(),d,visitor,H);
+}
+
+template <class Heap>
+void GridDijkstra(const vector<int>& costs,int m,vector<int>& d)
+{
+  int n = m*m;
+  Heap H(n);
+  d.resize(n);
+  fill(d.begin(),d.end(),INT_MAX);
+  d[0] = 0;
+  H.push(0,0);
+  while(!H.empty()) {
+    int u = H.top(); H.pop();
+    int x = u/m, y = u%m;
+    int nbrs[4] = {(x>0?u-m:-1),(x+1<m?u+m:-1),(y>0?u-1:-1),(y+1<m?u+1:-1)};
+    for(int k=0;k<4;k++) {
+      int v = nbrs[k];
+      if(v < 0) continue;
+      int dv = d[u] + costs[v];
+      if(dv < d[v]) {
+        d[v] = dv;
+        H.adjust(v,-dv);
+      }
+    }
+  }
+}
+
+//First order upwind update from the finished neighbors
+inline Real EikonalUpdate(Real a,Real b,Real c)
+{
+  if(a > b) swap(a,b);
+  if(IsInf(b) || b-a >= c) return a+c;
+  return 0.5*(a+b+Sqrt(2.0*c*c-Sqr(b-a)));
+}
+
+template <class Heap>
+void GridFMM(const vector<Real>& costs,int m,vector<Real>& d)
+{
+  int n = m*m;
+  Heap H(n);
+  vector<signed char> status(n,0);
+  d.resize(n);
+  fill(d.begin(),d.end(),Inf);
+  d[0] = 0;
+  H.push(0,0);
+  status[0] = 1;
+  while(!H.empty()) {
+    int u = H.top(); H.pop();
+    status[u] = -1;
+    int x = u/m, y = u%m;
+    if(u != 0) {
+      Real a = Min((x>0 && status[u-m]<0 ? d[u-m] : Inf),(x+1<m && status[u+m]<0 ? d[u+m] : Inf));
+      Real b = Min((y>0 && status[u-1]<0 ? d[u-1] : Inf),(y+1<m && status[u+1]<0 ? d[u+1] : Inf));
+      d[u] = EikonalUpdate(a,b,costs[u]);
+    }
+    int nbrs[4] = {(x>0?u-m:-1),(x+1<m?u+m:-1),(y>0?u-1:-1),(y+1<m?u+1:-1)};
+    for(int k=0;k<4;k++) {
+      int v = nbrs[k];
+      if(v < 0 || status[v] < 0) continue;
+      //the same tentative priority as FMMSearch
+      Real ncost = d[u] + costs[v];
+      if(status[v] == 0) {
+        H.push(v,-ncost);
+        d[v] = ncost;
+        status[v] = 1;
+      }
+      else if(ncost < d[v]) {
+        d[v] = ncost;
+        H.adjust(v,-ncost);
+      }
+    }
+  }
+}
+
+//Returns the fastest of several runs of a workload
+template <class Data,class Result>
+double TimeWorkload(void (*workload)(const Data&,int,Result&),const Data& data,int arg,Result& res,int repeats)
+{
+  double best = Inf;
+  for(int i=0;i<repeats;i++) {
+    Timer timer;
+    workload(data,arg,res);
+    best = Min(best,timer.ElapsedTime());
+  }
+  return best;
+}
+
+template <class T>
+double MaxDifference(const vector<T>& a,const vector<T>& b)
+{
+  double res = 0;
+  for(size_t i=0;i<a.size();i++)
+    if(a[i] != b[i]) res = Max(res,Abs(double(a[i])-double(b[i])));
+  return res;
+}
+
+void PrintResult(const char* workload,const char* heap,double time,double baseTime,double error)
+{
+  printf("%-8s %-8s %8.4f s  %5.2fx  max difference %g\n",workload,heap,time,baseTime/time,error);
+}
+
+void PrintUsage(const char* program)
+{
+  printf("Usage: %s [options]\n",program);
+  printf("Times FixedSizeHeap, FixedSizeDaryHeap and FixedSizeRadixHeap on shortest path and fast marching workloads.\n");
+  printf("Options:\n");
+  printf("  -nodes n: number of roadmap nodes (default 200000)\n");
+  printf("  -degree k: average roadmap degree (default 10)\n");
+  printf("  -grid m: side length of the grids (default 1000)\n");
+  printf("  -seed s: random seed (default 1)\n");
+  printf("  -repeats r: number of runs of each workload, of which the fastest is reported (default 3)\n");
+}
+
+int main(int argc,const char** argv)
+{
+  int numNodes = 200000, gridSize = 1000;
+  Real degree = 10;
+  int seed = 1, repeats = 3;
+  for(int i=1;i<argc;i++) {
+    if(0==strcmp(argv[i],"-nodes") && i+1<argc) numNodes = atoi(argv[++i]);
+    else if(0==strcmp(argv[i],"-degree") && i+1<argc) degree = atof(argv[++i]);
+    else if(0==strcmp(argv[i],"-grid") && i+1<argc) gridSize = atoi(argv[++i]);
+    else if(0==strcmp(argv[i],"-seed") && i+1<argc) seed = atoi(argv[++i]);
+    else if(0==strcmp(argv[i],"-repeats") && i+1<argc) repeats = atoi(argv[++i]);
+    else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  Srand(seed);
+
+  Roadmap roadmap;
+  MakeRoadmap(numNodes,Sqrt(degree/(Pi*numNodes)),roadmap);
+  Graph::CSRGraph<Vector2,RoadmapEdge> csr;
+  csr.Build(roadmap,Graph::CSRUndirected);
+  printf("roadmap: %d nodes, %d edges\n",roadmap.NumNodes(),roadmap.NumEdges());
+  vector<Real> d0,d;
+  double t0 = TimeWorkload(RoadmapDijkstra<FixedSizeHeap<Real> >,csr,0,d0,repeats);
+  PrintResult("roadmap","binary",t0,t0,0);
+  double t = TimeWorkload(RoadmapDijkstra<FixedSizeDaryHeap<Real,4> >,csr,0,d,repeats);
+  PrintResult("roadmap","4-ary",t,t0,MaxDifference(d0,d));
+  t = TimeWorkload(RoadmapDijkstra<FixedSizeRadixHeap<Real> >,csr,0,d,repeats);
+  PrintResult("roadmap","radix",t,t0,MaxDifference(d0,d));
+
+  int n = gridSize*gridSize;
+  printf("grid: %d x %d\n",gridSize,gridSize);
+  vector<int> icosts(n);
+  for(int i=0;i<n;i++) icosts[i] = 1+RandInt(9);
+  vector<int> id0,id;
+  t0 = TimeWorkload(GridDijkstra<FixedSizeHeap<int> >,icosts,gridSize,id0,repeats);
+  PrintResult("grid","binary",t0,t0,0);
+  t = TimeWorkload(GridDijkstra<FixedSizeDaryHeap<int,4> >,icosts,gridSize,id,repeats);
+  PrintResult("grid","4-ary",t,t0,MaxDifference(id0,id));
+  t = TimeWorkload(GridDijkstra<FixedSizeRadixHeap<int> >,icosts,gridSize,id,repeats);
+  PrintResult("grid","radix",t,t0,MaxDifference(id0,id));
+
+  vector<Real> costs(n);
+  for(int i=0;i<n;i++) costs[i] = Rand(1,10);
+  t0 = TimeWorkload(GridFMM<FixedSizeHeap<Real> >,costs,gridSize,d0,repeats);
+  PrintResult("fmm","binary",t0,t0,0);
+  t = TimeWorkload(GridFMM<FixedSizeDaryHeap<Real,4> >,costs,gridSize,d,repeats);
+  PrintResult("fmm","4-ary",t,t0,MaxDifference(d0,d));
+  t = TimeWorkload(GridFMM<FixedSizeRadixHeap<Real> >,costs,gridSize,d,repeats);
+  PrintResult("fmm","radix",t,t0,MaxDifference(d0,d));
+  return 0;
+}
@@ -5,31 +5,41 @@
 #include <iostream>
 #ifndef _WIN32
 #include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
 #endif
 using namespace std;
 
-AsyncReaderQueue::AsyncReaderQueue(size_t _queueMax)
-  :queueMax(_queueMax),msgCount(0),numDroppedMsgs(0)
+AsyncReaderQueue::AsyncReaderQueue(size_t _queueMax,AsyncQueuePolicy _policy)
+  :queueMax(_queueMax),policy(_policy),msgCount(0),msgQueue(_queueMax),numDroppedMsgs(0)
 {}
 
-void AsyncReaderQueue::OnRead(const string& msg)
+bool AsyncReaderQueue::OnRead(const string& msg)
 {
-  ScopedLock lock(mutex);
-  OnRead_NoLock(msg);
+  string temp(msg);
+  return OnReadSwap(temp);
 }
 
-void AsyncReaderQueue::OnRead_NoLock(const string& msg)
+bool AsyncReaderQueue::OnReadSwap(string& msg)
 {
-  while(msgQueue.size()>=queueMax) {
-    msgQueue.pop_front();
-    numDroppedMsgs++;
-    if(numDroppedMsgs % 1000 == 1) {
-      fprintf(stderr,"AsyncReaderQueue: Warning, dropped %d messages, ask your sender to reduce the send rate\n",(int)numDroppedMsgs);
+  if(msgQueue.Capacity() == 0) return false;
+  while(!msgQueue.TryPush(msg)) {
+    if(policy == AsyncBackpressure) return false;
+    //drop the oldest message.  The pop may fail if a reader emptied the
+    //queue in the meantime, and then the push is retried
+    string dropped;
+    if(msgQueue.TryPop(dropped)) {
+      size_t n = AtomicAdd(&numDroppedMsgs,1);
+      if(n % 1000 == 1) {
+        fprintf(stderr,"AsyncReaderQueue: Warning, dropped %d messages, ask your sender to reduce the send rate\n",(int)n);
+      }
     }
   }
-  msgQueue.push_back(msg);
-  msgLast = msg;
-  msgCount += 1;
+  AtomicAdd(&msgCount,1);
+  return true;
 }
 
 void AsyncReaderQueue::Reset()
@@ -37,78 +47,126 @@ void AsyncReaderQueue::Reset()
   ScopedLock lock(mutex);
   msgCount=0;
   msgLast="";
-  msgQueue.clear(); 
+  msgUnread.clear();
+  msgQueue.Resize(queueMax);
+}
+
+void AsyncReaderQueue::DrainQueue_NoLock()
+{
+  string msg;
+  while(msgQueue.TryPop(msg)) {
+    msgUnread.push_back(string());
+    msgUnread.back().swap(msg);
+  }
+  while(msgUnread.size() > queueMax) {
+    msgUnread.pop_front();
+    AtomicAdd(&numDroppedMsgs,1);
+  }
 }
 
 int AsyncReaderQueue::UnreadCount()
 {
   ScopedLock lock(mutex);
-  return (int)msgQueue.size();
+  return (int)(msgUnread.size()+msgQueue.Size());
 }
 
 string AsyncReaderQueue::PeekNewest()
 {
   ScopedLock lock(mutex);
+  DrainQueue_NoLock();
+  if(!msgUnread.empty()) msgLast=msgUnread.back();
+  return msgLast;
+}
+
+string AsyncReaderQueue::Newest()
+{
+  ScopedLock lock(mutex);
+  if(!msgUnread.empty()) {
+    msgLast.swap(msgUnread.back());
+    msgUnread.clear();
+  }
+  string msg;
+  while(msgQueue.TryPop(msg))
+    msgLast.swap(msg);
   return msgLast;
 }
 
 vector<string> AsyncReaderQueue::New()
 {
   ScopedLock lock(mutex);
-  if(msgQueue.empty()) { msgLast=""; return vector<string>(); }
-  vector<string> res(msgQueue.size());
-  copy(msgQueue.begin(),msgQueue.end(),res.begin());
+  vector<string> res(msgUnread.size());
+  for(size_t i=0;i<msgUnread.size();i++)
+    res[i].swap(msgUnread[i]);
+  msgUnread.clear();
+  string msg;
+  while(msgQueue.TryPop(msg)) {
+    res.push_back(string());
+    res.back().swap(msg);
+  }
+  if(res.empty()) { msgLast=""; return res; }
   msgLast=res.back(); 
-  msgQueue.clear();
   return res;
 }
 
-AsyncWriterQueue::AsyncWriterQueue(size_t _queueMax)
-  :queueMax(_queueMax),msgCount(0),numDroppedMsgs(0)
+bool AsyncReaderQueue::Next(string& msg)
+{
+  ScopedLock lock(mutex);
+  if(!msgUnread.empty()) {
+    msg.swap(msgUnread.front());
+    msgUnread.pop_front();
+  }
+  else if(!msgQueue.TryPop(msg))
+    return false;
+  msgLast=msg;
+  return true;
+}
+
+AsyncWriterQueue::AsyncWriterQueue(size_t _queueMax,AsyncQueuePolicy _policy)
+  :queueMax(_queueMax),policy(_policy),msgCount(0),msgQueue(_queueMax),numDroppedMsgs(0)
 {}
 
 
 string AsyncWriterQueue::OnWrite()
 {
-  ScopedLock lock(mutex);
-  return OnWrite_NoLock();
+  string res;
+  OnWrite(res);
+  return res;
 }
 
-string AsyncWriterQueue::OnWrite_NoLock()
+bool AsyncWriterQueue::OnWrite(string& msg)
 {
-  if(msgQueue.empty()) return "";
-  string res = msgQueue.front();
-  if(msgQueue.size() >= queueMax) {
-    printf("AsyncWriterQueue: Message queue overflowing!\n");
-    printf("   solution: slow down rate of sending via Send\n");
-  }
-  while(msgQueue.size()>=queueMax) {
-    msgQueue.pop_front();
-    numDroppedMsgs++;
-    if(numDroppedMsgs % 1000 == 1) {
-      fprintf(stderr,"AsyncWriterQueue: Warning, dropped %d messages, slow down the rate of sending via SendMessage\n",(int)numDroppedMsgs);
-    }
-  }
-  msgQueue.pop_front();
-  msgCount += 1;
-  return res;
+  if(!msgQueue.TryPop(msg)) return false;
+  AtomicAdd(&msgCount,1);
+  return true;
 }
 
 void AsyncWriterQueue::Reset()
 {
-  ScopedLock lock(mutex);
-  msgQueue.clear();
+  msgQueue.Resize(queueMax);
   msgCount = 0;
 }
 
-void AsyncWriterQueue::Send(const string& msg)
+bool AsyncWriterQueue::Send(const string& msg)
 {
-  ScopedLock lock(mutex);
+  string temp(msg);
+  return SendSwap(temp);
+}
+
+bool AsyncWriterQueue::SendSwap(string& msg)
+{
+  if(msgQueue.Capacity() == 0) return false;
   //prevent message queue from growing too big
-  while(msgQueue.size()>=queueMax) {
-    msgQueue.pop_front();
+  while(!msgQueue.TryPush(msg)) {
+    if(policy == AsyncBackpressure) return false;
+    string dropped;
+    if(msgQueue.TryPop(dropped)) {
+      size_t n = AtomicAdd(&numDroppedMsgs,1);
+      if(n % 1000 == 1) {
+        fprintf(stderr,"AsyncWriterQueue: Warning, dropped %d messages, slow down the rate of sending via Send\n",(int)n);
+      }
+    }
   }
-  msgQueue.push_back(msg);
+  return true;
 }
 
 
@@ -199,6 +257,8 @@ void AsyncReaderThread::Reset()
 void* read_worker_thread_func(void * ptr)
 {
   AsyncReaderThread* data = reinterpret_cast<AsyncReaderThread*>(ptr);
+  //swapped onto the queue, which hands back a recycled buffer
+  string msg;
   while(data->timer.ElapsedTime() < data->lastReadTime + data->timeout) {
     const string* res = data->transport->DoRead();
     if(!res) {
@@ -209,11 +269,11 @@ void* read_worker_thread_func(void * ptr)
     }
     if((*res)[0] == 0) continue;
 
-    {
-      ScopedLock lock(data->mutex);     
-      data->OnRead_NoLock(*res);
-      data->lastReadTime = data->timer.ElapsedTime();
-    }
+    msg = *res;
+    //with backpressure, wait for the reader to make room unless stopped
+    while(!data->OnReadSwap(msg) && data->timeout != 0)
+      ThreadSleep(0.001);
+    data->lastReadTime = data->timer.ElapsedTime();
   }
   if(data->timeout != 0)
     fprintf(stderr,"AsyncReaderThread: quitting due to timeout\n");
@@ -272,6 +332,8 @@ void* pipe_worker_thread_func(void * ptr)
 {
   int iters=0;
   AsyncPipeThread* data = reinterpret_cast<AsyncPipeThread*>(ptr);
+  //swapped on and off the queues, which hand back recycled buffers
+  string recv,send;
   while(data->initialized) {
     double t = data->timer.ElapsedTime();
     if(t >= data->lastReadTime + data->timeout && t >= data->lastWriteTime + data->timeout) {
@@ -287,34 +349,23 @@ void* pipe_worker_thread_func(void * ptr)
 	return NULL;
       } 
       if((*res)[0] != 0) { //nonempty string
-	ScopedLock lock(data->mutex);     
-	//don't do _NoLock: the read queue needs locking
-	data->OnRead(*res);
+	recv = *res;
+	//with backpressure, wait for the reader to make room unless stopped
+	while(!data->OnReadSwap(recv) && data->timeout != 0)
+	  ThreadSleep(0.001);
 	data->lastReadTime = data->timer.ElapsedTime();
-	//mutex unlocked
       }
     }
     if(data->transport->WriteReady()) {
-      string send;
-      bool done = false;
+      data->lastWriteTime = data->timer.ElapsedTime();
       //suppose multiple items are present... send all of them without yielding the thread
-      while(!done) {
-        {
-  	ScopedLock lock(data->mutex);
-  	//don't do _NoLock: the write queue needs locking
-  	send = data->OnWrite();
-  	data->lastWriteTime = data->timer.ElapsedTime();
-  	//mutex unlocked
-        }
-        if(send.empty()) 
-          done = true;
-        else {
-  	if(!data->transport->DoWrite(send)) {
-  	  fprintf(stderr,"AsyncPipeThread: abnormal termination, write failed\n");
-  	  data->transport->Stop();
-  	  return NULL;
-  	}
-        }
+      while(data->OnWrite(send)) {
+	if(!data->transport->DoWrite(send)) {
+	  fprintf(stderr,"AsyncPipeThread: abnormal termination, write failed\n");
+	  data->transport->Stop();
+	  return NULL;
+	}
+	data->lastWriteTime = data->timer.ElapsedTime();
       }
     }
     else {
@@ -486,6 +537,44 @@ bool ReadIntPrependedString(File& file,std::string& buf)
   return true;
 }
 
+static bool WriteIntPrependedString(File& file,const char* str,int length)
+{
+  assert(sizeof(int)==4);
+#ifndef _WIN32
+  //on a TCP socket, send the length and the string in one system call
+  if(file.IsTCPSocket()) {
+    SOCKET sock = *((SOCKET*)file.FileObjectPointer());
+    struct iovec iov[2];
+    iov[0].iov_base = &length;
+    iov[0].iov_len = 4;
+    iov[1].iov_base = (void*)str;
+    iov[1].iov_len = length;
+    int i=0;
+    while(i < 2) {
+      ssize_t n = writev(sock,iov+i,2-i);
+      if(n < 0) {
+        if(errno == EINTR) continue;
+        perror("WriteIntPrependedString writev");
+        return false;
+      }
+      //skip past the written bytes
+      while(i < 2 && (size_t)n >= iov[i].iov_len) {
+        n -= iov[i].iov_len;
+        i++;
+      }
+      if(i < 2) {
+        iov[i].iov_base = (char*)iov[i].iov_base + n;
+        iov[i].iov_len -= n;
+      }
+    }
+    return true;
+  }
+#endif
+  if(!file.WriteData(&length,4)) 
+    return false;
+  return file.WriteData(str,length);
+}
+
 const string* SocketClientTransport::DoRead()
 {
   ScopedLock lock(mutex);
@@ -531,10 +620,7 @@ bool SocketClientTransport::Stop()
 bool SocketClientTransport::DoWrite(const char* str,int length)
 {
   ScopedLock lock(mutex);
-  assert(sizeof(int)==4);
-  if(!socket.WriteData(&length,4)) 
-    return false;
-  return socket.WriteData(str,length);
+  return WriteIntPrependedString(socket,str,length);
 }
 
 
@@ -648,7 +734,7 @@ bool SocketServerTransport::DoWrite(const char* str,int length)
   }
 
   for(size_t i=0;i<clientsockets.size();i++) {
-    if(!clientsockets[i]->WriteData(&length,4) || !clientsockets[i]->WriteData(str,length)) {
+    if(!WriteIntPrependedString(*clientsockets[i],str,length)) {
       printf("SocketServerTransport: Lost client %d\n",(int)i);
       //close the client
       clientsockets[i] = NULL;
@@ -662,3 +748,377 @@ bool SocketServerTransport::DoWrite(const char* str,int length)
   if(clientsockets.empty()) return false;
   return true;
 }
+
+
+
+//the most frames sent in one vectored send
+const static int kMaxSendFrames = 64;
+//the most sent frames kept for reuse
+const static size_t kMaxSpareFrames = 16;
+const static size_t kRecvChunk = 4096;
+
+SocketEventServerTransport::SocketEventServerTransport(const char* _addr,int _maxclients)
+  :addr(_addr),serversocket(INVALID_SOCKET),epollfd(-1),maxclients(_maxclients),pollTimeout(0.01),maxPendingBytes(64*1024*1024),currentclient(-1)
+{
+  buf.reserve(4096);
+}
+
+SocketEventServerTransport::~SocketEventServerTransport()
+{
+  Stop();
+}
+
+bool SocketEventServerTransport::ReadReady()
+{
+  return serversocket != INVALID_SOCKET;
+}
+
+bool SocketEventServerTransport::WriteReady()
+{
+  return !clients.empty();
+}
+
+#ifdef __linux__
+
+//Sends the buffers without blocking.  Returns false on an error, and
+//otherwise the number of bytes sent in sent, which is 0 if the socket is
+//full.
+static bool SendVectored(SOCKET sock,struct iovec* iov,int count,size_t& sent)
+{
+  struct msghdr msg;
+  memset(&msg,0,sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+  while(true) {
+    ssize_t n = sendmsg(sock,&msg,MSG_NOSIGNAL|MSG_DONTWAIT);
+    if(n >= 0) {
+      sent = (size_t)n;
+      return true;
+    }
+    if(errno == EINTR) continue;
+    if(errno == EAGAIN || errno == EWOULDBLOCK) {
+      sent = 0;
+      return true;
+    }
+    return false;
+  }
+}
+
+bool SocketEventServerTransport::Start()
+{
+  if(serversocket != INVALID_SOCKET) return true;
+  serversocket = Bind(addr.c_str(),false);
+  if(serversocket == INVALID_SOCKET) {
+    fprintf(stderr,"Unable to bind server socket to address %s\n",addr.c_str());
+    return false;
+  }
+  listen(serversocket,maxclients);
+  epollfd = epoll_create1(0);
+  if(epollfd < 0) {
+    perror("SocketEventServerTransport: epoll_create1");
+    CloseSocket(serversocket);
+    serversocket = INVALID_SOCKET;
+    return false;
+  }
+  //the server socket is marked by a NULL pointer
+  struct epoll_event ev;
+  memset(&ev,0,sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  epoll_ctl(epollfd,EPOLL_CTL_ADD,serversocket,&ev);
+  return true;
+}
+
+bool SocketEventServerTransport::Stop()
+{
+  ScopedLock lock(mutex);
+  for(size_t i=0;i<clients.size();i++)
+    CloseClient(*clients[i]);
+  clients.resize(0);
+  currentclient = -1;
+  if(epollfd >= 0) close(epollfd);
+  epollfd = -1;
+  if(serversocket != INVALID_SOCKET) CloseSocket(serversocket);
+  serversocket = INVALID_SOCKET;
+  return true;
+}
+
+const string* SocketEventServerTransport::DoRead()
+{
+  ScopedLock lock(mutex);
+  if(serversocket == INVALID_SOCKET) return NULL;
+  //return messages that are already received before waiting
+  if(NextMessage()) return &buf;
+
+  struct epoll_event events[64];
+  int n = epoll_wait(epollfd,events,64,(int)(pollTimeout*1000));
+  if(n < 0) {
+    if(errno != EINTR) {
+      perror("SocketEventServerTransport: epoll_wait");
+      return NULL;
+    }
+    n = 0;
+  }
+  for(int i=0;i<n;i++) {
+    Client* c = (Client*)events[i].data.ptr;
+    if(c == NULL) {
+      AcceptClients();
+      continue;
+    }
+    //closed earlier in this batch
+    if(c->socket == INVALID_SOCKET) continue;
+    if(events[i].events & (EPOLLIN|EPOLLERR|EPOLLHUP)) {
+      if(!ReadClient(*c)) {
+        printf("SocketEventServerTransport: Lost client on %s\n",addr.c_str());
+        CloseClient(*c);
+        continue;
+      }
+    }
+    if(events[i].events & EPOLLOUT) {
+      if(!FlushClient(*c)) {
+        printf("SocketEventServerTransport: Lost client on %s\n",addr.c_str());
+        CloseClient(*c);
+      }
+    }
+  }
+  bool res = NextMessage();
+  RemoveClosedClients();
+  if(res) return &buf;
+  //tolerant of failed clients
+  buf.resize(0);
+  return &buf;
+}
+
+bool SocketEventServerTransport::DoWrite(const char* str,int length)
+{
+  ScopedLock lock(mutex);
+  if(clients.empty()) {
+    //tolerant of failed clients
+    return true;
+  }
+  //created if some client can't take the whole message now
+  SmartPointer<Frame> frame;
+  size_t frameBytes = 4+(size_t)length;
+  for(size_t i=0;i<clients.size();i++) {
+    Client& c = *clients[i];
+    size_t sent = 0;
+    if(c.pending.empty()) {
+      //usual case: send straight from str without copying
+      struct iovec iov[2];
+      iov[0].iov_base = &length;
+      iov[0].iov_len = 4;
+      iov[1].iov_base = (void*)str;
+      iov[1].iov_len = length;
+      if(!SendVectored(c.socket,iov,2,sent)) {
+        printf("SocketEventServerTransport: Lost client on %s\n",addr.c_str());
+        CloseClient(c);
+        continue;
+      }
+      if(sent == frameBytes) continue;
+    }
+    if(frame.isNull()) {
+      if(!spareFrames.empty()) {
+        frame = spareFrames.back();
+        spareFrames.resize(spareFrames.size()-1);
+      }
+      else
+        frame = new Frame;
+      frame->length = length;
+      frame->data.assign(str,length);
+    }
+    if(c.pending.empty()) c.pendingOffset = sent;
+    c.pending.push_back(frame);
+    c.pendingBytes += frameBytes-sent;
+    if(c.pendingBytes > maxPendingBytes) {
+      printf("SocketEventServerTransport: Client on %s has %d bytes queued, disconnecting\n",addr.c_str(),(int)c.pendingBytes);
+      CloseClient(c);
+      continue;
+    }
+    SetWaitForWrite(c,true);
+  }
+  RemoveClosedClients();
+  if(!frame.isNull()) RecycleFrame(frame);
+  return true;
+}
+
+bool SocketEventServerTransport::NextMessage()
+{
+  //go round-robin so that one busy client doesn't starve the others
+  for(size_t k=0;k<clients.size();k++) {
+    currentclient = (currentclient+1) % (int)clients.size();
+    Client& c = *clients[currentclient];
+    if(c.socket == INVALID_SOCKET) continue;
+    size_t avail = c.recvEnd-c.recvStart;
+    if(avail < 4) continue;
+    int slen;
+    memcpy(&slen,&c.recv[c.recvStart],4);
+    if(slen < 0) {
+      fprintf(stderr,"SocketEventServerTransport: read length %d is negative\n",slen);
+      CloseClient(c);
+      continue;
+    }
+    if(avail < 4+(size_t)slen) continue;
+    buf.assign(&c.recv[c.recvStart+4],slen);
+    c.recvStart += 4+slen;
+    if(c.recvStart == c.recvEnd) c.recvStart = c.recvEnd = 0;
+    return true;
+  }
+  return false;
+}
+
+void SocketEventServerTransport::AcceptClients()
+{
+  while(true) {
+    SOCKET clientsock = accept(serversocket,NULL,NULL);
+    if(clientsock == INVALID_SOCKET) {
+      if(errno == EINTR) continue;
+      if(errno != EAGAIN && errno != EWOULDBLOCK)
+        perror("SocketEventServerTransport: accept");
+      return;
+    }
+    if((int)clients.size() >= maxclients) {
+      printf("SocketEventServerTransport: Too many clients on %s, refusing a new one\n",addr.c_str());
+      CloseSocket(clientsock);
+      continue;
+    }
+    printf("Accepted new client on %s\n",addr.c_str());
+    SetNonblock(clientsock);
+    SetNodelay(clientsock);
+    SmartPointer<Client> c = new Client;
+    c->socket = clientsock;
+    c->recv.resize(kRecvChunk);
+    c->recvStart = c->recvEnd = 0;
+    c->pendingOffset = c->pendingBytes = 0;
+    struct epoll_event ev;
+    memset(&ev,0,sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = (Client*)c;
+    if(epoll_ctl(epollfd,EPOLL_CTL_ADD,clientsock,&ev) < 0) {
+      perror("SocketEventServerTransport: epoll_ctl");
+      CloseSocket(clientsock);
+      continue;
+    }
+    clients.push_back(c);
+  }
+}
+
+bool SocketEventServerTransport::ReadClient(Client& c)
+{
+  //move unparsed data to the front rather than growing the buffer
+  if(c.recvStart > 0 && c.recvEnd+kRecvChunk > c.recv.size()) {
+    memmove(&c.recv[0],&c.recv[c.recvStart],c.recvEnd-c.recvStart);
+    c.recvEnd -= c.recvStart;
+    c.recvStart = 0;
+  }
+  while(true) {
+    if(c.recvEnd == c.recv.size())
+      c.recv.resize(c.recv.size()*2);
+    ssize_t n = recv(c.socket,&c.recv[c.recvEnd],c.recv.size()-c.recvEnd,0);
+    if(n > 0) {
+      c.recvEnd += n;
+      continue;
+    }
+    if(n == 0) return false; //connection shut down
+    if(errno == EINTR) continue;
+    if(errno == EAGAIN || errno == EWOULDBLOCK) return true;
+    return false;
+  }
+}
+
+bool SocketEventServerTransport::FlushClient(Client& c)
+{
+  struct iovec iov[kMaxSendFrames*2];
+  while(!c.pending.empty()) {
+    //gather as many queued frames as possible into one send
+    int count = 0;
+    size_t offset = c.pendingOffset;
+    for(size_t i=0;i<c.pending.size() && i<(size_t)kMaxSendFrames;i++) {
+      Frame& f = *c.pending[i];
+      if(offset < 4) {
+        iov[count].iov_base = (char*)&f.length + offset;
+        iov[count].iov_len = 4-offset;
+        count++;
+        offset = 4;
+      }
+      if(offset-4 < f.data.length()) {
+        iov[count].iov_base = (char*)f.data.data() + (offset-4);
+        iov[count].iov_len = f.data.length()-(offset-4);
+        count++;
+      }
+      offset = 0;
+    }
+    size_t sent;
+    if(!SendVectored(c.socket,iov,count,sent)) return false;
+    if(sent == 0) break;
+    c.pendingBytes -= sent;
+    while(sent > 0) {
+      size_t remaining = 4+c.pending.front()->data.length()-c.pendingOffset;
+      if(sent < remaining) {
+        c.pendingOffset += sent;
+        break;
+      }
+      sent -= remaining;
+      RecycleFrame(c.pending.front());
+      c.pending.pop_front();
+      c.pendingOffset = 0;
+    }
+  }
+  SetWaitForWrite(c,!c.pending.empty());
+  return true;
+}
+
+void SocketEventServerTransport::SetWaitForWrite(Client& c,bool enabled)
+{
+  struct epoll_event ev;
+  memset(&ev,0,sizeof(ev));
+  ev.events = (enabled ? EPOLLIN|EPOLLOUT : EPOLLIN);
+  ev.data.ptr = &c;
+  epoll_ctl(epollfd,EPOLL_CTL_MOD,c.socket,&ev);
+}
+
+#else
+
+bool SocketEventServerTransport::Start()
+{
+  fprintf(stderr,"SocketEventServerTransport: only available on Linux\n");
+  return false;
+}
+
+bool SocketEventServerTransport::Stop() { return true; }
+const string* SocketEventServerTransport::DoRead() { return NULL; }
+bool SocketEventServerTransport::DoWrite(const char* str,int length) { return false; }
+bool SocketEventServerTransport::NextMessage() { return false; }
+void SocketEventServerTransport::AcceptClients() {}
+bool SocketEventServerTransport::ReadClient(Client& c) { return false; }
+bool SocketEventServerTransport::FlushClient(Client& c) { return false; }
+void SocketEventServerTransport::SetWaitForWrite(Client& c,bool enabled) {}
+
+#endif //__linux__
+
+void SocketEventServerTransport::CloseClient(Client& c)
+{
+  if(c.socket == INVALID_SOCKET) return;
+  CloseSocket(c.socket);
+  c.socket = INVALID_SOCKET;
+  c.pending.clear();
+  c.pendingBytes = c.pendingOffset = 0;
+}
+
+void SocketEventServerTransport::RemoveClosedClients()
+{
+  for(size_t i=0;i<clients.size();i++) {
+    if(clients[i]->socket == INVALID_SOCKET) {
+      clients[i] = clients.back();
+      clients.resize(clients.size()-1);
+      i--;
+    }
+  }
+  if(currentclient >= (int)clients.size()) currentclient = -1;
+}
+
+void SocketEventServerTransport::RecycleFrame(SmartPointer<Frame>& frame)
+{
+  //only keep frames that no client still holds
+  if(frame.getRefCount() == 1 && spareFrames.size() < kMaxSpareFrames)
+    spareFrames.push_back(frame);
+}
@@ -5,12 +5,22 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <deque>
 #include <KrisLibrary/Timer.h>
 #include <KrisLibrary/errors.h>
 #include <string.h>
 #include <KrisLibrary/math/math.h>
 #include "SmartPointer.h"
 #include "threadutils.h"
+#include "RingQueue.h"
+
+/** @brief What a queue does when a message arrives while it holds
+ * queueMax messages.
+ *
+ * - DropOldest: drops the oldest message to make room.
+ * - Backpressure: rejects the new message, and the sender retries later.
+ */
+enum AsyncQueuePolicy { AsyncDropOldest, AsyncBackpressure };
 
 /** @brief Asynchronous reader with queue.
  *
@@ -21,33 +31,54 @@
  * 
  * To do a non-blocking check for new messages without flushing the queue,
  * call UnreadCount().  To peek to the latest, call PeekLast()
+ *
+ * Messages are kept in a lock-free ring of reusable slots, so the thread
+ * that calls OnRead never waits on the threads that read the messages.
+ * OnReadSwap and Next move messages in and out without copying them.
  */
 class AsyncReaderQueue
 {
  public:
   ///This will keep only the newest queueMax messages
-  AsyncReaderQueue(size_t queueMax=1000);
+  AsyncReaderQueue(size_t queueMax=1000,AsyncQueuePolicy policy=AsyncDropOldest);
   virtual ~AsyncReaderQueue() {}
-  ///Called by subclass to add a message onto the queue
-  void OnRead(const std::string& msg);
-  void OnRead_NoLock(const std::string& msg);
-
-  ///Resets the queue and history
+  ///Called by subclass to add a message onto the queue.  Returns false if
+  ///the queue is full and the policy is AsyncBackpressure.
+  bool OnRead(const std::string& msg);
+  bool OnRead_NoLock(const std::string& msg) { return OnRead(msg); }
+  ///Like OnRead, but moves msg onto the queue.  Afterwards msg holds a
+  ///recycled buffer.  If false is returned, msg is untouched.
+  bool OnReadSwap(std::string& msg);
+
+  ///Resets the queue and history.  Must not be called while another
+  ///thread calls OnRead.
   virtual void Reset();
   ///Do some work to read messages from sender -- must be done by subclass
   virtual void Work() {}
-  int MessageCount() { return (int)msgCount; }
+  int MessageCount() { return (int)AtomicLoad(&msgCount); }
   int UnreadCount();
   std::string PeekNewest();
-  std::string Newest() { msgQueue.clear(); return PeekNewest(); }
+  std::string Newest();
   std::vector<std::string> New();
+  ///Moves the oldest unread message into msg.  Returns false if there
+  ///are none.
+  bool Next(std::string& msg);
 
+  ///Locks the readers of the queue against each other.  OnRead doesn't
+  ///use it.
   Mutex mutex;
+  ///The capacity of msgQueue.  Changes take effect on Reset().
   size_t queueMax;
+  AsyncQueuePolicy policy;
   size_t msgCount;
   std::string msgLast;
-  std::list<std::string> msgQueue;
+  RingQueue<std::string> msgQueue;
+  ///Messages taken off msgQueue by PeekNewest that are still unread
+  std::deque<std::string> msgUnread;
   size_t numDroppedMsgs;
+
+ private:
+  void DrainQueue_NoLock();
 };
 
 /** @brief Asynchronous writer with queue.
@@ -57,6 +88,10 @@ class AsyncReaderQueue
  * The usage is to call SendMessage().  The writer will then somehow
  * send it to a receiver (as implemented by the subclass or some external
  * monitor).
+ *
+ * Messages are kept in a lock-free ring of reusable slots, so several
+ * threads can Send while the subclass calls OnWrite.  SendSwap and
+ * OnWrite(std::string&) move messages in and out without copying them.
  */
 class AsyncWriterQueue 
 {
@@ -64,27 +99,38 @@ class AsyncWriterQueue
   ///This will keep only the newest recvQueueMax messages sent, and will only
   ///allow an overflow of sendQueueMax messages.  Typical usage may be 1 and 1
   ///(only keep and send newest messages).
-  AsyncWriterQueue(size_t queueMax=1000);
+  AsyncWriterQueue(size_t queueMax=1000,AsyncQueuePolicy policy=AsyncDropOldest);
   virtual ~AsyncWriterQueue() {}
 
   ///Called by subclass to see whether there's a message to send
-  bool WriteAvailable() const { return !msgQueue.empty(); }
+  bool WriteAvailable() const { return !msgQueue.Empty(); }
   ///Called by subclass to get the next message to deliver to the destination
   std::string OnWrite();
-  std::string OnWrite_NoLock();
+  std::string OnWrite_NoLock() { return OnWrite(); }
+  ///Called by subclass to move the next message to deliver into msg.
+  ///Returns false if there is none.
+  bool OnWrite(std::string& msg);
 
-  ///Resets the queue and history
+  ///Resets the queue and history.  Must not be called while other threads
+  ///use the queue.
   virtual void Reset();
   ///Do some work to write messages to receiver -- must be done by subclass
   virtual void Work() {}
-  void Send(const std::string& msg);
-  int SentCount() { return msgCount+msgQueue.size(); }
-  int DeliveredCount() { return (int)msgCount; }
-
+  ///Returns false if the queue is full and the policy is AsyncBackpressure
+  bool Send(const std::string& msg);
+  ///Like Send, but moves msg onto the queue.  Afterwards msg holds a
+  ///recycled buffer.  If false is returned, msg is untouched.
+  bool SendSwap(std::string& msg);
+  int SentCount() { return (int)(AtomicLoad(&msgCount)+msgQueue.Size()); }
+  int DeliveredCount() { return (int)AtomicLoad(&msgCount); }
+
+  ///For use by subclasses; the queue itself doesn't lock
   Mutex mutex;
+  ///The capacity of msgQueue.  Changes take effect on Reset().
   size_t queueMax;
+  AsyncQueuePolicy policy;
   size_t msgCount;
-  std::list<std::string> msgQueue;
+  RingQueue<std::string> msgQueue;
   size_t numDroppedMsgs;
 };
 
@@ -99,13 +145,15 @@ class AsyncPipeQueue
 
   ///Interfaces that subclasses should use in Work()
   ///Called by subclass to add a message onto the queue
-  void OnRead(const std::string& msg) { return reader.OnRead(msg); }
-  void OnRead_NoLock(const std::string& msg) { return reader.OnRead_NoLock(msg); }
+  bool OnRead(const std::string& msg) { return reader.OnRead(msg); }
+  bool OnRead_NoLock(const std::string& msg) { return reader.OnRead_NoLock(msg); }
+  bool OnReadSwap(std::string& msg) { return reader.OnReadSwap(msg); }
   ///Called by subclass to see whether there's a message to send
   bool WriteAvailable() const { return writer.WriteAvailable(); }
   ///Called by subclass to get the next message to send to the destination
   std::string OnWrite() { return writer.OnWrite(); }
   std::string OnWrite_NoLock() { return writer.OnWrite_NoLock(); }
+  bool OnWrite(std::string& msg) { return writer.OnWrite(msg); }
 
   ///Receive functions
   int MessageCount() { return reader.MessageCount(); }
@@ -113,9 +161,11 @@ class AsyncPipeQueue
   std::string PeekNewest() { return reader.PeekNewest(); }
   std::vector<std::string> New() { return reader.New(); }
   std::string Newest() { return reader.Newest(); }
+  bool Next(std::string& msg) { return reader.Next(msg); }
 
   ///Send functions
-  void Send(const std::string& msg) { writer.Send(msg); }
+  bool Send(const std::string& msg) { return writer.Send(msg); }
+  bool SendSwap(std::string& msg) { return writer.SendSwap(msg); }
   int SentCount() { return writer.SentCount(); }
   int DeliveredCount() { return writer.DeliveredCount(); }
 
@@ -239,6 +289,79 @@ class SocketServerTransport : public TransportBase
   std::string buf;
 };
 
+/** @brief A transport protocol that hosts many clients on one thread with
+ * an epoll event loop and non-blocking sockets.  Only available on Linux.
+ *
+ * Messages are framed like SocketServerTransport (4 byte length + data),
+ * and DoWrite sends each message to all clients.  The length and data go
+ * out in one vectored send.  When a client's socket is full, the rest of
+ * the message is queued for that client, and the queue is sent in as few
+ * vectored sends as possible once the socket is writable.  Clients with
+ * more than maxPendingBytes queued are disconnected.
+ *
+ * DoRead waits up to pollTimeout seconds for events, accepts new clients,
+ * reads into each client's receive buffer, and returns one complete
+ * message, or an empty string if there is none yet.
+ *
+ * Use it as the transport of an AsyncPipeThread to serve all clients from
+ * one thread.
+ */
+class SocketEventServerTransport : public TransportBase
+{
+ public:
+  SocketEventServerTransport(const char* addr,int maxclients=64);
+  ~SocketEventServerTransport();
+  virtual bool Start();
+  virtual bool Stop();
+  virtual bool ReadReady();
+  virtual bool WriteReady();
+  ///Reads a string (4 byte length + data) from any client
+  virtual const std::string* DoRead();
+  ///Writes a string (4 byte length + data) to all clients.  Doesn't block.
+  virtual bool DoWrite(const char* str,int length);
+
+  ///A message queued for one or more clients
+  struct Frame
+  {
+    int length;
+    std::string data;
+  };
+  struct Client
+  {
+    SOCKET socket;
+    ///Received data.  Bytes [recvStart,recvEnd) are not parsed yet.
+    std::vector<char> recv;
+    size_t recvStart,recvEnd;
+    ///Frames waiting to be sent.  pendingOffset bytes of the first one
+    ///(counting the length) are already sent.
+    std::deque<SmartPointer<Frame> > pending;
+    size_t pendingOffset,pendingBytes;
+  };
+
+  std::string addr;
+  SOCKET serversocket;
+  int epollfd;
+  int maxclients;
+  double pollTimeout;
+  size_t maxPendingBytes;
+  Mutex mutex;
+  std::vector<SmartPointer<Client> > clients;
+  int currentclient;
+  std::string buf;
+  ///Sent frames kept for reuse
+  std::vector<SmartPointer<Frame> > spareFrames;
+
+ private:
+  bool NextMessage();
+  void AcceptClients();
+  bool ReadClient(Client& c);
+  bool FlushClient(Client& c);
+  void SetWaitForWrite(Client& c,bool enabled);
+  void CloseClient(Client& c);
+  void RemoveClosedClients();
+  void RecycleFrame(SmartPointer<Frame>& frame);
+};
+
 /** @brief An synchronous reader/writer.
  * User/subclass will initialize the transport protocol (usually blocking I/O)
  * by setting the transport member.
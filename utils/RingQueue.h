@@ -0,0 +1,125 @@
+#ifndef UTILS_RING_QUEUE_H
+#define UTILS_RING_QUEUE_H
+
+#include <vector>
+#include <algorithm>
+#include <KrisLibrary/errors.h>
+#include "threadutils.h"
+
+/** @brief A bounded lock-free queue of preallocated, reusable slots.
+ *
+ * Any number of threads may push and pop at the same time (this is
+ * Vyukov's bounded MPMC queue).  It is used as a single- or
+ * multiple-producer, single-consumer queue in which a producer may also
+ * pop to drop the oldest item when the queue is full.
+ *
+ * Items are moved in and out by swapping, so with std::string or
+ * std::vector items, a producer gets back the buffer that the slot held
+ * before, and in steady state no memory is allocated.
+ *
+ * Resize and Clear are not thread-safe.
+ */
+template <class T>
+class RingQueue
+{
+public:
+  RingQueue(size_t capacity=0) :head(0),tail(0) { Resize(capacity); }
+
+  ///Sets the capacity and empties the queue
+  void Resize(size_t capacity)
+  {
+    slots.resize(capacity);
+    Clear();
+  }
+
+  ///Empties the queue, keeping the items' buffers for reuse
+  void Clear()
+  {
+    for(size_t i=0;i<slots.size();i++) slots[i].seq = i;
+    head = tail = 0;
+  }
+
+  ///Swaps item into a free slot; afterwards item holds the slot's old
+  ///contents.  Returns false if the queue is full.
+  bool TryPush(T& item)
+  {
+    if(slots.empty()) return false;
+    size_t pos = AtomicLoad(&tail);
+    while(true) {
+      Slot& slot = slots[pos % slots.size()];
+      size_t seq = AtomicLoad(&slot.seq);
+      if(seq == pos) {
+        //the slot is free, try to claim it
+        if(AtomicCompareAndSwap(&tail,pos,pos+1)) {
+          std::swap(slot.value,item);
+          AtomicStore(&slot.seq,pos+1);
+          return true;
+        }
+        pos = AtomicLoad(&tail);
+      }
+      else if(seq < pos) {
+        //the slot still holds the item from one lap ago
+        return false;
+      }
+      else
+        pos = AtomicLoad(&tail);
+    }
+  }
+
+  ///Swaps the oldest item out into item.  Returns false if the queue is
+  ///empty.
+  bool TryPop(T& item)
+  {
+    if(slots.empty()) return false;
+    size_t pos = AtomicLoad(&head);
+    while(true) {
+      Slot& slot = slots[pos % slots.size()];
+      size_t seq = AtomicLoad(&slot.seq);
+      if(seq == pos+1) {
+        //the slot is filled, try to claim it
+        if(AtomicCompareAndSwap(&head,pos,pos+1)) {
+          std::swap(slot.value,item);
+          AtomicStore(&slot.seq,pos+slots.size());
+          return true;
+        }
+        pos = AtomicLoad(&head);
+      }
+      else if(seq < pos+1) {
+        //the producer hasn't filled the slot yet
+        return false;
+      }
+      else
+        pos = AtomicLoad(&head);
+    }
+  }
+
+  ///The number of items.  Only a snapshot if other threads are pushing or
+  ///popping.
+  size_t Size() const
+  {
+    size_t h = AtomicLoad(&head);
+    size_t t = AtomicLoad(&tail);
+    return (t > h ? t-h : 0);
+  }
+  inline bool Empty() const { return Size()==0; }
+  inline size_t Capacity() const { return slots.size(); }
+
+private:
+  struct Slot
+  {
+    //pos+1 when the item pushed at pos is ready to pop, and pos+capacity
+    //when the slot is free for the push at that position
+    size_t seq;
+    T value;
+  };
+
+  std::vector<Slot> slots;
+  //keep the producers' and consumers' counters on separate cache lines
+  char pad0[64];
+  size_t head;
+  char pad1[64];
+  size_t tail;
+  char pad2[64];
+};
+
+#endif
@@ -17,6 +17,7 @@ void StatCollector::clear()
   xmax=-numeric_limits<double>::infinity();
   sum=0;
   sumsquared=0;
+  digest.clear();
 }
   
 void StatCollector::collect(double x)
@@ -26,6 +27,7 @@ void StatCollector::collect(double x)
   sum += x;
   sumsquared += x*x;
   n+=1;
+  digest.collect(x);
 }
 
 void StatCollector::weightedCollect(double x,double weight)
@@ -35,6 +37,17 @@ void StatCollector::weightedCollect(double x,double weight)
   sum += x*weight;
   sumsquared += x*x*weight;
   n+=weight;
+  digest.collect(x,weight);
+}
+
+void StatCollector::merge(const StatCollector& s)
+{
+  if(s.xmin<xmin) xmin=s.xmin;
+  if(s.xmax>xmax) xmax=s.xmax;
+  sum += s.sum;
+  sumsquared += s.sumsquared;
+  n += s.n;
+  digest.merge(s.digest);
 }
 
 string StatDatabase::Concat(const string& s1,const string& s2) const
@@ -136,6 +149,19 @@ void StatDatabase::AddValue(const string& name,double val)
   d.value << val;
 }
 
+void MergeRecurse(StatDatabase::Data& data,const StatDatabase::Data& other)
+{
+  data.count += other.count;
+  data.value.merge(other.value);
+  for(ConstIterator i=other.children.begin();i!=other.children.end();i++)
+    MergeRecurse(data.children[i->first],i->second);
+}
+
+void StatDatabase::Merge(const StatDatabase& db)
+{
+  MergeRecurse(root,db.root);
+}
+
 
 int StatDatabase::GetCount(const string& name) const
 {
@@ -284,6 +310,7 @@ bool LoadRecurse(istream& in,string& name,StatDatabase::Data& data,int indent)
     string childname;
     StatDatabase::Data child;
     if(!LoadRecurse(in,childname,child,indent+2)) return false;
+    data.children[childname] = child;
     EatWhitespace(in);
     c = in.peek();
   }
@@ -319,11 +346,18 @@ bool StatDatabase::Load(istream& in)
 void StatCollector::Print(ostream& out) const
 {
   out<<"Num: "<<n<<" min: "<<minimum()<<" max: "<<maximum()<<" avg: "<<average()<<" std: "<<stddev();
+  if(!digest.empty())
+    out<<" p50: "<<quantile(0.5)<<" p99: "<<quantile(0.99)<<" p999: "<<quantile(0.999);
 }
 
 bool StatCollector::Save(ostream& out) const
 {
   out<<n<<" "<<xmin<<" "<<xmax<<" "<<sum<<" "<<sumsquared;
+  //the quantile sketch is optional, so older files can still be loaded
+  if(!digest.empty()) {
+    out<<" q ";
+    digest.Save(out);
+  }
   return (bool)out;
 }
 
@@ -335,5 +369,12 @@ bool StatCollector::Load(istream& in)
   SafeInputFloat(in,xmax);
   SafeInputFloat(in,sum);
   SafeInputFloat(in,sumsquared);
+  digest.clear();
+  if(!in) return false;
+  EatWhitespace(in);
+  if(in.peek() == 'q') {
+    in.get();
+    if(!digest.Load(in)) return false;
+  }
   return (bool)in;
 }
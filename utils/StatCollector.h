@@ -2,6 +2,7 @@
 #define UTILS_STAT_COLLECTOR_H
 
 #include <KrisLibrary/utils.h>
+#include "TDigest.h"
 #include <math.h>
 #include <ostream>
 #include <map>
@@ -12,8 +13,11 @@
  * @brief Collects statistics (min,max,mean,stddev,etc) on
  * floating-point data.
  *
- * Collects datapoints incrementally and keeps statistics in a constant-sized
- * structure.
+ * Collects datapoints incrementally and keeps statistics in a bounded-size
+ * structure.  Quantiles (e.g., median and tail latencies) are estimated with
+ * a t-digest, which keeps at most 100 centroids plus a sort buffer of up to
+ * 500 points, so each StatCollector takes a few KB.  Collectors filled on
+ * different threads can be combined with merge.
  *
  * There is a risk of numerical overflow and precision errors in the stddev
  * and variance methods, when collecting many large values.
@@ -30,6 +34,8 @@ struct StatCollector
   void collect(double x);
   void weightedCollect(double x,double weight);
 
+  void merge(const StatCollector& s);
+
   int number() const { return (int)n; }
   double minimum() const { return xmin; }
   double maximum() const { return xmax; }
@@ -39,6 +45,9 @@ struct StatCollector
 	return Max(sumsquared/n - avg*avg,0.0);  //may have numerical errors...
   }
   double stddev() const { return sqrt(variance()); }
+  ///Estimate of the q'th quantile, q in [0,1]
+  double quantile(double q) const { return digest.quantile(q); }
+  double median() const { return quantile(0.5); }
   void clear();
   
   bool Load(std::istream& in);
@@ -48,6 +57,7 @@ struct StatCollector
   double n;
   double xmin,xmax;
   double sum,sumsquared;
+  TDigest digest;
 };
 
 /** @ingroup Utils
@@ -69,6 +79,8 @@ struct StatDatabase
   void Clear();
   void Increment(const std::string& name,int inc=1);
   void AddValue(const std::string& name,double val);
+  ///Adds the counts and values of db, e.g., one filled on another thread
+  void Merge(const StatDatabase& db);
   int GetCount(const std::string& name) const;
   const StatCollector& GetValue(const std::string& name) const;
 
@@ -1,6 +1,7 @@
 #include "Subset.h"
 #include <algorithm>
 #include <errors.h>
+#include "bits.h"
 #include <assert.h>
 using namespace std;
 
@@ -148,3 +149,162 @@ ostream& operator << (ostream& out,const Subset& s)
   out<<"}";
   return out;
 }
+
+
+inline int NumWords(int maxItem) { return (maxItem+63)/64; }
+
+BitSubset::BitSubset(int _maxItem)
+  :maxItem(_maxItem),words(NumWords(_maxItem),0)
+{}
+
+BitSubset::BitSubset(const BitSubset& s)
+  :maxItem(s.maxItem),words(s.words)
+{}
+
+BitSubset::BitSubset(const Subset& s)
+  :maxItem(s.maxItem),words(NumWords(s.maxItem),0)
+{
+  for(Subset::const_iterator i=s.begin();i!=s.end();i++)
+    insert(*i);
+}
+
+BitSubset::BitSubset(const vector<bool>& bits)
+  :maxItem((int)bits.size()),words(NumWords((int)bits.size()),0)
+{
+  for(size_t i=0;i<bits.size();i++)
+    if(bits[i]) words[i>>6] |= (Word(1) << (i&63));
+}
+
+bool BitSubset::empty() const
+{
+  for(size_t i=0;i<words.size();i++)
+    if(words[i]) return false;
+  return true;
+}
+
+size_t BitSubset::size() const
+{
+  size_t n=0;
+  for(size_t i=0;i<words.size();i++)
+    n += NumBits64(words[i]);
+  return n;
+}
+
+int BitSubset::next(int item) const
+{
+  if(item >= maxItem) return maxItem;
+  size_t w = size_t(item >> 6);
+  Word bits = words[w] & (~Word(0) << (item&63));
+  while(bits == 0) {
+    w++;
+    if(w >= words.size()) return maxItem;
+    bits = words[w];
+  }
+  return int(w*64) + GetLeastBit64(bits);
+}
+
+void BitSubset::insert(int item)
+{
+  assert(item >= 0 && item < maxItem);
+  words[item>>6] |= (Word(1) << (item&63));
+}
+
+void BitSubset::remove(int item)
+{
+  if(item < 0 || item >= maxItem) return;
+  words[item>>6] &= ~(Word(1) << (item&63));
+}
+
+BitSubset::const_iterator BitSubset::find(int item) const
+{
+  if(count(item)) return const_iterator(this,item);
+  return end();
+}
+
+bool BitSubset::operator < (const BitSubset& s) const
+{
+  if(maxItem < s.maxItem) return true;
+  if(maxItem > s.maxItem) return false;
+  //lexicographic comparison of the sorted item lists: the lists agree up to
+  //the lowest differing bit, and the list that contains that item is smaller
+  //unless the other list ends there
+  for(size_t i=0;i<words.size();i++) {
+    Word diff = words[i] ^ s.words[i];
+    if(diff == 0) continue;
+    int b = GetLeastBit64(diff);
+    const BitSubset& other = ((words[i] & (Word(1)<<b)) ? s : *this);
+    bool otherContinues = (other.next(int(i*64)+b+1) < maxItem);
+    if(&other == &s) return otherContinues;
+    else return !otherContinues;
+  }
+  return false;
+}
+
+bool BitSubset::operator > (const BitSubset& s) const
+{
+  return s < *this;
+}
+
+bool BitSubset::operator == (const BitSubset& s) const
+{
+  return maxItem == s.maxItem && words==s.words;
+}
+
+bool BitSubset::operator != (const BitSubset& s) const
+{
+  return !(s==*this);
+}
+
+BitSubset BitSubset::operator + (const BitSubset& s) const
+{
+  const BitSubset& big = (maxItem >= s.maxItem ? *this : s);
+  const BitSubset& small = (maxItem >= s.maxItem ? s : *this);
+  BitSubset res(big);
+  for(size_t i=0;i<small.words.size();i++)
+    res.words[i] |= small.words[i];
+  return res;
+}
+
+BitSubset BitSubset::operator - (const BitSubset& s) const
+{
+  BitSubset res(*this);
+  size_t n = std::min(words.size(),s.words.size());
+  for(size_t i=0;i<n;i++)
+    res.words[i] &= ~s.words[i];
+  return res;
+}
+
+BitSubset BitSubset::operator & (const BitSubset& s) const
+{
+  BitSubset res(std::min(maxItem,s.maxItem));
+  for(size_t i=0;i<res.words.size();i++)
+    res.words[i] = words[i] & s.words[i];
+  return res;
+}
+
+BitSubset BitSubset::operator - () const
+{
+  BitSubset res(maxItem);
+  for(size_t i=0;i<words.size();i++)
+    res.words[i] = ~words[i];
+  if(maxItem & 63)
+    res.words.back() &= (Word(1) << (maxItem&63))-1;
+  return res;
+}
+
+bool BitSubset::is_subset(const BitSubset& s) const
+{
+  if(maxItem > s.maxItem) return false;
+  for(size_t i=0;i<words.size();i++)
+    if(words[i] & ~s.words[i]) return false;
+  return true;
+}
+
+ostream& operator << (ostream& out,const BitSubset& s)
+{
+  out<<"{";
+  for(BitSubset::const_iterator i=s.begin();i!=s.end();i++)
+    out<<*i<<" ";
+  out<<"}";
+  return out;
+}
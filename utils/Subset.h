@@ -61,5 +61,75 @@ struct Subset
 
 std::ostream& operator << (std::ostream& out,const Subset& s);
 
+/**@brief A finite subset of numbered items stored as a dense bit vector,
+ * with the same interface as Subset.
+ *
+ * Union, intersection, difference, and subset tests operate on 64 items at
+ * a time, and size() counts bits with the hardware popcount where available.
+ * Most efficient when maxItem is small (e.g., the number of constraints of
+ * a CSpace) or the subset is dense.  Iteration visits the items in
+ * increasing order, and the comparison operators order subsets in the same
+ * way as Subset, so the two can be used interchangeably in sorted
+ * containers and searches.
+ */
+struct BitSubset
+{
+  typedef unsigned long long Word;
+
+  /// Iterates over the items of the subset in increasing order
+  class const_iterator
+  {
+  public:
+    const_iterator() : s(NULL),item(0) {}
+    const_iterator(const BitSubset* _s,int _item) : s(_s),item(_item) {}
+    inline int operator *() const { return item; }
+    inline const_iterator& operator ++() { item = s->next(item+1); return *this; }
+    inline const_iterator operator ++(int) { const_iterator temp=*this; ++(*this); return temp; }
+    inline bool operator == (const const_iterator& it) const { return item == it.item; }
+    inline bool operator != (const const_iterator& it) const { return item != it.item; }
+
+    const BitSubset* s;
+    int item;
+  };
+  typedef const_iterator iterator;
+
+  BitSubset(int maxItem=0);
+  BitSubset(const BitSubset& s);
+  BitSubset(const Subset& s);
+  BitSubset(const std::vector<bool>& bits);
+  inline const_iterator begin() const { return const_iterator(this,next(0)); }
+  inline const_iterator end() const { return const_iterator(this,maxItem); }
+  bool empty() const;
+  size_t size() const;
+  bool operator < (const BitSubset& s) const;
+  bool operator > (const BitSubset& s) const;
+  bool operator == (const BitSubset& s) const;
+  bool operator != (const BitSubset& s) const;
+  //set union
+  BitSubset operator + (const BitSubset& s) const;
+  //set complement
+  BitSubset operator - () const;
+  //set difference
+  BitSubset operator - (const BitSubset& s) const;
+  //set intersection
+  BitSubset operator & (const BitSubset& s) const;
+  void insert(int item);
+  void insert_end(int item) { insert(item); }
+  void remove(int item);
+  const_iterator find(int item) const;
+  inline void erase(const_iterator it) { remove(*it); }
+  inline size_t count(int item) const { return (item >= 0 && item < maxItem && (words[item>>6] & (Word(1)<<(item&63))) ? 1 : 0); }
+  bool is_subset(const BitSubset& s) const;
+  ///Returns the first item >= item, or maxItem if there is none
+  int next(int item) const;
+
+  int maxItem;
+  ///Bit i%64 of word i/64 is set if item i is in the subset.  Bits at or
+  ///beyond maxItem are always zero.
+  std::vector<Word> words;
+};
+
+std::ostream& operator << (std::ostream& out,const BitSubset& s);
+
 #endif
 
@@ -0,0 +1,158 @@
+#include "TDigest.h"
+#include <algorithm>
+#include <limits>
+#include <math/math.h>
+#include "ioutils.h"
+using namespace std;
+
+//number of buffered points, relative to the compression
+const static int kBufferFactor = 5;
+
+TDigest::TDigest(double _compression)
+  :compression(_compression),totalWeight(0),xmin(numeric_limits<double>::infinity()),xmax(-numeric_limits<double>::infinity())
+{}
+
+void TDigest::clear()
+{
+  totalWeight = 0;
+  xmin = numeric_limits<double>::infinity();
+  xmax = -numeric_limits<double>::infinity();
+  centroids.clear();
+  buffer.clear();
+}
+
+bool TDigest::BufferFull() const
+{
+  return buffer.size() >= (size_t)(kBufferFactor*compression);
+}
+
+//the k1 scale function k(q) = compression/(2 pi) asin(2q-1), which ranges
+//over [-compression/4,compression/4]
+static double ScaleK(double q,double compression)
+{
+  return compression/(2.0*Math::Pi)*Math::Asin(2.0*q-1.0);
+}
+
+//the inverse of ScaleK, clamped to [0,1]
+static double ScaleQ(double k,double compression)
+{
+  double x = k*2.0*Math::Pi/compression;
+  if(x >= 0.5*Math::Pi) return 1;
+  if(x <= -0.5*Math::Pi) return 0;
+  return 0.5*(Math::Sin(x)+1.0);
+}
+
+void TDigest::collect(double x,double weight)
+{
+  if(weight <= 0) return;
+  if(x < xmin) xmin = x;
+  if(x > xmax) xmax = x;
+  totalWeight += weight;
+  Centroid c;
+  c.mean = x;
+  c.weight = weight;
+  buffer.push_back(c);
+  if(BufferFull()) compress();
+}
+
+void TDigest::merge(const TDigest& d)
+{
+  if(d.empty()) return;
+  if(d.xmin < xmin) xmin = d.xmin;
+  if(d.xmax > xmax) xmax = d.xmax;
+  totalWeight += d.totalWeight;
+  buffer.insert(buffer.end(),d.centroids.begin(),d.centroids.end());
+  buffer.insert(buffer.end(),d.buffer.begin(),d.buffer.end());
+  if(BufferFull()) compress();
+}
+
+void TDigest::compress() const
+{
+  if(buffer.empty()) return;
+  //the centroids are already sorted, so only the buffer needs sorting
+  sort(buffer.begin(),buffer.end());
+  vector<Centroid> all(buffer.size()+centroids.size());
+  std::merge(buffer.begin(),buffer.end(),centroids.begin(),centroids.end(),all.begin());
+  centroids.resize(0);
+  double W = 0;
+  for(size_t i=0;i<all.size();i++) W += all[i].weight;
+  //merge neighbors while the merged centroid spans at most one unit of k,
+  //i.e., its weight stays below W*ScaleQ(k(q0)+1) where q0 is the quantile
+  //at its left edge.  Each pair of adjacent centroids spans more than one
+  //unit, so there are at most compression of them.
+  Centroid cur = all[0];
+  double wSoFar = 0;
+  double wLimit = W*ScaleQ(ScaleK(0,compression)+1,compression);
+  for(size_t i=1;i<all.size();i++) {
+    const Centroid& next = all[i];
+    double w = cur.weight+next.weight;
+    if(wSoFar+w <= wLimit) {
+      cur.weight = w;
+      cur.mean += (next.mean-cur.mean)*next.weight/w;
+    }
+    else {
+      wSoFar += cur.weight;
+      centroids.push_back(cur);
+      cur = next;
+      wLimit = W*ScaleQ(ScaleK(wSoFar/W,compression)+1,compression);
+    }
+  }
+  centroids.push_back(cur);
+  buffer.resize(0);
+}
+
+double TDigest::quantile(double q) const
+{
+  if(empty()) return numeric_limits<double>::quiet_NaN();
+  compress();
+  if(q <= 0) return xmin;
+  if(q >= 1) return xmax;
+  if(centroids.size() == 1) return centroids[0].mean;
+  //each centroid's weight is spread around its mean, so interpolate
+  //between the centers of neighboring centroids
+  double index = q*totalWeight;
+  double halfFirst = 0.5*centroids[0].weight;
+  if(index < halfFirst)
+    return xmin + (centroids[0].mean-xmin)*index/halfFirst;
+  double wSoFar = halfFirst;
+  for(size_t i=0;i+1<centroids.size();i++) {
+    double dw = 0.5*(centroids[i].weight+centroids[i+1].weight);
+    if(index < wSoFar+dw) {
+      double u = (index-wSoFar)/dw;
+      return centroids[i].mean + u*(centroids[i+1].mean-centroids[i].mean);
+    }
+    wSoFar += dw;
+  }
+  const Centroid& last = centroids.back();
+  double halfLast = 0.5*last.weight;
+  double u = (index-wSoFar)/halfLast;
+  if(u > 1) u = 1;
+  return last.mean + u*(xmax-last.mean);
+}
+
+bool TDigest::Save(ostream& out) const
+{
+  compress();
+  out<<compression<<" "<<totalWeight<<" "<<xmin<<" "<<xmax<<" "<<centroids.size();
+  for(size_t i=0;i<centroids.size();i++)
+    out<<" "<<centroids[i].mean<<" "<<centroids[i].weight;
+  return (bool)out;
+}
+
+bool TDigest::Load(istream& in)
+{
+  clear();
+  size_t n;
+  SafeInputFloat(in,compression);
+  SafeInputFloat(in,totalWeight);
+  SafeInputFloat(in,xmin);
+  SafeInputFloat(in,xmax);
+  in>>n;
+  if(!in) return false;
+  centroids.resize(n);
+  for(size_t i=0;i<n;i++) {
+    SafeInputFloat(in,centroids[i].mean);
+    SafeInputFloat(in,centroids[i].weight);
+  }
+  return (bool)in;
+}
@@ -0,0 +1,55 @@
+#ifndef UTILS_TDIGEST_H
+#define UTILS_TDIGEST_H
+
+#include <vector>
+#include <iostream>
+
+/** @ingroup Utils
+ * @brief A mergeable streaming sketch of a distribution on the real line
+ * that estimates quantiles, most accurately at the tails (Dunning's
+ * merging t-digest).
+ *
+ * Points are appended to a buffer, and when the buffer is full it is
+ * sorted and merged into a list of weighted centroids.  Centroid sizes are
+ * bounded by the scale function k(q) = compression/(2 pi) asin(2q-1): a
+ * centroid may span at most one unit of k, so centroids near q=0 and q=1
+ * stay small and tail quantiles are accurate.  There are at most
+ * compression centroids regardless of the number of points.  The buffer
+ * holds 5*compression points, and the amortized cost of a collect is
+ * O(log compression).
+ *
+ * Two digests are combined with merge, e.g., when each thread keeps its
+ * own digest.  quantile is const but may compress the buffer, so a digest
+ * must not be read from one thread while another thread modifies it.
+ */
+struct TDigest
+{
+  struct Centroid
+  {
+    inline bool operator < (const Centroid& c) const { return mean < c.mean; }
+    double mean,weight;
+  };
+
+  TDigest(double compression=100);
+  void collect(double x,double weight=1.0);
+  void merge(const TDigest& d);
+  void clear();
+  bool empty() const { return totalWeight == 0; }
+  ///Returns an estimate of the q'th quantile, for q in [0,1]
+  double quantile(double q) const;
+  ///Merges the buffered points into the centroids
+  void compress() const;
+  bool BufferFull() const;
+
+  bool Load(std::istream& in);
+  bool Save(std::ostream& out) const;
+
+  double compression;
+  double totalWeight;
+  double xmin,xmax;
+  //sorted centroids and unmerged points; compress() modifies these
+  mutable std::vector<Centroid> centroids;
+  mutable std::vector<Centroid> buffer;
+};
+
+#endif
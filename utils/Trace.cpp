@@ -7,9 +7,28 @@
 #include <errors.h>
 using namespace std;
 
-_DECLARE_READ_WRITE_FILE_BASIC(StatCollector)
+//trace files only store the moments of a StatCollector, not its quantile
+//sketch
+template <> bool ReadFile(File& f, StatCollector& s)
+{
+  s.clear();
+  if(!ReadFile(f,s.n)) return false;
+  if(!ReadFile(f,s.xmin)) return false;
+  if(!ReadFile(f,s.xmax)) return false;
+  if(!ReadFile(f,s.sum)) return false;
+  if(!ReadFile(f,s.sumsquared)) return false;
+  return true;
+}
 
-_DEFINE_READ_WRITE_FILE_BASIC(StatCollector)
+template <> bool WriteFile(File& f, const StatCollector& s)
+{
+  if(!WriteFile(f,s.n)) return false;
+  if(!WriteFile(f,s.xmin)) return false;
+  if(!WriteFile(f,s.xmax)) return false;
+  if(!WriteFile(f,s.sum)) return false;
+  if(!WriteFile(f,s.sumsquared)) return false;
+  return true;
+}
 
 
 
@@ -28,6 +28,16 @@ inline int NumBits(unsigned int x)
   return n;
 }
 
+/// Returns the number of nonzero bits in the 64-bit word x
+inline int NumBits64(unsigned long long x)
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll(x);
+#else
+  return NumBits((unsigned int)x) + NumBits((unsigned int)(x >> 32));
+#endif
+}
+
 /// Returns the number of bits where x and y differ
 inline int HammingDistance(unsigned int x,unsigned int y)
 {
@@ -69,6 +79,22 @@ inline int GetLeastBit(unsigned int x)
     return GetLeastBit16(x>>16)+16;
 }
 
+/** @brief Returns the index of the least significant bit of the 64-bit word
+ * x, or -1 if x=0.
+ */
+inline int GetLeastBit64(unsigned long long x)
+{
+  if(x == 0) return -1;
+#if defined(__GNUC__)
+  return __builtin_ctzll(x);
+#else
+  if(x & 0xffffffffULL)
+    return GetLeastBit((unsigned int)x);
+  else
+    return GetLeastBit((unsigned int)(x>>32))+32;
+#endif
+}
+
 inline int GetGreatestBit4(unsigned int x)
 {
   if(x & 0x8) return 3;
@@ -104,6 +130,22 @@ inline int GetGreatestBit(unsigned int x)
     return GetGreatestBit16(x);
 }
 
+/** @brief Returns the index of the most significant bit of the 64-bit word
+ * x, or -1 if x=0.
+ */
+inline int GetGreatestBit64(unsigned long long x)
+{
+  if(x == 0) return -1;
+#if defined(__GNUC__)
+  return 63-__builtin_clzll(x);
+#else
+  if(x >> 32)
+    return GetGreatestBit((unsigned int)(x>>32))+32;
+  else
+    return GetGreatestBit((unsigned int)x);
+#endif
+}
+
 
 /** @brief For integer iterators in the range [begin,end),
  * sets the bits corresponding to the indices.
@@ -5,6 +5,7 @@
 #include <strsafe.h>
 #include <shlobj.h>    // for SHCreateDirectoryEx
 #include <direct.h>
+#include <stdio.h>
 #define GetCurrentDir _getcwd
 #else
 #include <sys/unistd.h>
@@ -14,6 +15,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <dirent.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #define GetCurrentDir getcwd
 #endif //_WIN32
 #ifdef __APPLE__
@@ -249,4 +252,56 @@ std::string GetWorkingDirectory()
   return cCurrentPath;
 }
 
+FileView::FileView()
+  :data(NULL),size(0),mapped(false)
+{}
+
+FileView::~FileView()
+{
+  Close();
+}
+
+bool FileView::Open(const char* fn)
+{
+  Close();
+#ifndef _WIN32
+  int fd = open(fn,O_RDONLY);
+  if(fd < 0) return false;
+  struct stat st;
+  if(fstat(fd,&st) != 0) { close(fd); return false; }
+  size = (size_t)st.st_size;
+  if(size > 0) {
+    void* ptr = mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+    if(ptr == MAP_FAILED) { close(fd); size = 0; return false; }
+    madvise(ptr,size,MADV_SEQUENTIAL);
+    data = (const char*)ptr;
+    mapped = true;
+  }
+  close(fd);
+  return true;
+#else
+  FILE* f = fopen(fn,"rb");
+  if(!f) return false;
+  fseek(f,0,SEEK_END);
+  size = (size_t)ftell(f);
+  fseek(f,0,SEEK_SET);
+  buffer.resize(size);
+  if(size > 0 && fread(&buffer[0],1,size,f) != size) { fclose(f); size = 0; return false; }
+  fclose(f);
+  if(size > 0) data = &buffer[0];
+  return true;
+#endif //_WIN32
+}
+
+void FileView::Close()
+{
+#ifndef _WIN32
+  if(mapped) munmap((void*)data,size);
+#endif //_WIN32
+  buffer.clear();
+  data = NULL;
+  size = 0;
+  mapped = false;
+}
+
 } // namespace FileUtils
@@ -53,6 +53,28 @@ bool ListDirectory(const char* path,std::vector<std::string>& items);
 /// Returns the current working directory
 std::string GetWorkingDirectory();
 
+/** @brief A read-only view of the contents of a file.  On POSIX systems the
+ * file is memory-mapped, otherwise it is read into a buffer.
+ */
+class FileView
+{
+public:
+  FileView();
+  ~FileView();
+  /// Opens the file.  Returns true if successful.
+  bool Open(const char* fn);
+  void Close();
+
+  const char* data;
+  size_t size;
+  bool mapped;
+  std::vector<char> buffer;
+
+private:
+  FileView(const FileView&);
+  FileView& operator = (const FileView&);
+};
+
 } //namespace FileUtils
 
 /*@}*/
@@ -1,6 +1,8 @@
 #ifndef THREAD_UTILS_H
 #define THREAD_UTILS_H
 
+#include <stddef.h>
+
 #ifndef USE_BOOST_THREADS
 #ifndef USE_PTHREADS
 #ifdef _WIN32
@@ -23,11 +25,13 @@ typedef boost::interprocess::interprocess_condition Condition;
 inline Thread ThreadStart(void* (*fn)(void*),void* data=NULL) { return boost::thread(fn,data); }
 inline void ThreadJoin(Thread& thread) { thread.join(); }
 inline void ThreadYield() { boost::this_thread::yield(); }
+inline int ThreadHardwareConcurrency() { int n=(int)boost::thread::hardware_concurrency(); return (n > 0 ? n : 1); }
 
 #endif //USE_BOOST_THREADS
 
 #if USE_PTHREADS
 #include <pthread.h>
+#include <unistd.h>
 typedef pthread_t Thread;
 inline Thread ThreadStart(void* (*fn)(void*),void* data=NULL) {
 	pthread_t thread;
@@ -36,6 +40,7 @@ inline Thread ThreadStart(void* (*fn)(void*),void* data=NULL) {
 }
 inline void ThreadJoin(Thread& thread) { pthread_join(thread,NULL); }
 inline void ThreadYield() { pthread_yield(); }
+inline int ThreadHardwareConcurrency() { long n=sysconf(_SC_NPROCESSORS_ONLN); return (n > 0 ? (int)n : 1); }
 struct Mutex
 {
   Mutex() { mutex = PTHREAD_MUTEX_INITIALIZER; }
@@ -66,6 +71,39 @@ struct Condition
 
 #endif //USE_PTHREADS
 
+/* Atomic operations on a size_t shared between threads, for lock-free
+ * structures like RingQueue.  Loads have acquire semantics, stores have
+ * release semantics, and the read-modify-write operations are sequentially
+ * consistent.  AtomicAdd returns the new value.  The size_t must not be
+ * accessed in any other way while other threads use it.
+ */
+#if defined(_MSC_VER)
+#include <intrin.h>
+#ifdef _WIN64
+#define ATOMIC_SIZE_T_TYPE __int64
+#define ATOMIC_COMPARE_EXCHANGE _InterlockedCompareExchange64
+#define ATOMIC_EXCHANGE_ADD _InterlockedExchangeAdd64
+#else
+#define ATOMIC_SIZE_T_TYPE long
+#define ATOMIC_COMPARE_EXCHANGE _InterlockedCompareExchange
+#define ATOMIC_EXCHANGE_ADD _InterlockedExchangeAdd
+#endif
+//aligned loads and stores are atomic on x86, so only the compiler
+//needs to be kept from reordering them
+inline size_t AtomicLoad(const size_t* x) { size_t v=*(const volatile size_t*)x; _ReadWriteBarrier(); return v; }
+inline void AtomicStore(size_t* x,size_t v) { _ReadWriteBarrier(); *(volatile size_t*)x=v; }
+inline bool AtomicCompareAndSwap(size_t* x,size_t expected,size_t desired) { return (size_t)ATOMIC_COMPARE_EXCHANGE((volatile ATOMIC_SIZE_T_TYPE*)x,(ATOMIC_SIZE_T_TYPE)desired,(ATOMIC_SIZE_T_TYPE)expected) == expected; }
+inline size_t AtomicAdd(size_t* x,size_t v) { return (size_t)ATOMIC_EXCHANGE_ADD((volatile ATOMIC_SIZE_T_TYPE*)x,(ATOMIC_SIZE_T_TYPE)v)+v; }
+#undef ATOMIC_SIZE_T_TYPE
+#undef ATOMIC_COMPARE_EXCHANGE
+#undef ATOMIC_EXCHANGE_ADD
+#else
+inline size_t AtomicLoad(const size_t* x) { return __atomic_load_n(x,__ATOMIC_ACQUIRE); }
+inline void AtomicStore(size_t* x,size_t v) { __atomic_store_n(x,v,__ATOMIC_RELEASE); }
+inline bool AtomicCompareAndSwap(size_t* x,size_t expected,size_t desired) { return __atomic_compare_exchange_n(x,&expected,desired,false,__ATOMIC_SEQ_CST,__ATOMIC_SEQ_CST); }
+inline size_t AtomicAdd(size_t* x,size_t v) { return __atomic_add_fetch(x,v,__ATOMIC_SEQ_CST); }
+#endif
+
 #ifdef WIN32
 void ThreadSleep(double duration);
 #else